@@ -0,0 +1,105 @@
+#include "AllocationCounter.h"
+
+#if ALLOCATION_COUNTER_ENABLED
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+// Plain atomics of trivial types, so they need no construction before the first allocation of the process
+static std::atomic<bool> counting(false);
+static std::atomic<int> allocations(0);
+
+void AllocationCounter::Start()
+{
+	allocations.store(0);
+	counting.store(true);
+}
+
+int AllocationCounter::Stop()
+{
+	counting.store(false);
+
+	return allocations.load();
+}
+
+void* operator new(size_t size)
+{
+	if (counting.load(std::memory_order_relaxed))
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Give the new handler the chance to free some memory and try again, the way the allocator it replaces does
+	for (;;)
+	{
+		void* memory = malloc(size ? size : 1);
+		if (memory)
+		{
+			return memory;
+		}
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+		{
+			throw std::bad_alloc();
+		}
+
+		handler();
+	}
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (...)
+	{
+		return 0;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+#else
+
+void AllocationCounter::Start()
+{
+}
+
+int AllocationCounter::Stop()
+{
+	return -1;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+// The counter replaces the global new and delete, so it is only built into the debug and profile configurations, which
+// define PROFILE. Elsewhere the allocator is the one the runtime comes with and nothing is counted.
+#if defined(PROFILE)
+#define ALLOCATION_COUNTER_ENABLED 1
+#else
+#define ALLOCATION_COUNTER_ENABLED 0
+#endif
+
+// Counts the heap allocations made through new between starting and stopping, so code that is meant to run without
+// allocating can be checked. The count is shared by every thread, so the job system's workers are counted along with
+// the thread that started it, as is anything else allocating at the same time. Outside of a count the cost of an
+// allocation is a check of one flag.
+class AllocationCounter
+{
+public:
+	static void Start();
+
+	// Returns the number of allocations since the counter was started, or -1 when the counter is not built in
+	static int Stop();
+
+	static bool IsEnabled() { return ALLOCATION_COUNTER_ENABLED != 0; }
+};
@@ -0,0 +1,128 @@
+#include "AnimationStateMachine.h"
+
+AnimationStateMachine::AnimationStateMachine()
+{
+	_layers = 0;
+	_state = -1;
+	_fadeTime = 0.0f;
+	_fadeElapsed = 0.0f;
+}
+
+void AnimationStateMachine::Initialize(Skeleton::AnimationLayer* layers)
+{
+	_layers = layers;
+	_stateClips.clear();
+	_transitions.clear();
+	_state = -1;
+	_fadeTime = 0.0f;
+	_fadeElapsed = 0.0f;
+}
+
+int AnimationStateMachine::AddState(int clip)
+{
+	_stateClips.push_back(clip);
+
+	return (int)_stateClips.size() - 1;
+}
+
+void AnimationStateMachine::AddTransition(int from, int to, float fadeTime)
+{
+	Transition transition = { from, to, fadeTime };
+
+	_transitions.push_back(transition);
+}
+
+bool AnimationStateMachine::SetState(int state)
+{
+	if (!_layers || state < 0 || state >= (int)_stateClips.size())
+	{
+		return false;
+	}
+
+	if (state == _state)
+	{
+		return true;
+	}
+
+	float fadeTime = (_state >= 0) ? GetFadeTime(_state, state) : 0.0f;
+	Skeleton::AnimationLayer layer = { _stateClips[state], 0.0f, 1.0f, AnimationBlend_Override, -1 };
+	Skeleton::AnimationLayer empty = { -1, 0.0f, 0.0f, AnimationBlend_Override, -1 };
+
+	_state = state;
+
+	if (fadeTime <= 0.0f)
+	{
+		_layers[0] = layer;
+		_layers[1] = empty;
+		_fadeTime = 0.0f;
+
+		return true;
+	}
+
+	// A fade that is still going is cut short, keeping the clip it was fading into to fade out of
+	if (IsFading())
+	{
+		_layers[0] = _layers[1];
+		_layers[0].Weight = 1.0f;
+	}
+
+	layer.Weight = 0.0f;
+	_layers[1] = layer;
+	_fadeTime = fadeTime;
+	_fadeElapsed = 0.0f;
+
+	return true;
+}
+
+void AnimationStateMachine::Update(float deltaTime)
+{
+	if (!IsFading())
+	{
+		return;
+	}
+
+	_fadeElapsed += deltaTime;
+
+	// Once the fade is over the new clip takes the first layer over at its full weight
+	if (_fadeElapsed >= _fadeTime)
+	{
+		Skeleton::AnimationLayer empty = { -1, 0.0f, 0.0f, AnimationBlend_Override, -1 };
+
+		_layers[0] = _layers[1];
+		_layers[0].Weight = 1.0f;
+		_layers[1] = empty;
+		_fadeTime = 0.0f;
+
+		return;
+	}
+
+	// Ease in and out of the fade, so neither clip starts or stops moving all at once
+	float t = _fadeElapsed / _fadeTime;
+	_layers[1].Weight = t * t * (3.0f - (2.0f * t));
+}
+
+float AnimationStateMachine::GetFadeTime(int from, int to) const
+{
+	float fadeTime = 0.0f;
+
+	for (size_t i = 0; i < _transitions.size(); i++)
+	{
+		const Transition& transition = _transitions[i];
+		if (transition.To != to)
+		{
+			continue;
+		}
+
+		if (transition.From == from)
+		{
+			return transition.FadeTime;
+		}
+
+		if (transition.From == ANY_STATE)
+		{
+			fadeTime = transition.FadeTime;
+		}
+	}
+
+	return fadeTime;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Skeleton.h"
+
+#include <vector>
+
+// Plays one clip of a skeleton at a time, cross-fading from one to the next as the state changes. Each state plays a
+// clip, and a transition between two states gives the time the fade takes, with changes that have no transition
+// cutting straight to the new clip. The machine plays on the first two of the layers it is given, the clip it is
+// leaving on the first and the clip it is going to on the second, leaving the layers above them for additive and masked
+// clips. The layers can be those of the skeleton or of any instance of it, so each character of a crowd can have a
+// machine of its own.
+class AnimationStateMachine
+{
+public:
+	AnimationStateMachine();
+
+	// The layers are those of a skeleton or instance, which has to outlive the machine
+	void Initialize(Skeleton::AnimationLayer* layers);
+
+	// Adds a state playing a clip of the skeleton, and returns its index
+	int AddState(int clip);
+
+	// Fades from one state to another over a time, with ANY_STATE as the first meaning from every state that has no
+	// transition of its own to the second
+	void AddTransition(int from, int to, float fadeTime);
+
+	// Moves to a state, cutting to it when the machine has no state yet. Changing state during a fade starts the new
+	// fade from the clip that was fading in. Returns false when there is no such state.
+	bool SetState(int state);
+
+	// Moves the fade on. The skeleton or instance moves the clips on itself when it is updated.
+	void Update(float deltaTime);
+
+	int GetState() const { return _state; }
+	bool IsFading() const { return _fadeTime > 0.0f; }
+
+	static const int ANY_STATE = -1;
+
+private:
+	struct Transition
+	{
+		int From;
+		int To;
+		float FadeTime;
+	};
+
+	float GetFadeTime(int from, int to) const;
+
+	Skeleton::AnimationLayer*	_layers;
+
+	std::vector<int>			_stateClips;
+	std::vector<Transition>		_transitions;
+
+	// The state being played, and how long the fade into it takes and has taken, with no fade time once it is over
+	int							_state;
+	float						_fadeTime;
+	float						_fadeElapsed;
+};
@@ -0,0 +1,521 @@
+#include "BinaryVoxelMesher.h"
+
+#include <string.h>
+
+// Index of the lowest set bit in a mask that is not zero
+static inline int LowestBit(BinaryVoxelMesher::Mask mask)
+{
+	unsigned long index;
+
+#if defined(_M_X64)
+	_BitScanForward64(&index, mask);
+#else
+	if (!_BitScanForward(&index, (unsigned long)mask))
+	{
+		_BitScanForward(&index, (unsigned long)(mask >> 32));
+		index += 32;
+	}
+#endif
+
+	return (int)index;
+}
+
+// The two axes other than the given one, in ascending order
+static inline void GetOtherAxes(int axis, int& first, int& second)
+{
+	first = (axis == 0) ? 1 : 0;
+	second = (axis == 2) ? 1 : 2;
+}
+
+// The full detail voxel a face of a voxel scaled up lies on, which is the last one along the faces axis when the face
+// looks up it
+static inline void ScaleVoxel(int face, const int coord[3], int scale, int voxel[3])
+{
+	for (int i = 0; i < 3; i++)
+	{
+		voxel[i] = coord[i] * scale;
+	}
+
+	if (VoxelMesher::FACES[face].Sign > 0)
+	{
+		voxel[VoxelMesher::FACES[face].Axis] += scale - 1;
+	}
+}
+
+BinaryVoxelMesher::BinaryVoxelMesher()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		_columns[i] = new Mask[MAX_SIZE * MAX_SIZE];
+	}
+
+	for (int i = 0; i < VoxelMesher::Face_Count; i++)
+	{
+		_faces[i] = new Mask[MAX_SIZE * MAX_SIZE];
+	}
+
+	_planes = new Mask[16 * MAX_SIZE * MAX_SIZE]();
+	memset(_typeUsed, 0, sizeof(_typeUsed));
+
+	_shades = new unsigned short[MAX_SIZE * MAX_SIZE * MAX_SIZE];
+	_shadedRows = new Mask[MAX_SIZE * MAX_SIZE]();
+	_paddedColumns = new Mask[VoxelChunk::PADDED_SIZE * VoxelChunk::PADDED_SIZE];
+
+	for (int i = 0; i < VoxelMesher::Face_Count; i++)
+	{
+		_occluded[i] = new Mask[MAX_SIZE * MAX_SIZE];
+	}
+
+	_chunkColumns = new VoxelChunk::Column[VoxelChunk::CHUNK_AREA];
+	_chunkBlockTypes = new unsigned char[VoxelChunk::CHUNK_VOLUME / 2];
+}
+
+BinaryVoxelMesher::~BinaryVoxelMesher()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		delete[] _columns[i];
+		_columns[i] = 0;
+	}
+
+	for (int i = 0; i < VoxelMesher::Face_Count; i++)
+	{
+		delete[] _faces[i];
+		_faces[i] = 0;
+	}
+
+	delete[] _planes;
+	_planes = 0;
+
+	delete[] _shades;
+	_shades = 0;
+	delete[] _shadedRows;
+	_shadedRows = 0;
+	delete[] _paddedColumns;
+	_paddedColumns = 0;
+
+	for (int i = 0; i < VoxelMesher::Face_Count; i++)
+	{
+		delete[] _occluded[i];
+		_occluded[i] = 0;
+	}
+
+	delete[] _chunkColumns;
+	_chunkColumns = 0;
+	delete[] _chunkBlockTypes;
+	_chunkBlockTypes = 0;
+}
+
+void BinaryVoxelMesher::CreateMesh(const VoxelChunk& chunk, bool greedy, VoxelChunk::MeshData& mesh)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	const VoxelChunk::Column* columns = chunk.GetColumns();
+	const unsigned char* blockTypes = chunk.GetBlockTypes();
+	Mask* zColumns = _columns[2];
+
+	// Chunks that are not held densely are written out into scratch memory first, which is quicker than
+	// looking every column up in turn
+	if (!columns)
+	{
+		chunk.CopyVoxels(_chunkColumns, _chunkBlockTypes);
+		columns = _chunkColumns;
+		blockTypes = _chunkBlockTypes;
+	}
+
+	// Widen the chunks columns straight into the z columns
+	for (int i = 0; i < VoxelChunk::CHUNK_AREA; i++)
+	{
+		zColumns[i] = columns[i];
+	}
+
+	for (int face = 0; face < VoxelMesher::Face_Count; face++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			_borders[(face * size) + i] = chunk.GetBorder(face, i);
+		}
+	}
+
+	// Pad the columns out with the borders, and the edges and corners from the chunks diagonally across, which
+	// the corners of the faces along the sides of the chunk are occluded by
+	const int padded = VoxelChunk::PADDED_SIZE;
+
+	for (int x = -1; x <= size; x++)
+	{
+		for (int y = -1; y <= size; y++)
+		{
+			Mask& column = _paddedColumns[((x + 1) * padded) + y + 1];
+
+			if (x < 0 || y < 0 || x >= size || y >= size)
+			{
+				column = chunk.GetPaddedColumn(x, y);
+				continue;
+			}
+
+			column = (zColumns[(x * size) + y] << 1) | ((chunk.GetBorder(VoxelMesher::Face_NegativeZ, x) >> y) & 1) |
+				((Mask)((chunk.GetBorder(VoxelMesher::Face_PositiveZ, x) >> y) & 1) << (size + 1));
+		}
+	}
+
+	Shading shading;
+	shading.PaddedColumns = _paddedColumns;
+	shading.Light = chunk.GetMeshLight();
+
+	CreateMesh(size, zColumns, blockTypes, _borders, &shading, 1, greedy, mesh);
+}
+
+void BinaryVoxelMesher::CreateMesh(int size, const Mask* zColumns, const unsigned char* blockTypes, const Mask* borders, const Shading* shading,
+	int scale, bool greedy, VoxelChunk::MeshData& mesh)
+{
+	mesh.Clear();
+
+	if (size <= 0 || size * scale > MAX_SIZE)
+	{
+		return;
+	}
+
+	BuildAxisColumns(size, zColumns);
+	BuildFaceMasks(size, borders);
+
+	if (shading)
+	{
+		BuildOcclusionMasks(size, *shading);
+	}
+
+	if (greedy)
+	{
+		EmitGreedyFaces(size, blockTypes, shading, scale, mesh);
+	}
+	else
+	{
+		EmitFaces(size, blockTypes, shading, scale, mesh);
+	}
+}
+
+void BinaryVoxelMesher::BuildAxisColumns(int size, const Mask* zColumns)
+{
+	int area = size * size;
+
+	if (zColumns != _columns[2])
+	{
+		memcpy(_columns[2], zColumns, area * sizeof(Mask));
+	}
+
+	memset(_columns[0], 0, area * sizeof(Mask));
+	memset(_columns[1], 0, area * sizeof(Mask));
+
+	// Transpose the z columns into the x and y columns, only visiting active voxels
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			Mask column = _columns[2][(x * size) + y];
+
+			while (column)
+			{
+				int z = LowestBit(column);
+				column &= column - 1;
+
+				_columns[0][(y * size) + z] |= (Mask)1 << x;
+				_columns[1][(x * size) + z] |= (Mask)1 << y;
+			}
+		}
+	}
+}
+
+void BinaryVoxelMesher::BuildFaceMasks(int size, const Mask* borders)
+{
+	int area = size * size;
+
+	// A face is visible where a voxel is active and the next voxel along the column is not. The voxel
+	// past the end of the column is shifted in from the border, or counts as inactive without one.
+	for (int face = 0; face < VoxelMesher::Face_Count; face++)
+	{
+		const Mask* columns = _columns[VoxelMesher::FACES[face].Axis];
+		Mask* faces = _faces[face];
+
+		if (!borders)
+		{
+			for (int i = 0; i < area; i++)
+			{
+				faces[i] = columns[i] & ~((VoxelMesher::FACES[face].Sign < 0) ? (columns[i] << 1) : (columns[i] >> 1));
+			}
+			continue;
+		}
+
+		const Mask* border = &borders[face * size];
+
+		for (int p = 0; p < size; p++)
+		{
+			Mask layer = border[p];
+
+			if (VoxelMesher::FACES[face].Sign < 0)
+			{
+				for (int q = 0; q < size; q++)
+				{
+					int i = (p * size) + q;
+					faces[i] = columns[i] & ~((columns[i] << 1) | ((layer >> q) & 1));
+				}
+			}
+			else
+			{
+				for (int q = 0; q < size; q++)
+				{
+					int i = (p * size) + q;
+					faces[i] = columns[i] & ~((columns[i] >> 1) | (((layer >> q) & 1) << (size - 1)));
+				}
+			}
+		}
+	}
+}
+
+void BinaryVoxelMesher::EmitFaces(int size, const unsigned char* blockTypes, const Shading* shading, int scale, VoxelChunk::MeshData& mesh)
+{
+	int coord[3], voxel[3];
+	int first, second;
+
+	for (int face = 0; face < VoxelMesher::Face_Count; face++)
+	{
+		int axis = VoxelMesher::FACES[face].Axis;
+		GetOtherAxes(axis, first, second);
+
+		for (int p = 0; p < size; p++)
+		{
+			coord[first] = p;
+			for (int q = 0; q < size; q++)
+			{
+				coord[second] = q;
+
+				Mask visible = _faces[face][(p * size) + q];
+				while (visible)
+				{
+					coord[axis] = LowestBit(visible);
+					visible &= visible - 1;
+
+					unsigned int shade = VoxelMesher::FULL_SHADE;
+					if (IsShaded(size, shading, face, coord))
+					{
+						shade = GetShade(size, *shading, face, coord);
+					}
+
+					int index = (((coord[0] * size) + coord[1]) * size) + coord[2];
+					int type = (blockTypes[index >> 1] >> ((index & 1) * 4)) & 0xF;
+
+					ScaleVoxel(face, coord, scale, voxel);
+					VoxelMesher::AddQuad(mesh, (VoxelMesher::Face)face, voxel[0], voxel[1], voxel[2], scale, scale, type, shade);
+				}
+			}
+		}
+	}
+}
+
+// The column with each voxel spread to the voxels either side of it
+static inline BinaryVoxelMesher::Mask Spread(BinaryVoxelMesher::Mask column)
+{
+	return column | (column << 1) | (column >> 1);
+}
+
+void BinaryVoxelMesher::BuildOcclusionMasks(int size, const Shading& shading)
+{
+	const int padded = size + 2;
+	const Mask* columns = shading.PaddedColumns;
+
+	// A face can only be occluded when a voxel around the one in front of it, in the plane of the face, is active.
+	// The padded columns give that ring a whole column at a time, and bit z + 1 of a padded column is voxel z,
+	// which the shifts at the end line back up with the faces.
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			int i = (x * size) + y;
+
+			if (!_columns[2][i])
+			{
+				for (int face = 0; face < VoxelMesher::Face_Count; face++)
+				{
+					_occluded[face][i] = 0;
+				}
+				continue;
+			}
+
+			const Mask* low = &columns[(x * padded) + y + 1];
+			const Mask* middle = low + padded;
+			const Mask* high = middle + padded;
+
+			_occluded[VoxelMesher::Face_NegativeX][i] = (Spread(low[-1]) | Spread(low[1]) | (low[0] << 1) | (low[0] >> 1)) >> 1;
+			_occluded[VoxelMesher::Face_PositiveX][i] = (Spread(high[-1]) | Spread(high[1]) | (high[0] << 1) | (high[0] >> 1)) >> 1;
+			_occluded[VoxelMesher::Face_NegativeY][i] = (Spread(low[-1]) | Spread(high[-1]) | (middle[-1] << 1) | (middle[-1] >> 1)) >> 1;
+			_occluded[VoxelMesher::Face_PositiveY][i] = (Spread(low[1]) | Spread(high[1]) | (middle[1] << 1) | (middle[1] >> 1)) >> 1;
+
+			Mask ring = low[-1] | low[0] | low[1] | middle[-1] | middle[1] | high[-1] | high[0] | high[1];
+			_occluded[VoxelMesher::Face_NegativeZ][i] = ring;
+			_occluded[VoxelMesher::Face_PositiveZ][i] = ring >> 2;
+		}
+	}
+}
+
+unsigned int BinaryVoxelMesher::GetShade(int size, const Shading& shading, int face, const int coord[3])
+{
+	return VoxelMesher::GetShade(size, shading.PaddedColumns, shading.Light, (VoxelMesher::Face)face, coord);
+}
+
+void BinaryVoxelMesher::EmitGreedyFaces(int size, const unsigned char* blockTypes, const Shading* shading, int scale, VoxelChunk::MeshData& mesh)
+{
+	int area = size * size;
+	int coord[3], voxel[3];
+	int first, second;
+
+	for (int face = 0; face < VoxelMesher::Face_Count; face++)
+	{
+		const VoxelMesher::FaceInfo& info = VoxelMesher::FACES[face];
+		GetOtherAxes(info.Axis, first, second);
+
+		// Scatter the visible faces into a plane per block type. Each slice along the face axis has
+		// a row for every voxel along the right axis, with a bit for every voxel along the up axis.
+		const int strides[3] = { area, size, 1 };
+		bool rightIsFirst = (info.RightAxis == first);
+
+		for (int p = 0; p < size; p++)
+		{
+			for (int q = 0; q < size; q++)
+			{
+				Mask visible = _faces[face][(p * size) + q];
+				if (visible == 0)
+				{
+					continue;
+				}
+
+				int columnIndex = (p * strides[first]) + (q * strides[second]);
+				int row = rightIsFirst ? p : q;
+				Mask bit = (Mask)1 << (rightIsFirst ? q : p);
+
+				while (visible)
+				{
+					int slice = LowestBit(visible);
+					visible &= visible - 1;
+
+					int index = columnIndex + (slice * strides[info.Axis]);
+					int type = (blockTypes[index >> 1] >> ((index & 1) * 4)) & 0xF;
+
+					_typeUsed[type] = true;
+					_planes[(type * area) + (slice * size) + row] |= bit;
+
+					coord[info.Axis] = slice;
+					coord[first] = p;
+					coord[second] = q;
+
+					if (!IsShaded(size, shading, face, coord))
+					{
+						continue;
+					}
+
+					unsigned int shade = GetShade(size, *shading, face, coord);
+					if (shade != VoxelMesher::FULL_SHADE)
+					{
+						_shades[(((slice * size) + row) * size) + (rightIsFirst ? q : p)] = (unsigned short)shade;
+						_shadedRows[(slice * size) + row] |= bit;
+					}
+				}
+			}
+		}
+
+		// Merge each plane into rectangles. A run of faces along the up axis is found with one bit scan, then
+		// grown along the right axis for as long as the following rows contain the whole run.
+		for (int type = 0; type < 16; type++)
+		{
+			if (!_typeUsed[type])
+			{
+				continue;
+			}
+
+			Mask* plane = &_planes[type * area];
+
+			for (int slice = 0; slice < size; slice++)
+			{
+				Mask* rows = &plane[slice * size];
+				coord[info.Axis] = slice;
+
+				for (int u = 0; u < size; u++)
+				{
+					while (rows[u])
+					{
+						int start = LowestBit(rows[u]);
+						Mask shifted = ~(rows[u] >> start);
+						int height = shifted ? LowestBit(shifted) : 64 - start;
+						unsigned int shade = VoxelMesher::FULL_SHADE;
+
+						// Shaded faces only merge while the shade stays the same, up the run and across the rows.
+						// Faces in full sunlight with nothing around them merge as they are until they reach one that is not.
+						Mask* shadedRows = &_shadedRows[slice * size];
+						const unsigned short* shades = &_shades[((slice * size) + u) * size];
+						Mask marked = shadedRows[u] >> start;
+
+						if (marked & 1)
+						{
+							shade = shades[start];
+
+							int i = 1;
+							while (i < height && ((marked >> i) & 1) && shades[start + i] == shade)
+							{
+								i++;
+							}
+							height = i;
+						}
+						else if (marked && LowestBit(marked) < height)
+						{
+							height = LowestBit(marked);
+						}
+
+						Mask run = ((height == 64) ? ~(Mask)0 : (((Mask)1 << height) - 1)) << start;
+
+						rows[u] &= ~run;
+
+						int width = 1;
+						while (u + width < size && (rows[u + width] & run) == run)
+						{
+							Mask nextMarked = shadedRows[u + width] & run;
+
+							if (shade == VoxelMesher::FULL_SHADE)
+							{
+								if (nextMarked)
+								{
+									break;
+								}
+							}
+							else
+							{
+								const unsigned short* nextShades = shades + (width * size);
+								int i = 0;
+
+								while (i < height && nextShades[start + i] == shade)
+								{
+									i++;
+								}
+
+								if (nextMarked != run || i < height)
+								{
+									break;
+								}
+							}
+
+							rows[u + width] &= ~run;
+							shadedRows[u + width] &= ~run;
+							width++;
+						}
+
+						// Like the planes, the marks are all consumed by the time the face is done
+						shadedRows[u] &= ~run;
+
+						coord[info.RightAxis] = u;
+						coord[info.UpAxis] = start;
+						ScaleVoxel(face, coord, scale, voxel);
+						VoxelMesher::AddQuad(mesh, (VoxelMesher::Face)face, voxel[0], voxel[1], voxel[2], width * scale, height * scale, type, shade);
+					}
+				}
+			}
+
+			// Every bit has been consumed, so the plane is already clear for the next face
+			_typeUsed[type] = false;
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "VoxelMesher.h"
+
+// Meshes voxels a whole column at a time using 64 bit masks, so chunks can be up to 64 voxels along each side.
+// The occupancy is held as columns along all three axes, which makes the visible faces of a column
+// a single shift and mask. Faces can optionally be merged into rectangles straight from the bit masks.
+// The scratch memory is owned by the mesher and reused, so keep one mesher per thread.
+//
+// Faces can also be shaded, with the ambient occlusion of each corner worked out from the three voxels beside it in
+// front of the face, and the light of the voxel the face looks onto. Greedy faces are then only merged with faces
+// shaded the same way.
+class BinaryVoxelMesher
+{
+public:
+	typedef unsigned long long Mask;
+
+	static const int MAX_SIZE = 64;
+
+	// paddedColumns holds the columns along z of the block with one voxel more on every side, at index
+	// ((x + 1) * (size + 2)) + y + 1 with bit z + 1 for voxel z. light holds a byte for every voxel of the same padded
+	// block at index ((((x + 1) * (size + 2)) + y + 1) * (size + 2)) + z + 1, or is null for full sunlight everywhere.
+	struct Shading
+	{
+		const Mask*				PaddedColumns;
+		const unsigned char*	Light;
+	};
+
+	BinaryVoxelMesher();
+	~BinaryVoxelMesher();
+
+	// Shades the faces of a chunk from its borders and the light copied for it
+	void CreateMesh(const VoxelChunk& chunk, bool greedy, VoxelChunk::MeshData& mesh);
+
+	// Meshes a size^3 block of voxels. zColumns holds a column along z for every (x, y) at index (x * size) + y, and
+	// blockTypes holds the block type of every voxel at index (((x * size) + y) * size) + z, packed two to a byte.
+	// borders holds the layer of voxels just outside each face at index (face * size) + the first of the other two
+	// axes, with a bit along the second, or can be null when everything outside the block is empty. Without shading
+	// every face is unoccluded and in full sunlight. The quads are scaled up by scale, so a coarse block can fill a chunk,
+	// and as the packed positions go up to MAX_SIZE the block scaled up can be no bigger than that.
+	void CreateMesh(int size, const Mask* zColumns, const unsigned char* blockTypes, const Mask* borders, const Shading* shading,
+		int scale, bool greedy, VoxelChunk::MeshData& mesh);
+
+private:
+	void BuildAxisColumns(int size, const Mask* zColumns);
+	void BuildFaceMasks(int size, const Mask* borders);
+	void EmitFaces(int size, const unsigned char* blockTypes, const Shading* shading, int scale, VoxelChunk::MeshData& mesh);
+	void EmitGreedyFaces(int size, const unsigned char* blockTypes, const Shading* shading, int scale, VoxelChunk::MeshData& mesh);
+
+	void BuildOcclusionMasks(int size, const Shading& shading);
+	static unsigned int GetShade(int size, const Shading& shading, int face, const int coord[3]);
+
+	// Whether a face needs shading voxel by voxel, the rest are unoccluded and in full sunlight
+	bool IsShaded(int size, const Shading* shading, int face, const int coord[3]) const
+	{
+		return shading && (shading->Light || ((_occluded[face][(coord[0] * size) + coord[1]] >> coord[2]) & 1));
+	}
+
+	// Columns along each axis. Columns along x are indexed by (y, z), along y by (x, z) and along z by (x, y).
+	Mask*		_columns[3];
+	Mask		_borders[VoxelMesher::Face_Count * MAX_SIZE];
+
+	// The visible faces for each face direction, laid out the same way as the columns along the faces axis
+	Mask*		_faces[VoxelMesher::Face_Count];
+
+	// One plane of rows per block type, each row holding a bit per voxel along the faces up axis
+	Mask*		_planes;
+	bool		_typeUsed[16];
+
+	// The shade of every face in the planes being merged that is not in full sunlight and unoccluded, at the same
+	// slice and row with one entry per bit, and a row of bits marking which faces those are
+	unsigned short*		_shades;
+	Mask*				_shadedRows;
+
+	// The padded columns of a chunk being shaded, and for each face direction a bit for every face with a voxel
+	// beside the one in front of it, laid out like the z columns. Only those faces can be occluded.
+	Mask*		_paddedColumns;
+	Mask*		_occluded[VoxelMesher::Face_Count];
+
+	// The voxels of chunks that are not held densely, written out in the dense layout
+	VoxelChunk::Column*		_chunkColumns;
+	unsigned char*			_chunkBlockTypes;
+};
@@ -1065,6 +1065,53 @@ FN_DECIMAL FastNoise::SingleSimplexFractalRigidMulti(FN_DECIMAL x, FN_DECIMAL y,
 	return sum;
 }
 
+void FastNoise::FillSimplexFractalSet(int count, const FN_DECIMAL* x, const FN_DECIMAL* y, const FN_DECIMAL* z, FN_DECIMAL* noise) const
+{
+	// The frequency, amplitude and permutation offset of an octave are set up once for every point. Octaves with a
+	// lacunarity of 2 sample exactly where GetSimplexFractal does.
+	FN_DECIMAL frequency = m_frequency;
+	FN_DECIMAL amp = 1;
+
+	for (int i = 0; i < m_octaves; i++)
+	{
+		unsigned char offset = m_perm[i];
+
+		for (int n = 0; n < count; n++)
+		{
+			FN_DECIMAL value = SingleSimplex(offset, x[n] * frequency, y[n] * frequency, z[n] * frequency);
+
+			switch (m_fractalType)
+			{
+			case FBM:
+				noise[n] = (i == 0) ? value : noise[n] + (value * amp);
+				break;
+			case Billow:
+				value = FastAbs(value) * 2 - 1;
+				noise[n] = (i == 0) ? value : noise[n] + (value * amp);
+				break;
+			case RigidMulti:
+				value = 1 - FastAbs(value);
+				noise[n] = (i == 0) ? value : noise[n] - (value * amp);
+				break;
+			default:
+				noise[n] = 0;
+				break;
+			}
+		}
+
+		frequency *= m_lacunarity;
+		amp *= m_gain;
+	}
+
+	if (m_fractalType == FBM || m_fractalType == Billow)
+	{
+		for (int n = 0; n < count; n++)
+		{
+			noise[n] *= m_fractalBounding;
+		}
+	}
+}
+
 FN_DECIMAL FastNoise::GetSimplex(FN_DECIMAL x, FN_DECIMAL y, FN_DECIMAL z) const
 {
 	return SingleSimplex(0, x * m_frequency, y * m_frequency, z * m_frequency);
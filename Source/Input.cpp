@@ -313,6 +313,17 @@ bool Input::IsPgDownPressed()
 	return false;
 }
 
+bool Input::IsSpacePressed()
+{
+	// Do a bitwise and on the keyboard state to check if the key is currently being pressed.
+	if (_keyboardState[DIK_SPACE] & 0x80)
+	{
+		return true;
+	}
+
+	return false;
+}
+
 bool Input::IsF1Toggled()
 {
 	// Do a bitwise and on the keyboard state to check if the key is currently being pressed.
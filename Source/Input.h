@@ -28,6 +28,7 @@ public:
 	bool IsZPressed();
 	bool IsPgUpPressed();
 	bool IsPgDownPressed();
+	bool IsSpacePressed();
 
 	bool IsF1Toggled();
 	bool IsF2Toggled();
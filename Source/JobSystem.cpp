@@ -0,0 +1,123 @@
+#include "JobSystem.h"
+
+JobSystem::JobSystem()
+{
+	_unfinishedJobs = 0;
+	_stopping = false;
+}
+
+JobSystem::~JobSystem()
+{
+	Destroy();
+}
+
+bool JobSystem::Initialize(int threadCount)
+{
+	Destroy();
+
+	if (threadCount < 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+	}
+
+	_stopping = false;
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		_threads.push_back(std::thread(&JobSystem::WorkerLoop, this));
+	}
+
+	return true;
+}
+
+void JobSystem::Destroy()
+{
+	if (_threads.empty())
+	{
+		return;
+	}
+
+	// Let the workers finish what is queued, then wake them so they see they should stop
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_jobAvailable.notify_all();
+
+	for (size_t i = 0; i < _threads.size(); i++)
+	{
+		_threads[i].join();
+	}
+
+	_threads.clear();
+}
+
+void JobSystem::Submit(const Job& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_jobs.push_back(job);
+		_unfinishedJobs++;
+	}
+
+	_jobAvailable.notify_one();
+}
+
+void JobSystem::Wait()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (_unfinishedJobs > 0)
+	{
+		if (_jobs.empty())
+		{
+			// The last jobs are running on the workers
+			_jobsFinished.wait(lock);
+			continue;
+		}
+
+		Job job = _jobs.front();
+		_jobs.pop_front();
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		_unfinishedJobs--;
+	}
+
+	_jobsFinished.notify_all();
+}
+
+void JobSystem::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (true)
+	{
+		while (_jobs.empty() && !_stopping)
+		{
+			_jobAvailable.wait(lock);
+		}
+
+		if (_jobs.empty())
+		{
+			return;
+		}
+
+		Job job = _jobs.front();
+		_jobs.pop_front();
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		_unfinishedJobs--;
+		if (_unfinishedJobs == 0)
+		{
+			_jobsFinished.notify_all();
+		}
+	}
+}
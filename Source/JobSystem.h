@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A pool of worker threads that run jobs taken from a shared queue in the order they were submitted.
+// The thread waiting on the jobs helps to run them, so a job system without workers runs every job on that thread.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Job;
+
+	JobSystem();
+	~JobSystem();
+
+	// Starts the worker threads. A negative thread count starts one worker per core other than the calling threads.
+	bool Initialize(int threadCount);
+	void Destroy();
+
+	void Submit(const Job& job);
+
+	// Blocks until every submitted job has finished
+	void Wait();
+
+	int GetThreadCount() { return (int)_threads.size(); }
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread>	_threads;
+	std::deque<Job>				_jobs;
+	std::mutex					_mutex;
+	std::condition_variable		_jobAvailable;
+	std::condition_variable		_jobsFinished;
+	int							_unfinishedJobs;
+	bool						_stopping;
+};
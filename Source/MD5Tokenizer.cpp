@@ -0,0 +1,349 @@
+#include "MD5Tokenizer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The powers of ten a double holds exactly
+static const double POWERS_OF_TEN[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline bool IsSpace(char c)
+{
+	return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == '\v') || (c == '\f');
+}
+
+static inline bool IsDigit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+bool MD5Token::Equals(const char* text) const
+{
+	return (strncmp(Start, text, Length) == 0) && (text[Length] == '\0');
+}
+
+MD5Tokenizer::MD5Tokenizer()
+{
+	_file = INVALID_HANDLE_VALUE;
+	_mapping = NULL;
+	_view = 0;
+	_position = 0;
+	_end = 0;
+}
+
+MD5Tokenizer::~MD5Tokenizer()
+{
+	Close();
+}
+
+bool MD5Tokenizer::Open(const std::wstring& filename)
+{
+	Close();
+
+	_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(_file, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	// An empty file cannot be mapped, but has no tokens anyway
+	if (fileSize.QuadPart > 0)
+	{
+		_mapping = CreateFileMappingW(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (_mapping)
+		{
+			_view = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		if (!_view)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	SetText(_view, (size_t)fileSize.QuadPart);
+
+	return true;
+}
+
+void MD5Tokenizer::Close()
+{
+	if (_view)
+	{
+		UnmapViewOfFile(_view);
+		_view = 0;
+	}
+
+	if (_mapping)
+	{
+		CloseHandle(_mapping);
+		_mapping = NULL;
+	}
+
+	if (_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_file);
+		_file = INVALID_HANDLE_VALUE;
+	}
+
+	_position = 0;
+	_end = 0;
+}
+
+void MD5Tokenizer::SetText(const char* text, size_t length)
+{
+	_position = text;
+	_end = text + length;
+}
+
+bool MD5Tokenizer::Next(MD5Token& token)
+{
+	SkipSpace();
+
+	// The scans work on locals, since the compiler has to assume stores to the members could change the text
+	const char* position = _position;
+	const char* end = _end;
+
+	if (position >= end)
+	{
+		return false;
+	}
+
+	const char* start = position;
+
+	if (*position == '"')
+	{
+		// A quoted string runs to the next quote, spaces and all
+		start++;
+		position = start;
+
+		while (position < end && *position != '"')
+		{
+			position++;
+		}
+
+		token.Start = start;
+		token.Length = (int)(position - start);
+		_position = (position < end) ? position + 1 : position;
+
+		return true;
+	}
+
+	while (position < end && !IsSpace(*position))
+	{
+		position++;
+	}
+
+	token.Start = start;
+	token.Length = (int)(position - start);
+	_position = position;
+
+	return true;
+}
+
+bool MD5Tokenizer::Expect(const char* text)
+{
+	MD5Token token;
+
+	return Next(token) && token.Equals(text);
+}
+
+bool MD5Tokenizer::ReadInt(int& value)
+{
+	MD5Token token;
+
+	return Next(token) && ParseInt(token, value);
+}
+
+bool MD5Tokenizer::ReadFloat(float& value)
+{
+	MD5Token token;
+
+	return Next(token) && ParseFloat(token, value);
+}
+
+bool MD5Tokenizer::ReadString(MD5Token& token)
+{
+	SkipSpace();
+
+	if (_position >= _end || *_position != '"')
+	{
+		return false;
+	}
+
+	return Next(token);
+}
+
+void MD5Tokenizer::SkipLine()
+{
+	const char* newLine = (const char*)memchr(_position, '\n', _end - _position);
+
+	_position = newLine ? newLine : _end;
+}
+
+bool MD5Tokenizer::ParseInt(const MD5Token& token, int& value)
+{
+	const char* position = token.Start;
+	const char* end = token.Start + token.Length;
+	bool negative = false;
+
+	if (position < end && (*position == '-' || *position == '+'))
+	{
+		negative = (*position == '-');
+		position++;
+	}
+
+	if (position >= end)
+	{
+		return false;
+	}
+
+	int result = 0;
+	for (; position < end; position++)
+	{
+		if (!IsDigit(*position))
+		{
+			return false;
+		}
+
+		result = (result * 10) + (*position - '0');
+	}
+
+	value = negative ? -result : result;
+
+	return true;
+}
+
+bool MD5Tokenizer::ParseFloat(const MD5Token& token, float& value)
+{
+	const char* position = token.Start;
+	const char* end = token.Start + token.Length;
+	bool negative = false;
+
+	if (position < end && (*position == '-' || *position == '+'))
+	{
+		negative = (*position == '-');
+		position++;
+	}
+
+	// Gather the significant digits into an integer, counting the power of ten they are scaled by
+	unsigned long long mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool exact = true;
+
+	for (; position < end && IsDigit(*position); position++, digits++)
+	{
+		if (significantDigits < 19)
+		{
+			mantissa = (mantissa * 10) + (*position - '0');
+			significantDigits += (mantissa != 0) ? 1 : 0;
+		}
+		else
+		{
+			exponent++;
+			exact = false;
+		}
+	}
+
+	if (position < end && *position == '.')
+	{
+		for (position++; position < end && IsDigit(*position); position++, digits++)
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = (mantissa * 10) + (*position - '0');
+				significantDigits += (mantissa != 0) ? 1 : 0;
+				exponent--;
+			}
+			else
+			{
+				exact = false;
+			}
+		}
+	}
+
+	if (digits == 0)
+	{
+		return false;
+	}
+
+	if (position < end && (*position == 'e' || *position == 'E'))
+	{
+		MD5Token exponentToken = { position + 1, (int)(end - position - 1) };
+		int written;
+
+		if (!ParseInt(exponentToken, written))
+		{
+			return false;
+		}
+
+		exponent += written;
+		position = end;
+	}
+
+	if (position != end)
+	{
+		return false;
+	}
+
+	// One multiply or divide of two exact doubles is rounded correctly. Anything else is left to the C library.
+	if (exact && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double result = (double)mantissa;
+		result = (exponent < 0) ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+
+		value = (float)(negative ? -result : result);
+
+		return true;
+	}
+
+	char text[64];
+	if (token.Length >= (int)sizeof(text))
+	{
+		return false;
+	}
+
+	memcpy(text, token.Start, token.Length);
+	text[token.Length] = '\0';
+	value = strtof(text, 0);
+
+	return true;
+}
+
+void MD5Tokenizer::SkipSpace()
+{
+	const char* position = _position;
+	const char* end = _end;
+
+	while (position < end)
+	{
+		if (IsSpace(*position))
+		{
+			position++;
+		}
+		else if (*position == '/' && (position + 1) < end && position[1] == '/')
+		{
+			const char* newLine = (const char*)memchr(position, '\n', end - position);
+			position = newLine ? newLine : end;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	_position = position;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <windows.h>
+
+#include <string>
+
+// A token of the text being read, pointing into the text rather than holding a copy of it
+struct MD5Token
+{
+	const char*		Start;
+	int				Length;
+
+	bool Equals(const char* text) const;
+};
+
+// Splits MD5 mesh and animation files into tokens straight out of a read only mapping of the file, with no copies, no
+// wide characters and no locale. Tokens are separated by white space, a quoted string is one token without its
+// quotes, and comments run from // to the end of the line. Numbers are parsed by hand, falling back to the C library
+// only for floats with more digits than a double holds exactly, so they come out the same as the stream parser.
+class MD5Tokenizer
+{
+public:
+	MD5Tokenizer();
+	~MD5Tokenizer();
+
+	bool Open(const std::wstring& filename);
+	void Close();
+
+	// Reads text that is already in memory, which has to stay there while it is read
+	void SetText(const char* text, size_t length);
+
+	// Each of these reads the next token, returning false at the end of the text or when the token is not what was asked for
+	bool Next(MD5Token& token);
+	bool Expect(const char* text);
+	bool ReadInt(int& value);
+	bool ReadFloat(float& value);
+	bool ReadString(MD5Token& token);
+
+	// Skips whatever is left of the line
+	void SkipLine();
+
+	static bool ParseInt(const MD5Token& token, int& value);
+	static bool ParseFloat(const MD5Token& token, float& value);
+
+private:
+	void SkipSpace();
+
+	HANDLE			_file;
+	HANDLE			_mapping;
+	const char*		_view;
+
+	const char*		_position;
+	const char*		_end;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <directxmath.h>
+#include <fstream>
+
+#include "IShader.h"
+
+using namespace DirectX;
+using namespace std;
+
+// Draws voxel chunks made of packed vertices, shaded the same way as the VoxelShader. The vertices are counted from
+// the corner of their chunk, which is passed in with each draw.
+class PackedVoxelShader : public IShader
+{
+private:
+	struct ChunkBufferType
+	{
+		XMFLOAT3 Origin;
+		float Padding;
+	};
+
+public:
+	PackedVoxelShader();
+	PackedVoxelShader(const PackedVoxelShader&);
+	~PackedVoxelShader();
+
+	bool Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix,
+		ID3D11ShaderResourceView* texture, XMFLOAT3 chunkOrigin);
+
+protected:
+	bool InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename) override;
+	void DestroyShader() override;
+	void RenderShader(ID3D11DeviceContext* deviceContext, int indexCount) override;
+
+private:
+	bool SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, XMFLOAT3 chunkOrigin);
+
+	ID3D11SamplerState*			_sampleState;
+	ID3D11Buffer*				_chunkBuffer;
+};
\ No newline at end of file
@@ -1,7 +1,13 @@
 #include "SceneCombined.h"
 
+#include <stdio.h>
+
 SceneCombined::SceneCombined() : IScene()
 {
+	_skeletonVisible = true;
+	_skeletonSkinned = 0;
+	_skeletonSkipped = 0;
+	_frameCount = 0;
 }
 
 bool SceneCombined::Initialize(DX11Instance* Direct3D, HWND hwnd, int screenWidth, int screenHeight, float screenDepth)
@@ -237,8 +243,6 @@ bool SceneCombined::Update(DX11Instance* direct3D, Input* input, ShaderManager*
 	// Do the frame input processing.
 	ProcessInput(input, frameTime);
 
-	_skeleton->Update(direct3D->GetDeviceContext(), frameTime);
-
 	// Get the View point Position/rotation.
 	_camera->GetTransform()->GetPosition(posX, posY, posZ);
 	_camera->GetTransform()->GetRotation(rotX, rotY, rotZ);
@@ -270,6 +274,10 @@ bool SceneCombined::Update(DX11Instance* direct3D, Input* input, ShaderManager*
 		}
 	}
 
+	// Animate the skeleton where it now stands.
+	UpdateSkeleton(direct3D, frameTime);
+	ReportCullingStats();
+
 	// Render the graphics.
 	result = Draw(direct3D, shaderManager);
 	if (!result)
@@ -280,6 +288,49 @@ bool SceneCombined::Update(DX11Instance* direct3D, Input* input, ShaderManager*
 	return true;
 }
 
+void SceneCombined::UpdateSkeleton(DX11Instance* direct3D, float frameTime)
+{
+	XMMATRIX viewMatrix, projectionMatrix;
+
+	// The frustum of the camera as it will be drawn this frame.
+	_camera->Render();
+	_camera->GetViewMatrix(viewMatrix);
+	direct3D->GetProjectionMatrix(projectionMatrix);
+	_frustum->ConstructFrustum(projectionMatrix, viewMatrix);
+
+	// The clips move on first, so the skeleton is culled with the box around the frame it is drawn at. Out of view
+	// that is all it does, so it is on the right frame when it comes back.
+	_skeleton->AdvanceLayers(frameTime);
+
+	_skeletonVisible = _skeleton->IsVisible(_frustum);
+	if (_skeletonVisible)
+	{
+		_skeleton->Update(direct3D->GetDeviceContext(), 0.0f);
+		_skeletonSkinned++;
+	}
+	else
+	{
+		_skeletonSkipped++;
+	}
+}
+
+void SceneCombined::ReportCullingStats()
+{
+	char line[256];
+
+	_frameCount++;
+	if (COMBINED_STATS_INTERVAL <= 0 || (_frameCount % COMBINED_STATS_INTERVAL) != 0)
+	{
+		return;
+	}
+
+	sprintf_s(line, "Skeleton culling: skinned %d frames  skipped %d frames\n", _skeletonSkinned, _skeletonSkipped);
+	OutputDebugStringA(line);
+
+	_skeletonSkinned = 0;
+	_skeletonSkipped = 0;
+}
+
 void SceneCombined::ProcessInput(Input* Input, float frameTime)
 {
 	bool keyDown;
@@ -435,10 +486,18 @@ bool SceneCombined::Draw(DX11Instance* direct3D, ShaderManager* shaderManager)
 		(XMMatrixRotationX(skeletonRotation.x) * XMMatrixRotationY(skeletonRotation.y) * XMMatrixRotationZ(skeletonRotation.z)) *
 		XMMatrixTranslation(skeletonPosition.x, skeletonPosition.y, skeletonPosition.z);
 
-	for (int i = 0; i < _skeleton->GetSubsetCount(); i++)
+	for (int i = 0; _skeletonVisible && i < _skeleton->GetSubsetCount(); i++)
 	{
 		_skeleton->DrawSubset(direct3D->GetDeviceContext(), i);
-		result = shaderManager->RenderTextureShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix, _textureManager->GetTexture(10 + i));
+		if (_skeleton->GetSkinningMode() == SkinningMode_Shader)
+		{
+			result = shaderManager->RenderSkeletonShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix,
+				_textureManager->GetTexture(10 + i), _skeleton->GetJointMatrixRows(), _skeleton->GetJointCount());
+		}
+		else
+		{
+			result = shaderManager->RenderTextureShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix, _textureManager->GetTexture(10 + i));
+		}
 		if (!result)
 		{
 			return false;
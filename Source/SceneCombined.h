@@ -2,6 +2,8 @@
 
 #include "IScene.h"
 
+const int COMBINED_STATS_INTERVAL = 0;		// Frames between writing the skeleton culling stats to the output window, 0 to never write them
+
 class SceneCombined : public IScene
 {
 public:
@@ -15,10 +17,18 @@ private:
 	void ProcessInput(Input*, float) override;
 	bool Draw(DX11Instance*, ShaderManager*) override;
 
+	void UpdateSkeleton(DX11Instance* direct3D, float frameTime);
+	void ReportCullingStats();
+
 	SkyDome*		_skyDome;
 	Terrain*		_terrain;
 	Skeleton*		_skeleton;
 	Object*			_cube;
 
 	bool			_wireFrame, _cellLines, _heightLocked;
+
+	// Whether the skeleton was in view this frame, and the frames it was skinned and skipped since the stats were written
+	bool			_skeletonVisible;
+	int				_skeletonSkinned, _skeletonSkipped;
+	int				_frameCount;
 };
\ No newline at end of file
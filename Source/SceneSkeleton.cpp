@@ -1,7 +1,12 @@
 #include "SceneSkeleton.h"
 
+#include <stdio.h>
+
 SceneSkeleton::SceneSkeleton() : IScene()
 {
+	_skeleton = 0;
+	_jobSystem = 0;
+	_frameCount = 0;
 }
 
 SceneSkeleton::~SceneSkeleton()
@@ -63,6 +68,60 @@ bool SceneSkeleton::Initialize(DX11Instance* Direct3D, HWND hwnd, int screenWidt
 	_skeleton->Initialize(Direct3D->GetDevice(), Direct3D->GetDeviceContext(), _textureManager, L"Source/Animation/boy.md5mesh", L"Source/Animation/boy.md5anim");
 	_skeleton->GetTransform()->SetPosition(XMFLOAT3(0, 0, 100));
 
+	if (SKELETON_BENCHMARKS)
+	{
+		SkeletonBenchmark::Run(Direct3D->GetDevice(), Direct3D->GetDeviceContext(), _skeleton);
+	}
+
+	// Skin every frame of the clips once for the most distant instances to draw.
+	result = _skeleton->CacheFrames(Direct3D->GetDevice());
+	if (!result)
+	{
+		return false;
+	}
+
+	// Create the job system that animates the crowd.
+	_jobSystem = new JobSystem;
+	if (!_jobSystem)
+	{
+		return false;
+	}
+
+	result = _jobSystem->Initialize(SKELETON_WORKER_THREADS);
+	if (!result)
+	{
+		return false;
+	}
+
+	// Create the crowd, each instance a little further into the clip than the one before so they move apart
+	for (int row = 0; row < SKELETON_CROWD_ROWS; row++)
+	{
+		for (int column = 0; column < SKELETON_CROWD_COLUMNS; column++)
+		{
+			SkeletonInstance* instance = new SkeletonInstance;
+			if (!instance || !instance->Initialize(Direct3D->GetDevice(), _skeleton))
+			{
+				delete instance;
+				return false;
+			}
+
+			instance->GetTransform()->SetPosition(XMFLOAT3((column - ((SKELETON_CROWD_COLUMNS - 1) * 0.5f)) * SKELETON_CROWD_SPACING, 0.0f,
+				100.0f + (row * SKELETON_CROWD_SPACING)));
+
+			Skeleton::AnimationLayer layer = instance->GetLayer(0);
+			layer.Time = fmodf(_instances.size() * 0.37f, _skeleton->GetAnimationLength(0));
+			instance->SetLayer(0, layer);
+
+			// Only the instances in view are posed and skinned.
+			if (SKELETON_CULLING)
+			{
+				instance->SetFrustum(_frustum);
+			}
+
+			_instances.push_back(instance);
+		}
+	}
+
 	return true;
 }
 
@@ -90,9 +149,26 @@ void SceneSkeleton::Destroy()
 		_camera = 0;
 	}
 
+	// Release the crowd.
+	for (size_t i = 0; i < _instances.size(); i++)
+	{
+		_instances[i]->Destroy();
+		delete _instances[i];
+	}
+	_instances.clear();
+
+	// Release the job system.
+	if (_jobSystem)
+	{
+		_jobSystem->Destroy();
+		delete _jobSystem;
+		_jobSystem = 0;
+	}
+
 	// Release the skeleton object.
 	if (_skeleton)
 	{
+		_skeleton->Destroy();
 		delete _skeleton;
 		_skeleton = 0;
 	}
@@ -105,7 +181,26 @@ bool SceneSkeleton::Update(DX11Instance* direct3D, Input* input, ShaderManager*
 	// Do the frame input processing.
 	ProcessInput(input, frameTime);
 
-	_skeleton->Update(direct3D->GetDeviceContext(), frameTime);
+	// Pick how much of its animation each instance plays from how much of the screen it covers.
+	if (SKELETON_ANIMATION_LOD)
+	{
+		XMMATRIX projectionMatrix;
+		XMFLOAT3 cameraPosition;
+
+		direct3D->GetProjectionMatrix(projectionMatrix);
+		_camera->GetTransform()->GetPosition(cameraPosition);
+
+		for (size_t i = 0; i < _instances.size(); i++)
+		{
+			_instances[i]->SelectLod(cameraPosition, XMVectorGetY(projectionMatrix.r[1]));
+		}
+	}
+
+	// The instances are culled against the frustum once their clips have moved on.
+	ConstructFrustum(direct3D);
+
+	SkeletonInstance::UpdateInstances(_jobSystem, direct3D->GetDeviceContext(), _instances, frameTime);
+	ReportCullingStats();
 
 	// Render the graphics.
 	bool result = Draw(direct3D, shaderManager);
@@ -117,6 +212,42 @@ bool SceneSkeleton::Update(DX11Instance* direct3D, Input* input, ShaderManager*
 	return true;
 }
 
+void SceneSkeleton::ConstructFrustum(DX11Instance* direct3D)
+{
+	XMMATRIX viewMatrix, projectionMatrix;
+
+	// The frustum of the camera as it will be drawn this frame.
+	_camera->Render();
+	_camera->GetViewMatrix(viewMatrix);
+	direct3D->GetProjectionMatrix(projectionMatrix);
+	_frustum->ConstructFrustum(projectionMatrix, viewMatrix);
+}
+
+void SceneSkeleton::ReportCullingStats()
+{
+	char line[256];
+	int visible = 0;
+	int posed = 0;
+	int skinned = 0;
+
+	_frameCount++;
+	if (SKELETON_STATS_INTERVAL <= 0 || (_frameCount % SKELETON_STATS_INTERVAL) != 0)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < _instances.size(); i++)
+	{
+		visible += _instances[i]->IsVisible() ? 1 : 0;
+		posed += _instances[i]->WasPosed() ? 1 : 0;
+		skinned += _instances[i]->WasSkinned() ? 1 : 0;
+	}
+
+	sprintf_s(line, "Skeleton culling: %d instances  visible %d  skipped %d  posed %d  skinned %d\n",
+		(int)_instances.size(), visible, (int)_instances.size() - visible, posed, skinned);
+	OutputDebugStringA(line);
+}
+
 void SceneSkeleton::ProcessInput(Input* input, float frameTime)
 {
 	bool keyDown;
@@ -156,7 +287,7 @@ bool SceneSkeleton::Draw(DX11Instance* direct3D, ShaderManager* shaderManager)
 {
 	XMMATRIX worldMatrix, viewMatrix, projectionMatrix, baseViewMatrix, orthoMatrix;
 	bool result;
-	XMFLOAT3 cameraPosition, skeletonPosition;
+	XMFLOAT3 cameraPosition, instancePosition;
 
 	// Generate the View matrix based on the camera's Position.
 	_camera->Render();
@@ -171,9 +302,6 @@ bool SceneSkeleton::Draw(DX11Instance* direct3D, ShaderManager* shaderManager)
 	// Get the Position of the camera.
 	_camera->GetTransform()->GetPosition(cameraPosition);
 
-	// Get the position of the skeleton
-	_skeleton->GetTransform()->GetPosition(skeletonPosition);
-
 	// Construct the frustum.
 	_frustum->ConstructFrustum(projectionMatrix, viewMatrix);
 
@@ -191,18 +319,36 @@ bool SceneSkeleton::Draw(DX11Instance* direct3D, ShaderManager* shaderManager)
 	// Reset the world matrix.
 	direct3D->GetWorldMatrix(worldMatrix);
 
-	// Translate the sky dome to be centered around the skeleton Position.
-	worldMatrix = XMMatrixTranslation(skeletonPosition.x, skeletonPosition.y, skeletonPosition.z);
-
-	for (int i = 0; i < _skeleton->GetSubsetCount(); i++)
+	for (size_t j = 0; j < _instances.size(); j++)
 	{
-		_skeleton->DrawSubset(direct3D->GetDeviceContext(), i);
-		//result = shaderManager->RenderColourShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix);
-		result = shaderManager->RenderTextureShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix, _textureManager->GetTexture(10 + i));
+		SkeletonInstance* instance = _instances[j];
+		if (!instance->IsVisible())
+		{
+			continue;
+		}
+
+		// Translate the instance to its place in the crowd.
+		instance->GetTransform()->GetPosition(instancePosition);
+		worldMatrix = XMMatrixTranslation(instancePosition.x, instancePosition.y, instancePosition.z);
 
-		if (!result)
+		for (int i = 0; i < _skeleton->GetSubsetCount(); i++)
 		{
-			return false;
+			instance->DrawSubset(direct3D->GetDeviceContext(), i);
+			//result = shaderManager->RenderColourShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix);
+			if (_skeleton->GetSkinningMode() == SkinningMode_Shader)
+			{
+				result = shaderManager->RenderSkeletonShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix,
+					_textureManager->GetTexture(10 + i), instance->GetJointMatrixRows(), _skeleton->GetJointCount());
+			}
+			else
+			{
+				result = shaderManager->RenderTextureShader(direct3D->GetDeviceContext(), _skeleton->GetIndexCount(i), worldMatrix, viewMatrix, projectionMatrix, _textureManager->GetTexture(10 + i));
+			}
+
+			if (!result)
+			{
+				return false;
+			}
 		}
 	}
 
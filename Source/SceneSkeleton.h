@@ -2,6 +2,21 @@
 
 #include "IScene.h"
 
+#include <vector>
+
+#include "JobSystem.h"
+#include "SkeletonBenchmark.h"
+#include "SkeletonInstance.h"
+
+const bool SKELETON_BENCHMARKS = false;		// Time the skeleton code and write the results to the output window on startup
+const int SKELETON_CROWD_ROWS = 20;			// The crowd is a grid of instances sharing the one skeleton, this many deep
+const int SKELETON_CROWD_COLUMNS = 20;		// and this many wide
+const float SKELETON_CROWD_SPACING = 80.0f;	// The distance between the instances of the crowd
+const int SKELETON_WORKER_THREADS = -1;		// Threads animating the crowd alongside the main thread, -1 for one per spare core
+const bool SKELETON_ANIMATION_LOD = true;	// Animate the instances that cover less of the screen less often and with fewer joints
+const bool SKELETON_CULLING = true;			// Leave the instances outside the frustum unposed, unskinned and undrawn
+const int SKELETON_STATS_INTERVAL = 0;		// Frames between writing the culling stats to the output window, 0 to never write them
+
 class SceneSkeleton : public IScene
 {
 public:
@@ -16,6 +31,12 @@ private:
 	void ProcessInput(Input*, float) override;
 	bool Draw(DX11Instance*, ShaderManager*) override;
 
+	void ConstructFrustum(DX11Instance* direct3D);
+	void ReportCullingStats();
+
 	Skeleton* _skeleton;
+	JobSystem* _jobSystem;
+	std::vector<SkeletonInstance*> _instances;
+	int _frameCount;
 };
 
@@ -1,10 +1,17 @@
 #include "SceneVoxelTerrain.h"
 
 #include "FastNoise.h"
+#include "VoxelBenchmark.h"
+
+#include <stdio.h>
 
 SceneVoxelTerrain::SceneVoxelTerrain()
 {
 	_light = 0;
+	_voxel = 0;
+	_voxelTerrain = 0;
+	_jobSystem = 0;
+	_frameCount = 0;
 }
 
 bool SceneVoxelTerrain::Initialize(DX11Instance* Direct3D, HWND hwnd, int screenWidth, int screenHeight, float screenDepth)
@@ -40,7 +47,7 @@ bool SceneVoxelTerrain::Initialize(DX11Instance* Direct3D, HWND hwnd, int screen
 	}
 
 	// Set the initial Position and rotation.
-	_camera->GetTransform()->SetPosition(0.0f, 0.0f, -200.0f);
+	_camera->GetTransform()->SetPosition(0.0f, 0.0f, -(VOXEL_PLANET_RADIUS + 64.0f));
 	_camera->GetTransform()->SetRotation(0.0f, 0.0f, 0.0f);
 
 	// Set the initial Position of the camera and build the matrices needed for rendering.
@@ -87,21 +94,58 @@ bool SceneVoxelTerrain::Initialize(DX11Instance* Direct3D, HWND hwnd, int screen
 		return false;
 	}
 
+	// Create the job system that builds the terrain.
+	_jobSystem = new JobSystem;
+	if (!_jobSystem)
+	{
+		return false;
+	}
+
+	result = _jobSystem->Initialize(VOXEL_WORKER_THREADS);
+	if (!result)
+	{
+		return false;
+	}
+
 	// Initalize the terrain object.
 	_voxelTerrain = new VoxelTerrain;
 
-	result = _voxelTerrain->Initialize(Direct3D->GetDevice(), "Source/shadows/cube.txt", 47);
+	result = _voxelTerrain->Initialize("Source/shadows/cube.txt", 47, VOXEL_MESH_MODE, _jobSystem, VOXEL_PLANET_RADIUS, VOXEL_VIEW_RADIUS, VOXEL_MEMORY_BUDGET, VOXEL_SAVE_DIRECTORY);
 	if (!result)
 	{
 		MessageBox(hwnd, L"Could not initialize the terrain object.", L"Error", MB_OK);
 		return false;
 	}
 
+	_voxelTerrain->SetCaveCulling(VOXEL_CAVE_CULLING);
+	_voxelTerrain->SetLodDistance(VOXEL_LOD_DISTANCE);
+
+	if (VOXEL_BENCHMARKS)
+	{
+		VoxelBenchmark::Run(_voxelTerrain);
+	}
+
 	return true;
 }
 
 void SceneVoxelTerrain::Destroy()
 {
+	// Release the terrain object.
+	if (_voxelTerrain)
+	{
+		_voxelTerrain->Destroy();
+		delete _voxelTerrain;
+		_voxelTerrain = 0;
+	}
+
+	// Release the job system.
+	if (_jobSystem)
+	{
+		_jobSystem->Destroy();
+		delete _jobSystem;
+		_jobSystem = 0;
+	}
+
 	// Release the light object.
 	if (_light)
 	{
@@ -179,6 +223,30 @@ void SceneVoxelTerrain::ProcessInput(Input * input, float frameTime)
 	keyDown = input->IsPgDownPressed();
 	_camera->GetTransform()->LookDownward(keyDown);
 
+	// Dig a hole where the camera is looking.
+	if (input->IsSpacePressed())
+	{
+		XMFLOAT3 position, rotation;
+		VoxelTerrain::Ray ray;
+		VoxelTerrain::RaycastHit hit;
+
+		_camera->GetTransform()->GetPosition(position);
+		_camera->GetTransform()->GetRotation(rotation);
+
+		XMMATRIX rotationMatrix = XMMatrixRotationRollPitchYaw(rotation.x * 0.0174532925f, rotation.y * 0.0174532925f, rotation.z * 0.0174532925f);
+		XMVECTOR forward = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), rotationMatrix);
+
+		ray.Origin = position;
+		XMStoreFloat3(&ray.Direction, forward);
+		ray.MaxDistance = VOXEL_DIG_DISTANCE;
+
+		if (_voxelTerrain->Raycast(ray, hit))
+		{
+			XMFLOAT3 digPoint((float)hit.X + 0.5f, (float)hit.Y + 0.5f, (float)hit.Z + 0.5f);
+			_voxelTerrain->ApplyBrush(digPoint, VOXEL_BRUSH_RADIUS, false, BlockType_Default);
+		}
+	}
+
 	return;
 }
 
@@ -204,24 +272,36 @@ bool SceneVoxelTerrain::Draw(DX11Instance* direct3D, ShaderManager* shaderManage
 	// Get the Position of the camera.
 	_camera->GetTransform()->GetPosition(cameraPosition);
 
+	// Construct the frustum.
+	_frustum->ConstructFrustum(projectionMatrix, viewMatrix);
+
+	// Stream the chunks around the camera in and out.
+	result = _voxelTerrain->Update(direct3D->GetDevice(), direct3D->GetDeviceContext(), cameraPosition, _frustum);
+	if (!result)
+	{
+		return false;
+	}
+
+	ReportStreamingStats();
+
 	// Turn the Z buffer back on now that all 2D rendering has completed.
 	direct3D->TurnZBufferOn();
 	direct3D->TurnOnCulling();
 
-	for (int z = 0; z < VoxelTerrain::CHUNK_COUNT; z++)
+	const std::vector<VoxelChunk*>& chunks = _voxelTerrain->GetDrawList();
+	for (size_t i = 0; i < chunks.size(); i++)
 	{
-		for (int y = 0; y < VoxelTerrain::CHUNK_COUNT; y++)
+		chunks[i]->Render(direct3D->GetDeviceContext());
+
+		//shaderManager->RenderColourShader(direct3D->GetDeviceContext(), chunks[i]->GetIndexCount(), worldMatrix, viewMatrix, projectionMatrix);
+		if (chunks[i]->IsPacked())
+		{
+			shaderManager->RenderPackedVoxelShader(direct3D->GetDeviceContext(), chunks[i]->GetIndexCount(), worldMatrix, viewMatrix, projectionMatrix,
+				_textureManager->GetTexture(47), chunks[i]->GetOrigin());
+		}
+		else
 		{
-			for (int x = 0; x < VoxelTerrain::CHUNK_COUNT; x++)
-			{
-				if (_voxelTerrain->HasBlocks(x, y, z))
-				{
-					_voxelTerrain->Render(direct3D->GetDeviceContext(), x, y, z);
-
-					//shaderManager->RenderColourShader(direct3D->GetDeviceContext(), _voxelTerrain->GetIndexCount(x, y, z), worldMatrix, viewMatrix, projectionMatrix);
-					shaderManager->RenderTextureShader(direct3D->GetDeviceContext(), _voxelTerrain->GetIndexCount(x, y, z), worldMatrix, viewMatrix, projectionMatrix, _textureManager->GetTexture(47));
-				}
-			}
+			shaderManager->RenderVoxelShader(direct3D->GetDeviceContext(), chunks[i]->GetIndexCount(), worldMatrix, viewMatrix, projectionMatrix, _textureManager->GetTexture(47));
 		}
 	}
 
@@ -229,4 +309,42 @@ bool SceneVoxelTerrain::Draw(DX11Instance* direct3D, ShaderManager* shaderManage
 	direct3D->EndScene();
 
 	return true;
+}
+
+void SceneVoxelTerrain::ReportStreamingStats()
+{
+	char line[512];
+
+	_frameCount++;
+	if (VOXEL_STATS_INTERVAL <= 0 || (_frameCount % VOXEL_STATS_INTERVAL) != 0)
+	{
+		return;
+	}
+
+	const VoxelTerrain::StreamingStats& stats = _voxelTerrain->GetStats();
+
+	sprintf_s(line, "Voxel streaming: resident %d chunks (%.1f MB)  queued %d  in flight %d  uploaded %d chunks (%d bytes)  evicted %d  remeshed %d (%.3f ms)  loaded %d  saved %d\n",
+		stats.ResidentChunks, stats.ResidentBytes / (1024.0f * 1024.0f), stats.QueuedChunks, stats.ChunksInFlight,
+		stats.UploadedChunks, stats.UploadedBytes, stats.EvictedChunks, stats.RemeshedChunks, stats.RemeshMilliseconds,
+		stats.LoadedChunks, stats.SavedChunks);
+	OutputDebugStringA(line);
+
+	sprintf_s(line, "Voxel culling: visited %d  culled %d  drawn %d\n", stats.VisitedChunks, stats.CulledChunks, stats.DrawnChunks);
+	OutputDebugStringA(line);
+
+	sprintf_s(line, "Voxel detail: %d triangles  chunks at 1x %d  2x %d  4x %d  8x %d\n", stats.DrawnTriangles,
+		stats.LodChunks[0], stats.LodChunks[1], stats.LodChunks[2], stats.LodChunks[3]);
+	OutputDebugStringA(line);
+
+	sprintf_s(line, "Voxel lighting: visited %d voxels (%.3f ms)\n", stats.LitVoxels, stats.LightMilliseconds);
+	OutputDebugStringA(line);
+
+	VoxelTerrain::StorageStats storage;
+	_voxelTerrain->GetStorageStats(storage);
+
+	int storedChunks = storage.UniformChunks + storage.OctreeChunks + storage.DenseChunks;
+	sprintf_s(line, "Voxel storage: uniform %d  octree %d  dense %d  voxels %.2f MB (%.0f bytes per chunk) against %.2f MB dense\n",
+		storage.UniformChunks, storage.OctreeChunks, storage.DenseChunks, storage.VoxelBytes / (1024.0f * 1024.0f),
+		(storedChunks > 0) ? (float)storage.VoxelBytes / storedChunks : 0.0f, storage.DenseVoxelBytes / (1024.0f * 1024.0f));
+	OutputDebugStringA(line);
 }
\ No newline at end of file
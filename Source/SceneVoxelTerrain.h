@@ -6,6 +6,19 @@
 
 #include "VoxelTerrain.h"
 
+const VoxelMeshMode VOXEL_MESH_MODE = VoxelMeshMode_BinaryGreedy;	// How the voxel chunks are meshed
+const float VOXEL_PLANET_RADIUS = 2048.0f;					// The radius of the planet in voxels, far more chunks than fit in memory
+const int VOXEL_VIEW_RADIUS = 8;							// The number of chunks streamed in around the camera
+const bool VOXEL_CAVE_CULLING = true;						// Only draw the chunks in the frustum that can be seen through the empty voxels in front of them
+const int VOXEL_LOD_DISTANCE = 4;							// Chunks from this far away are meshed at half the detail, halving again each time it doubles, 0 for full detail everywhere
+const int VOXEL_MEMORY_BUDGET = 512;						// The megabytes of chunks kept resident before the least recently used are evicted
+const float VOXEL_BRUSH_RADIUS = 2.5f;						// The radius of the brush that digs holes with the space bar, a 5 voxel brush
+const float VOXEL_DIG_DISTANCE = 48.0f;						// How far in front of the camera the brush can reach the ground
+const int VOXEL_WORKER_THREADS = -1;						// Threads building the chunks alongside the main thread, -1 for one per spare core
+const bool VOXEL_BENCHMARKS = false;						// Time the voxel code and write the results to the output window on startup
+const int VOXEL_STATS_INTERVAL = 0;							// Frames between writing the streaming stats to the output window, 0 to never write them
+const char* const VOXEL_SAVE_DIRECTORY = "VoxelWorld";		// Where edited chunks are saved as region files, so the digging is kept between runs
+
 class SceneVoxelTerrain : public IScene
 {
 public:
@@ -18,9 +31,12 @@ public:
 private:
 	void ProcessInput(Input*, float) override;
 	bool Draw(DX11Instance*, ShaderManager*) override;
+	void ReportStreamingStats();
 
 	Light*					_light;
 
 	Object*					_voxel;
 	VoxelTerrain*			_voxelTerrain;
+	JobSystem*				_jobSystem;
+	int						_frameCount;
 };
\ No newline at end of file
@@ -7,6 +7,9 @@ ShaderManager::ShaderManager()
 	_lightShader = nullptr;
 	_skydomeShader = nullptr;
 	_terrainShader = nullptr;
+	_voxelShader = nullptr;
+	_packedVoxelShader = nullptr;
+	_skeletonShader = nullptr;
 }
 
 ShaderManager::~ShaderManager()
@@ -87,6 +90,48 @@ bool ShaderManager::Initialize(ID3D11Device* device, HWND hwnd)
 		return false;
 	}
 
+	// Create the voxel shader object.
+	_voxelShader = new VoxelShader;
+	if (!_voxelShader)
+	{
+		return false;
+	}
+
+	// Initialize the voxel shader object.
+	result = _voxelShader->Initialize(device, hwnd, L"Source/Shaders/VoxelPixelShader.hlsl", L"Source/Shaders/VoxelVertexShader.hlsl");
+	if (!result)
+	{
+		return false;
+	}
+
+	// Create the packed voxel shader object.
+	_packedVoxelShader = new PackedVoxelShader;
+	if (!_packedVoxelShader)
+	{
+		return false;
+	}
+
+	// Initialize the packed voxel shader object, which shares the pixel shader of the voxel shader.
+	result = _packedVoxelShader->Initialize(device, hwnd, L"Source/Shaders/VoxelPixelShader.hlsl", L"Source/Shaders/PackedVoxelVertexShader.hlsl");
+	if (!result)
+	{
+		return false;
+	}
+
+	// Create the skeleton shader object.
+	_skeletonShader = new SkeletonShader;
+	if (!_skeletonShader)
+	{
+		return false;
+	}
+
+	// Initialize the skeleton shader object.
+	result = _skeletonShader->Initialize(device, hwnd, L"Source/Shaders/SkeletonPixelShader.hlsl", L"Source/Shaders/SkeletonVertexShader.hlsl");
+	if (!result)
+	{
+		return false;
+	}
+
 	// Create the deferred shader object.
 	_deferredShader = new DeferredShader;
 	if (!_deferredShader)
@@ -148,6 +193,30 @@ bool ShaderManager::Initialize(ID3D11Device* device, HWND hwnd)
 
 void ShaderManager::Destroy()
 {
+	// Release the skeleton shader object.
+	if (_skeletonShader)
+	{
+		_skeletonShader->Destroy();
+		delete _skeletonShader;
+		_skeletonShader = 0;
+	}
+
+	// Release the packed voxel shader object.
+	if (_packedVoxelShader)
+	{
+		_packedVoxelShader->Destroy();
+		delete _packedVoxelShader;
+		_packedVoxelShader = 0;
+	}
+
+	// Release the voxel shader object.
+	if (_voxelShader)
+	{
+		_voxelShader->Destroy();
+		delete _voxelShader;
+		_voxelShader = 0;
+	}
+
 	// Release the terrain shader object.
 	if (_terrainShader)
 	{
@@ -203,6 +272,24 @@ bool ShaderManager::RenderTextureShader(ID3D11DeviceContext* deviceContext, int
 	return _textureShader->Render(deviceContext, indexCount, worldMatrix, viewMatrix, projectionMatrix, texture);
 }
 
+bool ShaderManager::RenderVoxelShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture)
+{
+	return _voxelShader->Render(deviceContext, indexCount, worldMatrix, viewMatrix, projectionMatrix, texture);
+}
+
+bool ShaderManager::RenderPackedVoxelShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, XMFLOAT3 chunkOrigin)
+{
+	return _packedVoxelShader->Render(deviceContext, indexCount, worldMatrix, viewMatrix, projectionMatrix, texture, chunkOrigin);
+}
+
+bool ShaderManager::RenderSkeletonShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, const XMFLOAT4* jointRows, int jointCount)
+{
+	return _skeletonShader->Render(deviceContext, indexCount, worldMatrix, viewMatrix, projectionMatrix, texture, jointRows, jointCount);
+}
+
 bool ShaderManager::RenderLightShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
 	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, XMFLOAT3 lightDirection,
 	XMFLOAT4 diffuseColor)
@@ -9,6 +9,9 @@
 #include "LightShader.h"
 #include "SkydomeShader.h"
 #include "TerrainShader.h"
+#include "VoxelShader.h"
+#include "PackedVoxelShader.h"
+#include "SkeletonShader.h"
 
 #include "DeferredShader.h"
 #include "DeferredLightShader.h"
@@ -37,6 +40,12 @@ public:
 		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* normalMap,
 		ID3D11ShaderResourceView* normalMap2, ID3D11ShaderResourceView* normalMap3,
 		XMFLOAT3 lightDirection, XMFLOAT4 diffuseColor);
+	bool RenderVoxelShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture);
+	bool RenderPackedVoxelShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, XMFLOAT3 chunkOrigin);
+	bool RenderSkeletonShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, const XMFLOAT4* jointRows, int jointCount);
 
 	bool RenderDeferredShader(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
 		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture);
@@ -55,6 +64,9 @@ private:
 	LightShader*			_lightShader;
 	SkyDomeShader*			_skydomeShader;
 	TerrainShader*			_terrainShader;
+	VoxelShader*			_voxelShader;
+	PackedVoxelShader*		_packedVoxelShader;
+	SkeletonShader*			_skeletonShader;
 
 	DeferredShader*			_deferredShader;
 	DeferredLightShader*	_deferredLightShader;
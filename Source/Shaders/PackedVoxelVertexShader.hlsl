@@ -0,0 +1,57 @@
+cbuffer MatrixBuffer
+{
+	matrix worldMatrix;
+	matrix viewMatrix;
+	matrix projectionMatrix;
+};
+
+cbuffer ChunkBuffer
+{
+	float3 chunkOrigin;
+	float padding;
+};
+
+// The right and up axes of each face and the way they run, the same as VoxelMesher::FACES.
+static const uint faceRightAxes[6] = { 2, 2, 0, 0, 0, 0 };
+static const float faceRightSigns[6] = { -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f };
+static const uint faceUpAxes[6] = { 1, 1, 2, 2, 1, 1 };
+static const float faceUpSigns[6] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+struct VertexInputType
+{
+	uint2 packed : POSITION;
+};
+
+struct PixelInputType
+{
+	float4 position : SV_POSITION;
+	float2 tex : TEXCOORD0;
+	float4 light : COLOR;
+};
+
+PixelInputType PackedVoxelVertexShader(VertexInputType input)
+{
+	PixelInputType output;
+	float3 local;
+	uint face;
+	uint light;
+
+	// Unpack the corner of the voxels, counted from the corner of the chunk, and the face it belongs to.
+	local = float3(input.packed.x & 0x7F, (input.packed.x >> 7) & 0x7F, (input.packed.x >> 14) & 0x7F);
+	face = (input.packed.x >> 21) & 0x7;
+
+	// Calculate the position of the vertex against the world, view, and projection matrices.
+	output.position = mul(float4(chunkOrigin + local, 1.0f), worldMatrix);
+	output.position = mul(output.position, viewMatrix);
+	output.position = mul(output.position, projectionMatrix);
+
+	// The texture repeats once per voxel along the faces right axis and down its up axis.
+	output.tex = float2(faceRightSigns[face] * local[faceRightAxes[face]], -faceUpSigns[face] * local[faceUpAxes[face]]);
+
+	// Spread the ambient occlusion, sunlight and block light over 0 to 1, the same as the full voxel vertices. The
+	// texture layer in the top of the surface is left for when the blocks have a texture each.
+	light = (input.packed.y >> 8) & 0xFF;
+	output.light = float4((input.packed.y & 0x3) / 3.0f, (light >> 4) / 15.0f, (light & 0xF) / 15.0f, 1.0f);
+
+	return output;
+}
@@ -1,10 +1,4 @@
-Texture2D texture0  : register(t0);
-Texture2D texture1  : register(t1);
-Texture2D texture2  : register(t2);
-Texture2D texture3  : register(t3);
-Texture2D texture4  : register(t4);
-
-
+Texture2D shaderTexture;
 SamplerState SampleType;
 
 struct PixelInputType
@@ -13,7 +7,7 @@ struct PixelInputType
 	float2 tex : TEXCOORD0;
 };
 
-float4 TexturePixelShader(PixelInputType input) : SV_TARGET
+float4 SkeletonPixelShader(PixelInputType input) : SV_TARGET
 {
 	float4 textureColor;
 
@@ -21,4 +15,4 @@ float4 TexturePixelShader(PixelInputType input) : SV_TARGET
 	textureColor = shaderTexture.Sample(SampleType, input.tex);
 
 	return textureColor;
-}
\ No newline at end of file
+}
@@ -1,3 +1,5 @@
+#define MAX_JOINTS 64
+
 cbuffer MatrixBuffer
 {
 	matrix worldMatrix;
@@ -5,10 +7,20 @@ cbuffer MatrixBuffer
 	matrix projectionMatrix;
 };
 
+// The pose of each joint times the inverse of its bind pose, three rows of a 3x4 matrix per joint, the same as
+// Skeleton::JointMatrix.
+cbuffer JointBuffer
+{
+	float4 jointRows[MAX_JOINTS * 3];
+};
+
 struct VertexInputType
 {
-	float4 position : POSITION;
+	float3 position : POSITION;
 	float2 tex : TEXCOORD0;
+	float3 normal : NORMAL;
+	uint4 joints : BLENDINDICES;
+	float4 weights : BLENDWEIGHT;
 };
 
 struct PixelInputType
@@ -17,15 +29,26 @@ struct PixelInputType
 	float2 tex : TEXCOORD0;
 };
 
-PixelInputType TextureVertexShader(VertexInputType input)
+float3x4 GetJointMatrix(uint joint)
+{
+	return float3x4(jointRows[joint * 3], jointRows[(joint * 3) + 1], jointRows[(joint * 3) + 2]);
+}
+
+PixelInputType SkeletonVertexShader(VertexInputType input)
 {
 	PixelInputType output;
+	float4 bindPosition;
+	float3 position;
 
-	// Change the position vector to be 4 units for proper matrix calculations.
-	input.position.w = 1.0f;
+	// Blend the bind pose position through the four joints with the most weight on the vertex.
+	bindPosition = float4(input.position, 1.0f);
+	position = input.weights.x * mul(GetJointMatrix(input.joints.x), bindPosition);
+	position += input.weights.y * mul(GetJointMatrix(input.joints.y), bindPosition);
+	position += input.weights.z * mul(GetJointMatrix(input.joints.z), bindPosition);
+	position += input.weights.w * mul(GetJointMatrix(input.joints.w), bindPosition);
 
 	// Calculate the position of the vertex against the world, view, and projection matrices.
-	output.position = mul(input.position, worldMatrix);
+	output.position = mul(float4(position, 1.0f), worldMatrix);
 	output.position = mul(output.position, viewMatrix);
 	output.position = mul(output.position, projectionMatrix);
 
@@ -33,4 +56,4 @@ PixelInputType TextureVertexShader(VertexInputType input)
 	output.tex = input.tex;
 
 	return output;
-}
\ No newline at end of file
+}
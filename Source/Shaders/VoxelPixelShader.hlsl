@@ -0,0 +1,27 @@
+Texture2D shaderTexture;
+SamplerState SampleType;
+
+struct PixelInputType
+{
+	float4 position : SV_POSITION;
+	float2 tex : TEXCOORD0;
+	float4 light : COLOR;
+};
+
+float4 VoxelPixelShader(PixelInputType input) : SV_TARGET
+{
+	float4 textureColor;
+	float occlusion;
+	float brightness;
+
+	// Sample the pixel color from the texture using the sampler at this texture coordinate location.
+	textureColor = shaderTexture.Sample(SampleType, input.tex);
+
+	// The red channel holds the ambient occlusion, which never goes fully black.
+	occlusion = lerp(0.35f, 1.0f, input.light.r);
+
+	// Green holds the sunlight and blue the block light. Each level down from full is a fifth darker.
+	brightness = pow(0.8f, 15.0f - (max(input.light.g, input.light.b) * 15.0f));
+
+	return float4(textureColor.rgb * occlusion * brightness, textureColor.a);
+}
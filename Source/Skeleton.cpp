@@ -1,203 +1,2690 @@
 #include "Skeleton.h"
+#include "MD5Tokenizer.h"
 
+#include <algorithm>
+#include <float.h>
+#include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <unordered_map>
+#include <xmmintrin.h>
+
+// Reads a vector written as ( x z y ), swapping the y and z axes the way the model was made
+static inline bool ReadSwappedVector(MD5Tokenizer& tokenizer, float& x, float& y, float& z)
+{
+	return tokenizer.Expect("(") && tokenizer.ReadFloat(x) && tokenizer.ReadFloat(z) && tokenizer.ReadFloat(y) && tokenizer.Expect(")");
+}
+
+// Names in the files are plain ASCII, so widening them a character at a time is all the wide streams did
+static inline std::wstring WidenToken(const MD5Token& token)
+{
+	return std::wstring(token.Start, token.Start + token.Length);
+}
+
+// How far the compressed animation may stray from the frames as loaded, in model units and in radians
+static const float ANIMATION_POSITION_TOLERANCE = 0.01f;
+static const float ANIMATION_ROTATION_TOLERANCE = 0.001f;
+
+// The parts of a rotation other than the largest lie within plus or minus one over the square root of two
+static const float SMALLEST_THREE_RANGE = 0.70710678f;
+static const int SMALLEST_THREE_STEPS = 32767;
+
+// Loads the same row of the joint matrices of four lanes, transposed so each register holds one column of the row
+// for all four lanes
+static inline void LoadMatrixRow(const float* lane0, const float* lane1, const float* lane2, const float* lane3, __m128 columns[4])
+{
+	columns[0] = _mm_loadu_ps(lane0);
+	columns[1] = _mm_loadu_ps(lane1);
+	columns[2] = _mm_loadu_ps(lane2);
+	columns[3] = _mm_loadu_ps(lane3);
+
+	_MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+}
+
+// Sets a joint matrix to the rotation the weights get from multiplying them by the conjugate of an orientation on the
+// left and by the orientation on the right, followed by a move to a position
+static inline void SetJointMatrix(Skeleton::JointMatrix& matrix, const XMFLOAT4& orientation, const XMFLOAT3& position)
+{
+	float x = orientation.x, y = orientation.y, z = orientation.z, w = orientation.w;
+
+	matrix.Rows[0] = XMFLOAT4(1.0f - (2.0f * ((y * y) + (z * z))), 2.0f * ((x * y) + (z * w)), 2.0f * ((x * z) - (y * w)), position.x);
+	matrix.Rows[1] = XMFLOAT4(2.0f * ((x * y) - (z * w)), 1.0f - (2.0f * ((x * x) + (z * z))), 2.0f * ((y * z) + (x * w)), position.y);
+	matrix.Rows[2] = XMFLOAT4(2.0f * ((x * z) + (y * w)), 2.0f * ((y * z) - (x * w)), 1.0f - (2.0f * ((x * x) + (y * y))), position.z);
+}
+
+// The inverse of a joint matrix, which only rotates and moves, so its rotation is inverted by transposing it
+static inline void InvertJointMatrix(const Skeleton::JointMatrix& matrix, Skeleton::JointMatrix& inverse)
+{
+	const XMFLOAT4* rows = matrix.Rows;
+
+	inverse.Rows[0] = XMFLOAT4(rows[0].x, rows[1].x, rows[2].x, -((rows[0].x * rows[0].w) + (rows[1].x * rows[1].w) + (rows[2].x * rows[2].w)));
+	inverse.Rows[1] = XMFLOAT4(rows[0].y, rows[1].y, rows[2].y, -((rows[0].y * rows[0].w) + (rows[1].y * rows[1].w) + (rows[2].y * rows[2].w)));
+	inverse.Rows[2] = XMFLOAT4(rows[0].z, rows[1].z, rows[2].z, -((rows[0].z * rows[0].w) + (rows[1].z * rows[1].w) + (rows[2].z * rows[2].w)));
+}
+
+// The joint matrix that applies the second and then the first
+static inline void MultiplyJointMatrices(const Skeleton::JointMatrix& first, const Skeleton::JointMatrix& second, Skeleton::JointMatrix& result)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		const XMFLOAT4& row = first.Rows[i];
+
+		result.Rows[i].x = (row.x * second.Rows[0].x) + (row.y * second.Rows[1].x) + (row.z * second.Rows[2].x);
+		result.Rows[i].y = (row.x * second.Rows[0].y) + (row.y * second.Rows[1].y) + (row.z * second.Rows[2].y);
+		result.Rows[i].z = (row.x * second.Rows[0].z) + (row.y * second.Rows[1].z) + (row.z * second.Rows[2].z);
+		result.Rows[i].w = (row.x * second.Rows[0].w) + (row.y * second.Rows[1].w) + (row.z * second.Rows[2].w) + row.w;
+	}
+}
+
+// One row of the joint matrices of four lanes applied to their (x, y, z, w)
+static inline __m128 TransformRow(const __m128 columns[4], __m128 x, __m128 y, __m128 z, __m128 w)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0], x), _mm_mul_ps(columns[1], y)), _mm_add_ps(_mm_mul_ps(columns[2], z), _mm_mul_ps(columns[3], w)));
+}
 
 Skeleton::Skeleton()
 {
+	_transform = 0;
+	_skinningMode = SkinningMode_Shader;
+	_compressedAnimation = true;
+	_boundingRadius = 0.0f;
+	_positionTolerance = ANIMATION_POSITION_TOLERANCE;
+	_rotationTolerance = ANIMATION_ROTATION_TOLERANCE;
+
+	ResetLayers();
+}
+
+Skeleton::~Skeleton()
+{
+}
+
+bool Skeleton::Initialize(ID3D11Device * device, ID3D11DeviceContext* context, TextureManager* textureManager, std::wstring meshFileName, std::wstring animFileName)
+{
+	// Only parse the text files when there is no up to date compiled file, and compile them for next time
+	if (!LoadCompiled(meshFileName, animFileName))
+	{
+		if (!LoadText(meshFileName, animFileName))
+			return false;
+
+		SaveCompiled(meshFileName, animFileName);
+	}
+
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		ModelSubset& subset = _md5Model.Subsets[i];
+
+		textureManager->LoadJPEGTexture(device, context, subset.TextureFileName, subset.TexArrayIndex);
+		CreateSubsetBuffers(device, subset);
+	}
+
+	if (!CreateInstance(device, _state))
+	{
+		return false;
+	}
+
+	_transform = new Transform;
+
+	CompressAnimation(ANIMATION_POSITION_TOLERANCE, ANIMATION_ROTATION_TOLERANCE);
+
+	SetSkinningMode(_skinningMode);
+	Pose(0.0f);
+
+	return true;
+}
+
+bool Skeleton::LoadText(std::wstring meshFileName, std::wstring animFileName)
+{
+	return LoadTextFiles(meshFileName, animFileName, false);
+}
+
+bool Skeleton::LoadTextReference(std::wstring meshFileName, std::wstring animFileName)
+{
+	return LoadTextFiles(meshFileName, animFileName, true);
+}
+
+bool Skeleton::LoadTextFiles(std::wstring meshFileName, std::wstring animFileName, bool reference)
+{
+	if (!ParseText(meshFileName, animFileName, reference))
+		return false;
+
+	CreatePoseBuffers();
+
+	return true;
+}
+
+bool Skeleton::ParseText(std::wstring meshFileName, std::wstring animFileName, bool reference)
+{
+	_md5Model = Model3D();
+	_frameBounds.clear();
+	_meshFileName = meshFileName;
+	_animFileName = animFileName;
+
+	if (!(reference ? LoadMD5ModelReference(meshFileName, _md5Model) : LoadMD5Model(meshFileName, _md5Model)))
+		return false;
+
+	if (!(reference ? LoadMD5AnimReference(animFileName, _md5Model) : LoadMD5Anim(animFileName, _md5Model)))
+		return false;
+
+	return true;
+}
+
+bool Skeleton::LoadCompiled(std::wstring meshFileName, std::wstring animFileName)
+{
+	CompiledHeader stamps;
+	if (!GetSourceStamps(meshFileName, animFileName, stamps))
+	{
+		return false;
+	}
+
+	// Map a private copy of the file, so the offsets in it can be fixed up into pointers where they are
+	std::wstring compiledFileName = GetCompiledFileName(meshFileName);
+	HANDLE file = CreateFileW(compiledFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = NULL;
+	char* view = 0;
+
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (long long)sizeof(CompiledHeader))
+	{
+		mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (mapping)
+		{
+			view = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		}
+	}
+
+	bool result = false;
+	if (view)
+	{
+		result = ReadCompiled(view, (unsigned long long)fileSize.QuadPart, stamps);
+		UnmapViewOfFile(view);
+	}
+
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+
+	if (result)
+	{
+		_meshFileName = meshFileName;
+		_animFileName = animFileName;
+		CreatePoseBuffers();
+	}
+
+	return result;
+}
+
+bool Skeleton::FixUpCompiledArray(CompiledArray& array, char* view, unsigned long long fileSize, size_t elementSize)
+{
+	unsigned long long offset = array.Offset;
+
+	// A file cut short, or not made by this loader, could point anywhere
+	if (offset > fileSize || array.Count > (fileSize - offset) / elementSize)
+	{
+		return false;
+	}
+
+	array.Data = view + offset;
+
+	return true;
+}
+
+template <typename T>
+void Skeleton::AddCompiledArray(std::vector<char>& data, CompiledArray& array, const T& values)
+{
+	size_t size = values.size() * sizeof(values[0]);
+
+	// Keep every array aligned for SIMD loads from the mapped file
+	data.resize((data.size() + 15) & ~(size_t)15);
+
+	array.Offset = data.size();
+	array.Count = (unsigned int)values.size();
+	array.Padding = 0;
+
+	if (size > 0)
+	{
+		data.resize(data.size() + size);
+		memcpy(&data[(size_t)array.Offset], &values[0], size);
+	}
+}
+
+template <typename T>
+void Skeleton::CopyCompiledArray(const CompiledArray& array, T& values)
+{
+	const typename T::value_type* first = (const typename T::value_type*)array.Data;
+
+	values.assign(first, first + array.Count);
+}
+
+bool Skeleton::ReadCompiled(char* view, unsigned long long fileSize, const CompiledHeader& stamps)
+{
+	CompiledHeader* header = (CompiledHeader*)view;
+
+	if (header->Magic != COMPILED_MAGIC || header->Version != COMPILED_VERSION || header->MeshSize != stamps.MeshSize ||
+		header->MeshWriteTime != stamps.MeshWriteTime || header->AnimSize != stamps.AnimSize || header->AnimWriteTime != stamps.AnimWriteTime)
+	{
+		return false;
+	}
+
+	if (!FixUpCompiledArray(header->Joints, view, fileSize, sizeof(CompiledJoint)) ||
+		!FixUpCompiledArray(header->Subsets, view, fileSize, sizeof(CompiledSubset)) ||
+		!FixUpCompiledArray(header->FrameBounds, view, fileSize, sizeof(BoundingBox)) ||
+		!FixUpCompiledArray(header->FramePoses, view, fileSize, sizeof(JointPose)) ||
+		!FixUpCompiledArray(header->FittedBounds, view, fileSize, sizeof(BoundingBox)))
+	{
+		return false;
+	}
+
+	if ((int)header->Joints.Count != header->NumJoints || (int)header->Subsets.Count != header->NumSubsets || header->NumFrames <= 0 ||
+		header->FramePoses.Count != (unsigned int)(header->NumFrames * header->NumJoints) ||
+		header->FittedBounds.Count != (unsigned int)header->NumFrames)
+	{
+		return false;
+	}
+
+	CompiledJoint* joints = (CompiledJoint*)header->Joints.Data;
+	CompiledSubset* subsets = (CompiledSubset*)header->Subsets.Data;
+
+	// Every parent has to come before its children, which also keeps the hierarchy free of loops
+	for (unsigned int i = 0; i < header->Joints.Count; i++)
+	{
+		if (!FixUpCompiledArray(joints[i].Name, view, fileSize, sizeof(wchar_t)) || joints[i].ParentID < -1 ||
+			joints[i].ParentID >= (int)i)
+		{
+			return false;
+		}
+	}
+
+	for (unsigned int i = 0; i < header->Subsets.Count; i++)
+	{
+		CompiledSubset& subset = subsets[i];
+
+		if (!FixUpCompiledArray(subset.TextureFileName, view, fileSize, sizeof(wchar_t)) ||
+			!FixUpCompiledArray(subset.Vertices, view, fileSize, sizeof(Vertex)) ||
+			!FixUpCompiledArray(subset.Indices, view, fileSize, sizeof(DWORD)) ||
+			!FixUpCompiledArray(subset.Weights, view, fileSize, sizeof(Weight)) ||
+			!FixUpCompiledArray(subset.Positions, view, fileSize, sizeof(XMFLOAT3)) ||
+			!FixUpCompiledArray(subset.SkinGroups, view, fileSize, sizeof(SkinGroup)) ||
+			!FixUpCompiledArray(subset.SkinSlots, view, fileSize, sizeof(SkinSlot)) ||
+			!FixUpCompiledArray(subset.BindVertices, view, fileSize, sizeof(SkinnedVertex)) ||
+			!CheckCompiledSubset(subset, header->NumJoints))
+		{
+			return false;
+		}
+	}
+
+	// Everything is in place, so the model is copied straight out of the arrays
+	_md5Model = Model3D();
+	_md5Model.NumJoints = header->NumJoints;
+	_md5Model.NumSubsets = header->NumSubsets;
+	_md5Model.Joints.resize(header->Joints.Count);
+	_md5Model.Subsets.resize(header->Subsets.Count);
+
+	for (unsigned int i = 0; i < header->Joints.Count; i++)
+	{
+		Joint& joint = _md5Model.Joints[i];
+		const wchar_t* name = (const wchar_t*)joints[i].Name.Data;
+
+		joint.Name.assign(name, name + joints[i].Name.Count);
+		joint.ParentID = joints[i].ParentID;
+		joint.Postion = joints[i].Position;
+		joint.Orientation = joints[i].Orientation;
+	}
+
+	for (unsigned int i = 0; i < header->Subsets.Count; i++)
+	{
+		const CompiledSubset& compiled = subsets[i];
+		ModelSubset& subset = _md5Model.Subsets[i];
+
+		subset.TexArrayIndex = compiled.TexArrayIndex;
+		subset.NumTriangles = compiled.NumTriangles;
+		CopyCompiledArray(compiled.TextureFileName, subset.TextureFileName);
+		CopyCompiledArray(compiled.Vertices, subset.Vertices);
+		CopyCompiledArray(compiled.Indices, subset.Indices);
+		CopyCompiledArray(compiled.Weights, subset.Weights);
+		CopyCompiledArray(compiled.Positions, subset.Positions);
+		CopyCompiledArray(compiled.SkinGroups, subset.SkinGroups);
+		CopyCompiledArray(compiled.SkinSlots, subset.SkinSlots);
+		CopyCompiledArray(compiled.BindVertices, subset.BindVertices);
+
+		subset.IndexBuff = 0;
+		subset.BindVertBuff = 0;
+	}
+
+	ModelAnimation animation;
+	animation.NumFrames = header->NumFrames;
+	animation.NumJoints = header->NumJoints;
+	animation.FrameRate = header->FrameRate;
+	animation.NumAnimatedComponents = header->NumAnimatedComponents;
+	animation.FrameTime = header->FrameTime;
+	animation.TotalAnimTime = header->TotalAnimTime;
+	animation.CurrAnimTime = 0.0f;
+	CopyCompiledArray(header->FrameBounds, animation.FrameBounds);
+	CopyCompiledArray(header->FramePoses, animation.FramePoses);
+
+	_md5Model.Animations.push_back(animation);
+
+	_frameBounds.resize(1);
+	CopyCompiledArray(header->FittedBounds, _frameBounds[0]);
+
+	return true;
+}
+
+bool Skeleton::CheckCompiledSubset(const CompiledSubset& subset, int numJoints)
+{
+	const Vertex* vertices = (const Vertex*)subset.Vertices.Data;
+	const DWORD* indices = (const DWORD*)subset.Indices.Data;
+	const Weight* weights = (const Weight*)subset.Weights.Data;
+	const SkinGroup* groups = (const SkinGroup*)subset.SkinGroups.Data;
+	const SkinSlot* slots = (const SkinSlot*)subset.SkinSlots.Data;
+	const SkinnedVertex* bindVertices = (const SkinnedVertex*)subset.BindVertices.Data;
+	int vertexCount = (int)subset.Vertices.Count;
+
+	// Every index the skinning and drawing follow has to stay inside the arrays it indexes, or a damaged file would
+	// read and write past them rather than fall back to the text files
+	if (subset.NumTriangles < 0 || (unsigned int)subset.NumTriangles > subset.Indices.Count / 3 ||
+		subset.Positions.Count != subset.Vertices.Count || subset.BindVertices.Count != subset.Vertices.Count)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < subset.Indices.Count; i++)
+	{
+		if (indices[i] >= (DWORD)vertexCount)
+		{
+			return false;
+		}
+	}
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		if (vertices[i].StartWeight < 0 || vertices[i].WeightCount < 0 ||
+			vertices[i].WeightCount > (int)subset.Weights.Count - vertices[i].StartWeight)
+		{
+			return false;
+		}
+
+		for (int j = 0; j < 4; j++)
+		{
+			if (bindVertices[i].JointIDs[j] >= numJoints)
+			{
+				return false;
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < subset.Weights.Count; i++)
+	{
+		if (weights[i].JointID < 0 || weights[i].JointID >= numJoints)
+		{
+			return false;
+		}
+	}
+
+	for (unsigned int i = 0; i < subset.SkinGroups.Count; i++)
+	{
+		const SkinGroup& group = groups[i];
+
+		if (group.FirstSlot < 0 || group.SlotCount < 0 || group.SlotCount > (int)subset.SkinSlots.Count - group.FirstSlot)
+		{
+			return false;
+		}
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (group.Vertices[lane] < -1 || group.Vertices[lane] >= vertexCount)
+			{
+				return false;
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < subset.SkinSlots.Count; i++)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (slots[i].JointID[lane] < 0 || slots[i].JointID[lane] >= numJoints)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool Skeleton::SaveCompiled(std::wstring meshFileName, std::wstring animFileName) const
+{
+	std::vector<char> data;
+
+	Compile(data);
+	if (data.empty() || !GetSourceStamps(meshFileName, animFileName, *(CompiledHeader*)&data[0]))
+	{
+		return false;
+	}
+
+	FILE* file;
+	if (_wfopen_s(&file, GetCompiledFileName(meshFileName).c_str(), L"wb") != 0)
+	{
+		return false;
+	}
+
+	bool result = (fwrite(&data[0], data.size(), 1, file) == 1);
+	fclose(file);
+
+	return result;
+}
+
+void Skeleton::Compile(std::vector<char>& data) const
+{
+	CompiledHeader header;
+	memset(&header, 0, sizeof(header));
+	data.clear();
+
+	if (_md5Model.Animations.empty())
+	{
+		return;
+	}
+
+	const ModelAnimation& animation = _md5Model.Animations[0];
+	std::vector<CompiledJoint> joints(_md5Model.Joints.size());
+	std::vector<CompiledSubset> subsets(_md5Model.Subsets.size());
+
+	header.Magic = COMPILED_MAGIC;
+	header.Version = COMPILED_VERSION;
+	header.NumJoints = _md5Model.NumJoints;
+	header.NumSubsets = _md5Model.NumSubsets;
+	header.NumFrames = animation.NumFrames;
+	header.FrameRate = animation.FrameRate;
+	header.NumAnimatedComponents = animation.NumAnimatedComponents;
+	header.FrameTime = animation.FrameTime;
+	header.TotalAnimTime = animation.TotalAnimTime;
+
+	// The header and the tables of joints and subsets come first, and every array after them
+	data.resize(sizeof(CompiledHeader) + (joints.size() * sizeof(CompiledJoint)) + (subsets.size() * sizeof(CompiledSubset)));
+
+	header.Joints.Offset = sizeof(CompiledHeader);
+	header.Joints.Count = (unsigned int)joints.size();
+	header.Subsets.Offset = header.Joints.Offset + (joints.size() * sizeof(CompiledJoint));
+	header.Subsets.Count = (unsigned int)subsets.size();
+	AddCompiledArray(data, header.FrameBounds, animation.FrameBounds);
+	AddCompiledArray(data, header.FramePoses, animation.FramePoses);
+	AddCompiledArray(data, header.FittedBounds, _frameBounds.empty() ? std::vector<BoundingBox>() : _frameBounds[0]);
+
+	for (size_t i = 0; i < joints.size(); i++)
+	{
+		const Joint& joint = _md5Model.Joints[i];
+
+		memset(&joints[i], 0, sizeof(CompiledJoint));
+		joints[i].ParentID = joint.ParentID;
+		joints[i].Position = joint.Postion;
+		joints[i].Orientation = joint.Orientation;
+		AddCompiledArray(data, joints[i].Name, joint.Name);
+	}
+
+	for (size_t i = 0; i < subsets.size(); i++)
+	{
+		const ModelSubset& subset = _md5Model.Subsets[i];
+		CompiledSubset& compiled = subsets[i];
+
+		memset(&compiled, 0, sizeof(CompiledSubset));
+		compiled.TexArrayIndex = subset.TexArrayIndex;
+		compiled.NumTriangles = subset.NumTriangles;
+		AddCompiledArray(data, compiled.TextureFileName, subset.TextureFileName);
+		AddCompiledArray(data, compiled.Vertices, subset.Vertices);
+		AddCompiledArray(data, compiled.Indices, subset.Indices);
+		AddCompiledArray(data, compiled.Weights, subset.Weights);
+		AddCompiledArray(data, compiled.Positions, subset.Positions);
+		AddCompiledArray(data, compiled.SkinGroups, subset.SkinGroups);
+		AddCompiledArray(data, compiled.SkinSlots, subset.SkinSlots);
+		AddCompiledArray(data, compiled.BindVertices, subset.BindVertices);
+	}
+
+	memcpy(&data[0], &header, sizeof(CompiledHeader));
+	if (!joints.empty())
+	{
+		memcpy(&data[(size_t)header.Joints.Offset], &joints[0], joints.size() * sizeof(CompiledJoint));
+	}
+	if (!subsets.empty())
+	{
+		memcpy(&data[(size_t)header.Subsets.Offset], &subsets[0], subsets.size() * sizeof(CompiledSubset));
+	}
+}
+
+std::wstring Skeleton::GetCompiledFileName(std::wstring meshFileName)
+{
+	return meshFileName + L".compiled";
+}
+
+bool Skeleton::GetSourceStamps(const std::wstring& meshFileName, const std::wstring& animFileName, CompiledHeader& header)
+{
+	WIN32_FILE_ATTRIBUTE_DATA mesh, anim;
+
+	if (!GetFileAttributesExW(meshFileName.c_str(), GetFileExInfoStandard, &mesh) ||
+		!GetFileAttributesExW(animFileName.c_str(), GetFileExInfoStandard, &anim))
+	{
+		return false;
+	}
+
+	header.MeshSize = ((unsigned long long)mesh.nFileSizeHigh << 32) | mesh.nFileSizeLow;
+	header.MeshWriteTime = ((unsigned long long)mesh.ftLastWriteTime.dwHighDateTime << 32) | mesh.ftLastWriteTime.dwLowDateTime;
+	header.AnimSize = ((unsigned long long)anim.nFileSizeHigh << 32) | anim.nFileSizeLow;
+	header.AnimWriteTime = ((unsigned long long)anim.ftLastWriteTime.dwHighDateTime << 32) | anim.ftLastWriteTime.dwLowDateTime;
+
+	return true;
+}
+
+void Skeleton::CreatePoseBuffers()
+{
+	_inverseBindMatrices.resize(_md5Model.NumJoints);
+
+	std::vector<float>* bindParts[7] = { &_bindPose.PositionX, &_bindPose.PositionY, &_bindPose.PositionZ,
+		&_bindPose.RotationX, &_bindPose.RotationY, &_bindPose.RotationZ, &_bindPose.RotationW };
+
+	for (int i = 0; i < 7; i++)
+	{
+		bindParts[i]->resize(_md5Model.NumJoints);
+	}
+
+	// The bind pose is where the joints of the mesh file put the vertices, and where the joints no layer moves stay
+	for (int i = 0; i < _md5Model.NumJoints; i++)
+	{
+		const Joint& joint = _md5Model.Joints[i];
+		JointMatrix bindMatrix;
+		SetJointMatrix(bindMatrix, joint.Orientation, joint.Postion);
+		InvertJointMatrix(bindMatrix, _inverseBindMatrices[i]);
+
+		JointPose local = { joint.Postion, joint.Orientation };
+		if (joint.ParentID >= 0)
+		{
+			const Joint& parent = _md5Model.Joints[joint.ParentID];
+			JointPose parentPose = { parent.Postion, parent.Orientation };
+			local = GetLocalJoint(local, parentPose);
+		}
+
+		_bindPose.PositionX[i] = local.Position.x;
+		_bindPose.PositionY[i] = local.Position.y;
+		_bindPose.PositionZ[i] = local.Position.z;
+		_bindPose.RotationX[i] = local.Orientation.x;
+		_bindPose.RotationY[i] = local.Orientation.y;
+		_bindPose.RotationZ[i] = local.Orientation.z;
+		_bindPose.RotationW[i] = local.Orientation.w;
+	}
+
+	// The parents come before their children, so going backwards each joint is done before its parent needs it
+	_jointHeights.assign(_md5Model.NumJoints, 0);
+	for (int i = _md5Model.NumJoints - 1; i >= 0; i--)
+	{
+		int parentID = _md5Model.Joints[i].ParentID;
+		if (parentID >= 0 && _jointHeights[parentID] < _jointHeights[i] + 1)
+		{
+			_jointHeights[parentID] = _jointHeights[i] + 1;
+		}
+	}
+
+	float radiusSquared = 0.0f;
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		const std::vector<XMFLOAT3>& positions = _md5Model.Subsets[i].Positions;
+		for (size_t j = 0; j < positions.size(); j++)
+		{
+			radiusSquared = fmaxf(radiusSquared, (positions[j].x * positions[j].x) + (positions[j].y * positions[j].y) + (positions[j].z * positions[j].z));
+		}
+	}
+	_boundingRadius = sqrtf(radiusSquared);
+
+	// The clips, masks and cached frames were made for the joints of the model that was there before
+	_compressedClips.clear();
+	_jointMasks.clear();
+	DestroyCachedFrames();
+	CreateInstance(0, _state);
+
+	// The compiled file brings the bounds of its clip already fitted
+	_frameBounds.resize(_md5Model.Animations.size());
+	for (int i = 0; i < (int)_md5Model.Animations.size(); i++)
+	{
+		if ((int)_frameBounds[i].size() != _md5Model.Animations[i].NumFrames)
+		{
+			FitFrameBounds(i);
+		}
+	}
+}
+
+void Skeleton::FitFrameBounds(int clip)
+{
+	const ModelAnimation& animation = _md5Model.Animations[clip];
+	InstanceState state;
+
+	CreateInstance(0, state);
+
+	_frameBounds.resize(_md5Model.Animations.size());
+	_frameBounds[clip].resize(animation.NumFrames);
+
+	for (int i = 0; i < animation.NumFrames; i++)
+	{
+		BoundingBox& bounds = _frameBounds[clip][i];
+		AnimationLayer layer = { clip, i * animation.FrameTime, 1.0f, AnimationBlend_Override, -1 };
+
+		if (i < (int)animation.FrameBounds.size())
+		{
+			bounds = animation.FrameBounds[i];
+		}
+		else
+		{
+			bounds.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			bounds.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		}
+
+		PoseFromLayers(state, &layer, 1);
+		Skin(state, SkinningMode_Weights);
+
+		for (int j = 0; j < _md5Model.NumSubsets; j++)
+		{
+			const std::vector<Vertex>& vertices = state.Vertices[j];
+			for (size_t k = 0; k < vertices.size(); k++)
+			{
+				const XMFLOAT3& position = vertices[k].Pos;
+
+				bounds.Min = XMFLOAT3(fminf(bounds.Min.x, position.x), fminf(bounds.Min.y, position.y), fminf(bounds.Min.z, position.z));
+				bounds.Max = XMFLOAT3(fmaxf(bounds.Max.x, position.x), fmaxf(bounds.Max.y, position.y), fmaxf(bounds.Max.z, position.z));
+			}
+		}
+	}
+}
+
+bool Skeleton::CreateInstance(ID3D11Device* device, InstanceState& state) const
+{
+	DestroyInstance(state);
+
+	state.Pose.resize(_md5Model.NumJoints);
+	state.JointMatrices.resize(_md5Model.NumJoints);
+	state.PaletteMatrices.resize(_md5Model.NumJoints);
+	state.BlendPose = _bindPose;
+	state.LeafLevels = 0;
+	state.CachedFrame = -1;
+
+	// The vertices start out as the bind pose, and the skinning only ever writes their positions and normals
+	state.Vertices.resize(_md5Model.NumSubsets);
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		state.Vertices[i] = _md5Model.Subsets[i].Vertices;
+	}
+
+	ResetLayers(state);
+	PoseFromLayers(state, state.Layers, MAX_ANIMATION_LAYERS);
+
+	if (!device)
+	{
+		return true;
+	}
+
+	D3D11_BUFFER_DESC vertexBufferDesc;
+	ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
+
+	vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;                            // We will be updating this buffer, so we must set as dynamic
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;                // Give CPU power to write to buffer
+	vertexBufferDesc.MiscFlags = 0;
+
+	state.VertexBuffers.resize(_md5Model.NumSubsets, 0);
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		D3D11_SUBRESOURCE_DATA vertexBufferData;
+		ZeroMemory(&vertexBufferData, sizeof(vertexBufferData));
+
+		vertexBufferDesc.ByteWidth = sizeof(Vertex) * state.Vertices[i].size();
+		vertexBufferData.pSysMem = &state.Vertices[i][0];
+		if (FAILED(device->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &state.VertexBuffers[i])))
+		{
+			DestroyInstance(state);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Skeleton::DestroyInstance(InstanceState& state) const
+{
+	for (size_t i = 0; i < state.VertexBuffers.size(); i++)
+	{
+		if (state.VertexBuffers[i])
+		{
+			state.VertexBuffers[i]->Release();
+		}
+	}
+
+	state.VertexBuffers.clear();
+}
+
+int Skeleton::GetInstanceSize(const InstanceState& state) const
+{
+	size_t size = (state.Pose.capacity() * sizeof(JointPose)) + ((state.JointMatrices.capacity() + state.PaletteMatrices.capacity()) * sizeof(JointMatrix));
+
+	const std::vector<float>* blendParts[7] = { &state.BlendPose.PositionX, &state.BlendPose.PositionY, &state.BlendPose.PositionZ,
+		&state.BlendPose.RotationX, &state.BlendPose.RotationY, &state.BlendPose.RotationZ, &state.BlendPose.RotationW };
+
+	for (int i = 0; i < 7; i++)
+	{
+		size += blendParts[i]->capacity() * sizeof(float);
+	}
+
+	size += state.Vertices.capacity() * sizeof(std::vector<Vertex>);
+	for (size_t i = 0; i < state.Vertices.size(); i++)
+	{
+		size += state.Vertices[i].capacity() * sizeof(Vertex);
+	}
+
+	return (int)(size + (state.VertexBuffers.capacity() * sizeof(ID3D11Buffer*)));
+}
+
+int Skeleton::GetSharedSize() const
+{
+	size_t size = GetAnimationSize() + GetCompressedAnimationSize() + (_inverseBindMatrices.size() * sizeof(JointMatrix));
+
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		const ModelSubset& subset = _md5Model.Subsets[i];
+		size += (subset.Vertices.size() * sizeof(Vertex)) + (subset.Indices.size() * sizeof(DWORD)) + (subset.Weights.size() * sizeof(Weight)) +
+			(subset.Positions.size() * sizeof(XMFLOAT3)) + (subset.SkinGroups.size() * sizeof(SkinGroup)) + (subset.SkinSlots.size() * sizeof(SkinSlot)) +
+			(subset.BindVertices.size() * sizeof(SkinnedVertex));
+	}
+
+	for (size_t i = 0; i < _jointMasks.size(); i++)
+	{
+		size += _jointMasks[i].size() * sizeof(float);
+	}
+
+	for (size_t i = 0; i < _frameBounds.size(); i++)
+	{
+		size += _frameBounds[i].size() * sizeof(BoundingBox);
+	}
+
+	return (int)(size + (_jointHeights.size() * sizeof(int)) + (_cachedMatrices.size() * sizeof(JointMatrix)));
+}
+
+bool Skeleton::CacheFrames(ID3D11Device* device)
+{
+	InstanceState state;
+	int frameCount = 0;
+
+	DestroyCachedFrames();
+	CreateInstance(0, state);
+
+	_cachedClipFrames.resize(_md5Model.Animations.size());
+	for (size_t i = 0; i < _md5Model.Animations.size(); i++)
+	{
+		_cachedClipFrames[i] = frameCount;
+		frameCount += _md5Model.Animations[i].NumFrames;
+	}
+
+	_cachedMatrices.resize(frameCount * _md5Model.NumJoints);
+	if (device)
+	{
+		_cachedVertexBuffers.resize(frameCount * _md5Model.NumSubsets, 0);
+	}
+
+	// The frames are skinned with the weights, which are exact, and never change once they are in the buffers
+	D3D11_BUFFER_DESC vertexBufferDesc;
+	ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
+
+	vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.MiscFlags = 0;
+
+	for (int i = 0; i < (int)_md5Model.Animations.size(); i++)
+	{
+		const ModelAnimation& animation = _md5Model.Animations[i];
+
+		for (int j = 0; j < animation.NumFrames; j++)
+		{
+			int frame = _cachedClipFrames[i] + j;
+			AnimationLayer layer = { i, j * animation.FrameTime, 1.0f, AnimationBlend_Override, -1 };
+
+			PoseFromLayers(state, &layer, 1);
+			std::copy(state.PaletteMatrices.begin(), state.PaletteMatrices.end(), _cachedMatrices.begin() + (frame * _md5Model.NumJoints));
+
+			if (!device)
+			{
+				continue;
+			}
+
+			Skin(state, SkinningMode_Weights);
+
+			for (int k = 0; k < _md5Model.NumSubsets; k++)
+			{
+				D3D11_SUBRESOURCE_DATA vertexBufferData;
+				ZeroMemory(&vertexBufferData, sizeof(vertexBufferData));
+
+				vertexBufferDesc.ByteWidth = sizeof(Vertex) * state.Vertices[k].size();
+				vertexBufferData.pSysMem = &state.Vertices[k][0];
+				if (FAILED(device->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &_cachedVertexBuffers[(frame * _md5Model.NumSubsets) + k])))
+				{
+					DestroyCachedFrames();
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+void Skeleton::DestroyCachedFrames()
+{
+	for (size_t i = 0; i < _cachedVertexBuffers.size(); i++)
+	{
+		if (_cachedVertexBuffers[i])
+		{
+			_cachedVertexBuffers[i]->Release();
+		}
+	}
+
+	_cachedClipFrames.clear();
+	_cachedMatrices.clear();
+	_cachedVertexBuffers.clear();
+}
+
+int Skeleton::GetCachedFrame(int clip, float animationTime) const
+{
+	if (clip < 0 || clip >= (int)_cachedClipFrames.size())
+	{
+		return -1;
+	}
+
+	const ModelAnimation& animation = _md5Model.Animations[clip];
+	int frame = (int)((animationTime * animation.FrameRate) + 0.5f);
+
+	return _cachedClipFrames[clip] + (frame % animation.NumFrames);
+}
+
+void Skeleton::GetWorldBounds(const InstanceState& state, Transform* transform, XMFLOAT3& minimum, XMFLOAT3& maximum) const
+{
+	XMVECTOR modelMinimum = XMVectorReplicate(FLT_MAX);
+	XMVECTOR modelMaximum = XMVectorReplicate(-FLT_MAX);
+	bool bounded = false;
+
+	for (int i = 0; i < MAX_ANIMATION_LAYERS; i++)
+	{
+		const AnimationLayer& layer = state.Layers[i];
+		if (layer.Clip < 0 || layer.Clip >= (int)_md5Model.Animations.size() || layer.Weight <= 0.0f)
+		{
+			continue;
+		}
+
+		if (layer.Clip >= (int)_frameBounds.size() || _frameBounds[layer.Clip].empty())
+		{
+			continue;
+		}
+
+		ClipSample sample;
+		GetClipSample(layer.Clip, layer.Time, sample);
+
+		const BoundingBox& bounds0 = _frameBounds[layer.Clip][sample.Frame0];
+		const BoundingBox& bounds1 = _frameBounds[layer.Clip][sample.Frame1];
+
+		modelMinimum = XMVectorMin(modelMinimum, XMVectorLerp(XMLoadFloat3(&bounds0.Min), XMLoadFloat3(&bounds1.Min), sample.Interpolation));
+		modelMaximum = XMVectorMax(modelMaximum, XMVectorLerp(XMLoadFloat3(&bounds0.Max), XMLoadFloat3(&bounds1.Max), sample.Interpolation));
+		bounded = true;
+	}
+
+	if (!bounded)
+	{
+		modelMinimum = XMVectorReplicate(-_boundingRadius);
+		modelMaximum = XMVectorReplicate(_boundingRadius);
+	}
+
+	XMFLOAT3 boxMinimum, boxMaximum;
+	XMStoreFloat3(&boxMinimum, modelMinimum);
+	XMStoreFloat3(&boxMaximum, modelMaximum);
+
+	XMFLOAT3 position, rotation, scale;
+	transform->GetPosition(position);
+	transform->GetRotation(rotation);
+	transform->GetScale(scale);
+
+	XMMATRIX worldMatrix = XMMatrixScaling(scale.x, scale.y, scale.z) *
+		(XMMatrixRotationX(rotation.x) * XMMatrixRotationY(rotation.y) * XMMatrixRotationZ(rotation.z)) *
+		XMMatrixTranslation(position.x, position.y, position.z);
+
+	// Box the eight corners once they are in the world, which turning the model can push out past the moved box
+	XMVECTOR worldMinimum = XMVectorReplicate(FLT_MAX);
+	XMVECTOR worldMaximum = XMVectorReplicate(-FLT_MAX);
+
+	for (int i = 0; i < 8; i++)
+	{
+		XMVECTOR corner = XMVectorSet((i & 1) ? boxMaximum.x : boxMinimum.x, (i & 2) ? boxMaximum.y : boxMinimum.y,
+			(i & 4) ? boxMaximum.z : boxMinimum.z, 1.0f);
+		corner = XMVector3Transform(corner, worldMatrix);
+
+		worldMinimum = XMVectorMin(worldMinimum, corner);
+		worldMaximum = XMVectorMax(worldMaximum, corner);
+	}
+
+	XMStoreFloat3(&minimum, worldMinimum);
+	XMStoreFloat3(&maximum, worldMaximum);
+}
+
+bool Skeleton::IsVisible(Frustum* frustum, const InstanceState& state, Transform* transform) const
+{
+	XMFLOAT3 minimum, maximum;
+
+	GetWorldBounds(state, transform, minimum, maximum);
+
+	return frustum->CheckRectangle2(maximum.x, maximum.y, maximum.z, minimum.x, minimum.y, minimum.z);
+}
+
+Skeleton::JointPose Skeleton::GetLocalJoint(const JointPose& pose, const JointPose& parent)
+{
+	XMVECTOR parentOrientation = XMLoadFloat4(&parent.Orientation);
+	XMVECTOR parentConjugate = XMQuaternionConjugate(parentOrientation);
+	XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&pose.Position), XMLoadFloat3(&parent.Position));
+	JointPose local;
+
+	XMStoreFloat3(&local.Position, XMQuaternionMultiply(XMQuaternionMultiply(parentConjugate, offset), parentOrientation));
+	XMStoreFloat4(&local.Orientation, XMQuaternionNormalize(XMQuaternionMultiply(parentConjugate, XMLoadFloat4(&pose.Orientation))));
+
+	return local;
+}
+
+int Skeleton::AddAnimation(std::wstring animFileName)
+{
+	if (_md5Model.Animations.empty() || !LoadMD5Anim(animFileName, _md5Model))
+	{
+		return -1;
+	}
+
+	int clip = (int)_md5Model.Animations.size() - 1;
+	const ModelAnimation& animation = _md5Model.Animations[clip];
+	bool matches = (animation.NumJoints == _md5Model.NumJoints && animation.NumFrames > 0 &&
+		(int)animation.FramePoses.size() == animation.NumFrames * animation.NumJoints);
+
+	// The poses of the clips are only blended joint for joint, so the joints have to come in the order of the mesh
+	for (int i = 0; matches && i < animation.NumJoints; i++)
+	{
+		matches = (animation.JointInfo[i].Name == _md5Model.Joints[i].Name);
+	}
+
+	if (!matches)
+	{
+		_md5Model.Animations.pop_back();
+		return -1;
+	}
+
+	if (!_compressedClips.empty())
+	{
+		_compressedClips.resize(clip + 1);
+		CompressClip(clip);
+	}
+
+	FitFrameBounds(clip);
+
+	return clip;
+}
+
+int Skeleton::AddJointMask(std::wstring jointName)
+{
+	int root = -1;
+
+	for (int i = 0; i < _md5Model.NumJoints && root < 0; i++)
+	{
+		if (_md5Model.Joints[i].Name == jointName)
+		{
+			root = i;
+		}
+	}
+
+	if (root < 0)
+	{
+		return -1;
+	}
+
+	// The parents come before their children, so a joint is under the root whenever its parent is
+	std::vector<float> mask(_md5Model.NumJoints, 0.0f);
+	mask[root] = 1.0f;
+
+	for (int i = root + 1; i < _md5Model.NumJoints; i++)
+	{
+		int parentID = _md5Model.Joints[i].ParentID;
+		mask[i] = (parentID >= 0) ? mask[parentID] : 0.0f;
+	}
+
+	_jointMasks.push_back(mask);
+
+	return (int)_jointMasks.size() - 1;
+}
+
+void Skeleton::ResetLayers()
+{
+	ResetLayers(_state);
+}
+
+void Skeleton::ResetLayers(InstanceState& state) const
+{
+	for (int i = 0; i < MAX_ANIMATION_LAYERS; i++)
+	{
+		AnimationLayer layer = { (i == 0) ? 0 : -1, 0.0f, (i == 0) ? 1.0f : 0.0f, AnimationBlend_Override, -1 };
+		state.Layers[i] = layer;
+	}
+}
+
+void Skeleton::AdvanceLayers(float deltaTime)
+{
+	AdvanceLayers(_state, deltaTime);
+}
+
+void Skeleton::AdvanceLayers(InstanceState& state, float deltaTime) const
+{
+	for (int i = 0; i < MAX_ANIMATION_LAYERS; i++)
+	{
+		AnimationLayer& layer = state.Layers[i];
+		if (layer.Clip < 0 || layer.Clip >= (int)_md5Model.Animations.size())
+		{
+			continue;
+		}
+
+		float length = _md5Model.Animations[layer.Clip].TotalAnimTime;
+
+		layer.Time += deltaTime;
+		if (layer.Time >= length)
+		{
+			layer.Time = fmodf(layer.Time, length);
+		}
+	}
+}
+
+void Skeleton::Destroy()
+{
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		_md5Model.Subsets[i].IndexBuff->Release();
+		_md5Model.Subsets[i].BindVertBuff->Release();
+	}
+
+	DestroyInstance(_state);
+	DestroyCachedFrames();
+}
+
+void Skeleton::Update(ID3D11DeviceContext* context, float deltaTime)
+{
+	AdvanceLayers(_state, deltaTime);
+	PoseLayers(_state);
+
+	// The shader skins the static bind pose vertices from the joint matrices, so there is nothing more to do
+	if (_skinningMode == SkinningMode_Shader)
+	{
+		return;
+	}
+
+	Skin(_state, _skinningMode);
+	UploadInstance(context, _state);
+}
+
+void Skeleton::UploadInstance(ID3D11DeviceContext* context, const InstanceState& state) const
+{
+	for (int k = 0; k < (int)state.VertexBuffers.size(); k++)
+	{
+		// Update the subsets vertex buffer
+		// First lock the buffer
+		D3D11_MAPPED_SUBRESOURCE mappedVertBuff;
+		context->Map(state.VertexBuffers[k], 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedVertBuff);
+
+		// Copy the data into the vertex buffer.
+		memcpy(mappedVertBuff.pData, &state.Vertices[k][0], (sizeof(Vertex) * state.Vertices[k].size()));
+
+		context->Unmap(state.VertexBuffers[k], 0);
+
+		// The line below is another way to update a buffer. You will use this when you want to update a buffer less
+		// than once per frame, since the GPU reads will be faster (the buffer was created as a DEFAULT buffer instead
+		// of a DYNAMIC buffer), and the CPU writes will be slower. You can try both methods to find out which one is faster
+		// for you. if you want to use the line below, you will have to create the buffer with D3D11_USAGE_DEFAULT instead
+		// of D3D11_USAGE_DYNAMIC
+		//d3d11DevCon->UpdateSubresource( MD5Model.subsets[k].vertBuff, 0, NULL, &MD5Model.subsets[k].vertices[0], 0, 0 );
+	}
+}
+
+void Skeleton::PoseLayers()
+{
+	PoseLayers(_state);
+}
+
+void Skeleton::PoseLayers(InstanceState& state) const
+{
+	PoseFromLayers(state, state.Layers, MAX_ANIMATION_LAYERS);
+}
+
+void Skeleton::Pose(float animationTime)
+{
+	AnimationLayer layer = { 0, animationTime, 1.0f, AnimationBlend_Override, -1 };
+
+	PoseFromLayers(_state, &layer, 1);
+}
+
+void Skeleton::PoseFromLayers(InstanceState& state, const AnimationLayer* layers, int count) const
+{
+	if (HasCompressedClips())
+	{
+		BlendLayers(state, layers, count);
+		ComposeLocalPose(state);
+	}
+	else
+	{
+		int layer = 0;
+		while (layer < count && (layers[layer].Clip < 0 || layers[layer].Clip >= (int)_md5Model.Animations.size() || layers[layer].Weight <= 0.0f))
+		{
+			layer++;
+		}
+
+		if (layer < count)
+		{
+			PoseFrames(state, layers[layer].Clip, layers[layer].Time);
+		}
+		else
+		{
+			state.BlendPose = _bindPose;
+			ComposeLocalPose(state);
+		}
+	}
+
+	// Turn each joint into the matrix the kernel skins with
+	for (int i = 0; i < _md5Model.NumJoints; i++)
+	{
+		SetJointMatrix(state.JointMatrices[i], state.Pose[i].Orientation, state.Pose[i].Position);
+		MultiplyJointMatrices(state.JointMatrices[i], _inverseBindMatrices[i], state.PaletteMatrices[i]);
+	}
+}
+
+void Skeleton::GetClipSample(int clip, float animationTime, ClipSample& sample) const
+{
+	const ModelAnimation& animation = _md5Model.Animations[clip];
+
+	// Which frames the time falls between, and how far it is between them
+	float currentFrame = animationTime * animation.FrameRate;
+	int frame = (int)floorf(currentFrame);
+
+	sample.Interpolation = currentFrame - frame;
+	sample.Frame0 = frame % animation.NumFrames;
+	sample.Frame1 = (sample.Frame0 + 1) % animation.NumFrames;
+}
+
+void Skeleton::PoseFrames(InstanceState& state, int clip, float animationTime) const
+{
+	const ModelAnimation& animation = _md5Model.Animations[clip];
+	ClipSample sample;
+
+	GetClipSample(clip, animationTime, sample);
+
+	const JointPose* frame0 = &animation.FramePoses[sample.Frame0 * animation.NumJoints];
+	const JointPose* frame1 = &animation.FramePoses[sample.Frame1 * animation.NumJoints];
+	float interpolation = sample.Interpolation;
+
+	// Interpolate each joint once for the whole mesh
+	for (int i = 0; i < animation.NumJoints; i++)
+	{
+		const JointPose& joint0 = frame0[i];
+		const JointPose& joint1 = frame1[i];
+		JointPose& joint = state.Pose[i];
+
+		XMVECTOR joint0Orient = XMLoadFloat4(&joint0.Orientation);
+		XMVECTOR joint1Orient = XMLoadFloat4(&joint1.Orientation);
+		XMStoreFloat4(&joint.Orientation, XMQuaternionNormalize(XMQuaternionSlerp(joint0Orient, joint1Orient, interpolation)));
+
+		joint.Position.x = joint0.Position.x + (interpolation * (joint1.Position.x - joint0.Position.x));
+		joint.Position.y = joint0.Position.y + (interpolation * (joint1.Position.y - joint0.Position.y));
+		joint.Position.z = joint0.Position.z + (interpolation * (joint1.Position.z - joint0.Position.z));
+	}
+}
+
+void Skeleton::BlendLayers(InstanceState& state, const AnimationLayer* layers, int count) const
+{
+	const XMVECTOR identity = XMQuaternionIdentity();
+	LocalPose& blend = state.BlendPose;
+
+	// The sizes match, so this copies into the arrays already there
+	blend = _bindPose;
+
+	// Each layer samples its clip straight into the local pose as it goes, joint by joint, rather than making a
+	// pose of its own to blend afterwards
+	for (int i = 0; i < count; i++)
+	{
+		const AnimationLayer& layer = layers[i];
+		if (layer.Clip < 0 || layer.Clip >= (int)_compressedClips.size() || layer.Weight <= 0.0f)
+		{
+			continue;
+		}
+
+		const CompressedClip& clip = _compressedClips[layer.Clip];
+		const CompressedKey* keys = &clip.Keys[0];
+		const float* mask = (layer.Mask >= 0) ? &_jointMasks[layer.Mask][0] : 0;
+		bool additive = (layer.Blend == AnimationBlend_Additive);
+		ClipSample sample;
+		int key0, key1;
+		float keyBlend;
+
+		GetClipSample(layer.Clip, layer.Time, sample);
+
+		for (int j = 0; j < clip.NumJoints; j++)
+		{
+			float weight = mask ? layer.Weight * mask[j] : layer.Weight;
+			if (weight <= 0.0f || _jointHeights[j] < state.LeafLevels)
+			{
+				continue;
+			}
+
+			const CompressedJoint& joint = clip.Joints[j];
+
+			// Blend the rotations the short way round, which the key reduction allowed for. Tracks that stand still,
+			// and times that fall on a key, need only the one key.
+			SampleCompressedTrack(clip, joint.Rotation, sample, key0, key1, keyBlend);
+			XMVECTOR rotation = DecodeRotation(keys[key0]);
+			if (key0 != key1 && keyBlend > 0.0f)
+			{
+				XMVECTOR rotation1 = DecodeRotation(keys[key1]);
+				if (XMVectorGetX(XMVector4Dot(rotation, rotation1)) < 0.0f)
+				{
+					rotation1 = XMVectorNegate(rotation1);
+				}
+				rotation = XMQuaternionNormalize(XMVectorLerp(rotation, rotation1, keyBlend));
+			}
+
+			SampleCompressedTrack(clip, joint.Position, sample, key0, key1, keyBlend);
+			XMVECTOR position = DecodePosition(keys[key0], joint);
+			if (key0 != key1 && keyBlend > 0.0f)
+			{
+				position = XMVectorLerp(position, DecodePosition(keys[key1], joint), keyBlend);
+			}
+
+			XMVECTOR below = XMVectorSet(blend.RotationX[j], blend.RotationY[j], blend.RotationZ[j], blend.RotationW[j]);
+			XMVECTOR belowPosition = XMVectorSet(blend.PositionX[j], blend.PositionY[j], blend.PositionZ[j], 0.0f);
+
+			if (additive)
+			{
+				// The turn from the first frame is made in the space of the joint, after the turn of the pose below
+				XMVECTOR difference = XMQuaternionMultiply(rotation, XMQuaternionConjugate(DecodeRotation(keys[joint.Rotation.FirstKey])));
+				if (weight < 1.0f)
+				{
+					if (XMVectorGetW(difference) < 0.0f)
+					{
+						difference = XMVectorNegate(difference);
+					}
+					difference = XMQuaternionNormalize(XMVectorLerp(identity, difference, weight));
+				}
+
+				rotation = XMQuaternionNormalize(XMQuaternionMultiply(difference, below));
+				position = XMVectorMultiplyAdd(XMVectorSubtract(position, DecodePosition(keys[joint.Position.FirstKey], joint)),
+					XMVectorReplicate(weight), belowPosition);
+			}
+			else if (weight < 1.0f)
+			{
+				if (XMVectorGetX(XMVector4Dot(below, rotation)) < 0.0f)
+				{
+					rotation = XMVectorNegate(rotation);
+				}
+
+				rotation = XMQuaternionNormalize(XMVectorLerp(below, rotation, weight));
+				position = XMVectorLerp(belowPosition, position, weight);
+			}
+
+			XMFLOAT4 blendedRotation;
+			XMFLOAT3 blendedPosition;
+			XMStoreFloat4(&blendedRotation, rotation);
+			XMStoreFloat3(&blendedPosition, position);
+
+			blend.RotationX[j] = blendedRotation.x;
+			blend.RotationY[j] = blendedRotation.y;
+			blend.RotationZ[j] = blendedRotation.z;
+			blend.RotationW[j] = blendedRotation.w;
+			blend.PositionX[j] = blendedPosition.x;
+			blend.PositionY[j] = blendedPosition.y;
+			blend.PositionZ[j] = blendedPosition.z;
+		}
+	}
+}
+
+void Skeleton::ComposeLocalPose(InstanceState& state) const
+{
+	const LocalPose& local = state.BlendPose;
+
+	for (int i = 0; i < _md5Model.NumJoints; i++)
+	{
+		XMVECTOR orientation = XMVectorSet(local.RotationX[i], local.RotationY[i], local.RotationZ[i], local.RotationW[i]);
+		XMVECTOR position = XMVectorSet(local.PositionX[i], local.PositionY[i], local.PositionZ[i], 0.0f);
+		int parentID = _md5Model.Joints[i].ParentID;
+
+		// The parents come before their children, so each is already in model space to build its children on
+		if (parentID >= 0)
+		{
+			const JointPose& parent = state.Pose[parentID];
+			XMVECTOR parentOrientation = XMLoadFloat4(&parent.Orientation);
+
+			position = XMVectorAdd(XMQuaternionMultiply(XMQuaternionMultiply(parentOrientation, position), XMQuaternionConjugate(parentOrientation)),
+				XMLoadFloat3(&parent.Position));
+			orientation = XMQuaternionNormalize(XMQuaternionMultiply(parentOrientation, orientation));
+		}
+
+		XMStoreFloat4(&state.Pose[i].Orientation, orientation);
+		XMStoreFloat3(&state.Pose[i].Position, position);
+	}
+}
+
+void Skeleton::CompressAnimation(float positionTolerance, float rotationTolerance)
+{
+	_positionTolerance = positionTolerance;
+	_rotationTolerance = rotationTolerance;
+	_compressedClips.resize(_md5Model.Animations.size());
+
+	for (int i = 0; i < (int)_md5Model.Animations.size(); i++)
+	{
+		CompressClip(i);
+	}
+}
+
+void Skeleton::CompressClip(int clip)
+{
+	const ModelAnimation& animation = _md5Model.Animations[clip];
+	CompressedClip& compressed = _compressedClips[clip];
+	std::vector<JointPose> localPoses(animation.FramePoses.size());
+	std::vector<CompressedKey> frameKeys(animation.NumFrames);
+
+	compressed = CompressedClip();
+	compressed.NumFrames = animation.NumFrames;
+	compressed.NumJoints = animation.NumJoints;
+	compressed.Joints.resize(animation.NumJoints);
+
+	// Undo what building the frames did, taking each joint back into the space of its parent
+	for (int i = 0; i < (int)animation.FramePoses.size(); i++)
+	{
+		const JointPose& pose = animation.FramePoses[i];
+		int parentID = _md5Model.Joints[i % animation.NumJoints].ParentID;
+
+		localPoses[i] = (parentID < 0) ? pose : GetLocalJoint(pose, animation.FramePoses[((i / animation.NumJoints) * animation.NumJoints) + parentID]);
+	}
+
+	for (int i = 0; i < animation.NumJoints; i++)
+	{
+		CompressedJoint& joint = compressed.Joints[i];
+		XMFLOAT3 positionMin = localPoses[i].Position;
+		XMFLOAT3 positionMax = positionMin;
+
+		for (int frame = 1; frame < animation.NumFrames; frame++)
+		{
+			const XMFLOAT3& position = localPoses[(frame * animation.NumJoints) + i].Position;
+
+			positionMin = XMFLOAT3(fminf(positionMin.x, position.x), fminf(positionMin.y, position.y), fminf(positionMin.z, position.z));
+			positionMax = XMFLOAT3(fmaxf(positionMax.x, position.x), fmaxf(positionMax.y, position.y), fmaxf(positionMax.z, position.z));
+		}
+
+		joint.ParentID = _md5Model.Joints[i].ParentID;
+		joint.PositionMin = positionMin;
+		joint.PositionScale = XMFLOAT3((positionMax.x - positionMin.x) / 65535.0f, (positionMax.y - positionMin.y) / 65535.0f,
+			(positionMax.z - positionMin.z) / 65535.0f);
+
+		for (int frame = 0; frame < animation.NumFrames; frame++)
+		{
+			QuantizeRotation(localPoses[(frame * animation.NumJoints) + i].Orientation, frameKeys[frame]);
+		}
+		AddCompressedTrack(compressed, localPoses, i, true, frameKeys, _rotationTolerance, joint.Rotation);
+
+		for (int frame = 0; frame < animation.NumFrames; frame++)
+		{
+			QuantizePosition(localPoses[(frame * animation.NumJoints) + i].Position, joint, frameKeys[frame]);
+		}
+		AddCompressedTrack(compressed, localPoses, i, false, frameKeys, _positionTolerance, joint.Position);
+	}
+}
+
+int Skeleton::GetAnimationSize() const
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < _md5Model.Animations.size(); i++)
+	{
+		size += _md5Model.Animations[i].FramePoses.size() * sizeof(JointPose);
+	}
+
+	return (int)size;
+}
+
+int Skeleton::GetCompressedAnimationSize() const
+{
+	size_t size = 0;
+
+	for (size_t i = 0; i < _compressedClips.size(); i++)
+	{
+		const CompressedClip& clip = _compressedClips[i];
+		size += (clip.Joints.size() * sizeof(CompressedJoint)) + (clip.KeyFrames.size() * sizeof(unsigned short)) + (clip.Keys.size() * sizeof(CompressedKey));
+	}
+
+	return (int)size;
+}
+
+int Skeleton::GetCompressedKeyCount() const
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < _compressedClips.size(); i++)
+	{
+		count += _compressedClips[i].Keys.size();
+	}
+
+	return (int)count;
+}
+
+bool Skeleton::CompressedSpanFits(const CompressedClip& clip, const std::vector<JointPose>& localPoses, int jointIndex, bool rotation,
+	const CompressedKey& key0, const CompressedKey& key1, int start, int end, float tolerance)
+{
+	const CompressedJoint& joint = clip.Joints[jointIndex];
+	XMVECTOR rotation0 = DecodeRotation(key0), rotation1 = DecodeRotation(key1);
+	XMVECTOR position0 = DecodePosition(key0, joint), position1 = DecodePosition(key1, joint);
+
+	if (XMVectorGetX(XMVector4Dot(rotation0, rotation1)) < 0.0f)
+	{
+		rotation1 = XMVectorNegate(rotation1);
+	}
+
+	// Every frame after the first key and before the second, blended between them the way the pose is, has to come
+	// back close enough to the frame as loaded, quantization and all
+	for (int frame = start + 1; frame < end; frame++)
+	{
+		const JointPose& pose = localPoses[(frame * clip.NumJoints) + jointIndex];
+		float blend = (float)(frame - start) / (float)(end - start);
+
+		if (rotation)
+		{
+			XMVECTOR blended = XMQuaternionNormalize(XMVectorLerp(rotation0, rotation1, blend));
+			XMVECTOR orientation = XMLoadFloat4(&pose.Orientation);
+			if (XMVectorGetX(XMVector4Dot(blended, orientation)) < 0.0f)
+			{
+				orientation = XMVectorNegate(orientation);
+			}
+
+			// The angle from the distance between the quaternions, since the arc cosine of their dot product loses
+			// small angles to rounding
+			float distance = XMVectorGetX(XMVector4Length(XMVectorSubtract(blended, orientation)));
+			if (4.0f * asinf(fminf(distance * 0.5f, 1.0f)) > tolerance)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, XMVectorLerp(position0, position1, blend));
+
+			if (fabsf(position.x - pose.Position.x) > tolerance || fabsf(position.y - pose.Position.y) > tolerance ||
+				fabsf(position.z - pose.Position.z) > tolerance)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void Skeleton::AddCompressedTrack(CompressedClip& clip, const std::vector<JointPose>& localPoses, int jointIndex, bool rotation,
+	const std::vector<CompressedKey>& frameKeys, float tolerance, CompressedTrack& track)
+{
+	int frames = (int)frameKeys.size();
+
+	track.FirstKey = (int)clip.Keys.size();
+	clip.Keys.push_back(frameKeys[0]);
+	clip.KeyFrames.push_back(0);
+
+	// A track that stays within the tolerance of its first frame throughout needs no other key
+	if (CompressedSpanFits(clip, localPoses, jointIndex, rotation, frameKeys[0], frameKeys[0], -1, frames, tolerance))
+	{
+		track.KeyCount = 1;
+		return;
+	}
+
+	// Stretch each span between keys for as long as blending its ends still puts back every frame inside it
+	for (int start = 0; start < frames - 1;)
+	{
+		int end = start + 1;
+		while (end + 1 < frames && CompressedSpanFits(clip, localPoses, jointIndex, rotation, frameKeys[start], frameKeys[end + 1], start, end + 1, tolerance))
+		{
+			end++;
+		}
+
+		clip.Keys.push_back(frameKeys[end]);
+		clip.KeyFrames.push_back((unsigned short)end);
+		start = end;
+	}
+
+	track.KeyCount = (int)clip.Keys.size() - track.FirstKey;
+}
+
+void Skeleton::SampleCompressedTrack(const CompressedClip& clip, const CompressedTrack& track, const ClipSample& sample, int& key0, int& key1, float& blend)
+{
+	if (track.KeyCount == 1)
+	{
+		key0 = track.FirstKey;
+		key1 = track.FirstKey;
+		blend = 0.0f;
+		return;
+	}
+
+	// The last frame blends into the first, which are both always keys
+	if (sample.Frame1 < sample.Frame0)
+	{
+		key0 = track.FirstKey + track.KeyCount - 1;
+		key1 = track.FirstKey;
+		blend = sample.Interpolation;
+		return;
+	}
+
+	// Find the last key at or before the frame, which is never the last key since the last frame is one. The tracks
+	// that move keep most of their frames, so start from where the key would be if they were spread evenly and walk
+	// the rest of the way, which is no way at all when every frame was kept.
+	const unsigned short* keyFrames = &clip.KeyFrames[track.FirstKey];
+	int low = (sample.Frame0 * (track.KeyCount - 1)) / (clip.NumFrames - 1);
+
+	while (keyFrames[low] > sample.Frame0)
+	{
+		low--;
+	}
+	while (keyFrames[low + 1] <= sample.Frame0)
+	{
+		low++;
+	}
+
+	key0 = track.FirstKey + low;
+	key1 = key0 + 1;
+	blend = ((float)(sample.Frame0 - keyFrames[low]) + sample.Interpolation) / (float)(keyFrames[low + 1] - keyFrames[low]);
+}
+
+void Skeleton::QuantizeRotation(const XMFLOAT4& orientation, CompressedKey& key)
+{
+	float parts[4] = { orientation.x, orientation.y, orientation.z, orientation.w };
+	float length = sqrtf((parts[0] * parts[0]) + (parts[1] * parts[1]) + (parts[2] * parts[2]) + (parts[3] * parts[3]));
+	int largest = 0;
+
+	for (int i = 1; i < 4; i++)
+	{
+		if (fabsf(parts[i]) > fabsf(parts[largest]))
+		{
+			largest = i;
+		}
+	}
+
+	// The dropped part is made positive, which leaves the rotation the same, so its square root is all it takes back
+	float sign = (parts[largest] < 0.0f) ? -1.0f : 1.0f;
+	unsigned long long bits = (unsigned long long)largest << 45;
+
+	for (int i = 0, shift = 30; i < 4; i++)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		float part = (sign * parts[i]) / length;
+		float unit = ((part / SMALLEST_THREE_RANGE) * 0.5f) + 0.5f;
+		int value = (int)floorf((unit * SMALLEST_THREE_STEPS) + 0.5f);
+		value = (value < 0) ? 0 : ((value > SMALLEST_THREE_STEPS) ? SMALLEST_THREE_STEPS : value);
+
+		bits |= (unsigned long long)value << shift;
+		shift -= 15;
+	}
+
+	key.Values[0] = (unsigned short)(bits >> 32);
+	key.Values[1] = (unsigned short)(bits >> 16);
+	key.Values[2] = (unsigned short)bits;
+}
+
+void Skeleton::QuantizePosition(const XMFLOAT3& position, const CompressedJoint& joint, CompressedKey& key)
+{
+	const float* parts = &position.x;
+	const float* minimum = &joint.PositionMin.x;
+	const float* scale = &joint.PositionScale.x;
+
+	for (int i = 0; i < 3; i++)
+	{
+		int value = (scale[i] > 0.0f) ? (int)floorf(((parts[i] - minimum[i]) / scale[i]) + 0.5f) : 0;
+		key.Values[i] = (unsigned short)((value < 0) ? 0 : ((value > 65535) ? 65535 : value));
+	}
+}
+
+XMVECTOR Skeleton::DecodeRotation(const CompressedKey& key)
+{
+	const float scale = (2.0f * SMALLEST_THREE_RANGE) / SMALLEST_THREE_STEPS;
+
+	unsigned long long bits = ((unsigned long long)key.Values[0] << 32) | ((unsigned long long)key.Values[1] << 16) | key.Values[2];
+	float first = ((float)((bits >> 30) & SMALLEST_THREE_STEPS) * scale) - SMALLEST_THREE_RANGE;
+	float second = ((float)((bits >> 15) & SMALLEST_THREE_STEPS) * scale) - SMALLEST_THREE_RANGE;
+	float third = ((float)(bits & SMALLEST_THREE_STEPS) * scale) - SMALLEST_THREE_RANGE;
+	float largest = sqrtf(fmaxf(1.0f - ((first * first) + (second * second) + (third * third)), 0.0f));
+
+	// The kept parts come in order, around the one that was dropped
+	switch ((bits >> 45) & 3)
+	{
+	case 0:
+		return XMVectorSet(largest, first, second, third);
+	case 1:
+		return XMVectorSet(first, largest, second, third);
+	case 2:
+		return XMVectorSet(first, second, largest, third);
+	default:
+		return XMVectorSet(first, second, third, largest);
+	}
+}
+
+XMVECTOR Skeleton::DecodePosition(const CompressedKey& key, const CompressedJoint& joint)
+{
+	return XMVectorMultiplyAdd(XMVectorSet((float)key.Values[0], (float)key.Values[1], (float)key.Values[2], 0.0f),
+		XMLoadFloat3(&joint.PositionScale), XMLoadFloat3(&joint.PositionMin));
+}
+
+void Skeleton::SetSkinningMode(SkinningMode mode)
+{
+	// Skeletons with more joints than the shader has room for blend the same way on the CPU
+	if (mode == SkinningMode_Shader && _md5Model.NumJoints > SkeletonShader::MAX_JOINTS)
+	{
+		mode = SkinningMode_Palette;
+	}
+
+	// and those with more joints than the bind vertices can name skin from the weights
+	if (mode == SkinningMode_Palette && _md5Model.NumJoints > MAX_PALETTE_JOINTS)
+	{
+		mode = SkinningMode_Weights;
+	}
+
+	_skinningMode = mode;
+}
+
+void Skeleton::Skin(SkinningMode mode)
+{
+	Skin(_state, mode);
+}
+
+void Skeleton::Skin(InstanceState& state, SkinningMode mode) const
+{
+	for (int k = 0; k < _md5Model.NumSubsets; k++)
+	{
+		if (mode == SkinningMode_Weights || _md5Model.NumJoints > MAX_PALETTE_JOINTS)
+		{
+			SkinSubset(_md5Model.Subsets[k], &state.JointMatrices[0], &state.Vertices[k][0]);
+		}
+		else
+		{
+			SkinSubsetPalette(_md5Model.Subsets[k], &state.PaletteMatrices[0], &state.Vertices[k][0]);
+		}
+	}
+}
+
+void Skeleton::SkinReference()
+{
+	// The joints Pose blended are the interpolated skeleton the reference skins from
+	for (int k = 0; k < _md5Model.NumSubsets; k++)
+	{
+		SkinSubsetReference(_md5Model.Subsets[k], &_state.Pose[0], &_state.Vertices[k][0]);
+	}
+}
+
+int Skeleton::GetVertexCount() const
+{
+	int count = 0;
+
+	for (int k = 0; k < _md5Model.NumSubsets; k++)
+	{
+		count += (int)_md5Model.Subsets[k].Vertices.size();
+	}
+
+	return count;
+}
+
+void Skeleton::GetSkinnedVertices(std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT3>& normals) const
+{
+	GetSkinnedVertices(_state, positions, normals);
+}
+
+void Skeleton::GetSkinnedVertices(const InstanceState& state, std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT3>& normals) const
+{
+	positions.clear();
+	normals.clear();
+
+	for (int k = 0; k < (int)state.Vertices.size(); k++)
+	{
+		for (int i = 0; i < (int)state.Vertices[k].size(); i++)
+		{
+			positions.push_back(state.Vertices[k][i].Pos);
+			normals.push_back(state.Vertices[k][i].Normal);
+		}
+	}
+}
+
+void Skeleton::SkinSubset(const ModelSubset& subset, const JointMatrix* matrices, Vertex* vertices)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (int i = 0; i < (int)subset.SkinGroups.size(); i++)
+	{
+		const SkinGroup& group = subset.SkinGroups[i];
+		const SkinSlot* slot = &subset.SkinSlots[group.FirstSlot];
+
+		__m128 positionX = zero, positionY = zero, positionZ = zero;
+		__m128 normalX = zero, normalY = zero, normalZ = zero;
+
+		for (int j = 0; j < group.SlotCount; j++, slot++)
+		{
+			const JointMatrix& joint0 = matrices[slot->JointID[0]];
+			const JointMatrix& joint1 = matrices[slot->JointID[1]];
+			const JointMatrix& joint2 = matrices[slot->JointID[2]];
+			const JointMatrix& joint3 = matrices[slot->JointID[3]];
+
+			// Load each row of the four lanes matrices and transpose it, so every register holds one element of the
+			// matrices for all four lanes
+			__m128 row0[4], row1[4], row2[4];
+			LoadMatrixRow(&joint0.Rows[0].x, &joint1.Rows[0].x, &joint2.Rows[0].x, &joint3.Rows[0].x, row0);
+			LoadMatrixRow(&joint0.Rows[1].x, &joint1.Rows[1].x, &joint2.Rows[1].x, &joint3.Rows[1].x, row1);
+			LoadMatrixRow(&joint0.Rows[2].x, &joint1.Rows[2].x, &joint2.Rows[2].x, &joint3.Rows[2].x, row2);
+
+			// The position is already scaled by the bias, so only the joints position needs to be
+			__m128 x = _mm_loadu_ps(slot->PositionX);
+			__m128 y = _mm_loadu_ps(slot->PositionY);
+			__m128 z = _mm_loadu_ps(slot->PositionZ);
+			__m128 bias = _mm_loadu_ps(slot->Bias);
+
+			positionX = _mm_add_ps(positionX, TransformRow(row0, x, y, z, bias));
+			positionY = _mm_add_ps(positionY, TransformRow(row1, x, y, z, bias));
+			positionZ = _mm_add_ps(positionZ, TransformRow(row2, x, y, z, bias));
+
+			x = _mm_loadu_ps(slot->NormalX);
+			y = _mm_loadu_ps(slot->NormalY);
+			z = _mm_loadu_ps(slot->NormalZ);
+
+			normalX = _mm_add_ps(normalX, TransformRow(row0, x, y, z, zero));
+			normalY = _mm_add_ps(normalY, TransformRow(row1, x, y, z, zero));
+			normalZ = _mm_add_ps(normalZ, TransformRow(row2, x, y, z, zero));
+		}
+
+		// Normalize the normals, leaving any with no length at zero
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(normalZ, normalZ)));
+		__m128 scale = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(one, length));
+
+		float positions[3][4], normals[3][4];
+		_mm_storeu_ps(positions[0], positionX);
+		_mm_storeu_ps(positions[1], positionY);
+		_mm_storeu_ps(positions[2], positionZ);
+		_mm_storeu_ps(normals[0], _mm_mul_ps(normalX, scale));
+		_mm_storeu_ps(normals[1], _mm_mul_ps(normalY, scale));
+		_mm_storeu_ps(normals[2], _mm_mul_ps(normalZ, scale));
+
+		for (int lane = 0; lane < 4 && group.Vertices[lane] >= 0; lane++)
+		{
+			Vertex& vertex = vertices[group.Vertices[lane]];
+			vertex.Pos = XMFLOAT3(positions[0][lane], positions[1][lane], positions[2][lane]);
+			vertex.Normal = XMFLOAT3(normals[0][lane], normals[1][lane], normals[2][lane]);
+		}
+	}
+}
+
+void Skeleton::SkinSubsetPalette(const ModelSubset& subset, const JointMatrix* matrices, Vertex* vertices)
+{
+	for (int i = 0; i < (int)subset.BindVertices.size(); i++)
+	{
+		const SkinnedVertex& bindVertex = subset.BindVertices[i];
+		const float weights[4] = { bindVertex.JointWeights.x, bindVertex.JointWeights.y, bindVertex.JointWeights.z, bindVertex.JointWeights.w };
+		XMFLOAT3 position(0.0f, 0.0f, 0.0f);
+		XMFLOAT3 normal(0.0f, 0.0f, 0.0f);
+
+		// Blend the bind pose moved by each joint, the same as the skeleton vertex shader
+		for (int j = 0; j < 4; j++)
+		{
+			const XMFLOAT4* rows = matrices[bindVertex.JointIDs[j]].Rows;
+			const XMFLOAT3& bindPos = bindVertex.Pos;
+			const XMFLOAT3& bindNormal = bindVertex.Normal;
+
+			position.x += weights[j] * ((rows[0].x * bindPos.x) + (rows[0].y * bindPos.y) + (rows[0].z * bindPos.z) + rows[0].w);
+			position.y += weights[j] * ((rows[1].x * bindPos.x) + (rows[1].y * bindPos.y) + (rows[1].z * bindPos.z) + rows[1].w);
+			position.z += weights[j] * ((rows[2].x * bindPos.x) + (rows[2].y * bindPos.y) + (rows[2].z * bindPos.z) + rows[2].w);
+
+			normal.x += weights[j] * ((rows[0].x * bindNormal.x) + (rows[0].y * bindNormal.y) + (rows[0].z * bindNormal.z));
+			normal.y += weights[j] * ((rows[1].x * bindNormal.x) + (rows[1].y * bindNormal.y) + (rows[1].z * bindNormal.z));
+			normal.z += weights[j] * ((rows[2].x * bindNormal.x) + (rows[2].y * bindNormal.y) + (rows[2].z * bindNormal.z));
+		}
+
+		vertices[i].Pos = position;
+		XMStoreFloat3(&vertices[i].Normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+	}
+}
+
+void Skeleton::SkinSubsetReference(const ModelSubset& subset, const JointPose* pose, Vertex* vertices)
+{
+	for (int i = 0; i < (int)subset.Vertices.size(); ++i)
+	{
+		const Vertex& bindVertex = subset.Vertices[i];
+		Vertex& vertex = vertices[i];
+		XMFLOAT3 position(0, 0, 0);    // Make sure the vertex's pos is cleared first
+		XMFLOAT3 normal(0, 0, 0);    // Clear vertices normal
+
+		// Sum up the joints and weights information to get vertex's position and normal
+		for (int j = 0; j < bindVertex.WeightCount; ++j)
+		{
+			const Weight& tempWeight = subset.Weights[bindVertex.StartWeight + j];
+			const JointPose& tempJoint = pose[tempWeight.JointID];
+
+			// Convert joint orientation and weight pos to vectors for easier computation
+			XMVECTOR tempJointOrientation = XMVectorSet(tempJoint.Orientation.x, tempJoint.Orientation.y, tempJoint.Orientation.z, tempJoint.Orientation.w);
+			XMVECTOR tempWeightPos = XMVectorSet(tempWeight.Position.x, tempWeight.Position.y, tempWeight.Position.z, 0.0f);
+
+			// We will need to use the conjugate of the joint orientation quaternion
+			XMVECTOR tempJointOrientationConjugate = XMQuaternionInverse(tempJointOrientation);
+
+			// Calculate vertex position (in joint space, eg. rotate the point around (0,0,0)) for this weight using the joint orientation quaternion and its conjugate
+			// We can rotate a point using a quaternion with the equation "rotatedPoint = quaternion * point * quaternionConjugate"
+			XMFLOAT3 rotatedPoint;
+			XMStoreFloat3(&rotatedPoint, XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientation, tempWeightPos), tempJointOrientationConjugate));
+
+			// Now move the verices position from joint space (0,0,0) to the joints position in world space, taking the weights bias into account
+			position.x += (tempJoint.Position.x + rotatedPoint.x) * tempWeight.Bias;
+			position.y += (tempJoint.Position.y + rotatedPoint.y) * tempWeight.Bias;
+			position.z += (tempJoint.Position.z + rotatedPoint.z) * tempWeight.Bias;
+
+			// Compute the normals for this frames skeleton using the weight normals from before
+			// We can comput the normals the same way we compute the vertices position, only we don't have to translate them (just rotate)
+			XMVECTOR tempWeightNormal = XMVectorSet(tempWeight.Normal.x, tempWeight.Normal.y, tempWeight.Normal.z, 0.0f);
+
+			// Rotate the normal
+			XMStoreFloat3(&rotatedPoint, XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientation, tempWeightNormal), tempJointOrientationConjugate));
+
+			// Add to vertices normal and ake weight bias into account
+			normal.x -= rotatedPoint.x * tempWeight.Bias;
+			normal.y -= rotatedPoint.y * tempWeight.Bias;
+			normal.z -= rotatedPoint.z * tempWeight.Bias;
+		}
+
+		vertex.Pos = position;
+		XMStoreFloat3(&vertex.Normal, XMVector3Normalize(XMLoadFloat3(&normal)));
+	}
+}
+
+void Skeleton::CreateSkinSlots(ModelSubset& subset)
+{
+	int vertexCount = (int)subset.Vertices.size();
+	int maxWeights = 0;
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		maxWeights = (subset.Vertices[i].WeightCount > maxWeights) ? subset.Vertices[i].WeightCount : maxWeights;
+	}
+
+	// Order the vertices by how many weights they have, most first, so each group of four has about the same
+	std::vector<int> order;
+	for (int count = maxWeights; count >= 0; count--)
+	{
+		for (int i = 0; i < vertexCount; i++)
+		{
+			if (subset.Vertices[i].WeightCount == count)
+			{
+				order.push_back(i);
+			}
+		}
+	}
+
+	subset.SkinGroups.clear();
+	subset.SkinSlots.clear();
+
+	for (int first = 0; first < vertexCount; first += 4)
+	{
+		SkinGroup group;
+		group.FirstSlot = (int)subset.SkinSlots.size();
+		group.SlotCount = subset.Vertices[order[first]].WeightCount;
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			group.Vertices[lane] = (first + lane < vertexCount) ? order[first + lane] : -1;
+		}
+
+		for (int j = 0; j < group.SlotCount; j++)
+		{
+			SkinSlot slot;
+			ZeroMemory(&slot, sizeof(slot));
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (group.Vertices[lane] < 0 || j >= subset.Vertices[group.Vertices[lane]].WeightCount)
+				{
+					continue;
+				}
+
+				const Weight& weight = subset.Weights[subset.Vertices[group.Vertices[lane]].StartWeight + j];
+
+				slot.JointID[lane] = weight.JointID;
+				slot.Bias[lane] = weight.Bias;
+				slot.PositionX[lane] = weight.Position.x * weight.Bias;
+				slot.PositionY[lane] = weight.Position.y * weight.Bias;
+				slot.PositionZ[lane] = weight.Position.z * weight.Bias;
+				slot.NormalX[lane] = -weight.Normal.x * weight.Bias;
+				slot.NormalY[lane] = -weight.Normal.y * weight.Bias;
+				slot.NormalZ[lane] = -weight.Normal.z * weight.Bias;
+			}
+
+			subset.SkinSlots.push_back(slot);
+		}
+
+		subset.SkinGroups.push_back(group);
+	}
+}
+
+void Skeleton::Draw(ID3D11DeviceContext * deviceContext)
+{
+	///***Draw MD5 Model***///
+	for (int i = 0; i < _md5Model.NumSubsets; i++)
+	{
+		DrawSubset(deviceContext, i);
+	}
+}
+
+void Skeleton::DrawSubset(ID3D11DeviceContext * deviceContext, int index)
+{
+	DrawSubset(deviceContext, _state, index);
+}
+
+void Skeleton::DrawSubset(ID3D11DeviceContext* deviceContext, const InstanceState& state, int index) const
+{
+	unsigned int stride;
+	unsigned int offset;
+	ID3D11Buffer* vertexBuffer;
+
+	// Set vertex buffer stride and offset, the shader taking the bind pose instead of the skinned vertices.
+	if (_skinningMode == SkinningMode_Shader)
+	{
+		stride = sizeof(SkinnedVertex);
+		vertexBuffer = _md5Model.Subsets[index].BindVertBuff;
+	}
+	else
+	{
+		stride = sizeof(Vertex);
+		vertexBuffer = state.VertexBuffers[index];
+
+		// Instances too far away to skin themselves draw the frame skinned for them when the frames were cached
+		if (state.CachedFrame >= 0 && !_cachedVertexBuffers.empty())
+		{
+			vertexBuffer = _cachedVertexBuffers[(state.CachedFrame * _md5Model.NumSubsets) + index];
+		}
+	}
+	offset = 0;
+
+	//Set the grounds index buffer
+	deviceContext->IASetIndexBuffer(_md5Model.Subsets[index].IndexBuff, DXGI_FORMAT_R32_UINT, 0);
+	//Set the grounds vertex buffer
+	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+}
+
+int Skeleton::GetIndexCount(int index)
+{
+	return _md5Model.Subsets[index].NumTriangles * 3;
+}
+
+void Skeleton::CreateBindVertices(ModelSubset& subset)
+{
+	std::vector<int> jointIDs;
+	std::vector<float> jointWeights;
+
+	subset.BindVertices.resize(subset.Vertices.size());
+
+	for (int i = 0; i < (int)subset.Vertices.size(); i++)
+	{
+		const Vertex& vertex = subset.Vertices[i];
+		SkinnedVertex& bindVertex = subset.BindVertices[i];
+
+		bindVertex.Pos = vertex.Pos;
+		bindVertex.TexCoord = vertex.TexCoord;
+		bindVertex.Normal = vertex.Normal;
+
+		// Weights on the same joint move together, so add them up
+		jointIDs.clear();
+		jointWeights.clear();
+
+		for (int j = 0; j < vertex.WeightCount; j++)
+		{
+			const Weight& weight = subset.Weights[vertex.StartWeight + j];
+			int k = 0;
+
+			while (k < (int)jointIDs.size() && jointIDs[k] != weight.JointID)
+			{
+				k++;
+			}
+
+			if (k == (int)jointIDs.size())
+			{
+				jointIDs.push_back(weight.JointID);
+				jointWeights.push_back(0.0f);
+			}
+
+			jointWeights[k] += weight.Bias;
+		}
+
+		// Keep the four joints with the most weight, sharing the weight of any others out between them
+		float weights[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float total = 0.0f;
+
+		for (int k = 0; k < 4; k++)
+		{
+			int heaviest = -1;
+			for (int j = 0; j < (int)jointIDs.size(); j++)
+			{
+				if (jointWeights[j] > 0.0f && (heaviest < 0 || jointWeights[j] > jointWeights[heaviest]))
+				{
+					heaviest = j;
+				}
+			}
+
+			bindVertex.JointIDs[k] = (heaviest < 0) ? 0 : (unsigned char)jointIDs[heaviest];
+
+			if (heaviest >= 0)
+			{
+				weights[k] = jointWeights[heaviest];
+				total += weights[k];
+				jointWeights[heaviest] = 0.0f;
+			}
+		}
+
+		for (int k = 0; k < 4; k++)
+		{
+			weights[k] = (total > 0.0f) ? weights[k] / total : 0.0f;
+		}
+
+		bindVertex.JointWeights = XMFLOAT4(weights[0], weights[1], weights[2], weights[3]);
+	}
+}
+
+void Skeleton::CreateSubsetBuffers(ID3D11Device* device, ModelSubset& subset)
+{
+	// Create index buffer
+	D3D11_BUFFER_DESC indexBufferDesc;
+	ZeroMemory(&indexBufferDesc, sizeof(indexBufferDesc));
+
+	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	indexBufferDesc.ByteWidth = sizeof(DWORD) * subset.NumTriangles * 3;
+	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.CPUAccessFlags = 0;
+	indexBufferDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA iinitData;
+
+	iinitData.pSysMem = &subset.Indices[0];
+	device->CreateBuffer(&indexBufferDesc, &iinitData, &subset.IndexBuff);
+
+	// Create the bind pose vertex buffer, which never changes since the shader skins it. The vertex buffers the CPU
+	// skins into belong to the instances.
+	D3D11_BUFFER_DESC vertexBufferDesc;
+	ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
+
+	vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	vertexBufferDesc.ByteWidth = sizeof(SkinnedVertex) * subset.BindVertices.size();
+	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vertexBufferDesc.CPUAccessFlags = 0;
+	vertexBufferDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA vertexBufferData;
+
+	ZeroMemory(&vertexBufferData, sizeof(vertexBufferData));
+
+	vertexBufferData.pSysMem = &subset.BindVertices[0];
+	device->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &subset.BindVertBuff);
+}
+
+void Skeleton::FinishSubset(const Model3D& MD5Model, ModelSubset& subset)
+{
+	//*** find each vertex's position using the joints and weights ***//
+	subset.Positions.reserve(subset.Vertices.size());
+	for (int i = 0; i < (int)subset.Vertices.size(); ++i)
+	{
+		const Vertex& tempVert = subset.Vertices[i];
+		XMFLOAT3 position(0, 0, 0);    // Make sure the vertex's pos is cleared first
+
+											 // Sum up the joints and weights information to get vertex's position
+		for (int j = 0; j < tempVert.WeightCount; ++j)
+		{
+			const Weight& tempWeight = subset.Weights[tempVert.StartWeight + j];
+			const Joint& tempJoint = MD5Model.Joints[tempWeight.JointID];
+
+			// Convert joint orientation and weight pos to vectors for easier computation
+			// When converting a 3d vector to a quaternion, you should put 0 for "w", and
+			// When converting a quaternion to a 3d vector, you can just ignore the "w"
+			XMVECTOR tempJointOrientation = XMVectorSet(tempJoint.Orientation.x, tempJoint.Orientation.y, tempJoint.Orientation.z, tempJoint.Orientation.w);
+			XMVECTOR tempWeightPos = XMVectorSet(tempWeight.Position.x, tempWeight.Position.y, tempWeight.Position.z, 0.0f);
+
+			// We will need to use the conjugate of the joint orientation quaternion
+			// To get the conjugate of a quaternion, all you have to do is inverse the x, y, and z
+			XMVECTOR tempJointOrientationConjugate = XMVectorSet(-tempJoint.Orientation.x, -tempJoint.Orientation.y, -tempJoint.Orientation.z, tempJoint.Orientation.w);
+
+			// Calculate vertex position (in joint space, eg. rotate the point around (0,0,0)) for this weight using the joint orientation quaternion and its conjugate
+			// We can rotate a point using a quaternion with the equation "rotatedPoint = quaternion * point * quaternionConjugate"
+			XMFLOAT3 rotatedPoint;
+			XMStoreFloat3(&rotatedPoint, XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientation, tempWeightPos), tempJointOrientationConjugate));
+
+			// Now move the verices position from joint space (0,0,0) to the joints position in world space, taking the weights bias into account
+			// The weight bias is used because multiple weights might have an effect on the vertices final position. Each weight is attached to one joint.
+			position.x += (tempJoint.Postion.x + rotatedPoint.x) * tempWeight.Bias;
+			position.y += (tempJoint.Postion.y + rotatedPoint.y) * tempWeight.Bias;
+			position.z += (tempJoint.Postion.z + rotatedPoint.z) * tempWeight.Bias;
+
+			// Basically what has happened above, is we have taken the weights position relative to the joints position
+			// we then rotate the weights position (so that the weight is actually being rotated around (0, 0, 0) in world space) using
+			// the quaternion describing the joints rotation. We have stored this rotated point in rotatedPoint, which we then add to
+			// the joints position (because we rotated the weight's position around (0,0,0) in world space, and now need to translate it
+			// so that it appears to have been rotated around the joints position). Finally we multiply the answer with the weights bias,
+			// or how much control the weight has over the final vertices position. All weight's bias effecting a single vertex's position
+			// must add up to 1.
+		}
+
+		subset.Positions.push_back(position);            // Store the vertices position in the position vector instead of straight into the vertex vector
+															 // since we can use the positions vector for certain things like collision detection or picking
+															 // without having to work with the entire vertex structure.
+	}
+
+	// Put the positions into the vertices for this subset
+	for (int i = 0; i < (int)subset.Vertices.size(); i++)
+	{
+		subset.Vertices[i].Pos = subset.Positions[i];
+	}
+
+	//*** Calculate vertex normals using normal averaging ***///
+	std::vector<XMFLOAT3> tempNormal;
+	tempNormal.reserve(subset.NumTriangles);
+
+	//normalized and unnormalized normals
+	XMFLOAT3 unnormalized = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	//Used to get vectors (sides) from the position of the verts
+	float vecX, vecY, vecZ;
+
+	//Two edges of our triangle
+	XMVECTOR edge1 = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
+	XMVECTOR edge2 = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
+
+	//Compute face normals
+	for (int i = 0; i < subset.NumTriangles; ++i)
+	{
+		//Get the vector describing one edge of our triangle (edge 0,2)
+		vecX = subset.Vertices[subset.Indices[(i * 3)]].Pos.x - subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.x;
+		vecY = subset.Vertices[subset.Indices[(i * 3)]].Pos.y - subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.y;
+		vecZ = subset.Vertices[subset.Indices[(i * 3)]].Pos.z - subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.z;
+		edge1 = XMVectorSet(vecX, vecY, vecZ, 0.0f);    //Create our first edge
+
+														//Get the vector describing another edge of our triangle (edge 2,1)
+		vecX = subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.x - subset.Vertices[subset.Indices[(i * 3) + 1]].Pos.x;
+		vecY = subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.y - subset.Vertices[subset.Indices[(i * 3) + 1]].Pos.y;
+		vecZ = subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.z - subset.Vertices[subset.Indices[(i * 3) + 1]].Pos.z;
+		edge2 = XMVectorSet(vecX, vecY, vecZ, 0.0f);    //Create our second edge
+
+														//Cross multiply the two edge vectors to get the un-normalized face normal
+		XMStoreFloat3(&unnormalized, XMVector3Cross(edge1, edge2));
+
+		tempNormal.push_back(unnormalized);
+	}
+
+	// Add each face normal to the vertices of its face, in the order of the faces so the sums come out the same as
+	// looking through every face for every vertex did. A face that uses a vertex twice still counts once.
+	std::vector<XMFLOAT3> normalSums(subset.Vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<int> facesUsing(subset.Vertices.size(), 0);
+
+	for (int j = 0; j < subset.NumTriangles; ++j)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			DWORD index = subset.Indices[(j * 3) + k];
+			if ((k > 0 && index == subset.Indices[j * 3]) || (k > 1 && index == subset.Indices[(j * 3) + 1]))
+			{
+				continue;
+			}
+
+			normalSums[index].x += tempNormal[j].x;
+			normalSums[index].y += tempNormal[j].y;
+			normalSums[index].z += tempNormal[j].z;
+			facesUsing[index]++;
+		}
+	}
 
-}
+	//Compute vertex normals (normal Averaging)
+	XMVECTOR normalSum;
 
-Skeleton::~Skeleton()
-{
-}
+						 //Go through each vertex
+	for (int i = 0; i < (int)subset.Vertices.size(); ++i)
+	{
+		normalSum = XMVectorSet(normalSums[i].x, normalSums[i].y, normalSums[i].z, 0.0f);
 
-bool Skeleton::Initialize(ID3D11Device * device, ID3D11DeviceContext* context, TextureManager* textureManager, std::wstring meshFileName, std::wstring animFileName)
-{
-	if (!LoadMD5Model(device, context, meshFileName, _md5Model, textureManager))
-		return false;
+		//Get the actual normal by dividing the normalSum by the number of faces sharing the vertex
+		normalSum = normalSum / (float)facesUsing[i];
 
-	if (!LoadMD5Anim(animFileName, _md5Model))
-		return false;
+		//Normalize the normalSum vector
+		normalSum = XMVector3Normalize(normalSum);
 
-	_transform = new Transform;
+		//Store the normal and tangent in our current vertex
+		subset.Vertices[i].Normal.x = -XMVectorGetX(normalSum);
+		subset.Vertices[i].Normal.y = -XMVectorGetY(normalSum);
+		subset.Vertices[i].Normal.z = -XMVectorGetZ(normalSum);
 
-	return true;
-}
+		// Turn the normal into the joint space of each weight, so it can be skinned the same way as the position
+		for (int j = 0; j < subset.Vertices[i].WeightCount; j++)
+		{
+			Weight& tempWeight = subset.Weights[subset.Vertices[i].StartWeight + j];
+			const Joint& tempJoint = MD5Model.Joints[tempWeight.JointID];
+
+			XMVECTOR tempJointOrientation = XMVectorSet(tempJoint.Orientation.x, tempJoint.Orientation.y, tempJoint.Orientation.z, tempJoint.Orientation.w);
+			XMVECTOR tempJointOrientationConjugate = XMVectorSet(-tempJoint.Orientation.x, -tempJoint.Orientation.y, -tempJoint.Orientation.z, tempJoint.Orientation.w);
+
+			XMStoreFloat3(&tempWeight.Normal, XMVector3Normalize(XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientationConjugate, normalSum), tempJointOrientation)));
+		}
 
-void Skeleton::Destroy()
-{
-	for (int i = 0; i < _md5Model.NumSubsets; i++)
-	{
-		_md5Model.Subsets[i].IndexBuff->Release();
-		_md5Model.Subsets[i].VertBuff->Release();
 	}
+
+	CreateSkinSlots(subset);
+	CreateBindVertices(subset);
 }
 
-void Skeleton::Update(ID3D11DeviceContext* context, float deltaTime)
+void Skeleton::AddFrameSkeleton(ModelAnimation& tempAnim, const FrameData& tempFrame)
 {
-	int animation = 0;
+	///*** build the frame skeleton ***///
+	int frameStart = (int)tempAnim.FramePoses.size();
 
-	_md5Model.Animations[animation].CurrAnimTime += deltaTime;            // Update the current animation time
+	for (int i = 0; i < (int)tempAnim.JointInfo.size(); i++)
+	{
+		int k = 0;						// Keep track of position in frameData array
 
-	if (_md5Model.Animations[animation].CurrAnimTime > _md5Model.Animations[animation].TotalAnimTime)
-		_md5Model.Animations[animation].CurrAnimTime = 0.0f;
+										// Start the frames joint with the base frame's joint
+		JointPose tempFrameJoint = tempAnim.BaseFrameJoints[i];
 
-	// Which frame are we on
-	float currentFrame = _md5Model.Animations[animation].CurrAnimTime * _md5Model.Animations[animation].FrameRate;
-	int frame0 = (int)floorf(currentFrame);
-	int frame1 = frame0 + 1;
+		int parentID = tempAnim.JointInfo[i].ParentID;
 
-	// Make sure we don't go over the number of frames    
-	if (frame0 == _md5Model.Animations[animation].NumFrames - 1)
-		frame1 = 0;
+		// Notice how I have been flipping y and z. this is because some modeling programs such as
+		// 3ds max (which is what I use) use a right handed coordinate system. Because of this, we
+		// need to flip the y and z axes. If your having problems loading some models, it's possible
+		// the model was created in a left hand coordinate system. in that case, just reflip all the
+		// y and z axes in our md5 mesh and anim loader.
+		if (tempAnim.JointInfo[i].Flags & 1)		// pos.x	( 000001 )
+			tempFrameJoint.Position.x = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
 
-	float interpolation = currentFrame - frame0;    // Get the remainder (in time) between frame0 and frame1 to use as interpolation factor
+		if (tempAnim.JointInfo[i].Flags & 2)		// pos.y	( 000010 )
+			tempFrameJoint.Position.z = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
 
-	std::vector<Joint> interpolatedSkeleton;        // Create a frame skeleton to store the interpolated skeletons in
+		if (tempAnim.JointInfo[i].Flags & 4)		// pos.z	( 000100 )
+			tempFrameJoint.Position.y = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
 
-	// Compute the interpolated skeleton
-	for (int i = 0; i < _md5Model.Animations[animation].NumJoints; i++)
-	{
-		Joint tempJoint;
-		Joint joint0 = _md5Model.Animations[animation].FrameSkeleton[frame0][i];        // Get the i'th joint of frame0's skeleton
-		Joint joint1 = _md5Model.Animations[animation].FrameSkeleton[frame1][i];        // Get the i'th joint of frame1's skeleton
+		if (tempAnim.JointInfo[i].Flags & 8)		// orientation.x	( 001000 )
+			tempFrameJoint.Orientation.x = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
+
+		if (tempAnim.JointInfo[i].Flags & 16)	// orientation.y	( 010000 )
+			tempFrameJoint.Orientation.z = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
+
+		if (tempAnim.JointInfo[i].Flags & 32)	// orientation.z	( 100000 )
+			tempFrameJoint.Orientation.y = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
+
+
+		// Compute the quaternions w
+		float t = 1.0f - (tempFrameJoint.Orientation.x * tempFrameJoint.Orientation.x)
+			- (tempFrameJoint.Orientation.y * tempFrameJoint.Orientation.y)
+			- (tempFrameJoint.Orientation.z * tempFrameJoint.Orientation.z);
+		if (t < 0.0f)
+		{
+			tempFrameJoint.Orientation.w = 0.0f;
+		}
+		else
+		{
+			tempFrameJoint.Orientation.w = -sqrtf(t);
+		}
+
+		// Now, if the upper arm of your skeleton moves, you need to also move the lower part of your arm, and then the hands, and then finally the fingers (possibly weapon or tool too)
+		// This is where joint hierarchy comes in. We start at the top of the hierarchy, and move down to each joints child, rotating and translating them based on their parents rotation
+		// and translation. We can assume that by the time we get to the child, the parent has already been rotated and transformed based of it's parent. We can assume this because
+		// the child should never come before the parent in the files we loaded in.
+		if (parentID >= 0)
+		{
+			JointPose parentJoint = tempAnim.FramePoses[frameStart + parentID];
 
-		tempJoint.ParentID = joint0.ParentID;                                            // Set the tempJoints parent id
+			// Turn the XMFLOAT3 and 4's into vectors for easier computation
+			XMVECTOR parentJointOrientation = XMVectorSet(parentJoint.Orientation.x, parentJoint.Orientation.y, parentJoint.Orientation.z, parentJoint.Orientation.w);
+			XMVECTOR tempJointPos = XMVectorSet(tempFrameJoint.Position.x, tempFrameJoint.Position.y, tempFrameJoint.Position.z, 0.0f);
+			XMVECTOR parentOrientationConjugate = XMVectorSet(-parentJoint.Orientation.x, -parentJoint.Orientation.y, -parentJoint.Orientation.z, parentJoint.Orientation.w);
 
-																						 // Turn the two quaternions into XMVECTORs for easy computations
-		XMVECTOR joint0Orient = XMVectorSet(joint0.Orientation.x, joint0.Orientation.y, joint0.Orientation.z, joint0.Orientation.w);
-		XMVECTOR joint1Orient = XMVectorSet(joint1.Orientation.x, joint1.Orientation.y, joint1.Orientation.z, joint1.Orientation.w);
+			// Calculate current joints position relative to its parents position
+			XMFLOAT3 rotatedPos;
+			XMStoreFloat3(&rotatedPos, XMQuaternionMultiply(XMQuaternionMultiply(parentJointOrientation, tempJointPos), parentOrientationConjugate));
 
-		// Interpolate positions
-		tempJoint.Postion.x = joint0.Postion.x + (interpolation * (joint1.Postion.x - joint0.Postion.x));
-		tempJoint.Postion.y = joint0.Postion.y + (interpolation * (joint1.Postion.y - joint0.Postion.y));
-		tempJoint.Postion.z = joint0.Postion.z + (interpolation * (joint1.Postion.z - joint0.Postion.z));
+			// Translate the joint to model space by adding the parent joint's pos to it
+			tempFrameJoint.Position.x = rotatedPos.x + parentJoint.Position.x;
+			tempFrameJoint.Position.y = rotatedPos.y + parentJoint.Position.y;
+			tempFrameJoint.Position.z = rotatedPos.z + parentJoint.Position.z;
 
-		// Interpolate orientations using spherical interpolation (Slerp)
-		XMStoreFloat4(&tempJoint.Orientation, XMQuaternionSlerp(joint0Orient, joint1Orient, interpolation));
+			// Currently the joint is oriented in its parent joints space, we now need to orient it in
+			// model space by multiplying the two orientations together (parentOrientation * childOrientation) <- In that order
+			XMVECTOR tempJointOrient = XMVectorSet(tempFrameJoint.Orientation.x, tempFrameJoint.Orientation.y, tempFrameJoint.Orientation.z, tempFrameJoint.Orientation.w);
+			tempJointOrient = XMQuaternionMultiply(parentJointOrientation, tempJointOrient);
 
-		interpolatedSkeleton.push_back(tempJoint);        // Push the joint back into our interpolated skeleton
+			// Normalize the orienation quaternion
+			tempJointOrient = XMQuaternionNormalize(tempJointOrient);
+
+			XMStoreFloat4(&tempFrameJoint.Orientation, tempJointOrient);
+		}
+
+		// Store the joint after the joints of the frame before it
+		tempAnim.FramePoses.push_back(tempFrameJoint);
 	}
+}
 
-	for (int k = 0; k < _md5Model.NumSubsets; k++)
+bool Skeleton::LoadMD5Model(std::wstring filename, Model3D& MD5Model)
+{
+	MD5Tokenizer tokenizer;
+	MD5Token token;
+	int meshCount = 0;
+
+	if (!tokenizer.Open(filename))
 	{
-		for (int i = 0; i < (int)_md5Model.Subsets[k].Vertices.size(); ++i)
-		{
-			Vertex tempVert = _md5Model.Subsets[k].Vertices[i];
-			tempVert.Pos = XMFLOAT3(0, 0, 0);    // Make sure the vertex's pos is cleared first
-			tempVert.Normal = XMFLOAT3(0, 0, 0);    // Clear vertices normal
+		std::wstring message = L"Could not open: ";
+		message += filename;
 
-			// Sum up the joints and weights information to get vertex's position and normal
-			for (int j = 0; j < tempVert.WeightCount; ++j)
-			{
-				Weight tempWeight = _md5Model.Subsets[k].Weights[tempVert.StartWeight + j];
-				Joint tempJoint = interpolatedSkeleton[tempWeight.JointID];
+		MessageBox(0, message.c_str(), L"Error", MB_OK);
 
-				// Convert joint orientation and weight pos to vectors for easier computation
-				XMVECTOR tempJointOrientation = XMVectorSet(tempJoint.Orientation.x, tempJoint.Orientation.y, tempJoint.Orientation.z, tempJoint.Orientation.w);
-				XMVECTOR tempWeightPos = XMVectorSet(tempWeight.Position.x, tempWeight.Position.y, tempWeight.Position.z, 0.0f);
+		return false;
+	}
 
-				// We will need to use the conjugate of the joint orientation quaternion
-				XMVECTOR tempJointOrientationConjugate = XMQuaternionInverse(tempJointOrientation);
+	while (tokenizer.Next(token))
+	{
+		if (token.Equals("numJoints"))
+		{
+			if (!tokenizer.ReadInt(MD5Model.NumJoints))
+				return false;
+		}
+		else if (token.Equals("numMeshes"))
+		{
+			if (!tokenizer.ReadInt(MD5Model.NumSubsets))
+				return false;
+		}
+		else if (token.Equals("joints"))
+		{
+			if (!tokenizer.Expect("{"))
+				return false;
 
-				// Calculate vertex position (in joint space, eg. rotate the point around (0,0,0)) for this weight using the joint orientation quaternion and its conjugate
-				// We can rotate a point using a quaternion with the equation "rotatedPoint = quaternion * point * quaternionConjugate"
-				XMFLOAT3 rotatedPoint;
-				XMStoreFloat3(&rotatedPoint, XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientation, tempWeightPos), tempJointOrientationConjugate));
+			for (int i = 0; i < MD5Model.NumJoints; i++)
+			{
+				Joint tempJoint;
+				MD5Token name;
 
-				// Now move the verices position from joint space (0,0,0) to the joints position in world space, taking the weights bias into account
-				tempVert.Pos.x += (tempJoint.Postion.x + rotatedPoint.x) * tempWeight.Bias;
-				tempVert.Pos.y += (tempJoint.Postion.y + rotatedPoint.y) * tempWeight.Bias;
-				tempVert.Pos.z += (tempJoint.Postion.z + rotatedPoint.z) * tempWeight.Bias;
+				if (!tokenizer.ReadString(name) || !tokenizer.ReadInt(tempJoint.ParentID) ||
+					!ReadSwappedVector(tokenizer, tempJoint.Postion.x, tempJoint.Postion.y, tempJoint.Postion.z) ||
+					!ReadSwappedVector(tokenizer, tempJoint.Orientation.x, tempJoint.Orientation.y, tempJoint.Orientation.z))
+				{
+					return false;
+				}
 
-				// Compute the normals for this frames skeleton using the weight normals from before
-				// We can comput the normals the same way we compute the vertices position, only we don't have to translate them (just rotate)
-				XMVECTOR tempWeightNormal = XMVectorSet(tempWeight.Normal.x, tempWeight.Normal.y, tempWeight.Normal.z, 0.0f);
+				tempJoint.Name = WidenToken(name);
 
-				// Rotate the normal
-				XMStoreFloat3(&rotatedPoint, XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientation, tempWeightNormal), tempJointOrientationConjugate));
+				// The file only has the axis of the rotation, and the w that makes it a unit quaternion is worked out
+				// the same way as the reference
+				float t = 1.0f - (tempJoint.Orientation.x * tempJoint.Orientation.x)
+					- (tempJoint.Orientation.y * tempJoint.Orientation.y)
+					- (tempJoint.Orientation.z * tempJoint.Orientation.z);
+				tempJoint.Orientation.w = (t < 0.0f) ? 0.0f : -sqrtf(t);
 
-				// Add to vertices normal and ake weight bias into account
-				tempVert.Normal.x -= rotatedPoint.x * tempWeight.Bias;
-				tempVert.Normal.y -= rotatedPoint.y * tempWeight.Bias;
-				tempVert.Normal.z -= rotatedPoint.z * tempWeight.Bias;
+				MD5Model.Joints.push_back(tempJoint);
 			}
 
-			_md5Model.Subsets[k].Positions[i] = tempVert.Pos;                // Store the vertices position in the position vector instead of straight into the vertex vector
-			_md5Model.Subsets[k].Vertices[i].Normal = tempVert.Normal;        // Store the vertices normal
-			XMStoreFloat3(&_md5Model.Subsets[k].Vertices[i].Normal, XMVector3Normalize(XMLoadFloat3(&_md5Model.Subsets[k].Vertices[i].Normal)));
+			if (!tokenizer.Expect("}"))
+				return false;
 		}
-
-		// Put the positions into the vertices for this subset
-		for (int i = 0; i < (int)_md5Model.Subsets[k].Vertices.size(); i++)
+		else if (token.Equals("mesh"))
 		{
-			_md5Model.Subsets[k].Vertices[i].Pos = _md5Model.Subsets[k].Positions[i];
-		}
+			ModelSubset subset;
 
-		// Update the subsets vertex buffer
-		// First lock the buffer
-		D3D11_MAPPED_SUBRESOURCE mappedVertBuff;
-		context->Map(_md5Model.Subsets[k].VertBuff, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedVertBuff);
+			if (!tokenizer.Expect("{"))
+				return false;
 
-		// Copy the data into the vertex buffer.
-		memcpy(mappedVertBuff.pData, &_md5Model.Subsets[k].Vertices[0], (sizeof(Vertex) * _md5Model.Subsets[k].Vertices.size()));
+			while (tokenizer.Next(token) && !token.Equals("}"))
+			{
+				if (token.Equals("shader"))
+				{
+					MD5Token shader;
+					if (!tokenizer.ReadString(shader))
+						return false;
+
+					// The textures are loaded once the whole model is, the same way for the compiled file
+					subset.TextureFileName = WidenToken(shader);
+					subset.TexArrayIndex = 10 + meshCount;
+					meshCount++;
+				}
+				else if (token.Equals("numverts"))
+				{
+					int numVerts;
+					if (!tokenizer.ReadInt(numVerts))
+						return false;
 
-		context->Unmap(_md5Model.Subsets[k].VertBuff, 0);
+					subset.Vertices.reserve(numVerts);
+					for (int i = 0; i < numVerts; i++)
+					{
+						Vertex tempVert;
+						int index;
 
-		// The line below is another way to update a buffer. You will use this when you want to update a buffer less
-		// than once per frame, since the GPU reads will be faster (the buffer was created as a DEFAULT buffer instead
-		// of a DYNAMIC buffer), and the CPU writes will be slower. You can try both methods to find out which one is faster
-		// for you. if you want to use the line below, you will have to create the buffer with D3D11_USAGE_DEFAULT instead
-		// of D3D11_USAGE_DYNAMIC
-		//d3d11DevCon->UpdateSubresource( MD5Model.subsets[k].vertBuff, 0, NULL, &MD5Model.subsets[k].vertices[0], 0, 0 );
+						if (!tokenizer.Expect("vert") || !tokenizer.ReadInt(index) || !tokenizer.Expect("(") ||
+							!tokenizer.ReadFloat(tempVert.TexCoord.x) || !tokenizer.ReadFloat(tempVert.TexCoord.y) ||
+							!tokenizer.Expect(")") || !tokenizer.ReadInt(tempVert.StartWeight) || !tokenizer.ReadInt(tempVert.WeightCount))
+						{
+							return false;
+						}
+
+						subset.Vertices.push_back(tempVert);
+					}
+				}
+				else if (token.Equals("numtris"))
+				{
+					if (!tokenizer.ReadInt(subset.NumTriangles))
+						return false;
+
+					subset.Indices.reserve(subset.NumTriangles * 3);
+					for (int i = 0; i < subset.NumTriangles; i++)
+					{
+						int index;
+						if (!tokenizer.Expect("tri") || !tokenizer.ReadInt(index))
+							return false;
+
+						for (int k = 0; k < 3; k++)
+						{
+							if (!tokenizer.ReadInt(index))
+								return false;
+
+							subset.Indices.push_back((DWORD)index);
+						}
+					}
+				}
+				else if (token.Equals("numweights"))
+				{
+					int numWeights;
+					if (!tokenizer.ReadInt(numWeights))
+						return false;
+
+					subset.Weights.reserve(numWeights);
+					for (int i = 0; i < numWeights; i++)
+					{
+						Weight tempWeight;
+						int index;
+
+						if (!tokenizer.Expect("weight") || !tokenizer.ReadInt(index) || !tokenizer.ReadInt(tempWeight.JointID) ||
+							!tokenizer.ReadFloat(tempWeight.Bias) ||
+							!ReadSwappedVector(tokenizer, tempWeight.Position.x, tempWeight.Position.y, tempWeight.Position.z))
+						{
+							return false;
+						}
+
+						subset.Weights.push_back(tempWeight);
+					}
+				}
+				else
+				{
+					tokenizer.SkipLine();
+				}
+			}
+
+			FinishSubset(MD5Model, subset);
+
+			MD5Model.Subsets.push_back(subset);
+		}
 	}
+
+	return true;
 }
 
-void Skeleton::Draw(ID3D11DeviceContext * deviceContext)
+bool Skeleton::LoadMD5Anim(std::wstring filename, Model3D& MD5Model)
 {
-	unsigned int stride;
-	unsigned int offset;
+	MD5Tokenizer tokenizer;
+	MD5Token token;
+	ModelAnimation tempAnim;
 
-	// Set vertex buffer stride and offset.
-	stride = sizeof(Vertex);
-	offset = 0;
+	if (!tokenizer.Open(filename))
+	{
+		std::wstring message = L"Could not open: ";
+		message += filename;
 
-	///***Draw MD5 Model***///
-	for (int i = 0; i < _md5Model.NumSubsets; i++)
+		MessageBox(0, message.c_str(), L"Error", MB_OK);
+
+		return false;
+	}
+
+	// The hierarchy of the animation has to match the joints of the mesh, which are found by name
+	std::unordered_map<std::wstring, int> jointIndices;
+	for (int i = 0; i < MD5Model.NumJoints; i++)
 	{
-		//Set the grounds index buffer
-		deviceContext->IASetIndexBuffer(_md5Model.Subsets[i].IndexBuff, DXGI_FORMAT_R32_UINT, 0);
-		//Set the grounds vertex buffer
-		deviceContext->IASetVertexBuffers(0, 1, &_md5Model.Subsets[i].VertBuff, &stride, &offset);
+		jointIndices[MD5Model.Joints[i].Name] = i;
 	}
-}
 
-void Skeleton::DrawSubset(ID3D11DeviceContext * deviceContext, int index)
-{
-	unsigned int stride;
-	unsigned int offset;
+	while (tokenizer.Next(token))
+	{
+		if (token.Equals("numFrames"))
+		{
+			if (!tokenizer.ReadInt(tempAnim.NumFrames))
+				return false;
+		}
+		else if (token.Equals("numJoints"))
+		{
+			if (!tokenizer.ReadInt(tempAnim.NumJoints))
+				return false;
+		}
+		else if (token.Equals("frameRate"))
+		{
+			if (!tokenizer.ReadInt(tempAnim.FrameRate))
+				return false;
+		}
+		else if (token.Equals("numAnimatedComponents"))
+		{
+			if (!tokenizer.ReadInt(tempAnim.NumAnimatedComponents))
+				return false;
+		}
+		else if (token.Equals("hierarchy"))
+		{
+			if (!tokenizer.Expect("{"))
+				return false;
 
-	// Set vertex buffer stride and offset.
-	stride = sizeof(Vertex);
-	offset = 0;
+			for (int i = 0; i < tempAnim.NumJoints; i++)
+			{
+				AnimJointInfo tempJoint;
+				MD5Token name;
 
-	//Set the grounds index buffer
-	deviceContext->IASetIndexBuffer(_md5Model.Subsets[index].IndexBuff, DXGI_FORMAT_R32_UINT, 0);
-	//Set the grounds vertex buffer
-	deviceContext->IASetVertexBuffers(0, 1, &_md5Model.Subsets[index].VertBuff, &stride, &offset);
-}
+				if (!tokenizer.ReadString(name) || !tokenizer.ReadInt(tempJoint.ParentID) ||
+					!tokenizer.ReadInt(tempJoint.Flags) || !tokenizer.ReadInt(tempJoint.StartIndex))
+				{
+					return false;
+				}
 
-int Skeleton::GetIndexCount(int index)
-{
-	return _md5Model.Subsets[index].NumTriangles * 3;
+				tempJoint.Name = WidenToken(name);
+
+				std::unordered_map<std::wstring, int>::const_iterator joint = jointIndices.find(tempJoint.Name);
+				if (joint == jointIndices.end() || MD5Model.Joints[joint->second].ParentID != tempJoint.ParentID)
+					return false;
+
+				tempAnim.JointInfo.push_back(tempJoint);
+			}
+
+			if (!tokenizer.Expect("}"))
+				return false;
+		}
+		else if (token.Equals("bounds"))
+		{
+			if (!tokenizer.Expect("{"))
+				return false;
+
+			tempAnim.FrameBounds.reserve(tempAnim.NumFrames);
+			for (int i = 0; i < tempAnim.NumFrames; i++)
+			{
+				BoundingBox tempBB;
+
+				if (!ReadSwappedVector(tokenizer, tempBB.Min.x, tempBB.Min.y, tempBB.Min.z) ||
+					!ReadSwappedVector(tokenizer, tempBB.Max.x, tempBB.Max.y, tempBB.Max.z))
+				{
+					return false;
+				}
+
+				tempAnim.FrameBounds.push_back(tempBB);
+			}
+
+			if (!tokenizer.Expect("}"))
+				return false;
+		}
+		else if (token.Equals("baseframe"))
+		{
+			if (!tokenizer.Expect("{"))
+				return false;
+
+			tempAnim.BaseFrameJoints.reserve(tempAnim.NumJoints);
+			for (int i = 0; i < tempAnim.NumJoints; i++)
+			{
+				JointPose tempBFJ;
+
+				if (!ReadSwappedVector(tokenizer, tempBFJ.Position.x, tempBFJ.Position.y, tempBFJ.Position.z) ||
+					!ReadSwappedVector(tokenizer, tempBFJ.Orientation.x, tempBFJ.Orientation.y, tempBFJ.Orientation.z))
+				{
+					return false;
+				}
+
+				tempBFJ.Orientation.w = 0.0f;
+				tempAnim.BaseFrameJoints.push_back(tempBFJ);
+			}
+
+			if (!tokenizer.Expect("}"))
+				return false;
+		}
+		else if (token.Equals("frame"))
+		{
+			FrameData tempFrame;
+
+			if (!tokenizer.ReadInt(tempFrame.FrameID) || !tokenizer.Expect("{"))
+				return false;
+
+			tempFrame.FrameDataVec.resize(tempAnim.NumAnimatedComponents);
+			for (int i = 0; i < tempAnim.NumAnimatedComponents; i++)
+			{
+				if (!tokenizer.ReadFloat(tempFrame.FrameDataVec[i]))
+					return false;
+			}
+
+			if (!tokenizer.Expect("}"))
+				return false;
+
+			tempAnim.FrameData.push_back(tempFrame);
+
+			AddFrameSkeleton(tempAnim, tempFrame);
+		}
+	}
+
+	tempAnim.FrameTime = 1.0f / tempAnim.FrameRate;
+	tempAnim.TotalAnimTime = tempAnim.NumFrames * tempAnim.FrameTime;
+	tempAnim.CurrAnimTime = 0.0f;
+
+	MD5Model.Animations.push_back(tempAnim);
+
+	return true;
 }
 
-bool Skeleton::LoadMD5Model(ID3D11Device* device,
-	ID3D11DeviceContext* context,
-	std::wstring filename,
-	Model3D& MD5Model,
-	TextureManager* textureManager)
+bool Skeleton::LoadMD5ModelReference(std::wstring filename, Model3D& MD5Model)
 {
 	int meshCount = 0;
 
@@ -334,7 +2821,9 @@ bool Skeleton::LoadMD5Model(ID3D11Device* device,
 						fileNamePath.erase(0, 1);
 						fileNamePath.erase(fileNamePath.size() - 1, 1);
 
-						textureManager->LoadJPEGTexture(device, context, fileNamePath, 10 + meshCount);
+						// The textures are loaded once the whole model is, the same way for the compiled file
+						subset.TextureFileName = fileNamePath;
+						subset.TexArrayIndex = 10 + meshCount;
 						meshCount++;
 
 						std::getline(fileIn, checkString);                // Skip rest of this line
@@ -422,164 +2911,7 @@ bool Skeleton::LoadMD5Model(ID3D11Device* device,
 					fileIn >> checkString;                                // Skip "}"
 				}
 
-				//*** find each vertex's position using the joints and weights ***//
-				for (int i = 0; i < (int)subset.Vertices.size(); ++i)
-				{
-					Vertex tempVert = subset.Vertices[i];
-					tempVert.Pos = XMFLOAT3(0, 0, 0);    // Make sure the vertex's pos is cleared first
-
-														 // Sum up the joints and weights information to get vertex's position
-					for (int j = 0; j < tempVert.WeightCount; ++j)
-					{
-						Weight tempWeight = subset.Weights[tempVert.StartWeight + j];
-						Joint tempJoint = MD5Model.Joints[tempWeight.JointID];
-
-						// Convert joint orientation and weight pos to vectors for easier computation
-						// When converting a 3d vector to a quaternion, you should put 0 for "w", and
-						// When converting a quaternion to a 3d vector, you can just ignore the "w"
-						XMVECTOR tempJointOrientation = XMVectorSet(tempJoint.Orientation.x, tempJoint.Orientation.y, tempJoint.Orientation.z, tempJoint.Orientation.w);
-						XMVECTOR tempWeightPos = XMVectorSet(tempWeight.Position.x, tempWeight.Position.y, tempWeight.Position.z, 0.0f);
-
-						// We will need to use the conjugate of the joint orientation quaternion
-						// To get the conjugate of a quaternion, all you have to do is inverse the x, y, and z
-						XMVECTOR tempJointOrientationConjugate = XMVectorSet(-tempJoint.Orientation.x, -tempJoint.Orientation.y, -tempJoint.Orientation.z, tempJoint.Orientation.w);
-
-						// Calculate vertex position (in joint space, eg. rotate the point around (0,0,0)) for this weight using the joint orientation quaternion and its conjugate
-						// We can rotate a point using a quaternion with the equation "rotatedPoint = quaternion * point * quaternionConjugate"
-						XMFLOAT3 rotatedPoint;
-						XMStoreFloat3(&rotatedPoint, XMQuaternionMultiply(XMQuaternionMultiply(tempJointOrientation, tempWeightPos), tempJointOrientationConjugate));
-
-						// Now move the verices position from joint space (0,0,0) to the joints position in world space, taking the weights bias into account
-						// The weight bias is used because multiple weights might have an effect on the vertices final position. Each weight is attached to one joint.
-						tempVert.Pos.x += (tempJoint.Postion.x + rotatedPoint.x) * tempWeight.Bias;
-						tempVert.Pos.y += (tempJoint.Postion.y + rotatedPoint.y) * tempWeight.Bias;
-						tempVert.Pos.z += (tempJoint.Postion.z + rotatedPoint.z) * tempWeight.Bias;
-
-						// Basically what has happened above, is we have taken the weights position relative to the joints position
-						// we then rotate the weights position (so that the weight is actually being rotated around (0, 0, 0) in world space) using
-						// the quaternion describing the joints rotation. We have stored this rotated point in rotatedPoint, which we then add to
-						// the joints position (because we rotated the weight's position around (0,0,0) in world space, and now need to translate it
-						// so that it appears to have been rotated around the joints position). Finally we multiply the answer with the weights bias,
-						// or how much control the weight has over the final vertices position. All weight's bias effecting a single vertex's position
-						// must add up to 1.
-					}
-
-					subset.Positions.push_back(tempVert.Pos);            // Store the vertices position in the position vector instead of straight into the vertex vector
-																		 // since we can use the positions vector for certain things like collision detection or picking
-																		 // without having to work with the entire vertex structure.
-				}
-
-				// Put the positions into the vertices for this subset
-				for (int i = 0; i < (int)subset.Vertices.size(); i++)
-				{
-					subset.Vertices[i].Pos = subset.Positions[i];
-				}
-
-				//*** Calculate vertex normals using normal averaging ***///
-				std::vector<XMFLOAT3> tempNormal;
-
-				//normalized and unnormalized normals
-				XMFLOAT3 unnormalized = XMFLOAT3(0.0f, 0.0f, 0.0f);
-
-				//Used to get vectors (sides) from the position of the verts
-				float vecX, vecY, vecZ;
-
-				//Two edges of our triangle
-				XMVECTOR edge1 = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
-				XMVECTOR edge2 = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
-
-				//Compute face normals
-				for (int i = 0; i < subset.NumTriangles; ++i)
-				{
-					//Get the vector describing one edge of our triangle (edge 0,2)
-					vecX = subset.Vertices[subset.Indices[(i * 3)]].Pos.x - subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.x;
-					vecY = subset.Vertices[subset.Indices[(i * 3)]].Pos.y - subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.y;
-					vecZ = subset.Vertices[subset.Indices[(i * 3)]].Pos.z - subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.z;
-					edge1 = XMVectorSet(vecX, vecY, vecZ, 0.0f);    //Create our first edge
-
-																	//Get the vector describing another edge of our triangle (edge 2,1)
-					vecX = subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.x - subset.Vertices[subset.Indices[(i * 3) + 1]].Pos.x;
-					vecY = subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.y - subset.Vertices[subset.Indices[(i * 3) + 1]].Pos.y;
-					vecZ = subset.Vertices[subset.Indices[(i * 3) + 2]].Pos.z - subset.Vertices[subset.Indices[(i * 3) + 1]].Pos.z;
-					edge2 = XMVectorSet(vecX, vecY, vecZ, 0.0f);    //Create our second edge
-
-																	//Cross multiply the two edge vectors to get the un-normalized face normal
-					XMStoreFloat3(&unnormalized, XMVector3Cross(edge1, edge2));
-
-					tempNormal.push_back(unnormalized);
-				}
-
-				//Compute vertex normals (normal Averaging)
-				XMVECTOR normalSum = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
-				int facesUsing = 0;
-				float tX, tY, tZ;    //temp axis variables
-
-									 //Go through each vertex
-				for (int i = 0; i < (int)subset.Vertices.size(); ++i)
-				{
-					//Check which triangles use this vertex
-					for (int j = 0; j < subset.NumTriangles; ++j)
-					{
-						if ((int)subset.Indices[j * 3] == i ||
-							(int)subset.Indices[(j * 3) + 1] == i ||
-							(int)subset.Indices[(j * 3) + 2] == i)
-						{
-							tX = XMVectorGetX(normalSum) + tempNormal[j].x;
-							tY = XMVectorGetY(normalSum) + tempNormal[j].y;
-							tZ = XMVectorGetZ(normalSum) + tempNormal[j].z;
-
-							normalSum = XMVectorSet(tX, tY, tZ, 0.0f);    //If a face is using the vertex, add the unormalized face normal to the normalSum
-
-							facesUsing++;
-						}
-					}
-
-					//Get the actual normal by dividing the normalSum by the number of faces sharing the vertex
-					normalSum = normalSum / (float)facesUsing;
-
-					//Normalize the normalSum vector
-					normalSum = XMVector3Normalize(normalSum);
-
-					//Store the normal and tangent in our current vertex
-					subset.Vertices[i].Normal.x = -XMVectorGetX(normalSum);
-					subset.Vertices[i].Normal.y = -XMVectorGetY(normalSum);
-					subset.Vertices[i].Normal.z = -XMVectorGetZ(normalSum);
-
-					//Clear normalSum, facesUsing for next vertex
-					normalSum = XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f);
-					facesUsing = 0;
-				}
-
-				// Create index buffer
-				D3D11_BUFFER_DESC indexBufferDesc;
-				ZeroMemory(&indexBufferDesc, sizeof(indexBufferDesc));
-
-				indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-				indexBufferDesc.ByteWidth = sizeof(DWORD) * subset.NumTriangles * 3;
-				indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-				indexBufferDesc.CPUAccessFlags = 0;
-				indexBufferDesc.MiscFlags = 0;
-
-				D3D11_SUBRESOURCE_DATA iinitData;
-
-				iinitData.pSysMem = &subset.Indices[0];
-				device->CreateBuffer(&indexBufferDesc, &iinitData, &subset.IndexBuff);
-
-				//Create Vertex Buffer
-				D3D11_BUFFER_DESC vertexBufferDesc;
-				ZeroMemory(&vertexBufferDesc, sizeof(vertexBufferDesc));
-
-				vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;                            // We will be updating this buffer, so we must set as dynamic
-				vertexBufferDesc.ByteWidth = sizeof(Vertex) * subset.Vertices.size();
-				vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-				vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;                // Give CPU power to write to buffer
-				vertexBufferDesc.MiscFlags = 0;
-
-				D3D11_SUBRESOURCE_DATA vertexBufferData;
-
-				ZeroMemory(&vertexBufferData, sizeof(vertexBufferData));
-				vertexBufferData.pSysMem = &subset.Vertices[0];
-				device->CreateBuffer(&vertexBufferDesc, &vertexBufferData, &subset.VertBuff);
+				FinishSubset(MD5Model, subset);
 
 				// Push back the temp subset into the models subset vector
 				MD5Model.Subsets.push_back(subset);
@@ -601,7 +2933,7 @@ bool Skeleton::LoadMD5Model(ID3D11Device* device,
 	return true;
 }
 
-bool Skeleton::LoadMD5Anim(std::wstring filename, Model3D & MD5Model)
+bool Skeleton::LoadMD5AnimReference(std::wstring filename, Model3D & MD5Model)
 {
 	ModelAnimation tempAnim;						// Temp animation to later store in our model's animation array
 
@@ -719,10 +3051,10 @@ bool Skeleton::LoadMD5Anim(std::wstring filename, Model3D & MD5Model)
 
 				for (int i = 0; i < tempAnim.NumJoints; i++)
 				{
-					Joint tempBFJ;
+					JointPose tempBFJ;
 
 					fileIn >> checkString;						// Skip "("
-					fileIn >> tempBFJ.Postion.x >> tempBFJ.Postion.z >> tempBFJ.Postion.y;
+					fileIn >> tempBFJ.Position.x >> tempBFJ.Position.z >> tempBFJ.Position.y;
 					fileIn >> checkString >> checkString;		// Skip ") ("
 					fileIn >> tempBFJ.Orientation.x >> tempBFJ.Orientation.z >> tempBFJ.Orientation.y;
 					fileIn >> checkString;						// Skip ")"
@@ -748,94 +3080,7 @@ bool Skeleton::LoadMD5Anim(std::wstring filename, Model3D & MD5Model)
 
 				tempAnim.FrameData.push_back(tempFrame);
 
-				///*** build the frame skeleton ***///
-				std::vector<Joint> tempSkeleton;
-
-				for (int i = 0; i < (int)tempAnim.JointInfo.size(); i++)
-				{
-					int k = 0;						// Keep track of position in frameData array
-
-													// Start the frames joint with the base frame's joint
-					Joint tempFrameJoint = tempAnim.BaseFrameJoints[i];
-
-					tempFrameJoint.ParentID = tempAnim.JointInfo[i].ParentID;
-
-					// Notice how I have been flipping y and z. this is because some modeling programs such as
-					// 3ds max (which is what I use) use a right handed coordinate system. Because of this, we
-					// need to flip the y and z axes. If your having problems loading some models, it's possible
-					// the model was created in a left hand coordinate system. in that case, just reflip all the
-					// y and z axes in our md5 mesh and anim loader.
-					if (tempAnim.JointInfo[i].Flags & 1)		// pos.x	( 000001 )
-						tempFrameJoint.Postion.x = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
-
-					if (tempAnim.JointInfo[i].Flags & 2)		// pos.y	( 000010 )
-						tempFrameJoint.Postion.z = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
-
-					if (tempAnim.JointInfo[i].Flags & 4)		// pos.z	( 000100 )
-						tempFrameJoint.Postion.y = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
-
-					if (tempAnim.JointInfo[i].Flags & 8)		// orientation.x	( 001000 )
-						tempFrameJoint.Orientation.x = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
-
-					if (tempAnim.JointInfo[i].Flags & 16)	// orientation.y	( 010000 )
-						tempFrameJoint.Orientation.z = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
-
-					if (tempAnim.JointInfo[i].Flags & 32)	// orientation.z	( 100000 )
-						tempFrameJoint.Orientation.y = tempFrame.FrameDataVec[tempAnim.JointInfo[i].StartIndex + k++];
-
-
-					// Compute the quaternions w
-					float t = 1.0f - (tempFrameJoint.Orientation.x * tempFrameJoint.Orientation.x)
-						- (tempFrameJoint.Orientation.y * tempFrameJoint.Orientation.y)
-						- (tempFrameJoint.Orientation.z * tempFrameJoint.Orientation.z);
-					if (t < 0.0f)
-					{
-						tempFrameJoint.Orientation.w = 0.0f;
-					}
-					else
-					{
-						tempFrameJoint.Orientation.w = -sqrtf(t);
-					}
-
-					// Now, if the upper arm of your skeleton moves, you need to also move the lower part of your arm, and then the hands, and then finally the fingers (possibly weapon or tool too)
-					// This is where joint hierarchy comes in. We start at the top of the hierarchy, and move down to each joints child, rotating and translating them based on their parents rotation
-					// and translation. We can assume that by the time we get to the child, the parent has already been rotated and transformed based of it's parent. We can assume this because
-					// the child should never come before the parent in the files we loaded in.
-					if (tempFrameJoint.ParentID >= 0)
-					{
-						Joint parentJoint = tempSkeleton[tempFrameJoint.ParentID];
-
-						// Turn the XMFLOAT3 and 4's into vectors for easier computation
-						XMVECTOR parentJointOrientation = XMVectorSet(parentJoint.Orientation.x, parentJoint.Orientation.y, parentJoint.Orientation.z, parentJoint.Orientation.w);
-						XMVECTOR tempJointPos = XMVectorSet(tempFrameJoint.Postion.x, tempFrameJoint.Postion.y, tempFrameJoint.Postion.z, 0.0f);
-						XMVECTOR parentOrientationConjugate = XMVectorSet(-parentJoint.Orientation.x, -parentJoint.Orientation.y, -parentJoint.Orientation.z, parentJoint.Orientation.w);
-
-						// Calculate current joints position relative to its parents position
-						XMFLOAT3 rotatedPos;
-						XMStoreFloat3(&rotatedPos, XMQuaternionMultiply(XMQuaternionMultiply(parentJointOrientation, tempJointPos), parentOrientationConjugate));
-
-						// Translate the joint to model space by adding the parent joint's pos to it
-						tempFrameJoint.Postion.x = rotatedPos.x + parentJoint.Postion.x;
-						tempFrameJoint.Postion.y = rotatedPos.y + parentJoint.Postion.y;
-						tempFrameJoint.Postion.z = rotatedPos.z + parentJoint.Postion.z;
-
-						// Currently the joint is oriented in its parent joints space, we now need to orient it in
-						// model space by multiplying the two orientations together (parentOrientation * childOrientation) <- In that order
-						XMVECTOR tempJointOrient = XMVectorSet(tempFrameJoint.Orientation.x, tempFrameJoint.Orientation.y, tempFrameJoint.Orientation.z, tempFrameJoint.Orientation.w);
-						tempJointOrient = XMQuaternionMultiply(parentJointOrientation, tempJointOrient);
-
-						// Normalize the orienation quaternion
-						tempJointOrient = XMQuaternionNormalize(tempJointOrient);
-
-						XMStoreFloat4(&tempFrameJoint.Orientation, tempJointOrient);
-					}
-
-					// Store the joint into our temporary frame skeleton
-					tempSkeleton.push_back(tempFrameJoint);
-				}
-
-				// Push back our newly created frame skeleton into the animation's frameSkeleton array
-				tempAnim.FrameSkeleton.push_back(tempSkeleton);
+				AddFrameSkeleton(tempAnim, tempFrame);
 
 				fileIn >> checkString;				// Skip closing bracket "}"
 			}
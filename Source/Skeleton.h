@@ -7,17 +7,63 @@
 #include <string>
 #include <vector>
 
+#include "Frustum.h"
+#include "SkeletonShader.h"
 #include "TextureManager.h"
 #include "Transform.h"
 
 using namespace DirectX;
 
+// How a skeleton skins its mesh each frame
+enum SkinningMode
+{
+	SkinningMode_Weights = 0,	// The MD5 weights on the CPU with the SIMD kernel, exact however many weights a vertex has
+	SkinningMode_Palette,		// Blends the bind pose by the matrices of up to four joints per vertex on the CPU
+	SkinningMode_Shader,		// The same blend in the skeleton vertex shader, so only the joint matrices are uploaded
+};
+
+// How a layer of animation is blended over the layers under it
+enum AnimationBlend
+{
+	AnimationBlend_Override = 0,	// Blends from the pose under the layer towards its clip by the weight
+	AnimationBlend_Additive,		// Adds how far its clip has moved from its first frame, scaled by the weight
+};
+
 class Skeleton
 {
+public:
+	// A joint as the rows of a 3x4 matrix, which rotates a point and then moves it
+	struct JointMatrix
+	{
+		XMFLOAT4 Rows[3];
+	};
+
+	// A clip playing on a layer of the pose. The layers are blended from the first up, each over the pose the ones
+	// before it made, starting from the bind pose. Layers with no clip or no weight are left out, and a mask scales
+	// the weight joint by joint.
+	struct AnimationLayer
+	{
+		int Clip;
+		float Time;
+		float Weight;
+		AnimationBlend Blend;
+		int Mask;			// -1 for every joint
+	};
+
+	// The joints the palette and shader modes can tell apart, as the bind vertices hold their joints in a byte each
+	static const int MAX_PALETTE_JOINTS = 256;
+
+	static const int MAX_ANIMATION_LAYERS = 4;
+
+	static const unsigned int COMPILED_MAGIC = 0x4335444D;	// "MD5C"
+	static const unsigned int COMPILED_VERSION = 2;
+
 private:
 	struct Vertex    //Overloaded Vertex Structure
 	{
-		Vertex() {}
+		// Zeroed, so the parts the loader never fills in are the same every time the model is compiled
+		Vertex() : Pos(0.0f, 0.0f, 0.0f), TexCoord(0.0f, 0.0f), Normal(0.0f, 0.0f, 0.0f), Tangent(0.0f, 0.0f, 0.0f),
+			BiTangent(0.0f, 0.0f, 0.0f), StartWeight(0), WeightCount(0) {}
 		Vertex(float x, float y, float z,
 			float u, float v,
 			float nx, float ny, float nz,
@@ -45,6 +91,14 @@ private:
 		XMFLOAT4 Orientation;
 	};
 
+	// Where a joint is and which way it faces in a pose. Poses are plain arrays of these, with the names and parents
+	// of the joints left with the model, so they are posed and copied without allocating.
+	struct JointPose
+	{
+		XMFLOAT3 Position;
+		XMFLOAT4 Orientation;
+	};
+
 	struct Weight
 	{
 		int JointID;
@@ -53,10 +107,41 @@ private:
 		XMFLOAT3 Normal;
 	};
 
+	// The weights of four vertices, one to each SIMD lane of the skinning kernel. The positions are scaled by the bias
+	// and the normals by minus the bias, so the kernel only has to rotate and add them up.
+	struct SkinSlot
+	{
+		int JointID[4];
+		float Bias[4];
+		float PositionX[4], PositionY[4], PositionZ[4];
+		float NormalX[4], NormalY[4], NormalZ[4];
+	};
+
+	// Four vertices skinned together, with the slots holding their first, second, third... weights. Lanes with fewer
+	// weights than the others in the group have weights of no bias, and lanes past the last vertex have no vertex.
+	struct SkinGroup
+	{
+		int FirstSlot;
+		int SlotCount;
+		int Vertices[4];
+	};
+
+	// A vertex of the bind pose with the joints it is blended from, as the skeleton vertex shader takes it. The
+	// weights of the joints add up to one.
+	struct SkinnedVertex
+	{
+		XMFLOAT3 Pos;
+		XMFLOAT2 TexCoord;
+		XMFLOAT3 Normal;
+		unsigned char JointIDs[4];
+		XMFLOAT4 JointWeights;
+	};
+
 	struct ModelSubset
 	{
 		int TexArrayIndex;
 		int NumTriangles;
+		std::wstring TextureFileName;
 
 		std::vector<Vertex> Vertices;
 		std::vector<DWORD> Indices;
@@ -64,7 +149,15 @@ private:
 
 		std::vector<XMFLOAT3> Positions;
 
-		ID3D11Buffer* VertBuff;
+		// The weights laid out for the skinning kernel, with the vertices sorted by how many weights they have so
+		// each group wastes as few lanes as it can
+		std::vector<SkinGroup> SkinGroups;
+		std::vector<SkinSlot> SkinSlots;
+
+		// The bind pose blended by the joint matrices, and the buffer the shader skins it from
+		std::vector<SkinnedVertex> BindVertices;
+		ID3D11Buffer* BindVertBuff;
+
 		ID3D11Buffer* IndexBuff;
 	};
 
@@ -102,9 +195,11 @@ private:
 
 		std::vector<AnimJointInfo> JointInfo;
 		std::vector<BoundingBox> FrameBounds;
-		std::vector<Joint>    BaseFrameJoints;
+		std::vector<JointPose>    BaseFrameJoints;
 		std::vector<FrameData>    FrameData;
-		std::vector<std::vector<Joint>> FrameSkeleton;
+
+		// The joints of every frame in model space, NumJoints to a frame, one frame after another
+		std::vector<JointPose> FramePoses;
 	};
 
 	struct Model3D
@@ -117,7 +212,148 @@ private:
 		std::vector<ModelAnimation> Animations;
 	};
 
+	// A key of a compressed track in 48 bits. Rotations keep the three smallest parts of the quaternion in 15 bits
+	// each, after two bits saying which part was dropped, and positions each part in 16 bits across its range.
+	struct CompressedKey
+	{
+		unsigned short Values[3];
+	};
+
+	// The keys of one track run from the first for the count, each with the frame it was taken from. The first and
+	// last frames are always keys, unless the track never moves and has only one key.
+	struct CompressedTrack
+	{
+		int FirstKey;
+		int KeyCount;
+	};
+
+	// The tracks of a joint hold it relative to its parent, which leaves the positions of most joints still, and the
+	// positions are quantized across the range they cover in the clip
+	struct CompressedJoint
+	{
+		int ParentID;
+		XMFLOAT3 PositionMin;
+		XMFLOAT3 PositionScale;
+		CompressedTrack Rotation;
+		CompressedTrack Position;
+	};
+
+	// An animation with its joints quantized, and the keys that blending the keys either side of them puts back within
+	// a tolerance dropped. The tracks of all the joints share the arrays of keys.
+	struct CompressedClip
+	{
+		int NumFrames;
+		int NumJoints;
+
+		std::vector<CompressedJoint> Joints;
+		std::vector<unsigned short> KeyFrames;
+		std::vector<CompressedKey> Keys;
+	};
+
+	// Which frames of a clip a time falls between, and how far it is between them
+	struct ClipSample
+	{
+		int Frame0, Frame1;
+		float Interpolation;
+	};
+
+	// The joints of a pose relative to their parents, with each part of them in an array of its own so the layers are
+	// blended a joint at a time without gathering the parts
+	struct LocalPose
+	{
+		std::vector<float> PositionX, PositionY, PositionZ;
+		std::vector<float> RotationX, RotationY, RotationZ, RotationW;
+	};
+
+	// An array in the compiled file, stored as its offset from the start of the file and fixed up into a pointer to
+	// it once the file is mapped
+	struct CompiledArray
+	{
+		union
+		{
+			unsigned long long Offset;
+			const void* Data;
+		};
+		unsigned int Count;
+		unsigned int Padding;
+	};
+
+	struct CompiledJoint
+	{
+		int ParentID;
+		XMFLOAT3 Position;
+		XMFLOAT4 Orientation;
+		CompiledArray Name;
+	};
+
+	struct CompiledSubset
+	{
+		int TexArrayIndex;
+		int NumTriangles;
+		CompiledArray TextureFileName;
+		CompiledArray Vertices;
+		CompiledArray Indices;
+		CompiledArray Weights;
+		CompiledArray Positions;
+		CompiledArray SkinGroups;
+		CompiledArray SkinSlots;
+		CompiledArray BindVertices;
+	};
+
+	// The start of the compiled file, with the sizes and times of the text files it was made from so it can tell
+	// when they have changed. The animation is the first clip of the model, the one it is loaded with, and the clips
+	// added after it are read from their own text files.
+	struct CompiledHeader
+	{
+		unsigned int Magic;
+		unsigned int Version;
+		unsigned long long MeshSize, MeshWriteTime;
+		unsigned long long AnimSize, AnimWriteTime;
+
+		int NumJoints;
+		int NumSubsets;
+		int NumFrames;
+		int FrameRate;
+		int NumAnimatedComponents;
+		float FrameTime;
+		float TotalAnimTime;
+
+		CompiledArray Joints;
+		CompiledArray Subsets;
+		CompiledArray FrameBounds;
+		CompiledArray FramePoses;
+
+		// The bounds of the first clip fitted around every frame of the skinned mesh, so loading it skips the fitting
+		CompiledArray FittedBounds;
+	};
+
 public:
+	// One character playing the skeleton: the clips it plays, its pose and joint matrices, and the mesh skinned to the
+	// pose with the vertex buffers it is drawn from. The model, clips and masks stay with the skeleton, so each of the
+	// characters sharing it only costs its pose and vertices. The skeleton plays one of these itself.
+	struct InstanceState
+	{
+		AnimationLayer Layers[MAX_ANIMATION_LAYERS];
+
+		// The pose in model space, and the joint matrices of the pose. The palette matrices take the bind pose to the
+		// pose, being the joint matrices after the inverse bind matrices. The layers are blended into the local pose.
+		std::vector<JointPose> Pose;
+		LocalPose BlendPose;
+		std::vector<JointMatrix> JointMatrices;
+		std::vector<JointMatrix> PaletteMatrices;
+
+		// The vertices of each subset as skinned on the CPU, and the vertex buffers they are copied into
+		std::vector<std::vector<Vertex>> Vertices;
+		std::vector<ID3D11Buffer*> VertexBuffers;
+
+		// How many levels of joints at the ends of the chains, such as the fingers, are left in their bind pose under
+		// their parents, 0 to pose every joint. Only the compressed clips leave joints out.
+		int LeafLevels;
+
+		// The frame of the cached frames drawn in place of the vertex buffers of the instance, or -1 to draw its own
+		int CachedFrame;
+	};
+
 	Skeleton();
 	~Skeleton();
 
@@ -133,16 +369,212 @@ public:
 
 	Transform* GetTransform() { return _transform; }
 
-private:
-	bool LoadMD5Model(ID3D11Device* device, 
-		ID3D11DeviceContext* context, 
-		std::wstring filename,
-		Model3D& MD5Model,
-		TextureManager* textureManager);
+	// The shader mode needs no vertex buffer updates, but is drawn with the skeleton shader and the joint matrices
+	void SetSkinningMode(SkinningMode mode);
+	SkinningMode GetSkinningMode() const { return _skinningMode; }
+
+	// The joint matrices of the pose, taking the bind pose to it, as three rows for each joint
+	const XMFLOAT4* GetJointMatrixRows() const { return &_state.PaletteMatrices[0].Rows[0]; }
+	int GetJointCount() const { return _md5Model.NumJoints; }
+	int GetFrameCount() const { return _md5Model.Animations[0].NumFrames; }
+	float GetFrameTime() const { return _md5Model.Animations[0].FrameTime; }
+
+	// Loads another clip of the same joints from an MD5 animation file, compressing it if the others are, and returns
+	// its index. The first clip is the one the skeleton was loaded with. Returns -1 when the file could not be read or
+	// animates other joints.
+	int AddAnimation(std::wstring animFileName);
+	int GetAnimationCount() const { return (int)_md5Model.Animations.size(); }
+	float GetAnimationLength(int clip) const { return _md5Model.Animations[clip].TotalAnimTime; }
+
+	// Adds a mask of the named joint and every joint under it, and returns its index, or -1 when there is no such joint
+	int AddJointMask(std::wstring jointName);
+
+	// The layers start out with the first clip on the first layer and nothing on the others. Update moves the time of
+	// each layer on, looping its clip, and poses the skeleton from them.
+	void SetLayer(int index, const AnimationLayer& layer) { _state.Layers[index] = layer; }
+	const AnimationLayer& GetLayer(int index) const { return _state.Layers[index]; }
+	AnimationLayer* GetLayers() { return _state.Layers; }
+	void ResetLayers();
+	void AdvanceLayers(float deltaTime);
+
+	// Poses the skeleton from its layers, or at a time into the first clip, and skins the mesh to the pose on the CPU
+	// the way a skinning mode does, or with the quaternion reference the modes are checked against. The shader mode
+	// is skinned the same way as the palette mode here. None of them touch the vertex buffers.
+	void PoseLayers();
+	void Pose(float animationTime);
+	void Skin(SkinningMode mode);
+	void SkinReference();
+
+	// Sizes an instance for the model and starts it on the first frame of the first clip, creating its vertex buffers
+	// when there is a device. Animating an instance only reads the skeleton, so instances of the same skeleton can be
+	// animated on different threads at once, though their buffers have to be filled on the thread of the context.
+	bool CreateInstance(ID3D11Device* device, InstanceState& state) const;
+	void DestroyInstance(InstanceState& state) const;
+	void ResetLayers(InstanceState& state) const;
+	void AdvanceLayers(InstanceState& state, float deltaTime) const;
+	void PoseLayers(InstanceState& state) const;
+	void Skin(InstanceState& state, SkinningMode mode) const;
+	void UploadInstance(ID3D11DeviceContext* context, const InstanceState& state) const;
+	void DrawSubset(ID3D11DeviceContext* deviceContext, const InstanceState& state, int index) const;
+	void GetSkinnedVertices(const InstanceState& state, std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT3>& normals) const;
+
+	// The bytes the arrays of an instance take on the CPU, and the bytes of the model and clips every instance shares
+	int GetInstanceSize(const InstanceState& state) const;
+	int GetSharedSize() const;
+
+	// Poses every frame of every clip once, keeping the joint matrices of each, and skins them into vertex buffers when
+	// there is a device, for distant instances to draw in place of posing and skinning themselves. Clips added after
+	// the frames are cached have none. The cached frame is the one nearest the time, or -1 when the clip has none.
+	bool CacheFrames(ID3D11Device* device);
+	void DestroyCachedFrames();
+	int GetCachedFrame(int clip, float animationTime) const;
+	const XMFLOAT4* GetCachedJointMatrixRows(int frame) const { return &_cachedMatrices[frame * _md5Model.NumJoints].Rows[0]; }
+
+	// The distance from the origin of the model to the furthest vertex of the bind pose
+	float GetBoundingRadius() const { return _boundingRadius; }
+
+	// The box in the world around the pose of an instance, from the bounds the clips hold for each frame, taken between
+	// the two frames each layer is on and put around every layer with a clip. The bounds of the files are grown to hold
+	// the mesh skinned at each frame when the clips are loaded, and a layer with no clip is boxed by the bounding
+	// radius. The box in model space is moved by the transform the way the model is drawn, so an instance outside the
+	// frustum can be left unposed and unskinned.
+	void GetWorldBounds(const InstanceState& state, Transform* transform, XMFLOAT3& minimum, XMFLOAT3& maximum) const;
+	bool IsVisible(Frustum* frustum, const InstanceState& state, Transform* transform) const;
+	bool IsVisible(Frustum* frustum) const { return IsVisible(frustum, _state, _transform); }
+
+	// Compresses the clips, keeping a key wherever dropping it would move a joint relative to its parent further than
+	// the position tolerance or turn it further than the rotation tolerance, in radians. Posing samples the compressed
+	// clips once there are some, unless they are turned off. The layers are only blended from the compressed clips,
+	// which hold the joints relative to their parents, so without them the first layer with a clip plays on its own
+	// from the frames as loaded.
+	void CompressAnimation(float positionTolerance, float rotationTolerance);
+	void SetCompressedAnimation(bool compressed) { _compressedAnimation = compressed; }
+	bool GetCompressedAnimation() const { return _compressedAnimation; }
+	float GetPositionTolerance() const { return _positionTolerance; }
+	float GetRotationTolerance() const { return _rotationTolerance; }
+
+	// The bytes the frames of all the clips take as loaded and once compressed, and the number of keys kept
+	int GetAnimationSize() const;
+	int GetCompressedAnimationSize() const;
+	int GetCompressedKeyCount() const;
+
+	// Fill the model from the MD5 text files, or from the compiled file made from them, without creating anything on
+	// the device. The compiled file holds everything the text loader makes, written beside the mesh file the first time
+	// the text is parsed, and is mapped into memory with one call rather than parsed. It is out of date, and is not
+	// loaded, when either text file has changed since it was written or it was written by an older loader.
+	bool LoadText(std::wstring meshFileName, std::wstring animFileName);
+	bool LoadCompiled(std::wstring meshFileName, std::wstring animFileName);
+	bool SaveCompiled(std::wstring meshFileName, std::wstring animFileName) const;
+
+	// The text is read with the MD5 tokenizer. The reference reads it with the wide file streams instead, and is kept
+	// to check the tokenizer against.
+	bool LoadTextReference(std::wstring meshFileName, std::wstring animFileName);
+
+	// Only parses the text files into the model, with the tokenizer or the reference, leaving out the pose buffers and
+	// frame bounds the loaders make from it, so the parsing can be timed on its own. The skeleton is not usable after.
+	bool ParseText(std::wstring meshFileName, std::wstring animFileName, bool reference);
+
+	// Lays the model out the way the compiled file holds it, without the times of the text files, so two models can be
+	// checked for holding exactly the same data
+	void Compile(std::vector<char>& data) const;
+
+	static std::wstring GetCompiledFileName(std::wstring meshFileName);
+
+	const std::wstring& GetMeshFileName() const { return _meshFileName; }
+	const std::wstring& GetAnimFileName() const { return _animFileName; }
+
+	int GetVertexCount() const;
+	int GetVertexStride() const { return sizeof(Vertex); }
+	void GetSkinnedVertices(std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT3>& normals) const;
 
+private:
+	bool LoadTextFiles(std::wstring meshFileName, std::wstring animFileName, bool reference);
+	bool LoadMD5Model(std::wstring filename, Model3D& MD5Model);
 	bool LoadMD5Anim(std::wstring filename, Model3D& MD5Model);
+	bool LoadMD5ModelReference(std::wstring filename, Model3D& MD5Model);
+	bool LoadMD5AnimReference(std::wstring filename, Model3D& MD5Model);
+
+	// The work the loaders share once a mesh or frame has been read: the bind pose of the vertices, their normals
+	// and the skinning data of a mesh, and the model space joints of a frame
+	void FinishSubset(const Model3D& MD5Model, ModelSubset& subset);
+	void AddFrameSkeleton(ModelAnimation& animation, const FrameData& frame);
+
+	bool ReadCompiled(char* view, unsigned long long fileSize, const CompiledHeader& stamps);
+	static bool GetSourceStamps(const std::wstring& meshFileName, const std::wstring& animFileName, CompiledHeader& header);
+	static bool FixUpCompiledArray(CompiledArray& array, char* view, unsigned long long fileSize, size_t elementSize);
+	static bool CheckCompiledSubset(const CompiledSubset& subset, int numJoints);
+	template <typename T> static void AddCompiledArray(std::vector<char>& data, CompiledArray& array, const T& values);
+	template <typename T> static void CopyCompiledArray(const CompiledArray& array, T& values);
+
+	// Sizes the pose buffers for the joints of the model just loaded, and works out the inverse bind matrices
+	void CreatePoseBuffers();
+
+	// Grows the bounds a clip holds for each frame to hold the mesh skinned at the frame, as exporters write boxes
+	// that only hold the joints or leave out parts of the mesh
+	void FitFrameBounds(int clip);
+	void CreateSubsetBuffers(ID3D11Device* device, ModelSubset& subset);
+
+	void CompressClip(int clip);
+	static bool CompressedSpanFits(const CompressedClip& clip, const std::vector<JointPose>& localPoses, int jointIndex, bool rotation,
+		const CompressedKey& key0, const CompressedKey& key1, int start, int end, float tolerance);
+	static void AddCompressedTrack(CompressedClip& clip, const std::vector<JointPose>& localPoses, int jointIndex, bool rotation,
+		const std::vector<CompressedKey>& frameKeys, float tolerance, CompressedTrack& track);
+	static void SampleCompressedTrack(const CompressedClip& clip, const CompressedTrack& track, const ClipSample& sample, int& key0, int& key1, float& blend);
+
+	// Poses an instance from the layers, blending them into the local pose and building the pose in model space from
+	// it when the clips are compressed, and from the frames of the first layer otherwise
+	void PoseFromLayers(InstanceState& state, const AnimationLayer* layers, int count) const;
+	void BlendLayers(InstanceState& state, const AnimationLayer* layers, int count) const;
+	void ComposeLocalPose(InstanceState& state) const;
+	void PoseFrames(InstanceState& state, int clip, float animationTime) const;
+	void GetClipSample(int clip, float animationTime, ClipSample& sample) const;
+	bool HasCompressedClips() const { return _compressedAnimation && !_compressedClips.empty() && _compressedClips.size() == _md5Model.Animations.size(); }
+
+	// A joint in model space taken back into the space of its parent
+	static JointPose GetLocalJoint(const JointPose& pose, const JointPose& parent);
+
+	static void QuantizeRotation(const XMFLOAT4& orientation, CompressedKey& key);
+	static void QuantizePosition(const XMFLOAT3& position, const CompressedJoint& joint, CompressedKey& key);
+	static XMVECTOR DecodeRotation(const CompressedKey& key);
+	static XMVECTOR DecodePosition(const CompressedKey& key, const CompressedJoint& joint);
+
+	void CreateSkinSlots(ModelSubset& subset);
+	void CreateBindVertices(ModelSubset& subset);
+	static void SkinSubset(const ModelSubset& subset, const JointMatrix* matrices, Vertex* vertices);
+	static void SkinSubsetPalette(const ModelSubset& subset, const JointMatrix* matrices, Vertex* vertices);
+	static void SkinSubsetReference(const ModelSubset& subset, const JointPose* pose, Vertex* vertices);
 
 	Model3D			_md5Model;
 	Transform*		_transform;
+
+	std::wstring	_meshFileName;
+	std::wstring	_animFileName;
+
+	SkinningMode				_skinningMode;
+
+	// The instance the skeleton plays itself, and the bind pose relative to the parents of the joints with the inverse
+	// bind matrices, which every instance shares. They are all sized when the skeleton is loaded, so posing never
+	// allocates. The height of a joint is the most levels of joints under it, 0 at the ends of the chains.
+	InstanceState				_state;
+	LocalPose					_bindPose;
+	std::vector<JointMatrix>	_inverseBindMatrices;
+	std::vector<int>			_jointHeights;
+	float						_boundingRadius;
+
+	// The bounds of each frame of each clip in model space, holding both the box of the file and the skinned mesh
+	std::vector<std::vector<BoundingBox>>	_frameBounds;
+
+	// The first cached frame of each clip, or -1, and the joint matrices and vertex buffers of the cached frames,
+	// one after another
+	std::vector<int>			_cachedClipFrames;
+	std::vector<JointMatrix>	_cachedMatrices;
+	std::vector<ID3D11Buffer*>	_cachedVertexBuffers;
+
+	// A compressed clip for each clip, or none, and the tolerances they were compressed to
+	std::vector<CompressedClip>	_compressedClips;
+	bool						_compressedAnimation;
+	float						_positionTolerance, _rotationTolerance;
+
+	std::vector<std::vector<float>>	_jointMasks;
 };
 
@@ -0,0 +1,726 @@
+#include "SkeletonBenchmark.h"
+
+#include <math.h>
+#include <stdio.h>
+
+// The heap allocations a benchmark counted, or a note that they are not counted in this build
+static inline void FormatAllocations(int allocations, char (&text)[64])
+{
+	if (allocations < 0)
+	{
+		sprintf_s(text, "heap allocations not counted without PROFILE");
+	}
+	else
+	{
+		sprintf_s(text, "%d heap allocations", allocations);
+	}
+}
+
+void SkeletonBenchmark::Run(ID3D11Device* device, ID3D11DeviceContext* context, Skeleton* skeleton)
+{
+	Report("---- Skeleton benchmarks ----");
+
+	RunSkinningBenchmark(skeleton);
+	RunAllocationBenchmark(context, skeleton);
+	RunLoadBenchmark(skeleton);
+	RunCompressionBenchmark(skeleton);
+	RunBlendBenchmark(skeleton);
+	RunInstanceBenchmark(device, context, skeleton);
+	RunLodBenchmark(device, context, skeleton);
+}
+
+void SkeletonBenchmark::RunSkinningBenchmark(Skeleton* skeleton)
+{
+	const SkinningMode modes[] = { SkinningMode_Weights, SkinningMode_Palette };
+	const char* names[] = { "Weights", "Palette" };
+	const int modeCount = sizeof(modes) / sizeof(modes[0]);
+
+	std::vector<XMFLOAT3> referencePositions, referenceNormals, positions, normals;
+	Timer timer;
+	char line[256];
+	int vertexCount = skeleton->GetVertexCount();
+
+	// Posing is timed too, since the CPU paths need the joint matrices it builds
+	timer.StartTimer();
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		skeleton->Pose(i * 0.01f);
+		skeleton->SkinReference();
+	}
+	timer.StopTimer();
+
+	float referenceMilliseconds = timer.GetTimingMilliseconds() / ITERATIONS;
+
+	sprintf_s(line, "Skinning %-10s vertices %6d  %8.1f us per mesh  %10.0f vertices per ms", "Reference", vertexCount,
+		referenceMilliseconds * 1000.0f, (referenceMilliseconds > 0.0f) ? vertexCount / referenceMilliseconds : 0.0f);
+	Report(line);
+
+	for (int i = 0; i < modeCount; i++)
+	{
+		float positionError = 0.0f, normalError = 0.0f;
+
+		// Check the mode against the reference over poses spread through the animation
+		for (int j = 0; j < POSES; j++)
+		{
+			skeleton->Pose(j * 0.1f);
+
+			skeleton->SkinReference();
+			skeleton->GetSkinnedVertices(referencePositions, referenceNormals);
+
+			skeleton->Skin(modes[i]);
+			skeleton->GetSkinnedVertices(positions, normals);
+
+			for (int k = 0; k < vertexCount; k++)
+			{
+				positionError = fmaxf(positionError, fabsf(positions[k].x - referencePositions[k].x));
+				positionError = fmaxf(positionError, fabsf(positions[k].y - referencePositions[k].y));
+				positionError = fmaxf(positionError, fabsf(positions[k].z - referencePositions[k].z));
+				normalError = fmaxf(normalError, fabsf(normals[k].x - referenceNormals[k].x));
+				normalError = fmaxf(normalError, fabsf(normals[k].y - referenceNormals[k].y));
+				normalError = fmaxf(normalError, fabsf(normals[k].z - referenceNormals[k].z));
+			}
+		}
+
+		timer.StartTimer();
+		for (int j = 0; j < ITERATIONS; j++)
+		{
+			skeleton->Pose(j * 0.01f);
+			skeleton->Skin(modes[i]);
+		}
+		timer.StopTimer();
+
+		float milliseconds = timer.GetTimingMilliseconds() / ITERATIONS;
+
+		sprintf_s(line, "Skinning %-10s vertices %6d  %8.1f us per mesh  %10.0f vertices per ms  largest error against the reference %g (normals %g)",
+			names[i], vertexCount, milliseconds * 1000.0f, (milliseconds > 0.0f) ? vertexCount / milliseconds : 0.0f, positionError, normalError);
+		Report(line);
+	}
+
+	// The shader path only uploads the joint matrices each frame, where the CPU paths upload every vertex
+	sprintf_s(line, "Skinning uploads per frame: %d bytes of vertices on the CPU, %d bytes of joint matrices with the shader",
+		skeleton->GetVertexCount() * skeleton->GetVertexStride(), skeleton->GetJointCount() * (int)sizeof(Skeleton::JointMatrix));
+	Report(line);
+}
+
+void SkeletonBenchmark::RunAllocationBenchmark(ID3D11DeviceContext* context, Skeleton* skeleton)
+{
+	const SkinningMode modes[] = { SkinningMode_Weights, SkinningMode_Palette, SkinningMode_Shader };
+	const char* names[] = { "Weights", "Palette", "Shader" };
+	const int modeCount = sizeof(modes) / sizeof(modes[0]);
+
+	SkinningMode oldMode = skeleton->GetSkinningMode();
+	char line[256];
+	char allocationText[64];
+
+	// Once the skeleton is loaded every update should reuse the buffers it already has
+	for (int i = 0; i < modeCount; i++)
+	{
+		skeleton->SetSkinningMode(modes[i]);
+		skeleton->Update(context, 0.016f);
+
+		AllocationCounter::Start();
+		for (int j = 0; j < ITERATIONS; j++)
+		{
+			skeleton->Update(context, 0.016f);
+		}
+		int allocations = AllocationCounter::Stop();
+
+		FormatAllocations(allocations, allocationText);
+		sprintf_s(line, "Update %-10s %s over %d updates", names[i], allocationText, ITERATIONS);
+		Report(line);
+	}
+
+	skeleton->SetSkinningMode(oldMode);
+}
+
+void SkeletonBenchmark::RunLoadBenchmark(Skeleton* skeleton)
+{
+	const std::wstring& meshFileName = skeleton->GetMeshFileName();
+	const std::wstring& animFileName = skeleton->GetAnimFileName();
+
+	Skeleton reference, text, compiled;
+	Timer timer;
+	char line[256];
+
+	// Make sure the compiled file is there and up to date, as it is after the skeleton is first loaded
+	if (!text.LoadText(meshFileName, animFileName) || !text.SaveCompiled(meshFileName, animFileName))
+	{
+		Report("Load could not parse and compile the skeleton");
+		return;
+	}
+
+	timer.StartTimer();
+	for (int i = 0; i < LOADS; i++)
+	{
+		reference.LoadTextReference(meshFileName, animFileName);
+	}
+	timer.StopTimer();
+
+	float referenceMilliseconds = timer.GetTimingMilliseconds() / LOADS;
+
+	timer.StartTimer();
+	for (int i = 0; i < LOADS; i++)
+	{
+		text.LoadText(meshFileName, animFileName);
+	}
+	timer.StopTimer();
+
+	float textMilliseconds = timer.GetTimingMilliseconds() / LOADS;
+
+	// The parsing on its own, without the pose buffers and fitted bounds both loaders make once the model is read
+	Skeleton parsed;
+	timer.StartTimer();
+	for (int i = 0; i < LOADS; i++)
+	{
+		parsed.ParseText(meshFileName, animFileName, true);
+	}
+	timer.StopTimer();
+
+	float referenceParseMilliseconds = timer.GetTimingMilliseconds() / LOADS;
+
+	timer.StartTimer();
+	for (int i = 0; i < LOADS; i++)
+	{
+		parsed.ParseText(meshFileName, animFileName, false);
+	}
+	timer.StopTimer();
+
+	float parseMilliseconds = timer.GetTimingMilliseconds() / LOADS;
+
+	// The tokenizer has to read exactly what the stream parser did, down to the last bit of every float
+	std::vector<char> referenceData, textData;
+	reference.Compile(referenceData);
+	text.Compile(textData);
+
+	bool loaded = true;
+	timer.StartTimer();
+	for (int i = 0; i < LOADS; i++)
+	{
+		loaded &= compiled.LoadCompiled(meshFileName, animFileName);
+	}
+	timer.StopTimer();
+
+	float compiledMilliseconds = timer.GetTimingMilliseconds() / LOADS;
+
+	if (!loaded)
+	{
+		Report("Load could not map the compiled skeleton");
+		return;
+	}
+
+	// Both should skin to exactly the same mesh
+	std::vector<XMFLOAT3> textPositions, textNormals, compiledPositions, compiledNormals;
+	float difference = 0.0f;
+
+	for (int i = 0; i < POSES; i++)
+	{
+		text.Pose(i * 0.1f);
+		text.Skin(SkinningMode_Weights);
+		text.GetSkinnedVertices(textPositions, textNormals);
+
+		compiled.Pose(i * 0.1f);
+		compiled.Skin(SkinningMode_Weights);
+		compiled.GetSkinnedVertices(compiledPositions, compiledNormals);
+
+		if (textPositions.size() != compiledPositions.size())
+		{
+			difference = INFINITY;
+			break;
+		}
+
+		for (size_t j = 0; j < textPositions.size(); j++)
+		{
+			difference = fmaxf(difference, fabsf(textPositions[j].x - compiledPositions[j].x));
+			difference = fmaxf(difference, fabsf(textPositions[j].y - compiledPositions[j].y));
+			difference = fmaxf(difference, fabsf(textPositions[j].z - compiledPositions[j].z));
+		}
+	}
+
+	sprintf_s(line, "Load reference %8.2f ms  tokenized %8.2f ms  %6.1fx faster  same data %s",
+		referenceMilliseconds, textMilliseconds, (textMilliseconds > 0.0f) ? referenceMilliseconds / textMilliseconds : 0.0f,
+		(!referenceData.empty() && referenceData == textData) ? "yes" : "no");
+	Report(line);
+
+	// The parsing was meant to be ten times faster than the streams. Both parsers still work out the normals, skin
+	// slots and model space frames of what they read, which takes a good part of the tokenized time.
+	float parseSpeedup = (parseMilliseconds > 0.0f) ? referenceParseMilliseconds / parseMilliseconds : 0.0f;
+	sprintf_s(line, "Load parse reference %8.2f ms  tokenized %8.2f ms  %6.1fx faster  10x target %s",
+		referenceParseMilliseconds, parseMilliseconds, parseSpeedup, (parseSpeedup >= 10.0f) ? "met" : "not met");
+	Report(line);
+
+	sprintf_s(line, "Load text %8.2f ms  compiled %8.2f ms  %6.1fx faster  largest difference %g",
+		textMilliseconds, compiledMilliseconds, (compiledMilliseconds > 0.0f) ? textMilliseconds / compiledMilliseconds : 0.0f, difference);
+	Report(line);
+}
+
+void SkeletonBenchmark::RunCompressionBenchmark(Skeleton* skeleton)
+{
+	bool oldCompressed = skeleton->GetCompressedAnimation();
+	Timer timer;
+	char line[256];
+
+	int joints = skeleton->GetJointCount();
+	int animationSize = skeleton->GetAnimationSize();
+	int compressedSize = skeleton->GetCompressedAnimationSize();
+
+	if (compressedSize == 0)
+	{
+		Report("Compression has no compressed animation to sample");
+		return;
+	}
+
+	// How far the compressed pose strays at the skinned vertices. It is checked on the frames, since between them the
+	// frames are blended in model space and the compressed clip in the space of each parent, which bends rather than
+	// shortens the limbs that turn quickly.
+	std::vector<XMFLOAT3> framePositions, frameNormals, compressedPositions, compressedNormals;
+	float vertexError = 0.0f;
+
+	for (int i = 0; i < skeleton->GetFrameCount(); i++)
+	{
+		skeleton->SetCompressedAnimation(false);
+		skeleton->Pose(i * skeleton->GetFrameTime());
+		skeleton->Skin(SkinningMode_Weights);
+		skeleton->GetSkinnedVertices(framePositions, frameNormals);
+
+		skeleton->SetCompressedAnimation(true);
+		skeleton->Pose(i * skeleton->GetFrameTime());
+		skeleton->Skin(SkinningMode_Weights);
+		skeleton->GetSkinnedVertices(compressedPositions, compressedNormals);
+
+		for (size_t j = 0; j < framePositions.size(); j++)
+		{
+			vertexError = fmaxf(vertexError, fabsf(framePositions[j].x - compressedPositions[j].x));
+			vertexError = fmaxf(vertexError, fabsf(framePositions[j].y - compressedPositions[j].y));
+			vertexError = fmaxf(vertexError, fabsf(framePositions[j].z - compressedPositions[j].z));
+		}
+	}
+
+	// Posing builds the joint matrices as well, which costs the same either way, so the difference is the decode
+	float milliseconds[2];
+	for (int i = 0; i < 2; i++)
+	{
+		skeleton->SetCompressedAnimation(i == 1);
+
+		timer.StartTimer();
+		for (int j = 0; j < DECODES; j++)
+		{
+			skeleton->Pose(j * 0.0137f);
+		}
+		timer.StopTimer();
+
+		milliseconds[i] = timer.GetTimingMilliseconds();
+	}
+
+	skeleton->SetCompressedAnimation(oldCompressed);
+
+	float frameNanoseconds = (milliseconds[0] * 1000000.0f) / (DECODES * joints);
+	float compressedNanoseconds = (milliseconds[1] * 1000000.0f) / (DECODES * joints);
+
+	sprintf_s(line, "Compression frames %8d bytes  compressed %8d bytes  %6.1fx smaller  %d keys  largest vertex error %g",
+		animationSize, compressedSize, (float)animationSize / compressedSize, skeleton->GetCompressedKeyCount(), vertexError);
+	Report(line);
+
+	sprintf_s(line, "Compression pose per joint %6.1f ns from the frames  %6.1f ns compressed", frameNanoseconds, compressedNanoseconds);
+	Report(line);
+}
+
+void SkeletonBenchmark::RunBlendBenchmark(Skeleton* source)
+{
+	const float frameTime = 0.016f;
+
+	// The clips and the mask are added to a skeleton of the benchmark's own, so the one passed in keeps only its clip
+	Skeleton local;
+	Skeleton* skeleton = &local;
+	std::vector<XMFLOAT4> expected, blended;
+	Timer timer;
+	char line[256];
+
+	if (source->GetCompressedAnimationSize() == 0 || !source->GetCompressedAnimation())
+	{
+		Report("Blend has no compressed clips to blend");
+		return;
+	}
+
+	if (!skeleton->LoadText(source->GetMeshFileName(), source->GetAnimFileName()))
+	{
+		Report("Blend could not load the skeleton");
+		return;
+	}
+
+	skeleton->CompressAnimation(source->GetPositionTolerance(), source->GetRotationTolerance());
+
+	// The model comes with one animation, so the clips blended are copies of it, which cost just as much to blend
+	while (skeleton->GetAnimationCount() < BLEND_CLIPS)
+	{
+		if (skeleton->AddAnimation(skeleton->GetAnimFileName()) < 0)
+		{
+			Report("Blend could not load the clips to blend");
+			return;
+		}
+	}
+
+	// A clip at full weight on its own poses just as Pose does, a fade into the same clip at the same time stays on
+	// the clip, and an additive clip at its first frame adds nothing
+	float timeOnly = 0.7f;
+	skeleton->Pose(timeOnly);
+	GetJointMatrixRows(skeleton, expected);
+
+	Skeleton::AnimationLayer base = { 0, timeOnly, 1.0f, AnimationBlend_Override, -1 };
+	Skeleton::AnimationLayer fade = { 0, timeOnly, 0.4f, AnimationBlend_Override, -1 };
+	Skeleton::AnimationLayer additive = { 0, 0.0f, 1.0f, AnimationBlend_Additive, -1 };
+	Skeleton::AnimationLayer empty = { -1, 0.0f, 0.0f, AnimationBlend_Override, -1 };
+	float differences[3];
+
+	skeleton->ResetLayers();
+	skeleton->SetLayer(0, base);
+	skeleton->PoseLayers();
+	GetJointMatrixRows(skeleton, blended);
+	differences[0] = GetJointMatrixDifference(expected, blended);
+
+	skeleton->SetLayer(1, fade);
+	skeleton->PoseLayers();
+	GetJointMatrixRows(skeleton, blended);
+	differences[1] = GetJointMatrixDifference(expected, blended);
+
+	skeleton->SetLayer(1, empty);
+	skeleton->SetLayer(2, additive);
+	skeleton->PoseLayers();
+	GetJointMatrixRows(skeleton, blended);
+	differences[2] = GetJointMatrixDifference(expected, blended);
+
+	sprintf_s(line, "Blend checks: one layer %g  fade into itself %g  additive first frame %g", differences[0], differences[1], differences[2]);
+	Report(line);
+
+	// Every character cross-fades between two clips, adds a third, and plays a fourth on its upper body, each at a time
+	// of its own, the way a crowd of the same skeleton would be posed
+	int upperBody = skeleton->AddJointMask(L"Bip01 Spine1");
+	int allocations = 0;
+
+	timer.StartTimer();
+	for (int frame = 0; frame < BLEND_FRAMES; frame++)
+	{
+		AllocationCounter::Start();
+		for (int character = 0; character < BLEND_CHARACTERS; character++)
+		{
+			float time = (frame * frameTime) + (character * 0.037f);
+			Skeleton::AnimationLayer layers[BLEND_CLIPS] =
+			{
+				{ 0, fmodf(time, skeleton->GetAnimationLength(0)), 1.0f, AnimationBlend_Override, -1 },
+				{ 1, fmodf(time * 1.3f, skeleton->GetAnimationLength(1)), 0.5f + (0.5f * sinf(time)), AnimationBlend_Override, -1 },
+				{ 2, fmodf(time * 0.7f, skeleton->GetAnimationLength(2)), 0.5f, AnimationBlend_Additive, -1 },
+				{ 3, fmodf(time * 1.1f, skeleton->GetAnimationLength(3)), 1.0f, AnimationBlend_Override, upperBody },
+			};
+
+			for (int i = 0; i < BLEND_CLIPS; i++)
+			{
+				skeleton->SetLayer(i, layers[i]);
+			}
+			skeleton->PoseLayers();
+		}
+		allocations += AllocationCounter::Stop();
+	}
+	timer.StopTimer();
+
+	float milliseconds = timer.GetTimingMilliseconds() / BLEND_FRAMES;
+	char allocationText[64];
+
+	FormatAllocations(AllocationCounter::IsEnabled() ? allocations : -1, allocationText);
+	sprintf_s(line, "Blend %d clips for %d characters %8.3f ms per frame  %6.2f us per character  %s the 1 ms budget  %s",
+		BLEND_CLIPS, BLEND_CHARACTERS, milliseconds, (milliseconds * 1000.0f) / BLEND_CHARACTERS, (milliseconds <= 1.0f) ? "within" : "over",
+		allocationText);
+	Report(line);
+
+	// Fade from one state to another and see the new clip left on its own once the fade is over
+	AnimationStateMachine stateMachine;
+	stateMachine.Initialize(skeleton->GetLayers());
+	skeleton->ResetLayers();
+
+	int idle = stateMachine.AddState(0);
+	int walk = stateMachine.AddState(1);
+	stateMachine.AddTransition(idle, walk, 0.25f);
+	stateMachine.SetState(idle);
+	stateMachine.SetState(walk);
+
+	int updates = 0;
+	while (stateMachine.IsFading() && updates < 1000)
+	{
+		stateMachine.Update(frameTime);
+		skeleton->AdvanceLayers(frameTime);
+		skeleton->PoseLayers();
+		updates++;
+	}
+
+	sprintf_s(line, "Blend state machine faded in %d updates, leaving clip %d on its own", updates,
+		(skeleton->GetLayer(1).Clip < 0) ? skeleton->GetLayer(0).Clip : -1);
+	Report(line);
+}
+
+void SkeletonBenchmark::RunInstanceBenchmark(ID3D11Device* device, ID3D11DeviceContext* context, Skeleton* skeleton)
+{
+	const SkinningMode modes[] = { SkinningMode_Weights, SkinningMode_Shader };
+	const char* names[] = { "Weights", "Shader" };
+	const int modeCount = sizeof(modes) / sizeof(modes[0]);
+	const int instanceCounts[] = { 1, 10, 100, 1000 };
+	const int countCount = sizeof(instanceCounts) / sizeof(instanceCounts[0]);
+	const float frameTime = 0.016f;
+
+	SkinningMode oldMode = skeleton->GetSkinningMode();
+	Skeleton::AnimationLayer oldLayers[Skeleton::MAX_ANIMATION_LAYERS];
+	std::vector<XMFLOAT3> expectedPositions, expectedNormals, positions, normals;
+	std::vector<SkeletonInstance*> instances;
+	JobSystem jobSystem;
+	Timer timer;
+	char line[256];
+
+	for (int i = 0; i < Skeleton::MAX_ANIMATION_LAYERS; i++)
+	{
+		oldLayers[i] = skeleton->GetLayer(i);
+	}
+
+	// An instance playing the first clip alongside the skeleton has to skin to the same mesh
+	SkeletonInstance check;
+	check.Initialize(device, skeleton);
+	skeleton->SetSkinningMode(SkinningMode_Weights);
+	skeleton->ResetLayers();
+	skeleton->Update(context, 0.5f);
+	check.Update(context, 0.5f);
+	skeleton->GetSkinnedVertices(expectedPositions, expectedNormals);
+	check.GetSkinnedVertices(positions, normals);
+
+	float difference = 0.0f;
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		difference = fmaxf(difference, fabsf(positions[i].x - expectedPositions[i].x));
+		difference = fmaxf(difference, fabsf(positions[i].y - expectedPositions[i].y));
+		difference = fmaxf(difference, fabsf(positions[i].z - expectedPositions[i].z));
+	}
+
+	int instanceSize = check.GetMemorySize();
+
+	sprintf_s(line, "Instances share %d bytes of model and clips, and each adds %d bytes on the CPU and %d bytes of vertex buffers  largest difference from the skeleton %g",
+		skeleton->GetSharedSize(), instanceSize, skeleton->GetVertexCount() * skeleton->GetVertexStride(), difference);
+	Report(line);
+	check.Destroy();
+
+	jobSystem.Initialize(-1);
+
+	for (int i = 0; i < modeCount; i++)
+	{
+		skeleton->SetSkinningMode(modes[i]);
+
+		for (int j = 0; j < countCount; j++)
+		{
+			// Spread the instances through the clip, so they do not all pose the same frame
+			while ((int)instances.size() < instanceCounts[j])
+			{
+				SkeletonInstance* instance = new SkeletonInstance;
+				instance->Initialize(device, skeleton);
+
+				Skeleton::AnimationLayer layer = instance->GetLayer(0);
+				layer.Time = fmodf(instances.size() * 0.037f, skeleton->GetAnimationLength(0));
+				instance->SetLayer(0, layer);
+
+				instances.push_back(instance);
+			}
+
+			timer.StartTimer();
+			for (int frame = 0; frame < INSTANCE_FRAMES; frame++)
+			{
+				for (size_t k = 0; k < instances.size(); k++)
+				{
+					instances[k]->Update(context, frameTime);
+				}
+			}
+			timer.StopTimer();
+
+			float serialMilliseconds = timer.GetTimingMilliseconds() / INSTANCE_FRAMES;
+
+			timer.StartTimer();
+			for (int frame = 0; frame < INSTANCE_FRAMES; frame++)
+			{
+				SkeletonInstance::UpdateInstances(&jobSystem, context, instances, frameTime);
+			}
+			timer.StopTimer();
+
+			float milliseconds = timer.GetTimingMilliseconds() / INSTANCE_FRAMES;
+
+			sprintf_s(line, "Instances %-8s %5d  %8.3f ms per frame on one thread  %8.3f ms on %d threads  %6.2f us per instance  %5.2fx  %8.1f KB of instances",
+				names[i], instanceCounts[j], serialMilliseconds, milliseconds, jobSystem.GetThreadCount() + 1, (milliseconds * 1000.0f) / instanceCounts[j],
+				(milliseconds > 0.0f) ? serialMilliseconds / milliseconds : 0.0f, (instanceCounts[j] * instanceSize) / 1024.0f);
+			Report(line);
+		}
+
+		for (size_t j = 0; j < instances.size(); j++)
+		{
+			instances[j]->Destroy();
+			delete instances[j];
+		}
+		instances.clear();
+	}
+
+	jobSystem.Destroy();
+
+	skeleton->SetSkinningMode(oldMode);
+	for (int i = 0; i < Skeleton::MAX_ANIMATION_LAYERS; i++)
+	{
+		skeleton->SetLayer(i, oldLayers[i]);
+	}
+}
+
+void SkeletonBenchmark::RunLodBenchmark(ID3D11Device* device, ID3D11DeviceContext* context, Skeleton* skeleton)
+{
+	const SkinningMode modes[] = { SkinningMode_Weights, SkinningMode_Shader };
+	const char* names[] = { "Weights", "Shader" };
+	const int modeCount = sizeof(modes) / sizeof(modes[0]);
+	const char* lodNames[AnimationLod_Count] = { "Full", "Half", "Quarter", "Cached" };
+	const float frameTime = 0.016f;
+
+	SkinningMode oldMode = skeleton->GetSkinningMode();
+	std::vector<SkeletonInstance*> instances, references;
+	JobSystem jobSystem;
+	Timer timer;
+	char line[256];
+
+	if (!skeleton->CacheFrames(device))
+	{
+		Report("Lod could not cache the frames");
+		return;
+	}
+
+	jobSystem.Initialize(-1);
+
+	// The first few instances are checked against instances at full detail playing the same times
+	for (int i = 0; i < LOD_INSTANCES + LOD_CHECKS; i++)
+	{
+		SkeletonInstance* instance = new SkeletonInstance;
+		instance->Initialize(device, skeleton);
+
+		if (i < LOD_INSTANCES)
+		{
+			instances.push_back(instance);
+		}
+		else
+		{
+			references.push_back(instance);
+		}
+	}
+
+	for (int i = 0; i < modeCount; i++)
+	{
+		skeleton->SetSkinningMode(modes[i]);
+
+		for (int lod = 0; lod < AnimationLod_Count; lod++)
+		{
+			for (int j = 0; j < LOD_INSTANCES; j++)
+			{
+				Skeleton::AnimationLayer layer = instances[j]->GetLayer(0);
+				layer.Time = fmodf(j * 0.037f, skeleton->GetAnimationLength(0));
+				instances[j]->SetLayer(0, layer);
+				instances[j]->SetLod((AnimationLod)lod);
+
+				if (j < LOD_CHECKS)
+				{
+					references[j]->SetLayer(0, layer);
+				}
+			}
+
+			// Every instance takes its turn at posing over the frames timed, and only the instances are timed
+			float milliseconds = 0.0f, difference = 0.0f;
+
+			for (int frame = 0; frame < LOD_FRAMES; frame++)
+			{
+				timer.StartTimer();
+				SkeletonInstance::UpdateInstances(&jobSystem, context, instances, frameTime);
+				timer.StopTimer();
+
+				milliseconds += timer.GetTimingMilliseconds() / LOD_FRAMES;
+
+				SkeletonInstance::UpdateInstances(&jobSystem, context, references, frameTime);
+
+				for (int j = 0; j < LOD_CHECKS; j++)
+				{
+					const XMFLOAT4* rows = instances[j]->GetJointMatrixRows();
+					const XMFLOAT4* expected = references[j]->GetJointMatrixRows();
+
+					for (int k = 0; k < skeleton->GetJointCount() * 3; k++)
+					{
+						difference = fmaxf(difference, fabsf(rows[k].x - expected[k].x) + fabsf(rows[k].y - expected[k].y) + fabsf(rows[k].z - expected[k].z) +
+							fabsf(rows[k].w - expected[k].w));
+					}
+				}
+			}
+
+			sprintf_s(line, "Lod %-8s %-8s %d instances  %8.3f ms per frame  %6.2f us per instance  largest joint matrix difference from full detail %g",
+				names[i], lodNames[lod], LOD_INSTANCES, milliseconds, (milliseconds * 1000.0f) / LOD_INSTANCES, difference);
+			Report(line);
+		}
+	}
+
+	// Stand the instances in a line going away from a camera with a 45 degree field of view, and see where each
+	// level of detail starts
+	int lodCounts[AnimationLod_Count] = { 0 };
+	float lodDistances[AnimationLod_Count] = { 0.0f };
+	XMFLOAT3 cameraPosition(0.0f, 0.0f, 0.0f);
+	float projectionScale = 1.0f / tanf(XM_PIDIV4 * 0.5f);
+
+	for (int i = 0; i < LOD_INSTANCES; i++)
+	{
+		float distance = 10.0f * (i + 1);
+		instances[i]->GetTransform()->SetPosition(0.0f, 0.0f, distance);
+		instances[i]->SelectLod(cameraPosition, projectionScale);
+
+		int lod = instances[i]->GetLod();
+		if (lodCounts[lod]++ == 0)
+		{
+			lodDistances[lod] = distance;
+		}
+	}
+
+	sprintf_s(line, "Lod over %d to %d units  Full %d  Half %d from %.0f  Quarter %d from %.0f  Cached %d from %.0f", 10, 10 * LOD_INSTANCES,
+		lodCounts[AnimationLod_Full], lodCounts[AnimationLod_Half], lodDistances[AnimationLod_Half], lodCounts[AnimationLod_Quarter],
+		lodDistances[AnimationLod_Quarter], lodCounts[AnimationLod_Cached], lodDistances[AnimationLod_Cached]);
+	Report(line);
+
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		instances[i]->Destroy();
+		delete instances[i];
+	}
+	for (size_t i = 0; i < references.size(); i++)
+	{
+		references[i]->Destroy();
+		delete references[i];
+	}
+	jobSystem.Destroy();
+
+	skeleton->DestroyCachedFrames();
+	skeleton->SetSkinningMode(oldMode);
+}
+
+void SkeletonBenchmark::GetJointMatrixRows(Skeleton* skeleton, std::vector<XMFLOAT4>& rows)
+{
+	const XMFLOAT4* first = skeleton->GetJointMatrixRows();
+
+	rows.assign(first, first + (skeleton->GetJointCount() * 3));
+}
+
+float SkeletonBenchmark::GetJointMatrixDifference(const std::vector<XMFLOAT4>& first, const std::vector<XMFLOAT4>& second)
+{
+	float difference = 0.0f;
+
+	for (size_t i = 0; i < first.size(); i++)
+	{
+		difference = fmaxf(difference, fabsf(first[i].x - second[i].x));
+		difference = fmaxf(difference, fabsf(first[i].y - second[i].y));
+		difference = fmaxf(difference, fabsf(first[i].z - second[i].z));
+		difference = fmaxf(difference, fabsf(first[i].w - second[i].w));
+	}
+
+	return difference;
+}
+
+void SkeletonBenchmark::Report(const char* line)
+{
+	OutputDebugStringA(line);
+	OutputDebugStringA("\n");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "AllocationCounter.h"
+#include "AnimationStateMachine.h"
+#include "Skeleton.h"
+#include "SkeletonInstance.h"
+#include "Timer.h"
+
+// Times the skeletal animation code paths and writes the results to the debugger output window
+class SkeletonBenchmark
+{
+public:
+	static void Run(ID3D11Device* device, ID3D11DeviceContext* context, Skeleton* skeleton);
+
+private:
+	static void RunSkinningBenchmark(Skeleton* skeleton);
+	static void RunAllocationBenchmark(ID3D11DeviceContext* context, Skeleton* skeleton);
+	static void RunLoadBenchmark(Skeleton* skeleton);
+	static void RunCompressionBenchmark(Skeleton* skeleton);
+	static void RunBlendBenchmark(Skeleton* source);
+	static void RunInstanceBenchmark(ID3D11Device* device, ID3D11DeviceContext* context, Skeleton* skeleton);
+	static void RunLodBenchmark(ID3D11Device* device, ID3D11DeviceContext* context, Skeleton* skeleton);
+
+	static float GetJointMatrixDifference(const std::vector<XMFLOAT4>& first, const std::vector<XMFLOAT4>& second);
+	static void GetJointMatrixRows(Skeleton* skeleton, std::vector<XMFLOAT4>& rows);
+
+	static void Report(const char* line);
+
+	static const int ITERATIONS = 200;
+	static const int POSES = 16;
+	static const int LOADS = 5;
+	static const int DECODES = 2000;
+	static const int BLEND_CLIPS = 4;
+	static const int BLEND_CHARACTERS = 100;
+	static const int BLEND_FRAMES = 100;
+	static const int INSTANCE_FRAMES = 10;
+	static const int LOD_INSTANCES = 1000;
+	static const int LOD_CHECKS = 20;
+	static const int LOD_FRAMES = 40;
+};
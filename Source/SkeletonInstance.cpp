@@ -0,0 +1,230 @@
+#include "SkeletonInstance.h"
+
+// The fraction of the height of the screen an instance has to cover to be animated at each level of detail, dropping
+// to the next level below it
+static const float LOD_SCREEN_SIZES[AnimationLod_Cached] = { 0.3f, 0.15f, 0.08f };
+
+// The frames from one pose to the next at each level, and the levels of joints at the ends of the chains left out
+static const int LOD_POSE_INTERVALS[AnimationLod_Count] = { 1, 2, 4, 4 };
+static const int LOD_LEAF_LEVELS[AnimationLod_Count] = { 0, 1, 2, 2 };
+
+// Each instance poses on the frame after the one before it, so a crowd spreads its poses evenly over the frames
+static int NextLodPhase = 0;
+
+SkeletonInstance::SkeletonInstance()
+{
+	_skeleton = 0;
+	_lod = AnimationLod_Full;
+	_lodFrame = 0;
+	_lodPhase = 0;
+	_posed = false;
+	_posedFrame = false;
+	_skinned = false;
+	_extrapolating = false;
+	_frustum = 0;
+	_visible = true;
+	_poseInterval = 0.0f;
+	_sincePose = 0.0f;
+
+	_transform.SetScale(1.0f, 1.0f, 1.0f);
+}
+
+SkeletonInstance::~SkeletonInstance()
+{
+}
+
+bool SkeletonInstance::Initialize(ID3D11Device* device, const Skeleton* skeleton)
+{
+	_skeleton = skeleton;
+	_lodPhase = NextLodPhase++;
+	_previousMatrices.resize(_skeleton->GetJointCount());
+	_extrapolatedMatrices.resize(_skeleton->GetJointCount());
+
+	return _skeleton->CreateInstance(device, _state);
+}
+
+void SkeletonInstance::Destroy()
+{
+	if (_skeleton)
+	{
+		_skeleton->DestroyInstance(_state);
+	}
+}
+
+void SkeletonInstance::Animate(float deltaTime)
+{
+	bool shader = (_skeleton->GetSkinningMode() == SkinningMode_Shader);
+
+	_skeleton->AdvanceLayers(_state, deltaTime);
+	_sincePose += deltaTime;
+	_posedFrame = false;
+	_skinned = false;
+	_extrapolating = false;
+
+	// Nothing of an instance out of view is drawn, and the poses it had before it left are too old to carry on from
+	_visible = !_frustum || _skeleton->IsVisible(_frustum, _state, &_transform);
+	if (!_visible)
+	{
+		_state.CachedFrame = -1;
+		_posed = false;
+		return;
+	}
+
+	// The most distant instances only look up the frame they are on
+	_state.CachedFrame = (_lod == AnimationLod_Cached) ? _skeleton->GetCachedFrame(_state.Layers[0].Clip, _state.Layers[0].Time) : -1;
+	if (_state.CachedFrame >= 0)
+	{
+		return;
+	}
+
+	// Between its poses the instance carries on the way its last two poses were going, or keeps the mesh it has
+	if (_posed && ((_lodFrame++ + _lodPhase) % LOD_POSE_INTERVALS[_lod]) != 0)
+	{
+		if (shader)
+		{
+			ExtrapolateJointMatrices();
+			_extrapolating = true;
+		}
+		return;
+	}
+
+	// The sizes match, so this copies into the array already there. There is nothing to extrapolate from until the
+	// level has posed twice.
+	_previousMatrices = _state.PaletteMatrices;
+	_poseInterval = _posed ? _sincePose : 0.0f;
+	_sincePose = 0.0f;
+	_posed = true;
+	_posedFrame = true;
+
+	_state.LeafLevels = LOD_LEAF_LEVELS[_lod];
+	_skeleton->PoseLayers(_state);
+
+	// The shader skins the static bind pose vertices from the joint matrices, so there is nothing more to do
+	if (!shader)
+	{
+		_skeleton->Skin(_state, _skeleton->GetSkinningMode());
+		_skinned = true;
+	}
+}
+
+void SkeletonInstance::Upload(ID3D11DeviceContext* context)
+{
+	if (_skinned)
+	{
+		_skeleton->UploadInstance(context, _state);
+	}
+}
+
+void SkeletonInstance::ExtrapolateJointMatrices()
+{
+	XMVECTOR scale = XMVectorReplicate((_poseInterval > 0.0f) ? _sincePose / _poseInterval : 0.0f);
+
+	for (size_t i = 0; i < _extrapolatedMatrices.size(); i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			XMVECTOR current = XMLoadFloat4(&_state.PaletteMatrices[i].Rows[j]);
+			XMVECTOR previous = XMLoadFloat4(&_previousMatrices[i].Rows[j]);
+
+			XMStoreFloat4(&_extrapolatedMatrices[i].Rows[j], XMVectorMultiplyAdd(XMVectorSubtract(current, previous), scale, current));
+		}
+	}
+}
+
+void SkeletonInstance::SelectLod(const XMFLOAT3& cameraPosition, float projectionScale)
+{
+	XMFLOAT3 position, scale;
+	_transform.GetPosition(position);
+	_transform.GetScale(scale);
+
+	float x = position.x - cameraPosition.x;
+	float y = position.y - cameraPosition.y;
+	float z = position.z - cameraPosition.z;
+	float distance = sqrtf((x * x) + (y * y) + (z * z));
+	float radius = _skeleton->GetBoundingRadius() * fmaxf(scale.x, fmaxf(scale.y, scale.z));
+
+	// A camera inside the bounds sees the instance fill the screen
+	float screenSize = (distance > radius) ? (radius * projectionScale) / distance : 1.0f;
+	AnimationLod lod = AnimationLod_Cached;
+
+	for (int i = 0; i < AnimationLod_Cached; i++)
+	{
+		if (screenSize >= LOD_SCREEN_SIZES[i])
+		{
+			lod = (AnimationLod)i;
+			break;
+		}
+	}
+
+	SetLod(lod);
+}
+
+void SkeletonInstance::SetLod(AnimationLod lod)
+{
+	// Start the new level with a pose, so nothing is carried over from the poses of the last one
+	if (lod != _lod)
+	{
+		_lod = lod;
+		_posed = false;
+	}
+}
+
+const XMFLOAT4* SkeletonInstance::GetJointMatrixRows() const
+{
+	if (_state.CachedFrame >= 0)
+	{
+		return _skeleton->GetCachedJointMatrixRows(_state.CachedFrame);
+	}
+
+	return _extrapolating ? &_extrapolatedMatrices[0].Rows[0] : &_state.PaletteMatrices[0].Rows[0];
+}
+
+void SkeletonInstance::Update(ID3D11DeviceContext* context, float deltaTime)
+{
+	Animate(deltaTime);
+	Upload(context);
+}
+
+void SkeletonInstance::DrawSubset(ID3D11DeviceContext* deviceContext, int index)
+{
+	_skeleton->DrawSubset(deviceContext, _state, index);
+}
+
+void SkeletonInstance::UpdateInstances(JobSystem* jobSystem, ID3D11DeviceContext* context, const std::vector<SkeletonInstance*>& instances, float deltaTime)
+{
+	int count = (int)instances.size();
+	int jobCount = (jobSystem->GetThreadCount() + 1) * JOBS_PER_THREAD;
+	int perJob = (count + jobCount - 1) / jobCount;
+
+	// The instances share nothing they write, so each job animates a run of them without locking
+	for (int first = 0; first < count; first += perJob)
+	{
+		int last = (first + perJob < count) ? first + perJob : count;
+
+		jobSystem->Submit([&instances, first, last, deltaTime]()
+		{
+			for (int i = first; i < last; i++)
+			{
+				instances[i]->Animate(deltaTime);
+			}
+		});
+	}
+	jobSystem->Wait();
+
+	// The device context is only used from the thread that owns it
+	for (int i = 0; i < count; i++)
+	{
+		instances[i]->Upload(context);
+	}
+}
+
+void SkeletonInstance::GetSkinnedVertices(std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT3>& normals) const
+{
+	_skeleton->GetSkinnedVertices(_state, positions, normals);
+}
+
+int SkeletonInstance::GetMemorySize() const
+{
+	return (int)(sizeof(SkeletonInstance) + ((_previousMatrices.capacity() + _extrapolatedMatrices.capacity()) * sizeof(Skeleton::JointMatrix))) +
+		_skeleton->GetInstanceSize(_state);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "Skeleton.h"
+#include "Transform.h"
+
+#include <vector>
+
+// How much of its animation an instance plays, picked by how much of the screen it covers
+enum AnimationLod
+{
+	AnimationLod_Full = 0,	// Every joint posed and skinned every frame
+	AnimationLod_Half,		// Posed and skinned every second frame without the joints at the ends of the chains, such as the fingers
+	AnimationLod_Quarter,	// Posed and skinned every fourth frame without the last two levels of joints
+	AnimationLod_Cached,	// Not posed at all, drawing the cached frame of its first layer nearest its time
+	AnimationLod_Count,
+};
+
+// One character of a crowd sharing a skeleton. The instance holds only where it stands, the clips it plays and the
+// pose and skinned mesh they make, reading the model and clips from the skeleton, which has to outlive it.
+class SkeletonInstance
+{
+public:
+	SkeletonInstance();
+	~SkeletonInstance();
+
+	bool Initialize(ID3D11Device* device, const Skeleton* skeleton);
+	void Destroy();
+
+	// Moves the clips on and poses the instance, skinning it on the CPU unless the skeleton leaves that to the shader.
+	// This only reads the skeleton, so instances of the same skeleton animate on different threads at once. An
+	// instance outside the frustum only moves its clips on, and poses afresh once it is back in view.
+	void Animate(float deltaTime);
+
+	// Fills the vertex buffers with the mesh skinned on the CPU, on the thread of the device context
+	void Upload(ID3D11DeviceContext* context);
+
+	void Update(ID3D11DeviceContext* context, float deltaTime);
+	void DrawSubset(ID3D11DeviceContext* deviceContext, int index);
+
+	// Animates the instances across the workers of the job system, a run of them to each job, and uploads them once
+	// every job has finished
+	static void UpdateInstances(JobSystem* jobSystem, ID3D11DeviceContext* context, const std::vector<SkeletonInstance*>& instances, float deltaTime);
+
+	// Picks the level of detail from the fraction of the height of the screen the instance covers, its bounding
+	// radius scaled by the second diagonal element of the projection matrix over its distance from the camera. The
+	// instances posed less often than every frame pose on different frames from one another, and in between they
+	// extrapolate the joint matrices of their last two poses for the shader, or draw the mesh they skinned last. The
+	// cached level falls back to the quarter rate for clips the skeleton has no cached frames of.
+	void SelectLod(const XMFLOAT3& cameraPosition, float projectionScale);
+	void SetLod(AnimationLod lod);
+	AnimationLod GetLod() const { return _lod; }
+
+	// The frustum the instance is culled against each time it is animated, once its clips have moved on, checking the
+	// box around the frame they are now on. An instance out of view skips posing, skinning and uploading, and the draw
+	// skips it. The frustum is only read, so instances are culled against it on different threads at once, and with
+	// none the instance is always in view.
+	void SetFrustum(Frustum* frustum) { _frustum = frustum; }
+	bool IsVisible() const { return _visible; }
+
+	// Whether the last update posed the instance, and skinned it on the CPU, rather than skipping or extrapolating
+	bool WasPosed() const { return _posedFrame; }
+	bool WasSkinned() const { return _skinned; }
+
+	Transform* GetTransform() { return &_transform; }
+	const Skeleton* GetSkeleton() const { return _skeleton; }
+
+	void SetLayer(int index, const Skeleton::AnimationLayer& layer) { _state.Layers[index] = layer; }
+	const Skeleton::AnimationLayer& GetLayer(int index) const { return _state.Layers[index]; }
+	Skeleton::AnimationLayer* GetLayers() { return _state.Layers; }
+
+	// The joint matrices the instance is drawn with, which are the cached or extrapolated ones between its poses
+	const XMFLOAT4* GetJointMatrixRows() const;
+	void GetSkinnedVertices(std::vector<XMFLOAT3>& positions, std::vector<XMFLOAT3>& normals) const;
+
+	// The bytes the instance takes on the CPU, all of it its own rather than shared with the other instances
+	int GetMemorySize() const;
+
+private:
+	void ExtrapolateJointMatrices();
+
+	// Jobs for each thread that runs them, so threads that finish their runs early take on more
+	static const int JOBS_PER_THREAD = 4;
+
+	const Skeleton*				_skeleton;
+	Transform					_transform;
+	Skeleton::InstanceState		_state;
+
+	// The level of detail, the frames animated at it and which of them it poses on, and whether it posed and skinned
+	// or is extrapolating this frame
+	AnimationLod				_lod;
+	int							_lodFrame;
+	int							_lodPhase;
+	bool						_posed;
+	bool						_posedFrame;
+	bool						_skinned;
+	bool						_extrapolating;
+
+	// The frustum to cull against, and whether the instance was inside it when it was last animated
+	Frustum*					_frustum;
+	bool						_visible;
+
+	// The joint matrices of the pose before the last, the time from it to the last pose and the time since, with the
+	// joint matrices extrapolated from them
+	std::vector<Skeleton::JointMatrix>	_previousMatrices;
+	std::vector<Skeleton::JointMatrix>	_extrapolatedMatrices;
+	float						_poseInterval;
+	float						_sincePose;
+};
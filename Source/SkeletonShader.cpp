@@ -1,27 +1,22 @@
 #include "SkeletonShader.h"
 
-SkeletonShader::SkeletonShader()
+SkeletonShader::SkeletonShader() : IShader()
 {
 	_sampleState = nullptr;
-	_lightBuffer = nullptr;
+	_jointBuffer = nullptr;
 }
 
 SkeletonShader::~SkeletonShader()
 {
 }
 
-// SHADER HAS 5 TEXTURES
-
 bool SkeletonShader::Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
-	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture0, ID3D11ShaderResourceView* texture1,
-	ID3D11ShaderResourceView* texture2, ID3D11ShaderResourceView* texture3, ID3D11ShaderResourceView* texture4,
-	XMFLOAT3 lightDirection, XMFLOAT4 diffuseColor)
+	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, const XMFLOAT4* jointRows, int jointCount)
 {
 	bool result;
 
 	// Set the shader parameters that it will use for rendering.
-	result = SetShaderParameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix, texture0, texture1, texture2, texture3, texture4,
-		lightDirection, diffuseColor);
+	result = SetShaderParameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix, texture, jointRows, jointCount);
 	if (!result)
 	{
 		return false;
@@ -39,11 +34,11 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 	ID3D10Blob* errorMessage;
 	ID3D10Blob* vertexShaderBuffer;
 	ID3D10Blob* pixelShaderBuffer;
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[4];
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[5];
 	unsigned int numElements;
 	D3D11_BUFFER_DESC matrixBufferDesc;
+	D3D11_BUFFER_DESC jointBufferDesc;
 	D3D11_SAMPLER_DESC samplerDesc;
-	D3D11_BUFFER_DESC lightBufferDesc;
 
 	// Initialize the pointers this function will use to null.
 	errorMessage = 0;
@@ -51,7 +46,7 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 	pixelShaderBuffer = 0;
 
 	// Compile the vertex shader code.
-	result = D3DCompileFromFile(vsFilename, NULL, NULL, "TerrainVertexShader", "vs_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
+	result = D3DCompileFromFile(vsFilename, NULL, NULL, "SkeletonVertexShader", "vs_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
 		&vertexShaderBuffer, &errorMessage);
 	if (FAILED(result))
 	{
@@ -70,7 +65,7 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 	}
 
 	// Compile the pixel shader code.
-	result = D3DCompileFromFile(psFilename, NULL, NULL, "TerrainPixelShader", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
+	result = D3DCompileFromFile(psFilename, NULL, NULL, "SkeletonPixelShader", "ps_5_0", D3D10_SHADER_ENABLE_STRICTNESS, 0,
 		&pixelShaderBuffer, &errorMessage);
 	if (FAILED(result))
 	{
@@ -103,6 +98,7 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 	}
 
 	// Create the vertex input layout description.
+	// This setup needs to match the SkinnedVertex stucture in the Skeleton and in the shader.
 	polygonLayout[0].SemanticName = "POSITION";
 	polygonLayout[0].SemanticIndex = 0;
 	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
@@ -127,14 +123,22 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 	polygonLayout[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[2].InstanceDataStepRate = 0;
 
-	polygonLayout[3].SemanticName = "TANGENT";
+	polygonLayout[3].SemanticName = "BLENDINDICES";
 	polygonLayout[3].SemanticIndex = 0;
-	polygonLayout[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	polygonLayout[3].Format = DXGI_FORMAT_R8G8B8A8_UINT;
 	polygonLayout[3].InputSlot = 0;
 	polygonLayout[3].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 	polygonLayout[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 	polygonLayout[3].InstanceDataStepRate = 0;
 
+	polygonLayout[4].SemanticName = "BLENDWEIGHT";
+	polygonLayout[4].SemanticIndex = 0;
+	polygonLayout[4].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	polygonLayout[4].InputSlot = 0;
+	polygonLayout[4].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+	polygonLayout[4].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	polygonLayout[4].InstanceDataStepRate = 0;
+
 	// Get a count of the elements in the layout.
 	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
 
@@ -168,11 +172,26 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 		return false;
 	}
 
+	// Setup the description of the dynamic joint constant buffer that is in the vertex shader.
+	jointBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	jointBufferDesc.ByteWidth = sizeof(JointBufferType);
+	jointBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	jointBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	jointBufferDesc.MiscFlags = 0;
+	jointBufferDesc.StructureByteStride = 0;
+
+	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
+	result = device->CreateBuffer(&jointBufferDesc, NULL, &_jointBuffer);
+	if (FAILED(result))
+	{
+		return false;
+	}
+
 	// Create a TargaTexture sampler state description.
 	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
 	samplerDesc.MipLODBias = 0.0f;
 	samplerDesc.MaxAnisotropy = 1;
 	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
@@ -190,33 +209,11 @@ bool SkeletonShader::InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vs
 		return false;
 	}
 
-	// Setup the description of the light dynamic constant buffer that is in the pixel shader.
-	lightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	lightBufferDesc.ByteWidth = sizeof(LightBufferType);
-	lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	lightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	lightBufferDesc.MiscFlags = 0;
-	lightBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the pixel shader constant buffer from within this class.
-	result = device->CreateBuffer(&lightBufferDesc, NULL, &_lightBuffer);
-	if (FAILED(result))
-	{
-		return false;
-	}
-
 	return true;
 }
 
 void SkeletonShader::DestroyShader()
 {
-	// Release the light constant buffer.
-	if (_lightBuffer)
-	{
-		_lightBuffer->Release();
-		_lightBuffer = 0;
-	}
-
 	// Release the sampler state.
 	if (_sampleState)
 	{
@@ -224,6 +221,13 @@ void SkeletonShader::DestroyShader()
 		_sampleState = 0;
 	}
 
+	// Release the joint constant buffer.
+	if (_jointBuffer)
+	{
+		_jointBuffer->Release();
+		_jointBuffer = 0;
+	}
+
 	// Release the matrix constant buffer.
 	if (_matrixBuffer)
 	{
@@ -255,34 +259,15 @@ void SkeletonShader::DestroyShader()
 	return;
 }
 
-void SkeletonShader::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount)
-{
-	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(_layout);
-
-	// Set the vertex and pixel shaders that will be used to render.
-	deviceContext->VSSetShader(_vertexShader, NULL, 0);
-	deviceContext->PSSetShader(_pixelShader, NULL, 0);
-
-	// Set the sampler state in the pixel shader.
-	deviceContext->PSSetSamplers(0, 1, &_sampleState);
-
-	// Render the polygon data.
-	deviceContext->DrawIndexed(indexCount, 0, 0);
-
-	return;
-}
-
 bool SkeletonShader::SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
-	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture0, ID3D11ShaderResourceView* texture1,
-	ID3D11ShaderResourceView* texture2, ID3D11ShaderResourceView* texture3, ID3D11ShaderResourceView* texture4,
-	XMFLOAT3 lightDirection, XMFLOAT4 diffuseColor)
+	XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, const XMFLOAT4* jointRows, int jointCount)
 {
 	HRESULT result;
 	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	MatrixBufferType* dataPtr;
+	JointBufferType* dataPtr2;
 	unsigned int bufferNumber;
-	LightBufferType* dataPtr2;
+
 
 	// Transpose the matrices to prepare them for the shader.
 	worldMatrix = XMMatrixTranspose(worldMatrix);
@@ -313,36 +298,50 @@ bool SkeletonShader::SetShaderParameters(ID3D11DeviceContext* deviceContext, XMM
 	// Finanly set the constant buffer in the vertex shader with the updated values.
 	deviceContext->VSSetConstantBuffers(bufferNumber, 1, &_matrixBuffer);
 
-	// Set shader TargaTexture resource in the pixel shader.
-	deviceContext->PSSetShaderResources(0, 1, &texture0);
-	deviceContext->PSSetShaderResources(1, 2, &texture1);
-	deviceContext->PSSetShaderResources(2, 3, &texture2);
-	deviceContext->PSSetShaderResources(3, 4, &texture3);
-	deviceContext->PSSetShaderResources(4, 5, &texture4);
-
-	// Lock the light constant buffer so it can be written to.
-	result = deviceContext->Map(_lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	// Lock the joint constant buffer so it can be written to.
+	result = deviceContext->Map(_jointBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 	if (FAILED(result))
 	{
 		return false;
 	}
 
-	// Get a pointer to the data in the light constant buffer.
-	dataPtr2 = (LightBufferType*)mappedResource.pData;
+	// Get a pointer to the data in the constant buffer.
+	dataPtr2 = (JointBufferType*)mappedResource.pData;
 
-	// Copy the lighting variables into the constant buffer.
-	dataPtr2->DiffuseColour = diffuseColor;
-	dataPtr2->LightDirection = lightDirection;
-	dataPtr2->Padding = 0.0f;
+	// Copy the rows of the joint matrices into the constant buffer, the shader only reading the joints the skeleton has.
+	if (jointCount > MAX_JOINTS)
+	{
+		jointCount = MAX_JOINTS;
+	}
+	memcpy(dataPtr2->Rows, jointRows, sizeof(XMFLOAT4) * 3 * jointCount);
 
-	// Unlock the light constant buffer.
-	deviceContext->Unmap(_lightBuffer, 0);
+	// Unlock the constant buffer.
+	deviceContext->Unmap(_jointBuffer, 0);
 
-	// Set the Position of the light constant buffer in the pixel shader.
-	bufferNumber = 0;
+	// Set the joint constant buffer after the matrices in the vertex shader.
+	bufferNumber = 1;
+	deviceContext->VSSetConstantBuffers(bufferNumber, 1, &_jointBuffer);
 
-	// Finally set the light constant buffer in the pixel shader with the updated values.
-	deviceContext->PSSetConstantBuffers(bufferNumber, 1, &_lightBuffer);
+	// Set shader TargaTexture resource in the pixel shader.
+	deviceContext->PSSetShaderResources(0, 1, &texture);
 
 	return true;
 }
+
+void SkeletonShader::RenderShader(ID3D11DeviceContext* deviceContext, int indexCount)
+{
+	// Set the vertex input layout.
+	deviceContext->IASetInputLayout(_layout);
+
+	// Set the vertex and pixel shaders that will be used to render this triangle.
+	deviceContext->VSSetShader(_vertexShader, NULL, 0);
+	deviceContext->PSSetShader(_pixelShader, NULL, 0);
+
+	// Set the sampler state in the pixel shader.
+	deviceContext->PSSetSamplers(0, 1, &_sampleState);
+
+	// Render the triangle.
+	deviceContext->DrawIndexed(indexCount, 0, 0);
+
+	return;
+}
@@ -1,37 +1,50 @@
 #pragma once
 
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <directxmath.h>
+#include <fstream>
+
 #include "IShader.h"
 
+using namespace DirectX;
+using namespace std;
+
+// Draws a skeleton by skinning the vertices of its bind pose in the vertex shader. Each vertex is blended from the
+// matrices of up to four joints, which are passed in with each draw as three rows for each joint.
 class SkeletonShader : public IShader
 {
 public:
-	struct LightBufferType
+	// The joints the shader has room for, as MAX_JOINTS in SkeletonVertexShader.hlsl. Everything else that depends on
+	// the limit reads it from here.
+	static const int MAX_JOINTS = 64;
+
+private:
+	struct JointBufferType
 	{
-		XMFLOAT4	DiffuseColour;
-		XMFLOAT3	LightDirection;
-		float		Padding;
+		XMFLOAT4 Rows[MAX_JOINTS * 3];
 	};
 
+	// The buffer has to match the jointRows array of the shaders cbuffer exactly, and fit in a constant buffer
+	static_assert(sizeof(JointBufferType) == MAX_JOINTS * 3 * 16, "JointBufferType does not match the jointRows cbuffer");
+	static_assert(sizeof(JointBufferType) <= D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16, "MAX_JOINTS is too many for a constant buffer");
+
+public:
 	SkeletonShader();
 	~SkeletonShader();
 
-	bool Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
-		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture0, ID3D11ShaderResourceView* texture1,
-		ID3D11ShaderResourceView* texture2, ID3D11ShaderResourceView* texture3, ID3D11ShaderResourceView* texture4,
-		XMFLOAT3 lightDirection, XMFLOAT4 diffuseColor);
+	bool Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix,
+		ID3D11ShaderResourceView* texture, const XMFLOAT4* jointRows, int jointCount);
 
 protected:
-	bool InitializeShader(ID3D11Device*, HWND, WCHAR*, WCHAR*) override;
+	bool InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename) override;
 	void DestroyShader() override;
-	void RenderShader(ID3D11DeviceContext*, int) override;
+	void RenderShader(ID3D11DeviceContext* deviceContext, int indexCount) override;
 
 private:
 	bool SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
-		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture0, ID3D11ShaderResourceView* texture1,
-		ID3D11ShaderResourceView* texture2, ID3D11ShaderResourceView* texture3, ID3D11ShaderResourceView* texture4,
-		XMFLOAT3 lightDirection, XMFLOAT4 diffuseColor);
+		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture, const XMFLOAT4* jointRows, int jointCount);
 
-	ID3D11SamplerState*		_sampleState;
-	ID3D11Buffer*			_lightBuffer;
+	ID3D11SamplerState*			_sampleState;
+	ID3D11Buffer*				_jointBuffer;
 };
-
@@ -0,0 +1,248 @@
+#include "SparseVoxelOctree.h"
+
+#include <string.h>
+
+// A mask of length bits starting at the given bit
+static inline SparseVoxelOctree::Column GetRunMask(int start, int length)
+{
+	const int bits = sizeof(SparseVoxelOctree::Column) * 8;
+	SparseVoxelOctree::Column run = (length >= bits) ? ~(SparseVoxelOctree::Column)0 : (((SparseVoxelOctree::Column)1 << length) - 1);
+
+	return run << start;
+}
+
+SparseVoxelOctree::SparseVoxelOctree()
+{
+	_root = LEAF_FLAG;
+	_size = 0;
+}
+
+void SparseVoxelOctree::Build(int size, const Column* columns, const unsigned char* blockTypes)
+{
+	_nodes.clear();
+	_size = size;
+	_root = BuildNode(0, 0, 0, size, columns, blockTypes);
+
+	// The tree is built once and then only read, so hold on to no more than it needs
+	_nodes.shrink_to_fit();
+}
+
+void SparseVoxelOctree::Clear()
+{
+	_nodes.clear();
+	_nodes.shrink_to_fit();
+	_root = LEAF_FLAG;
+}
+
+void SparseVoxelOctree::Decode(Column* columns, unsigned char* blockTypes) const
+{
+	DecodeNode(_root, 0, 0, 0, _size, columns, blockTypes);
+}
+
+unsigned char SparseVoxelOctree::GetValue(int x, int y, int z) const
+{
+	unsigned short slot = _root;
+	int half = _size;
+
+	while (!(slot & LEAF_FLAG))
+	{
+		half >>= 1;
+		slot = _nodes[(slot * 8) + GetChildIndex((x & half) != 0, (y & half) != 0, (z & half) != 0)];
+	}
+
+	return (unsigned char)(slot & ~LEAF_FLAG);
+}
+
+SparseVoxelOctree::Column SparseVoxelOctree::GetColumn(int x, int y) const
+{
+	Column column = 0;
+
+	CollectColumn(_root, 0, 0, 0, _size, x, y, column);
+
+	return column;
+}
+
+void SparseVoxelOctree::GetLayer(int axis, int coordinate, Column* layer) const
+{
+	const int origin[3] = { 0, 0, 0 };
+
+	memset(layer, 0, _size * sizeof(Column));
+
+	CollectLayer(_root, origin, _size, axis, coordinate, layer);
+}
+
+unsigned short SparseVoxelOctree::BuildNode(int x, int y, int z, int size, const Column* columns, const unsigned char* blockTypes)
+{
+	if (size == 1)
+	{
+		if (!((columns[(x * _size) + y] >> z) & 1))
+		{
+			return LEAF_FLAG;
+		}
+
+		int index = (((x * _size) + y) * _size) + z;
+		return (unsigned short)(LEAF_FLAG | (((blockTypes[index >> 1] >> ((index & 1) * 4)) & 0xF) + 1));
+	}
+
+	// Most of the air in a chunk can be found from the columns without looking at any children
+	Column run = GetRunMask(z, size);
+	bool empty = true;
+
+	for (int i = x; i < x + size && empty; i++)
+	{
+		for (int j = y; j < y + size; j++)
+		{
+			if (columns[(i * _size) + j] & run)
+			{
+				empty = false;
+				break;
+			}
+		}
+	}
+
+	if (empty)
+	{
+		return LEAF_FLAG;
+	}
+
+	int half = size / 2;
+	unsigned short children[8];
+	bool uniform = true;
+
+	for (int dx = 0; dx < 2; dx++)
+	{
+		for (int dy = 0; dy < 2; dy++)
+		{
+			for (int dz = 0; dz < 2; dz++)
+			{
+				int child = GetChildIndex(dx, dy, dz);
+				children[child] = BuildNode(x + (dx * half), y + (dy * half), z + (dz * half), half, columns, blockTypes);
+			}
+		}
+	}
+
+	// Collapse the children when they are all leaves with the same value. Being leaves they added no nodes of their own.
+	for (int i = 0; i < 8; i++)
+	{
+		if (!(children[i] & LEAF_FLAG) || children[i] != children[0])
+		{
+			uniform = false;
+			break;
+		}
+	}
+
+	if (uniform)
+	{
+		return children[0];
+	}
+
+	unsigned short block = (unsigned short)(_nodes.size() / 8);
+	_nodes.insert(_nodes.end(), children, children + 8);
+
+	return block;
+}
+
+void SparseVoxelOctree::DecodeNode(unsigned short slot, int x, int y, int z, int size, Column* columns, unsigned char* blockTypes) const
+{
+	if (!(slot & LEAF_FLAG))
+	{
+		int half = size / 2;
+
+		for (int child = 0; child < 8; child++)
+		{
+			DecodeNode(_nodes[(slot * 8) + child], x + ((child >> 2) & 1) * half, y + ((child >> 1) & 1) * half, z + (child & 1) * half, half, columns, blockTypes);
+		}
+		return;
+	}
+
+	int value = slot & ~LEAF_FLAG;
+	if (value == 0)
+	{
+		return;
+	}
+
+	Column run = GetRunMask(z, size);
+	unsigned char blockType = (unsigned char)((value - 1) & 0xF);
+
+	for (int i = x; i < x + size; i++)
+	{
+		for (int j = y; j < y + size; j++)
+		{
+			columns[(i * _size) + j] |= run;
+
+			int index = (((i * _size) + j) * _size) + z;
+
+			// Nodes larger than a voxel start on an even index, so their run of types fills whole bytes
+			if (size > 1)
+			{
+				memset(blockTypes + (index >> 1), blockType | (blockType << 4), size / 2);
+			}
+			else
+			{
+				blockTypes[index >> 1] |= blockType << ((index & 1) * 4);
+			}
+		}
+	}
+}
+
+void SparseVoxelOctree::CollectColumn(unsigned short slot, int x, int y, int z, int size, int columnX, int columnY, Column& column) const
+{
+	if (slot & LEAF_FLAG)
+	{
+		if (slot != LEAF_FLAG)
+		{
+			column |= GetRunMask(z, size);
+		}
+		return;
+	}
+
+	// Only the two children stacked along the column touch it
+	int half = size / 2;
+	int dx = (columnX >= x + half) ? 1 : 0;
+	int dy = (columnY >= y + half) ? 1 : 0;
+
+	for (int dz = 0; dz < 2; dz++)
+	{
+		CollectColumn(_nodes[(slot * 8) + GetChildIndex(dx, dy, dz)], x + (dx * half), y + (dy * half), z + (dz * half), half, columnX, columnY, column);
+	}
+}
+
+void SparseVoxelOctree::CollectLayer(unsigned short slot, const int origin[3], int size, int axis, int coordinate, Column* layer) const
+{
+	// The layer is indexed by the first of the other two axes, with a bit along the second
+	int first = (axis == 0) ? 1 : 0;
+	int second = (axis == 2) ? 1 : 2;
+
+	if (slot & LEAF_FLAG)
+	{
+		if (slot != LEAF_FLAG)
+		{
+			Column run = GetRunMask(origin[second], size);
+
+			for (int i = origin[first]; i < origin[first] + size; i++)
+			{
+				layer[i] |= run;
+			}
+		}
+		return;
+	}
+
+	// Only the four children on the same side of the middle as the layer touch it
+	int half = size / 2;
+	int side = (coordinate >= origin[axis] + half) ? 1 : 0;
+
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			int offset[3];
+			offset[axis] = side;
+			offset[first] = i;
+			offset[second] = j;
+
+			int childOrigin[3] = { origin[0] + (offset[0] * half), origin[1] + (offset[1] * half), origin[2] + (offset[2] * half) };
+
+			CollectLayer(_nodes[(slot * 8) + GetChildIndex(offset[0], offset[1], offset[2])], childOrigin, half, axis, coordinate, layer);
+		}
+	}
+}
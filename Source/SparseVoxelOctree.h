@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+// A cube of voxels held as an octree in which every node whose voxels all match is collapsed into a single value.
+// Air and solid interiors collapse into a handful of nodes, so mostly uniform chunks take far less memory than
+// a dense array. A voxels value is 0 when it is inactive and 1 + its block type when it is active.
+//
+// The voxels go in and come out in the dense layout chunks use, a column of bits along z for every (x, y) at index
+// (x * size) + y, and the block types at index (((x * size) + y) * size) + z packed two to a byte.
+class SparseVoxelOctree
+{
+public:
+	typedef unsigned int Column;
+
+	SparseVoxelOctree();
+
+	// Builds the tree from dense voxels. The size must be a power of two no larger than the bits in a Column.
+	void Build(int size, const Column* columns, const unsigned char* blockTypes);
+	void Clear();
+
+	// Writes the voxels back out in the dense layout. The arrays must be cleared to zero beforehand.
+	void Decode(Column* columns, unsigned char* blockTypes) const;
+
+	unsigned char GetValue(int x, int y, int z) const;
+	Column GetColumn(int x, int y) const;
+
+	// Fills a layer of voxels at the given coordinate along an axis. The layer holds one Column for each coordinate
+	// along the first of the other two axes, with a bit for each coordinate along the second.
+	void GetLayer(int axis, int coordinate, Column* layer) const;
+
+	bool IsEmpty() const { return _nodes.empty() && _root == LEAF_FLAG; }
+	int GetNodeCount() const { return (int)_nodes.size() / 8; }
+	int GetMemoryUsage() const { return (int)(_nodes.capacity() * sizeof(unsigned short)); }
+
+private:
+	// A slot is either a leaf holding a value, or the index of a block of eight child slots
+	static const unsigned short LEAF_FLAG = 0x8000;
+
+	unsigned short BuildNode(int x, int y, int z, int size, const Column* columns, const unsigned char* blockTypes);
+	void DecodeNode(unsigned short slot, int x, int y, int z, int size, Column* columns, unsigned char* blockTypes) const;
+	void CollectColumn(unsigned short slot, int x, int y, int z, int size, int columnX, int columnY, Column& column) const;
+	void CollectLayer(unsigned short slot, const int origin[3], int size, int axis, int coordinate, Column* layer) const;
+
+	static int GetChildIndex(int dx, int dy, int dz) { return (dx << 2) | (dy << 1) | dz; }
+
+	std::vector<unsigned short>		_nodes;
+	unsigned short					_root;
+	int								_size;
+};
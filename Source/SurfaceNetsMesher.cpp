@@ -0,0 +1,303 @@
+#include "SurfaceNetsMesher.h"
+
+#include <math.h>
+#include <string.h>
+
+// Index of the lowest set bit in a mask that is not zero
+static inline int LowestBit(unsigned long long mask)
+{
+	unsigned long index;
+
+#if defined(_M_X64)
+	_BitScanForward64(&index, mask);
+#else
+	if (!_BitScanForward(&index, (unsigned long)mask))
+	{
+		_BitScanForward(&index, (unsigned long)(mask >> 32));
+		index += 32;
+	}
+#endif
+
+	return (int)index;
+}
+
+SurfaceNetsMesher::SurfaceNetsMesher()
+{
+	_columns = new unsigned long long[SAMPLES * SAMPLES];
+	_density = new float[SAMPLES * SAMPLES * SAMPLES];
+	_cellVertices = new int[CELLS * CELLS * CELLS];
+}
+
+SurfaceNetsMesher::~SurfaceNetsMesher()
+{
+	delete[] _columns;
+	_columns = 0;
+
+	delete[] _density;
+	_density = 0;
+
+	delete[] _cellVertices;
+	_cellVertices = 0;
+}
+
+void SurfaceNetsMesher::CreateMesh(const VoxelChunk& chunk, const VoxelGenerator* generator, VoxelChunk::MeshData& mesh)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	const unsigned long long interior = (((unsigned long long)1 << size) - 1) << 1;
+	int origin[3];
+	bool hasFaces = false;
+
+	mesh.Clear();
+
+	// The first sample is the voxel just below the chunk along every axis
+	chunk.GetPosition(origin[0], origin[1], origin[2]);
+	for (int i = 0; i < 3; i++)
+	{
+		origin[i] = (origin[i] * size) - 1;
+	}
+
+	for (int x = 0; x < SAMPLES; x++)
+	{
+		for (int y = 0; y < SAMPLES; y++)
+		{
+			_columns[(x * SAMPLES) + y] = chunk.GetPaddedColumn(x - 1, y - 1);
+		}
+	}
+
+	// Buried and empty chunks have no surface, and finding that out is far cheaper than sampling the density
+	for (int x = 1; x <= size && !hasFaces; x++)
+	{
+		for (int y = 1; y <= size; y++)
+		{
+			unsigned long long column = _columns[(x * SAMPLES) + y];
+			unsigned long long hidden = (column << 1) & (column >> 1) & _columns[((x - 1) * SAMPLES) + y] & _columns[((x + 1) * SAMPLES) + y] &
+				_columns[(x * SAMPLES) + y - 1] & _columns[(x * SAMPLES) + y + 1];
+
+			if (column & interior & ~hidden)
+			{
+				hasFaces = true;
+				break;
+			}
+		}
+	}
+
+	if (!hasFaces)
+	{
+		return;
+	}
+
+	if (generator)
+	{
+		generator->SampleDensity(origin[0], origin[1], origin[2], SAMPLES, SAMPLES, SAMPLES, _density);
+	}
+	else
+	{
+		memset(_density, 0, SAMPLES * SAMPLES * SAMPLES * sizeof(float));
+	}
+
+	// The voxels have the final say on what is solid. Where an edit disagrees with the density, or there is no
+	// density, the surface runs halfway between the voxels.
+	for (int x = 0; x < SAMPLES; x++)
+	{
+		for (int y = 0; y < SAMPLES; y++)
+		{
+			unsigned long long column = _columns[(x * SAMPLES) + y];
+			float* density = _density + GetSampleIndex(x, y, 0);
+
+			for (int z = 0; z < SAMPLES; z++)
+			{
+				if ((column >> z) & 1)
+				{
+					density[z] = (density[z] > 0.0f) ? density[z] : 0.5f;
+				}
+				else
+				{
+					density[z] = (density[z] < 0.0f) ? density[z] : -0.5f;
+				}
+			}
+		}
+	}
+
+	memset(_cellVertices, 0xFF, CELLS * CELLS * CELLS * sizeof(int));
+
+	// Each solid voxel in the chunk gets a quad for every empty voxel beside it, as with the culled faces
+	for (int x = 1; x <= size; x++)
+	{
+		for (int y = 1; y <= size; y++)
+		{
+			unsigned long long column = _columns[(x * SAMPLES) + y];
+			unsigned long long solid = column & interior;
+
+			if (!solid)
+			{
+				continue;
+			}
+
+			unsigned long long faces[6] =
+			{
+				solid & ~_columns[((x - 1) * SAMPLES) + y],
+				solid & ~_columns[((x + 1) * SAMPLES) + y],
+				solid & ~_columns[(x * SAMPLES) + y - 1],
+				solid & ~_columns[(x * SAMPLES) + y + 1],
+				solid & ~(column << 1),
+				solid & ~(column >> 1),
+			};
+
+			for (int face = 0; face < 6; face++)
+			{
+				unsigned long long mask = faces[face];
+
+				while (mask)
+				{
+					int z = LowestBit(mask);
+					mask &= mask - 1;
+
+					AddQuad(x, y, z, face / 2, (face % 2 == 0) ? -1 : 1, origin, mesh);
+				}
+			}
+		}
+	}
+}
+
+void SurfaceNetsMesher::AddQuad(int x, int y, int z, int axis, int sign, const int origin[3], VoxelChunk::MeshData& mesh)
+{
+	int sample[3] = { x, y, z };
+	int first = (axis == 0) ? 1 : 0;
+	int second = (axis == 2) ? 1 : 2;
+	int vertices[2][2];
+
+	// The four cells around the edge from the solid sample to the empty one, indexed by their offsets along the
+	// first and second of the other axes
+	for (int i = 0; i < 2; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			int cell[3];
+			cell[axis] = (sign > 0) ? sample[axis] : sample[axis] - 1;
+			cell[first] = sample[first] - 1 + i;
+			cell[second] = sample[second] - 1 + j;
+
+			vertices[i][j] = GetCellVertex(cell[0], cell[1], cell[2], origin, mesh);
+		}
+	}
+
+	// Wind the quad clockwise seen from outside, the same way as the culled faces. The first other axis crossed
+	// with the second points down the x and z axes but up the y axis.
+	int cross = (axis == 1) ? -1 : 1;
+	unsigned long topLeft, topRight, bottomLeft, bottomRight;
+
+	if (cross == -sign)
+	{
+		topLeft = vertices[0][1];
+		topRight = vertices[1][1];
+		bottomLeft = vertices[0][0];
+		bottomRight = vertices[1][0];
+	}
+	else
+	{
+		topLeft = vertices[1][0];
+		topRight = vertices[1][1];
+		bottomLeft = vertices[0][0];
+		bottomRight = vertices[0][1];
+	}
+
+	mesh.Indices.push_back(topLeft);
+	mesh.Indices.push_back(topRight);
+	mesh.Indices.push_back(bottomLeft);
+	mesh.Indices.push_back(bottomLeft);
+	mesh.Indices.push_back(topRight);
+	mesh.Indices.push_back(bottomRight);
+}
+
+int SurfaceNetsMesher::GetCellVertex(int x, int y, int z, const int origin[3], VoxelChunk::MeshData& mesh)
+{
+	int& vertex = _cellVertices[GetCellIndex(x, y, z)];
+	if (vertex >= 0)
+	{
+		return vertex;
+	}
+
+	// The corners are indexed by (x offset * 4) + (y offset * 2) + z offset
+	float corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = _density[GetSampleIndex(x + ((i >> 2) & 1), y + ((i >> 1) & 1), z + (i & 1))];
+	}
+
+	// Average where the surface crosses each of the twelve edges of the cell
+	float position[3] = { 0.0f, 0.0f, 0.0f };
+	int crossings = 0;
+
+	for (int i = 0; i < 8; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int bit = 4 >> axis;
+			if (i & bit)
+			{
+				continue;
+			}
+
+			int j = i | bit;
+			if ((corners[i] > 0.0f) == (corners[j] > 0.0f))
+			{
+				continue;
+			}
+
+			float t = corners[i] / (corners[i] - corners[j]);
+			position[0] += (axis == 0) ? t : (float)((i >> 2) & 1);
+			position[1] += (axis == 1) ? t : (float)((i >> 1) & 1);
+			position[2] += (axis == 2) ? t : (float)(i & 1);
+			crossings++;
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		position[i] /= crossings;
+	}
+
+	// The normal points down the gradient of the density blended across the cell, out of the ground
+	float u = position[0], v = position[1], w = position[2];
+	float gradient[3];
+
+	gradient[0] = ((1.0f - v) * (1.0f - w) * (corners[4] - corners[0])) + (v * (1.0f - w) * (corners[6] - corners[2])) +
+		((1.0f - v) * w * (corners[5] - corners[1])) + (v * w * (corners[7] - corners[3]));
+	gradient[1] = ((1.0f - u) * (1.0f - w) * (corners[2] - corners[0])) + (u * (1.0f - w) * (corners[6] - corners[4])) +
+		((1.0f - u) * w * (corners[3] - corners[1])) + (u * w * (corners[7] - corners[5]));
+	gradient[2] = ((1.0f - u) * (1.0f - v) * (corners[1] - corners[0])) + (u * (1.0f - v) * (corners[5] - corners[4])) +
+		((1.0f - u) * v * (corners[3] - corners[2])) + (u * v * (corners[7] - corners[6]));
+
+	float length = sqrtf((gradient[0] * gradient[0]) + (gradient[1] * gradient[1]) + (gradient[2] * gradient[2]));
+	XMFLOAT3 normal(0.0f, 1.0f, 0.0f);
+	if (length > 1e-6f)
+	{
+		normal = XMFLOAT3(-gradient[0] / length, -gradient[1] / length, -gradient[2] / length);
+	}
+
+	// Work from whole voxel coordinates, so the chunks either side of a border place its vertices identically
+	VoxelChunk::VertexType newVertex;
+	newVertex.position = XMFLOAT3((float)(origin[0] + x) + 0.5f + position[0], (float)(origin[1] + y) + 0.5f + position[1], (float)(origin[2] + z) + 0.5f + position[2]);
+	newVertex.normal = normal;
+	newVertex.light = VoxelChunk::PackVertexLight(3, VoxelChunk::SKY_LIGHT);
+
+	// Project the texture along whichever axis the surface faces most, repeating once per voxel
+	float absX = fabsf(normal.x), absY = fabsf(normal.y), absZ = fabsf(normal.z);
+	if (absX >= absY && absX >= absZ)
+	{
+		newVertex.texture = XMFLOAT2(newVertex.position.z, -newVertex.position.y);
+	}
+	else if (absY >= absZ)
+	{
+		newVertex.texture = XMFLOAT2(newVertex.position.x, -newVertex.position.z);
+	}
+	else
+	{
+		newVertex.texture = XMFLOAT2(newVertex.position.x, -newVertex.position.y);
+	}
+
+	vertex = (int)mesh.Vertices.size();
+	mesh.Vertices.push_back(newVertex);
+
+	return vertex;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "VoxelChunk.h"
+#include "VoxelGenerator.h"
+
+// Meshes a chunk as a smooth surface with surface nets. The centres of the voxels form a grid of samples, and every
+// cell of eight samples the surface passes through gets a single vertex, placed at the average of the points where
+// the density crosses zero along the cells edges. Each solid voxel beside an empty one then gets a quad joining the
+// four cells around the edge between them, so the quads share their vertices.
+//
+// The voxels decide what is solid, so edits show up, and the generators density only moves the vertices between
+// them. The cells along the sides of a chunk are worked out from its borders, from exactly the same samples its
+// neighbours use, so the surface is watertight across chunks. The scratch memory is reused, so keep one mesher per thread.
+class SurfaceNetsMesher
+{
+public:
+	SurfaceNetsMesher();
+	~SurfaceNetsMesher();
+
+	void CreateMesh(const VoxelChunk& chunk, const VoxelGenerator* generator, VoxelChunk::MeshData& mesh);
+
+	// The samples along each axis, for the voxels from -1 to CHUNK_SIZE
+	static const int SAMPLES = VoxelChunk::CHUNK_SIZE + 2;
+	static const int CELLS = SAMPLES - 1;
+	static_assert(SAMPLES <= 64, "A padded chunk column must fit in 64 bits");
+
+private:
+	int GetCellVertex(int x, int y, int z, const int origin[3], VoxelChunk::MeshData& mesh);
+	void AddQuad(int x, int y, int z, int axis, int sign, const int origin[3], VoxelChunk::MeshData& mesh);
+
+	static int GetSampleIndex(int x, int y, int z) { return (((x * SAMPLES) + y) * SAMPLES) + z; }
+	static int GetCellIndex(int x, int y, int z) { return (((x * CELLS) + y) * CELLS) + z; }
+
+	// The padded columns of the chunk, indexed by (x * SAMPLES) + y with a bit per sample along z
+	unsigned long long*		_columns;
+
+	// The density at every sample, positive inside the ground, and the vertex made for each cell or -1
+	float*					_density;
+	int*					_cellVertices;
+};
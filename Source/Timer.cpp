@@ -81,4 +81,15 @@ int Timer::GetTiming()
 	milliseconds = (elapsedTicks / (float)frequency) * 1000.0f;
 
 	return (int)milliseconds;
+}
+
+float Timer::GetTimingMilliseconds()
+{
+	INT64 frequency;
+
+	// Get the ticks per second speed of the timer.
+	QueryPerformanceFrequency((LARGE_INTEGER*)&frequency);
+
+	// Calculate the elapsed time in milliseconds without rounding it down to a whole number.
+	return ((float)(_endTime - _beginTime) / (float)frequency) * 1000.0f;
 }
\ No newline at end of file
@@ -16,6 +16,7 @@ public:
 	void StartTimer();
 	void StopTimer();
 	int GetTiming();
+	float GetTimingMilliseconds();
 
 private:
 	float		_frequency;
@@ -1,5 +1,7 @@
 #pragma once
 
+// Voxels are no longer stored as individual objects, a chunk keeps one bit per voxel for whether
+// it is active and packs the block type of each voxel into 4 bits. BlockType_NumTypes must stay <= 16.
 enum BlockType
 {
 	BlockType_Default = 0,
@@ -10,21 +12,18 @@ enum BlockType
 	BlockType_Stone,
 	BlockType_Wood,
 	BlockType_Sand,
+	BlockType_Lamp,				// Gives off light, see VoxelLighting
 
 	BlockType_NumTypes,
 };
 
-class Voxel
+// How a chunk turns its voxels into triangles
+enum VoxelMeshMode
 {
-public:
-	Voxel();
-	~Voxel();
-
-	bool IsActive();
-	void SetActive(bool active);
-
-private:
-	bool m_active;
-
-	BlockType m_blockType;
-};
\ No newline at end of file
+	VoxelMeshMode_Cubes = 0,	// Stamp the whole cube model for every surface voxel
+	VoxelMeshMode_Culled,		// Emit only the faces of each voxel that border an inactive voxel
+	VoxelMeshMode_Greedy,		// Merge the visible faces of matching blocks into as few rectangles as possible
+	VoxelMeshMode_Binary,		// Culled faces found with 64 bit column masks along every axis
+	VoxelMeshMode_BinaryGreedy,	// Greedy faces merged straight from the 64 bit face masks
+	VoxelMeshMode_SurfaceNets,	// A smooth surface through the generators density field, shaped by the voxels
+};
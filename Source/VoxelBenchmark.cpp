@@ -0,0 +1,732 @@
+#include "VoxelBenchmark.h"
+
+#include "BinaryVoxelMesher.h"
+#include "VoxelRegionStore.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void VoxelBenchmark::Run(VoxelTerrain* voxelTerrain)
+{
+	Report("---- Voxel benchmarks ----");
+
+	RunMesherBenchmark(voxelTerrain);
+	RunWorldBenchmark(VoxelMeshMode_BinaryGreedy, "BinaryGreedy");
+	RunWorldBenchmark(VoxelMeshMode_SurfaceNets, "SurfaceNets");
+	RunStorageBenchmark();
+	RunSerializerBenchmark();
+	RunRaycastBenchmark();
+	RunLodBenchmark();
+	RunLightingBenchmark();
+}
+
+void VoxelBenchmark::RunMesherBenchmark(VoxelTerrain* voxelTerrain)
+{
+	VoxelChunk chunk;
+
+	chunk.SetModel(voxelTerrain->GetModel(), voxelTerrain->GetModelVertexCount());
+
+	// A striped sphere
+	chunk.CreateSphere();
+	BenchmarkMeshers("Sphere", chunk);
+
+	// Flat ground, grass on top of dirt filling the bottom half of the chunk
+	chunk.Clear();
+	for (int x = 0; x < VoxelChunk::CHUNK_SIZE; x++)
+	{
+		for (int y = 0; y < VoxelChunk::CHUNK_SIZE / 2; y++)
+		{
+			for (int z = 0; z < VoxelChunk::CHUNK_SIZE; z++)
+			{
+				chunk.SetVoxel(x, y, z, true, (y == (VoxelChunk::CHUNK_SIZE / 2) - 1) ? BlockType_Grass : BlockType_Dirt);
+			}
+		}
+	}
+
+	BenchmarkMeshers("Flat", chunk);
+
+	// The same ground held in an octree, which the meshers read through the chunks storage interface
+	chunk.Compact();
+	BenchmarkMeshers("Octree", chunk);
+
+	// A block bigger than a chunk, which only the binary mesher takes
+	BenchmarkLargeBlock();
+}
+
+// A sphere filling most of the large block on a floor running out to its sides, so there are corners all the way out at
+// the far sides, with holes scattered through both so there are faces inside them as well
+static inline bool IsLargeBlockVoxel(int x, int y, int z, int size)
+{
+	float centre = (size - 1) * 0.5f;
+	float dx = x - centre;
+	float dy = y - centre;
+	float dz = z - centre;
+
+	return ((y < 4) || ((dx * dx) + (dy * dy) + (dz * dz) <= centre * centre)) && (((x * 7) + (y * 3) + z) % 11) != 0;
+}
+
+void VoxelBenchmark::BenchmarkLargeBlock()
+{
+	const int size = BinaryVoxelMesher::MAX_SIZE;
+	const int offsets[VoxelMesher::Face_Count][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+	const char* names[] = { "Binary", "BinaryGreedy" };
+
+	std::vector<BinaryVoxelMesher::Mask> zColumns(size * size, 0);
+	std::vector<unsigned char> blockTypes((size * size * size) / 2, 0);
+	BinaryVoxelMesher mesher;
+	VoxelChunk::MeshData mesh;
+	Timer timer;
+	char line[256];
+	int faces = 0;
+
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			for (int z = 0; z < size; z++)
+			{
+				if (!IsLargeBlockVoxel(x, y, z, size))
+				{
+					continue;
+				}
+
+				int index = (((x * size) + y) * size) + z;
+				int blockType = (y < size / 2) ? BlockType_Dirt : BlockType_Stone;
+
+				zColumns[(x * size) + y] |= (BinaryVoxelMesher::Mask)1 << z;
+				blockTypes[index >> 1] |= (unsigned char)(blockType << ((index & 1) * 4));
+
+				// Count the faces voxel by voxel, everything outside the block being empty
+				for (int i = 0; i < VoxelMesher::Face_Count; i++)
+				{
+					int nx = x + offsets[i][0];
+					int ny = y + offsets[i][1];
+					int nz = z + offsets[i][2];
+
+					if (nx < 0 || ny < 0 || nz < 0 || nx >= size || ny >= size || nz >= size || !IsLargeBlockVoxel(nx, ny, nz, size))
+					{
+						faces++;
+					}
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		bool greedy = (i == 1);
+
+		timer.StartTimer();
+		for (int j = 0; j < ITERATIONS; j++)
+		{
+			mesher.CreateMesh(size, &zColumns[0], &blockTypes[0], 0, 0, 1, greedy, mesh);
+		}
+		timer.StopTimer();
+
+		// The area the quads cover, in voxel faces, has to match the faces counted one at a time, and the corners at the
+		// far sides of the block have to come back out of the packed vertices
+		int quads = (int)mesh.PackedVertices.size() / 4;
+		int area = 0;
+		float extent = 0.0f;
+
+		for (int j = 0; j < quads; j++)
+		{
+			VoxelChunk::VertexType corners[4];
+			int layer;
+
+			for (int k = 0; k < 4; k++)
+			{
+				VoxelMesher::UnpackVertex(mesh.PackedVertices[(j * 4) + k], XMFLOAT3(0.0f, 0.0f, 0.0f), corners[k], layer);
+				extent = fmaxf(extent, fmaxf(corners[k].position.x, fmaxf(corners[k].position.y, corners[k].position.z)));
+			}
+
+			float width = fabsf(corners[1].position.x - corners[0].position.x) + fabsf(corners[1].position.y - corners[0].position.y) +
+				fabsf(corners[1].position.z - corners[0].position.z);
+			float height = fabsf(corners[2].position.x - corners[0].position.x) + fabsf(corners[2].position.y - corners[0].position.y) +
+				fabsf(corners[2].position.z - corners[0].position.z);
+			area += (int)(width * height);
+		}
+
+		bool matches = (area == faces) && (greedy || quads == faces) && (extent == size);
+
+		sprintf_s(line, "Block %d^3 mesher %-12s quads %8d  faces covered %8d of %8d  extent %3.0f  %s  %9.1f us per block",
+			size, names[i], quads, area, faces, extent, matches ? "matches" : "MISMATCH", (timer.GetTimingMilliseconds() * 1000.0f) / ITERATIONS);
+		Report(line);
+	}
+}
+
+void VoxelBenchmark::BenchmarkMeshers(const char* chunkName, VoxelChunk& chunk)
+{
+	const VoxelMeshMode modes[] = { VoxelMeshMode_Cubes, VoxelMeshMode_Culled, VoxelMeshMode_Greedy, VoxelMeshMode_Binary, VoxelMeshMode_BinaryGreedy,
+		VoxelMeshMode_SurfaceNets };
+	const char* names[] = { "Cubes", "Culled", "Greedy", "Binary", "BinaryGreedy", "SurfaceNets" };
+	const int modeCount = sizeof(modes) / sizeof(modes[0]);
+
+	VoxelChunk::MeshData mesh;
+	Timer timer;
+	char line[256];
+	int cubeTriangles = 0;
+
+	for (int i = 0; i < modeCount; i++)
+	{
+		timer.StartTimer();
+		for (int j = 0; j < ITERATIONS; j++)
+		{
+			chunk.CreateMesh(modes[i], mesh);
+		}
+		timer.StopTimer();
+
+		int triangles = (int)mesh.Indices.size() / 3;
+		int vertexBytes = (int)((mesh.Vertices.size() * sizeof(VoxelChunk::VertexType)) + (mesh.PackedVertices.size() * sizeof(VoxelChunk::PackedVertexType)));
+
+		if (modes[i] == VoxelMeshMode_Cubes)
+		{
+			cubeTriangles = triangles;
+		}
+
+		sprintf_s(line, "%-8s mesher %-12s vertices %8d (%8d bytes)  triangles %8d (%6.2f%%)  %9.1f us per chunk",
+			chunkName, names[i], mesh.GetVertexCount(), vertexBytes, triangles, (cubeTriangles > 0) ? (100.0f * triangles) / cubeTriangles : 0.0f,
+			(timer.GetTimingMilliseconds() * 1000.0f) / ITERATIONS);
+		Report(line);
+	}
+}
+
+void VoxelBenchmark::RunWorldBenchmark(VoxelMeshMode meshMode, const char* meshName)
+{
+	VoxelTerrain world;
+	JobSystem jobSystem;
+	Timer timer;
+	char line[256];
+	float singleThreadMilliseconds = 0.0f;
+	int chunkCount = WORLD_SIZE * WORLD_SIZE * WORLD_SIZE;
+	int first = -(WORLD_SIZE / 2);
+	int last = first + WORLD_SIZE - 1;
+	int maxThreads = (int)std::thread::hardware_concurrency();
+
+	if (maxThreads < 1)
+	{
+		maxThreads = 1;
+	}
+
+	// Build the same block of chunks with more threads each time, the waiting thread makes one more than the job systems workers
+	for (int threads = 1; ; threads *= 2)
+	{
+		if (threads > maxThreads)
+		{
+			threads = maxThreads;
+		}
+
+		jobSystem.Initialize(threads - 1);
+
+		// The planet fills most of the block, leaving room for its hills
+		if (!world.Initialize("Source/shadows/cube.txt", 47, meshMode, &jobSystem, WORLD_SIZE * VoxelChunk::CHUNK_SIZE * 0.4f, 0, 0, 0))
+		{
+			Report("World benchmark could not load the voxel model");
+			return;
+		}
+
+		timer.StartTimer();
+		world.GenerateRegion(first, first, first, last, last, last);
+		timer.StopTimer();
+		float generateMilliseconds = timer.GetTimingMilliseconds();
+
+		timer.StartTimer();
+		world.MeshRegion(first, first, first, last, last, last);
+		timer.StopTimer();
+		float meshMilliseconds = timer.GetTimingMilliseconds();
+
+		world.Destroy();
+
+		float totalMilliseconds = generateMilliseconds + meshMilliseconds;
+		if (threads == 1)
+		{
+			singleThreadMilliseconds = totalMilliseconds;
+		}
+
+		sprintf_s(line, "World %dx%dx%d chunks  %-12s threads %2d  generate %8.1f ms  mesh %8.1f ms  total %8.1f ms  %8.0f chunks/s  speedup %5.2fx",
+			WORLD_SIZE, WORLD_SIZE, WORLD_SIZE, meshName, threads, generateMilliseconds, meshMilliseconds, totalMilliseconds,
+			(chunkCount * 1000.0f) / totalMilliseconds, singleThreadMilliseconds / totalMilliseconds);
+		Report(line);
+
+		if (threads == maxThreads)
+		{
+			break;
+		}
+	}
+
+	jobSystem.Destroy();
+}
+
+void VoxelBenchmark::RunStorageBenchmark()
+{
+	VoxelTerrain world;
+	JobSystem jobSystem;
+	VoxelTerrain::StorageStats stats;
+	Timer timer;
+	char line[256];
+	int chunkCount = WORLD_SIZE * WORLD_SIZE * WORLD_SIZE;
+	int first = -(WORLD_SIZE / 2);
+	int last = first + WORLD_SIZE - 1;
+	int octreeChunks = 0;
+
+	jobSystem.Initialize(-1);
+
+	if (!world.Initialize("Source/shadows/cube.txt", 47, VoxelMeshMode_BinaryGreedy, &jobSystem, WORLD_SIZE * VoxelChunk::CHUNK_SIZE * 0.4f, 0, 0, 0))
+	{
+		Report("Storage benchmark could not load the voxel model");
+		return;
+	}
+
+	world.GenerateRegion(first, first, first, last, last, last);
+	world.GetStorageStats(stats);
+
+	sprintf_s(line, "Storage %dx%dx%d chunks  uniform %5d  octree %5d  dense %5d  voxels %8.2f MB  dense layout %8.2f MB  (%5.2f%%)",
+		WORLD_SIZE, WORLD_SIZE, WORLD_SIZE, stats.UniformChunks, stats.OctreeChunks, stats.DenseChunks,
+		stats.VoxelBytes / (1024.0f * 1024.0f), stats.DenseVoxelBytes / (1024.0f * 1024.0f), (100.0f * stats.VoxelBytes) / stats.DenseVoxelBytes);
+	Report(line);
+
+	sprintf_s(line, "Storage per chunk  average %8.1f bytes  octree chunks %8.1f bytes  dense layout %d bytes",
+		(float)stats.VoxelBytes / chunkCount, (stats.OctreeChunks > 0) ? (float)stats.VoxelBytes / stats.OctreeChunks : 0.0f, VoxelChunk::DENSE_VOXEL_BYTES);
+	Report(line);
+
+	// Time moving the surface chunks out to the dense layout, as an edit does, and back into their octrees
+	float expandMilliseconds = 0.0f;
+	float compactMilliseconds = 0.0f;
+
+	for (int x = first; x <= last; x++)
+	{
+		for (int y = first; y <= last; y++)
+		{
+			for (int z = first; z <= last; z++)
+			{
+				VoxelChunk* chunk = world.GetChunk(x, y, z);
+				if (!chunk || chunk->GetStorage() != VoxelChunk::VoxelStorage_Octree)
+				{
+					continue;
+				}
+
+				timer.StartTimer();
+				chunk->Expand();
+				timer.StopTimer();
+				expandMilliseconds += timer.GetTimingMilliseconds();
+
+				timer.StartTimer();
+				chunk->Compact();
+				timer.StopTimer();
+				compactMilliseconds += timer.GetTimingMilliseconds();
+
+				octreeChunks++;
+			}
+		}
+	}
+
+	if (octreeChunks > 0)
+	{
+		sprintf_s(line, "Storage octree chunks %5d  expand %7.1f us per chunk  compact %7.1f us per chunk",
+			octreeChunks, (expandMilliseconds * 1000.0f) / octreeChunks, (compactMilliseconds * 1000.0f) / octreeChunks);
+		Report(line);
+	}
+
+	world.Destroy();
+	jobSystem.Destroy();
+}
+
+void VoxelBenchmark::RunSerializerBenchmark()
+{
+	const char* directory = "VoxelBenchmarkRegions";
+
+	VoxelTerrain world;
+	JobSystem jobSystem;
+	VoxelRegionStore saveStore, loadStore;
+	Timer timer;
+	char line[256];
+	int chunkCount = WORLD_SIZE * WORLD_SIZE * WORLD_SIZE;
+	int first = -(WORLD_SIZE / 2);
+	int last = first + WORLD_SIZE - 1;
+	int maxThreads = (int)std::thread::hardware_concurrency();
+	float rawMegabytes = (chunkCount * (float)VoxelChunk::DENSE_VOXEL_BYTES) / (1024.0f * 1024.0f);
+
+	if (maxThreads < 1)
+	{
+		maxThreads = 1;
+	}
+
+	jobSystem.Initialize(-1);
+
+	if (!world.Initialize("Source/shadows/cube.txt", 47, VoxelMeshMode_BinaryGreedy, &jobSystem, WORLD_SIZE * VoxelChunk::CHUNK_SIZE * 0.4f, 0, 0, 0))
+	{
+		Report("Serializer benchmark could not load the voxel model");
+		return;
+	}
+
+	world.GenerateRegion(first, first, first, last, last, last);
+
+	// Save every chunk on this thread, the way the terrain saves the chunks it evicts
+	saveStore.Initialize(directory);
+
+	timer.StartTimer();
+	for (int x = first; x <= last; x++)
+	{
+		for (int y = first; y <= last; y++)
+		{
+			for (int z = first; z <= last; z++)
+			{
+				saveStore.SaveChunk(*world.GetChunk(x, y, z));
+			}
+		}
+	}
+	timer.StopTimer();
+
+	float saveSeconds = timer.GetTimingMilliseconds() / 1000.0f;
+	float fileMegabytes = saveStore.GetBytesWritten() / (1024.0f * 1024.0f);
+
+	saveStore.Destroy();
+	world.Destroy();
+
+	sprintf_s(line, "Save %d chunks  %8.1f ms  %8.0f chunks/s  %8.1f MB/s written  %8.1f MB/s of voxels  %7.1f bytes per chunk (%5.2f%% of dense)",
+		chunkCount, saveSeconds * 1000.0f, chunkCount / saveSeconds, fileMegabytes / saveSeconds, rawMegabytes / saveSeconds,
+		(fileMegabytes * 1024.0f * 1024.0f) / chunkCount, (100.0f * fileMegabytes) / rawMegabytes);
+	Report(line);
+
+	// Load them back on the job system, the way the terrain loads saved chunks in place of generating them
+	std::vector<VoxelChunk*> chunks;
+	for (int x = first; x <= last; x++)
+	{
+		for (int y = first; y <= last; y++)
+		{
+			for (int z = first; z <= last; z++)
+			{
+				VoxelChunk* chunk = new VoxelChunk;
+				chunk->SetPosition(x, y, z);
+				chunks.push_back(chunk);
+			}
+		}
+	}
+
+	for (int threads = 1; ; threads *= 2)
+	{
+		if (threads > maxThreads)
+		{
+			threads = maxThreads;
+		}
+
+		jobSystem.Initialize(threads - 1);
+
+		// Start each run with the region tables unread
+		loadStore.Initialize(directory);
+		std::atomic<int> failed(0);
+
+		timer.StartTimer();
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			VoxelChunk* chunk = chunks[i];
+			jobSystem.Submit([&loadStore, &failed, chunk]()
+			{
+				if (!loadStore.LoadChunk(*chunk))
+				{
+					failed++;
+				}
+			});
+		}
+		jobSystem.Wait();
+		timer.StopTimer();
+
+		float loadSeconds = timer.GetTimingMilliseconds() / 1000.0f;
+
+		sprintf_s(line, "Load %d chunks  threads %2d  %8.1f ms  %8.0f chunks/s  %8.1f MB/s read  %8.1f MB/s of voxels  failed %d",
+			chunkCount, threads, loadSeconds * 1000.0f, chunkCount / loadSeconds, (loadStore.GetBytesRead() / (1024.0f * 1024.0f)) / loadSeconds,
+			rawMegabytes / loadSeconds, (int)failed);
+		Report(line);
+
+		if (threads == maxThreads)
+		{
+			break;
+		}
+	}
+
+	loadStore.DeleteRegions();
+	jobSystem.Destroy();
+
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		delete chunks[i];
+	}
+}
+
+void VoxelBenchmark::RunRaycastBenchmark()
+{
+	VoxelTerrain world;
+	JobSystem jobSystem;
+	Timer timer;
+	char line[256];
+	int first = -(WORLD_SIZE / 2);
+	int last = first + WORLD_SIZE - 1;
+	float planetRadius = WORLD_SIZE * VoxelChunk::CHUNK_SIZE * 0.4f;
+
+	jobSystem.Initialize(-1);
+
+	if (!world.Initialize("Source/shadows/cube.txt", 47, VoxelMeshMode_BinaryGreedy, &jobSystem, planetRadius, 0, 0, 0))
+	{
+		Report("Raycast benchmark could not load the voxel model");
+		return;
+	}
+
+	world.GenerateRegion(first, first, first, last, last, last);
+
+	// Rays from points scattered around the planet towards points near its centre, the way picks and projectiles
+	// come from above the ground, so most cross a few empty chunks before they hit
+	std::vector<VoxelTerrain::Ray> rays(RAYCAST_COUNT);
+	std::vector<VoxelTerrain::RaycastHit> hits(RAYCAST_COUNT);
+
+	srand(1);
+	for (int i = 0; i < RAYCAST_COUNT; i++)
+	{
+		float point[3], target[3];
+		float length = 0.0f;
+
+		while (length < 0.1f)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				point[j] = ((float)rand() / RAND_MAX) - 0.5f;
+			}
+			length = sqrtf((point[0] * point[0]) + (point[1] * point[1]) + (point[2] * point[2]));
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			point[j] *= (planetRadius * 1.2f) / length;
+			target[j] = (((float)rand() / RAND_MAX) - 0.5f) * planetRadius;
+		}
+
+		rays[i].Origin = XMFLOAT3(point[0], point[1], point[2]);
+		rays[i].Direction = XMFLOAT3(target[0] - point[0], target[1] - point[1], target[2] - point[2]);
+		rays[i].MaxDistance = planetRadius * 2.0f;
+	}
+
+	int hitCount = 0;
+	float distance = 0.0f;
+
+	timer.StartTimer();
+	for (int j = 0; j < ITERATIONS; j++)
+	{
+		hitCount = 0;
+		for (int i = 0; i < RAYCAST_COUNT; i++)
+		{
+			if (world.Raycast(rays[i], hits[i]))
+			{
+				hitCount++;
+			}
+		}
+	}
+	timer.StopTimer();
+	float singleMilliseconds = timer.GetTimingMilliseconds() / ITERATIONS;
+
+	for (int i = 0; i < RAYCAST_COUNT; i++)
+	{
+		distance += hits[i].Hit ? hits[i].Distance : 0.0f;
+	}
+
+	timer.StartTimer();
+	for (int j = 0; j < ITERATIONS; j++)
+	{
+		world.RaycastBatch(&rays[0], RAYCAST_COUNT, &hits[0]);
+	}
+	timer.StopTimer();
+	float batchMilliseconds = timer.GetTimingMilliseconds() / ITERATIONS;
+
+	sprintf_s(line, "Raycast %d rays  hits %4d  average distance %6.1f  single %7.3f ms (%5.2f us per ray)  batch %7.3f ms (%5.2f us per ray)",
+		RAYCAST_COUNT, hitCount, (hitCount > 0) ? distance / hitCount : 0.0f, singleMilliseconds, (singleMilliseconds * 1000.0f) / RAYCAST_COUNT,
+		batchMilliseconds, (batchMilliseconds * 1000.0f) / RAYCAST_COUNT);
+	Report(line);
+
+	world.Destroy();
+	jobSystem.Destroy();
+}
+
+void VoxelBenchmark::RunLodBenchmark()
+{
+	VoxelTerrain world;
+	JobSystem jobSystem;
+	VoxelChunk::MeshData mesh;
+	Timer timer;
+	char line[256];
+	int first = -(WORLD_SIZE / 2);
+	int last = first + WORLD_SIZE - 1;
+	float averageTriangles[VoxelChunk::LOD_COUNT];
+
+	jobSystem.Initialize(-1);
+
+	if (!world.Initialize("Source/shadows/cube.txt", 47, VoxelMeshMode_BinaryGreedy, &jobSystem, WORLD_SIZE * VoxelChunk::CHUNK_SIZE * 0.4f, 0, 0, 0))
+	{
+		Report("LOD benchmark could not load the voxel model");
+		return;
+	}
+
+	// Meshing the region fills in the borders of every chunk, which the coarse meshes are built from as well
+	world.GenerateRegion(first, first, first, last, last, last);
+	world.MeshRegion(first, first, first, last, last, last);
+
+	for (int lod = 0; lod < VoxelChunk::LOD_COUNT; lod++)
+	{
+		int meshedChunks = 0;
+		int surfaceChunks = 0;
+		int triangles = 0;
+
+		timer.StartTimer();
+		for (int x = first; x <= last; x++)
+		{
+			for (int y = first; y <= last; y++)
+			{
+				for (int z = first; z <= last; z++)
+				{
+					VoxelChunk* chunk = world.GetChunk(x, y, z);
+					if (!chunk || chunk->IsEmpty())
+					{
+						continue;
+					}
+
+					if (lod > 0)
+					{
+						chunk->CreateLodMesh(lod, mesh);
+					}
+					else
+					{
+						chunk->CreateMesh(VoxelMeshMode_BinaryGreedy, mesh);
+					}
+
+					meshedChunks++;
+
+					// Only chunks the surface passes through are drawn, the buried ones have no faces at any level
+					if (!mesh.Indices.empty())
+					{
+						surfaceChunks++;
+						triangles += (int)mesh.Indices.size() / 3;
+					}
+				}
+			}
+		}
+		timer.StopTimer();
+
+		averageTriangles[lod] = (surfaceChunks > 0) ? (float)triangles / surfaceChunks : 0.0f;
+
+		sprintf_s(line, "LOD %dx  surface chunks %5d  triangles %8d (%6.2f%%)  %6.0f per chunk  %9.1f us per chunk",
+			1 << lod, surfaceChunks, triangles, (averageTriangles[0] > 0.0f) ? (100.0f * averageTriangles[lod]) / averageTriangles[0] : 0.0f,
+			averageTriangles[lod], (meshedChunks > 0) ? (timer.GetTimingMilliseconds() * 1000.0f) / meshedChunks : 0.0f);
+		Report(line);
+	}
+
+	world.Destroy();
+	jobSystem.Destroy();
+
+	// Project the triangles drawn over flat ground out to the view radius, where the surface chunks fill a disc and
+	// each ring of the levels of detail holds as many chunks as its area
+	float fullTriangles = 3.14159265f * LOD_VIEW_RADIUS * LOD_VIEW_RADIUS * averageTriangles[0];
+	float lodTriangles = 0.0f;
+	float inner = 0.0f;
+	float outer = (float)LOD_DISTANCE;
+
+	for (int lod = 0; lod < VoxelChunk::LOD_COUNT; lod++)
+	{
+		if (lod == VoxelChunk::LOD_COUNT - 1 || outer > LOD_VIEW_RADIUS)
+		{
+			outer = (float)LOD_VIEW_RADIUS;
+		}
+
+		lodTriangles += 3.14159265f * ((outer * outer) - (inner * inner)) * averageTriangles[lod];
+
+		inner = outer;
+		outer *= 2.0f;
+	}
+
+	sprintf_s(line, "LOD view radius %d chunks  full detail %10.0f triangles  LOD from %d chunks %10.0f triangles (%5.2f%%)",
+		LOD_VIEW_RADIUS, fullTriangles, LOD_DISTANCE, lodTriangles, (fullTriangles > 0.0f) ? (100.0f * lodTriangles) / fullTriangles : 0.0f);
+	Report(line);
+}
+
+void VoxelBenchmark::RunLightingBenchmark()
+{
+	char line[256];
+
+	// The same edits in bigger and bigger worlds, which should cost the same in all of them
+	for (int worldSize = WORLD_SIZE / 4; worldSize <= WORLD_SIZE; worldSize *= 2)
+	{
+		VoxelTerrain world;
+		JobSystem jobSystem;
+		Timer timer;
+		int first = -(worldSize / 2);
+		int last = first + worldSize - 1;
+
+		jobSystem.Initialize(-1);
+
+		if (!world.Initialize("Source/shadows/cube.txt", 47, VoxelMeshMode_BinaryGreedy, &jobSystem, worldSize * VoxelChunk::CHUNK_SIZE * 0.4f, 0, 0, 0))
+		{
+			Report("Lighting benchmark could not load the voxel model");
+			return;
+		}
+
+		world.GenerateRegion(first, first, first, last, last, last);
+		world.MeshRegion(first, first, first, last, last, last);
+
+		// Find the ground at the top of the planet
+		VoxelTerrain::Ray ray;
+		VoxelTerrain::RaycastHit hit;
+		ray.Origin = XMFLOAT3(0.5f, (float)((last + 1) * VoxelChunk::CHUNK_SIZE) - 0.5f, 0.5f);
+		ray.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		ray.MaxDistance = (float)(worldSize * VoxelChunk::CHUNK_SIZE);
+
+		if (!world.Raycast(ray, hit))
+		{
+			Report("Lighting benchmark could not find the ground");
+			world.Destroy();
+			jobSystem.Destroy();
+			return;
+		}
+
+		int litVoxels = world.GetStats().LitVoxels;
+		float lightMilliseconds = world.GetStats().LightMilliseconds;
+		int edits = 0;
+
+		// Dig a shaft the sun falls down, light the bottom with a lamp, roof it over, then put it all back
+		timer.StartTimer();
+		for (int i = 0; i < SHAFT_DEPTH; i++)
+		{
+			edits += world.ClearVoxel(hit.X, hit.Y - i, hit.Z) ? 1 : 0;
+		}
+		world.PropagateLight();
+
+		edits += world.SetVoxel(hit.X, hit.Y - SHAFT_DEPTH + 1, hit.Z, BlockType_Lamp) ? 1 : 0;
+		world.PropagateLight();
+
+		edits += world.SetVoxel(hit.X, hit.Y, hit.Z, BlockType_Stone) ? 1 : 0;
+		world.PropagateLight();
+
+		edits += world.ClearVoxel(hit.X, hit.Y - SHAFT_DEPTH + 1, hit.Z) ? 1 : 0;
+		world.PropagateLight();
+
+		for (int i = 0; i < SHAFT_DEPTH; i++)
+		{
+			edits += world.SetVoxel(hit.X, hit.Y - i, hit.Z, BlockType_Stone) ? 1 : 0;
+		}
+		world.PropagateLight();
+		timer.StopTimer();
+
+		litVoxels = world.GetStats().LitVoxels - litVoxels;
+		lightMilliseconds = world.GetStats().LightMilliseconds - lightMilliseconds;
+
+		sprintf_s(line, "Lighting world %2dx%2dx%2d chunks  edits %3d  voxels visited %6d  light %7.3f ms (%6.2f us per edit)  edits total %7.3f ms",
+			worldSize, worldSize, worldSize, edits, litVoxels, lightMilliseconds, (edits > 0) ? (lightMilliseconds * 1000.0f) / edits : 0.0f,
+			timer.GetTimingMilliseconds());
+		Report(line);
+
+		world.Destroy();
+		jobSystem.Destroy();
+	}
+}
+
+void VoxelBenchmark::Report(const char* line)
+{
+	OutputDebugStringA(line);
+	OutputDebugStringA("\n");
+}
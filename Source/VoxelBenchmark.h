@@ -0,0 +1,31 @@
+#pragma once
+
+#include "VoxelTerrain.h"
+#include "Timer.h"
+
+// Times the voxel code paths and writes the results to the debugger output window
+class VoxelBenchmark
+{
+public:
+	static void Run(VoxelTerrain* voxelTerrain);
+
+private:
+	static void RunMesherBenchmark(VoxelTerrain* voxelTerrain);
+	static void BenchmarkMeshers(const char* chunkName, VoxelChunk& chunk);
+	static void BenchmarkLargeBlock();
+	static void RunWorldBenchmark(VoxelMeshMode meshMode, const char* meshName);
+	static void RunStorageBenchmark();
+	static void RunSerializerBenchmark();
+	static void RunRaycastBenchmark();
+	static void RunLodBenchmark();
+	static void RunLightingBenchmark();
+
+	static void Report(const char* line);
+
+	static const int ITERATIONS = 20;
+	static const int WORLD_SIZE = 16;
+	static const int RAYCAST_COUNT = 1024;
+	static const int LOD_VIEW_RADIUS = 64;
+	static const int LOD_DISTANCE = 4;
+	static const int SHAFT_DEPTH = 16;
+};
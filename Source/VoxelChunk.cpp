@@ -1,230 +1,1230 @@
 #include "VoxelChunk.h"
 
+#include "VoxelMesher.h"
+#include "BinaryVoxelMesher.h"
+#include "SurfaceNetsMesher.h"
+
+// The binary mesher reuses its scratch masks, so each thread keeps its own
+static BinaryVoxelMesher& GetBinaryMesher()
+{
+	static thread_local BinaryVoxelMesher binaryMesher;
+	return binaryMesher;
+}
+
+// The number of set bits in a column
+static inline int CountBits(VoxelChunk::Column column)
+{
+	column = column - ((column >> 1) & 0x55555555);
+	column = (column & 0x33333333) + ((column >> 2) & 0x33333333);
+	return (int)((((column + (column >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+}
+
 VoxelChunk::VoxelChunk()
 {
-	// Create the blocks as a cube with rounded corners
-	_voxels = new Voxel**[CHUNK_SIZE];
+	memset(_buffers, 0, sizeof(_buffers));
+	_drawLod = 0;
+	_validMeshes = 0;
+	_pendingLod = 0;
+	_hasPendingMesh = false;
+	_model = 0;
+	_modelVertexCount = 0;
+	_generator = 0;
+	_xPos = 0;
+	_yPos = 0;
+	_zPos = 0;
+
+	// Start out empty, which needs no memory for the blocks at all
+	_storage = VoxelStorage_Uniform;
+	_uniformValue = 0;
+	_voxelData = 0;
+	_occupancy = 0;
+	_blockTypes = 0;
+
+	// With no neighbours everything around the chunk is empty
+	memset(_borders, 0, sizeof(_borders));
+	memset(_edges, 0, sizeof(_edges));
+	_corners = 0;
+	memset(_connectedFaces, 0x3F, sizeof(_connectedFaces));
+
+	// Everything starts out with the default light
+	_light = 0;
+	_meshLight = 0;
+}
+
+VoxelChunk::~VoxelChunk()
+{
+	// Delete the blocks
+	ReleaseVoxels();
+
+	ResetLight();
+	delete[] _meshLight;
+	_meshLight = 0;
+
+	// Release the buffers
+	ReleaseBuffers();
+}
+
+void VoxelChunk::SetPosition(int xPos, int yPos, int zPos)
+{
+	_xPos = xPos;
+	_yPos = yPos;
+	_zPos = zPos;
+}
+
+void VoxelChunk::BuildMesh(VoxelMeshMode meshMode)
+{
+	UpdateConnectivity();
+	CreateMesh(meshMode, _mesh);
+	_pendingLod = 0;
+	_hasPendingMesh = true;
+
+	delete[] _meshLight;
+	_meshLight = 0;
+}
+
+void VoxelChunk::BuildLodMesh(int lod)
+{
+	UpdateConnectivity();
+	CreateLodMesh(lod, _mesh);
+	_pendingLod = lod;
+	_hasPendingMesh = true;
+
+	// The coarse meshes are not lit
+	delete[] _meshLight;
+	_meshLight = 0;
+}
+
+bool VoxelChunk::UploadMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+{
+	bool result;
+
+	if (!_hasPendingMesh)
+	{
+		return true;
+	}
+
+	MeshBuffers& buffers = _buffers[_pendingLod];
+	int vertexCount = _mesh.GetVertexCount();
+	int indexCount = (int)_mesh.Indices.size();
+	int vertexStride = _mesh.IsPacked() ? sizeof(PackedVertexType) : sizeof(VertexType);
+
+	_hasPendingMesh = false;
+
+	if (indexCount > 0 && vertexStride == buffers.VertexStride && vertexCount <= buffers.VertexCapacity && indexCount <= buffers.IndexCapacity)
+	{
+		// The mesh fits in the buffers already made, so copy it over the start of them
+		D3D11_BOX box;
+		box.left = 0;
+		box.top = 0;
+		box.front = 0;
+		box.bottom = 1;
+		box.back = 1;
+
+		box.right = vertexCount * vertexStride;
+		deviceContext->UpdateSubresource(buffers.VertexBuffer, 0, &box, _mesh.IsPacked() ? (const void*)&_mesh.PackedVertices[0] : (const void*)&_mesh.Vertices[0], 0, 0);
+
+		box.right = indexCount * sizeof(unsigned long);
+		deviceContext->UpdateSubresource(buffers.IndexBuffer, 0, &box, &_mesh.Indices[0], 0, 0);
+	}
+	else if (indexCount > 0)
+	{
+		// A chunk that is remeshed has probably been edited, and is likely to be edited again,
+		// so leave its new buffers room to grow
+		if (buffers.VertexBuffer)
+		{
+			if (_mesh.IsPacked())
+			{
+				_mesh.PackedVertices.resize(vertexCount + (vertexCount / 2));
+			}
+			else
+			{
+				_mesh.Vertices.resize(vertexCount + (vertexCount / 2));
+			}
+			_mesh.Indices.resize(indexCount + (indexCount / 2));
+		}
+
+		ReleaseBuffers(buffers);
+
+		// Initialize the vertex and index buffers.
+		result = InitializeBuffers(device, _mesh, buffers);
+		if (!result)
+		{
+			ReleaseBuffers(buffers);
+			_validMeshes &= ~(1 << _pendingLod);
+			return false;
+		}
+	}
+
+	// An empty mesh keeps any buffers it had, so they can be reused if the chunk is filled in again
+	buffers.VertexCount = vertexCount;
+	buffers.IndexCount = indexCount;
+	_validMeshes |= 1 << _pendingLod;
+	_drawLod = _pendingLod;
+
+	// The mesh lives on in the buffers, so give back its memory
+	_mesh.Vertices.clear();
+	_mesh.Vertices.shrink_to_fit();
+	_mesh.PackedVertices.clear();
+	_mesh.PackedVertices.shrink_to_fit();
+	_mesh.Indices.clear();
+	_mesh.Indices.shrink_to_fit();
+
+	return true;
+}
+
+int VoxelChunk::GetIndexCount()
+{
+	return _buffers[_drawLod].IndexCount;
+}
+
+int VoxelChunk::GetVertexCount()
+{
+	return _buffers[_drawLod].VertexCount;
+}
+
+int VoxelChunk::GetBufferBytes() const
+{
+	int bytes = 0;
+
+	for (int lod = 0; lod < LOD_COUNT; lod++)
+	{
+		bytes += (_buffers[lod].VertexCapacity * _buffers[lod].VertexStride) + (_buffers[lod].IndexCapacity * sizeof(unsigned long));
+	}
+
+	return bytes;
+}
+
+void VoxelChunk::Update(float deltaTime)
+{
+}
+
+void VoxelChunk::Render(ID3D11DeviceContext * deviceContext)
+{
+	unsigned int stride;
+	unsigned int offset;
+
+	// Set vertex buffer stride and offset.
+	stride = _buffers[_drawLod].VertexStride;
+	offset = 0;
+
+	// Set the vertex buffer to active in the input assembler so it can be rendered.
+	deviceContext->IASetVertexBuffers(0, 1, &_buffers[_drawLod].VertexBuffer, &stride, &offset);
+
+	// Set the index buffer to active in the input assembler so it can be rendered.
+	deviceContext->IASetIndexBuffer(_buffers[_drawLod].IndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+
+	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	return;
+}
+
+bool VoxelChunk::IsActive(int x, int y, int z) const
+{
+	switch (_storage)
+	{
+	case VoxelStorage_Uniform:
+		return _uniformValue != 0;
+
+	case VoxelStorage_Octree:
+		return _octree.GetValue(x, y, z) != 0;
+
+	default:
+		return ((_occupancy[GetColumnIndex(x, y)] >> z) & 1) != 0;
+	}
+}
+
+BlockType VoxelChunk::GetBlockType(int x, int y, int z) const
+{
+	int value;
+
+	switch (_storage)
+	{
+	case VoxelStorage_Uniform:
+		value = _uniformValue;
+		break;
+
+	case VoxelStorage_Octree:
+		value = _octree.GetValue(x, y, z);
+		break;
+
+	default:
+		{
+			int index = GetVoxelIndex(x, y, z);
+			return (BlockType)((_blockTypes[index >> 1] >> ((index & 1) * 4)) & 0xF);
+		}
+	}
+
+	// Inactive voxels are the default block
+	return (BlockType)((value > 0) ? value - 1 : 0);
+}
+
+VoxelChunk::Column VoxelChunk::GetColumn(int x, int y) const
+{
+	switch (_storage)
+	{
+	case VoxelStorage_Uniform:
+		return (_uniformValue != 0) ? ~(Column)0 : 0;
+
+	case VoxelStorage_Octree:
+		return _octree.GetColumn(x, y);
+
+	default:
+		return _occupancy[GetColumnIndex(x, y)];
+	}
+}
+
+void VoxelChunk::GetLayer(int axis, int coordinate, Column layer[CHUNK_SIZE]) const
+{
+	if (_storage == VoxelStorage_Octree)
+	{
+		_octree.GetLayer(axis, coordinate, layer);
+		return;
+	}
+
+	if (_storage == VoxelStorage_Uniform)
+	{
+		memset(layer, (_uniformValue != 0) ? 0xFF : 0, CHUNK_SIZE * sizeof(Column));
+		return;
+	}
+
+	// Along x and y the layer is made of whole columns, along z it takes one bit from every column
+	memset(layer, 0, CHUNK_SIZE * sizeof(Column));
+
 	for (int i = 0; i < CHUNK_SIZE; i++)
 	{
-		_voxels[i] = new Voxel*[CHUNK_SIZE];
+		if (axis == 0)
+		{
+			layer[i] = _occupancy[GetColumnIndex(coordinate, i)];
+		}
+		else if (axis == 1)
+		{
+			layer[i] = _occupancy[GetColumnIndex(i, coordinate)];
+		}
+		else
+		{
+			for (int y = 0; y < CHUNK_SIZE; y++)
+			{
+				layer[i] |= ((_occupancy[GetColumnIndex(i, y)] >> coordinate) & 1) << y;
+			}
+		}
+	}
+}
+
+void VoxelChunk::CopyVoxels(Column* columns, unsigned char* blockTypes) const
+{
+	switch (_storage)
+	{
+	case VoxelStorage_Uniform:
+		{
+			unsigned char blockType = (unsigned char)((_uniformValue > 0) ? (_uniformValue - 1) & 0xF : 0);
+			memset(columns, (_uniformValue != 0) ? 0xFF : 0, CHUNK_AREA * sizeof(Column));
+			memset(blockTypes, blockType | (blockType << 4), CHUNK_VOLUME / 2);
+		}
+		break;
+
+	case VoxelStorage_Octree:
+		memset(columns, 0, CHUNK_AREA * sizeof(Column));
+		memset(blockTypes, 0, CHUNK_VOLUME / 2);
+		_octree.Decode(columns, blockTypes);
+		break;
+
+	default:
+		memcpy(columns, _occupancy, CHUNK_AREA * sizeof(Column));
+		memcpy(blockTypes, _blockTypes, CHUNK_VOLUME / 2);
+		break;
+	}
+}
+
+void VoxelChunk::SetVoxels(const Column* columns, const unsigned char* blockTypes)
+{
+	// Nothing held now is kept, so start from empty rather than writing the old voxels out
+	ReleaseVoxels();
+	Expand();
+
+	memcpy(_occupancy, columns, CHUNK_AREA * sizeof(Column));
+	memcpy(_blockTypes, blockTypes, CHUNK_VOLUME / 2);
+}
+
+void VoxelChunk::SetVoxel(int x, int y, int z, bool active, BlockType blockType)
+{
+	if (_storage != VoxelStorage_Dense)
+	{
+		Expand();
+	}
+
+	int index = GetVoxelIndex(x, y, z);
+	int shift = (index & 1) * 4;
+
+	if (active)
+	{
+		_occupancy[GetColumnIndex(x, y)] |= (Column)1 << z;
+	}
+	else
+	{
+		_occupancy[GetColumnIndex(x, y)] &= ~((Column)1 << z);
+	}
+
+	_blockTypes[index >> 1] = (unsigned char)((_blockTypes[index >> 1] & ~(0xF << shift)) | ((blockType & 0xF) << shift));
+}
+
+void VoxelChunk::Clear()
+{
+	ReleaseVoxels();
+	_uniformValue = 0;
+}
+
+bool VoxelChunk::IsEmpty() const
+{
+	if (_storage == VoxelStorage_Uniform)
+	{
+		return _uniformValue == 0;
+	}
+
+	if (_storage == VoxelStorage_Octree)
+	{
+		return _octree.IsEmpty();
+	}
+
+	for (int i = 0; i < CHUNK_AREA; i++)
+	{
+		if (_occupancy[i] != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void VoxelChunk::Fill(BlockType blockType)
+{
+	ReleaseVoxels();
+	_uniformValue = (unsigned char)((blockType & 0xF) + 1);
+}
+
+void VoxelChunk::Compact()
+{
+	if (_storage != VoxelStorage_Dense)
+	{
+		return;
+	}
+
+	// A chunk that is all air or all one block needs nothing but its value
+	Column first = _occupancy[0];
+	bool uniform = (first == 0 || first == ~(Column)0);
+
+	for (int i = 1; i < CHUNK_AREA && uniform; i++)
+	{
+		uniform = (_occupancy[i] == first);
+	}
+
+	if (uniform && first != 0)
+	{
+		unsigned char types = _blockTypes[0];
+		uniform = ((types & 0xF) == (types >> 4));
+
+		for (int i = 1; i < CHUNK_VOLUME / 2 && uniform; i++)
+		{
+			uniform = (_blockTypes[i] == types);
+		}
+	}
+
+	if (uniform)
+	{
+		unsigned char value = (first != 0) ? (unsigned char)((_blockTypes[0] & 0xF) + 1) : 0;
+		ReleaseVoxels();
+		_uniformValue = value;
+		return;
+	}
+
+	// Keep the octree only when it beats the dense array, which it does for anything but the noisiest chunks
+	_octree.Build(CHUNK_SIZE, _occupancy, _blockTypes);
+	if (_octree.GetMemoryUsage() >= DENSE_VOXEL_BYTES)
+	{
+		_octree.Clear();
+		return;
+	}
+
+	delete[] _voxelData;
+	_voxelData = 0;
+	_occupancy = 0;
+	_blockTypes = 0;
+	_storage = VoxelStorage_Octree;
+}
+
+void VoxelChunk::Expand()
+{
+	if (_storage == VoxelStorage_Dense)
+	{
+		return;
+	}
+
+	// Allocate the occupancy bitset and the packed block types together, and write the voxels out into them
+	_voxelData = new unsigned char[DENSE_VOXEL_BYTES];
+	_occupancy = (Column*)_voxelData;
+	_blockTypes = _voxelData + (CHUNK_AREA * sizeof(Column));
 
+	CopyVoxels(_occupancy, _blockTypes);
+
+	_octree.Clear();
+	_uniformValue = 0;
+	_storage = VoxelStorage_Dense;
+}
+
+void VoxelChunk::ReleaseVoxels()
+{
+	delete[] _voxelData;
+	_voxelData = 0;
+	_occupancy = 0;
+	_blockTypes = 0;
+
+	_octree.Clear();
+	_storage = VoxelStorage_Uniform;
+}
+
+void VoxelChunk::CreateSphere()
+{
+	Clear();
+
+	// Create the blocks as a cube with rounded corners
+	for (int i = 0; i < CHUNK_SIZE; i++)
+	{
 		for (int j = 0; j < CHUNK_SIZE; j++)
 		{
-			_voxels[i][j] = new Voxel[CHUNK_SIZE];
 			for (int k = 0; k < CHUNK_SIZE; k++)
 			{
 				if (sqrt((float)(i - CHUNK_SIZE / 2)*(i - CHUNK_SIZE / 2) + (j - CHUNK_SIZE / 2)*(j - CHUNK_SIZE / 2) + (k - CHUNK_SIZE / 2)*(k - CHUNK_SIZE / 2)) <= CHUNK_SIZE / 2)
 				{
 					if (j % 2 != 0)
 					{
-						_voxels[i][j][k].SetActive(true);
+						SetVoxel(i, j, k, true, BlockType_Default);
 					}
-					else
+				}
+			}
+		}
+	}
+}
+
+void VoxelChunk::UpdateBorders(const VoxelChunk* const neighbours[6])
+{
+	// Each neighbour touches this chunk with its layer on the far side, the last layer for the neighbours below
+	// and the first for those above. The layers come out in the same layout as the borders.
+	for (int side = 0; side < 6; side++)
+	{
+		if (neighbours[side])
+		{
+			neighbours[side]->GetLayer(side / 2, (side % 2 == 0) ? CHUNK_SIZE - 1 : 0, _borders[side]);
+		}
+		else
+		{
+			memset(_borders[side], 0, sizeof(_borders[side]));
+		}
+	}
+}
+
+void VoxelChunk::UpdateDiagonalBorders(const VoxelChunk* const neighbours[27])
+{
+	Column layer[CHUNK_SIZE];
+
+	memset(_edges, 0, sizeof(_edges));
+	_corners = 0;
+
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				int offAxes = (dx != 0) + (dy != 0) + (dz != 0);
+				const VoxelChunk* neighbour = neighbours[GetNeighbourIndex(dx, dy, dz)];
+
+				if (offAxes < 2 || !neighbour)
+				{
+					continue;
+				}
+
+				// The voxels of the neighbour that touch this chunk are on its far side along each axis it is off on
+				int x = (dx < 0) ? CHUNK_SIZE - 1 : 0;
+				int y = (dy < 0) ? CHUNK_SIZE - 1 : 0;
+				int z = (dz < 0) ? CHUNK_SIZE - 1 : 0;
+
+				if (offAxes == 3)
+				{
+					if (neighbour->IsActive(x, y, z))
 					{
-						_voxels[i][j][k].SetActive(false);
+						_corners |= 1 << (((dx > 0) << 2) | ((dy > 0) << 1) | (dz > 0));
 					}
 				}
+				else if (dz == 0)
+				{
+					_edges[2][((dx > 0) * 2) + (dy > 0)] = neighbour->GetColumn(x, y);
+				}
+				else if (dy == 0)
+				{
+					// The layer across z is indexed by x with a bit per y, so one entry of it is the whole edge
+					neighbour->GetLayer(2, z, layer);
+					_edges[1][((dx > 0) * 2) + (dz > 0)] = layer[x];
+				}
 				else
 				{
-					_voxels[i][j][k].SetActive(false);
+					// The layer across y is indexed by x with a bit per z, so the edge takes one bit from each entry
+					neighbour->GetLayer(1, y, layer);
+
+					Column edge = 0;
+					for (int i = 0; i < CHUNK_SIZE; i++)
+					{
+						edge |= ((layer[i] >> z) & 1) << i;
+					}
+					_edges[0][((dy > 0) * 2) + (dz > 0)] = edge;
 				}
 			}
 		}
 	}
 }
 
-VoxelChunk::~VoxelChunk()
+unsigned long long VoxelChunk::GetPaddedColumn(int x, int y) const
 {
-	// Delete the blocks
-	for (int i = 0; i < CHUNK_SIZE; ++i)
+	int sideX = (x < 0) ? 0 : ((x >= CHUNK_SIZE) ? 1 : -1);
+	int sideY = (y < 0) ? 0 : ((y >= CHUNK_SIZE) ? 1 : -1);
+	Column column, low, high;
+
+	if (sideX < 0 && sideY < 0)
+	{
+		column = GetColumn(x, y);
+		low = (_borders[4][x] >> y) & 1;
+		high = (_borders[5][x] >> y) & 1;
+	}
+	else if (sideY < 0)
+	{
+		// Beside the chunk along x, the ends are on the edges along y
+		column = _borders[sideX][y];
+		low = (_edges[1][sideX * 2] >> y) & 1;
+		high = (_edges[1][(sideX * 2) + 1] >> y) & 1;
+	}
+	else if (sideX < 0)
+	{
+		// Beside the chunk along y, the ends are on the edges along x
+		column = _borders[2 + sideY][x];
+		low = (_edges[0][sideY * 2] >> x) & 1;
+		high = (_edges[0][(sideY * 2) + 1] >> x) & 1;
+	}
+	else
+	{
+		// Diagonally across from the chunk, the column is an edge along z and the ends are corners
+		column = _edges[2][(sideX * 2) + sideY];
+		low = (_corners >> ((sideX << 2) | (sideY << 1))) & 1;
+		high = (_corners >> ((sideX << 2) | (sideY << 1) | 1)) & 1;
+	}
+
+	return ((unsigned long long)column << 1) | low | ((unsigned long long)high << (CHUNK_SIZE + 1));
+}
+
+unsigned char VoxelChunk::GetLight(int x, int y, int z) const
+{
+	if (_light)
+	{
+		return _light[GetVoxelIndex(x, y, z)];
+	}
+
+	return IsActive(x, y, z) ? 0 : SKY_LIGHT;
+}
+
+void VoxelChunk::SetLight(int x, int y, int z, unsigned char light)
+{
+	// Write the default light out before changing any of it
+	if (!_light)
 	{
-		for (int j = 0; j < CHUNK_SIZE; ++j)
+		_light = new unsigned char[CHUNK_VOLUME];
+
+		for (int i = 0; i < CHUNK_AREA; i++)
 		{
-			delete[] _voxels[i][j];
+			Column column = GetColumn(i / CHUNK_SIZE, i % CHUNK_SIZE);
+			unsigned char* light = _light + (i * CHUNK_SIZE);
+
+			for (int j = 0; j < CHUNK_SIZE; j++)
+			{
+				light[j] = ((column >> j) & 1) ? 0 : SKY_LIGHT;
+			}
 		}
+	}
+
+	_light[GetVoxelIndex(x, y, z)] = light;
+}
 
-		delete[] _voxels[i];
+void VoxelChunk::ClearLight()
+{
+	if (!_light)
+	{
+		_light = new unsigned char[CHUNK_VOLUME];
 	}
-	delete[] _voxels;
+
+	memset(_light, 0, CHUNK_VOLUME);
 }
 
-bool VoxelChunk::Initialize(ID3D11Device * device, char * modelFilename, int textureIndex, ModelType* model, int vertexCount, int indexCount, int xPos, int yPos, int zPos)
+void VoxelChunk::ResetLight()
 {
-	bool result;
+	delete[] _light;
+	_light = 0;
+}
 
-	_model = model;
+void VoxelChunk::UpdateLightBorders(const VoxelChunk* const neighbours[6])
+{
+	const int size = CHUNK_SIZE;
+	bool defaultLight = (_light == 0);
 
-	_xPos = xPos;
-	_yPos = yPos;
-	_zPos = zPos;
+	for (int face = 0; face < 6; face++)
+	{
+		if (neighbours[face] && neighbours[face]->HasLight())
+		{
+			defaultLight = false;
+		}
+	}
+
+	if (defaultLight)
+	{
+		delete[] _meshLight;
+		_meshLight = 0;
+		return;
+	}
 
-	CreateMesh();
+	if (!_meshLight)
+	{
+		_meshLight = new unsigned char[PADDED_VOLUME];
+	}
 
+	// Only the voxels inside the chunk and on the layers against its faces are read, the edges and corners are left dark
+	memset(_meshLight, 0, PADDED_VOLUME);
 
-	if (_newVoxels.size() == 0)
+	for (int x = 0; x < size; x++)
 	{
-		_hasBlocks = false;
-		return true;
+		for (int y = 0; y < size; y++)
+		{
+			unsigned char* light = _meshLight + (((((x + 1) * PADDED_SIZE) + y + 1) * PADDED_SIZE) + 1);
+
+			if (_light)
+			{
+				memcpy(light, _light + GetVoxelIndex(x, y, 0), size);
+				continue;
+			}
+
+			Column column = GetColumn(x, y);
+			for (int z = 0; z < size; z++)
+			{
+				light[z] = ((column >> z) & 1) ? 0 : SKY_LIGHT;
+			}
+		}
 	}
-	else
+
+	// A missing neighbour counts as empty, so it is in full sunlight
+	for (int face = 0; face < 6; face++)
 	{
-		_hasBlocks = true;
+		const VoxelChunk* neighbour = neighbours[face];
+		int axis = face / 2;
+		int outside = (face & 1) ? size : -1;
+		int inside = (face & 1) ? 0 : size - 1;
+
+		for (int p = 0; p < size; p++)
+		{
+			for (int q = 0; q < size; q++)
+			{
+				int padded[3], voxel[3];
+
+				// Along x the layer is indexed by y then z, along y by x then z and along z by x then y
+				int first = (axis == 0) ? 1 : 0;
+				int second = (axis == 2) ? 1 : 2;
+
+				padded[axis] = outside;
+				padded[first] = p;
+				padded[second] = q;
+				voxel[axis] = inside;
+				voxel[first] = p;
+				voxel[second] = q;
+
+				_meshLight[((((padded[0] + 1) * PADDED_SIZE) + padded[1] + 1) * PADDED_SIZE) + padded[2] + 1] =
+					neighbour ? neighbour->GetLight(voxel[0], voxel[1], voxel[2]) : SKY_LIGHT;
+			}
+		}
 	}
+}
 
-	// Initialize the vertex and index buffers.
-	result = InitializeBuffers(device, vertexCount, indexCount);
-	if (!result)
+// Spreads the seed voxels along the runs of open voxels holding them, both ways along the column
+static inline VoxelChunk::Column FillRuns(VoxelChunk::Column seeds, VoxelChunk::Column open)
+{
+	VoxelChunk::Column up = seeds & open, down = up;
+	VoxelChunk::Column upOpen = open, downOpen = open;
+
+	for (int shift = 1; shift < VoxelChunk::CHUNK_SIZE; shift *= 2)
 	{
-		return false;
+		up |= (up << shift) & upOpen;
+		upOpen &= upOpen << shift;
+		down |= (down >> shift) & downOpen;
+		downOpen &= downOpen >> shift;
 	}
 
-	return true;
+	return up | down;
 }
 
-int VoxelChunk::GetIndexCount()
+void VoxelChunk::UpdateConnectivity()
 {
-	return _indexCount;
+	const int size = CHUNK_SIZE;
+	const Column full = (size == sizeof(Column) * 8) ? ~(Column)0 : (((Column)1 << size) - 1);
+	const Column ends = (Column)1 | ((Column)1 << (size - 1));
+
+	if (_storage == VoxelStorage_Uniform)
+	{
+		memset(_connectedFaces, (_uniformValue == 0) ? 0x3F : 0, sizeof(_connectedFaces));
+		return;
+	}
+
+	// The empty voxels not yet reached from a face, and the region being flooded
+	static thread_local Column remaining[CHUNK_AREA];
+	static thread_local Column region[CHUNK_AREA];
+
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			remaining[GetColumnIndex(x, y)] = ~GetColumn(x, y) & full;
+		}
+	}
+
+	memset(_connectedFaces, 0, sizeof(_connectedFaces));
+	memset(region, 0, sizeof(region));
+
+	// Flood each region of empty voxels from a voxel on a face of the chunk. Regions that touch no face can never
+	// be seen through, so they are skipped.
+	for (int seed = 0; seed < CHUNK_AREA; seed++)
+	{
+		int seedX = seed / size;
+		int seedY = seed % size;
+		bool side = (seedX == 0 || seedX == size - 1 || seedY == 0 || seedY == size - 1);
+		Column seedBits = remaining[seed] & (side ? full : ends);
+
+		while (seedBits)
+		{
+			region[seed] = seedBits & (~seedBits + 1);
+
+			// Grow the region until it stops changing. Each column fills its open runs straight away, and sweeping
+			// forwards and then backwards carries the region along x and y a whole row at a time. Only the columns
+			// next to the region so far are swept, growing as the region does, so the small pockets of noisy chunks
+			// stay cheap.
+			int minX = seedX, maxX = seedX, minY = seedY, maxY = seedY;
+			bool changed = true;
+
+			for (int pass = 0; changed; pass++)
+			{
+				int direction = (pass & 1) ? -1 : 1;
+				changed = false;
+
+				for (int x = (direction > 0) ? minX - 1 : maxX + 1; (direction > 0) ? x <= maxX + 1 : x >= minX - 1; x += direction)
+				{
+					if (x < 0 || x >= size)
+					{
+						continue;
+					}
+
+					for (int y = (direction > 0) ? minY - 1 : maxY + 1; (direction > 0) ? y <= maxY + 1 : y >= minY - 1; y += direction)
+					{
+						if (y < 0 || y >= size)
+						{
+							continue;
+						}
+
+						int i = GetColumnIndex(x, y);
+						Column column = region[i];
+						Column grown = column;
+
+						grown |= (x > 0) ? region[i - size] : 0;
+						grown |= (x < size - 1) ? region[i + size] : 0;
+						grown |= (y > 0) ? region[i - 1] : 0;
+						grown |= (y < size - 1) ? region[i + 1] : 0;
+						grown = FillRuns(grown, remaining[i]);
+
+						if (grown != column)
+						{
+							region[i] = grown;
+							changed = true;
+
+							minX = (x < minX) ? x : minX;
+							maxX = (x > maxX) ? x : maxX;
+							minY = (y < minY) ? y : minY;
+							maxY = (y > maxY) ? y : maxY;
+						}
+					}
+				}
+			}
+
+			// Note the faces the region reaches, in the order -x, +x, -y, +y, -z, +z, and clear it for the next
+			unsigned char faces = 0;
+			for (int x = minX; x <= maxX; x++)
+			{
+				for (int y = minY; y <= maxY; y++)
+				{
+					Column column = region[GetColumnIndex(x, y)];
+					if (!column)
+					{
+						continue;
+					}
+
+					faces |= (x == 0) ? 0x01 : 0;
+					faces |= (x == size - 1) ? 0x02 : 0;
+					faces |= (y == 0) ? 0x04 : 0;
+					faces |= (y == size - 1) ? 0x08 : 0;
+					faces |= (column & 1) ? 0x10 : 0;
+					faces |= ((column >> (size - 1)) & 1) ? 0x20 : 0;
+
+					remaining[GetColumnIndex(x, y)] &= ~column;
+					region[GetColumnIndex(x, y)] = 0;
+				}
+			}
+
+			for (int face = 0; face < 6; face++)
+			{
+				if (faces & (1 << face))
+				{
+					_connectedFaces[face] |= faces;
+				}
+			}
+
+			seedBits = remaining[seed] & (side ? full : ends);
+		}
+	}
 }
 
-void VoxelChunk::Update(float deltaTime)
+int VoxelChunk::GetMemoryUsage() const
 {
+	return sizeof(VoxelChunk) + GetVoxelBytes() + (_light ? CHUNK_VOLUME : 0);
 }
 
-void VoxelChunk::Render(ID3D11DeviceContext * deviceContext)
+int VoxelChunk::GetVoxelBytes() const
 {
-	unsigned int stride;
-	unsigned int offset;
+	switch (_storage)
+	{
+	case VoxelStorage_Octree:
+		return _octree.GetMemoryUsage();
 
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
-	offset = 0;
+	case VoxelStorage_Dense:
+		return DENSE_VOXEL_BYTES;
 
-	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &_vertexBuffer, &stride, &offset);
+	default:
+		return 0;
+	}
+}
 
-	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+void VoxelChunk::SetModel(ModelType* model, int vertexCount)
+{
+	_model = model;
+	_modelVertexCount = vertexCount;
+}
 
-	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+void VoxelChunk::CreateMesh(VoxelMeshMode meshMode, MeshData& mesh)
+{
+	mesh.Clear();
 
-	return;
+	switch (meshMode)
+	{
+	case VoxelMeshMode_Cubes:
+		FindSurfaceVoxels();
+		CreateCubeMesh(mesh, _modelVertexCount);
+		break;
+
+	case VoxelMeshMode_Culled:
+		VoxelMesher::CreateCulledMesh(*this, mesh);
+		break;
+
+	case VoxelMeshMode_Greedy:
+		VoxelMesher::CreateGreedyMesh(*this, mesh);
+		break;
+
+	case VoxelMeshMode_Binary:
+	case VoxelMeshMode_BinaryGreedy:
+		GetBinaryMesher().CreateMesh(*this, meshMode == VoxelMeshMode_BinaryGreedy, mesh);
+		break;
+
+	case VoxelMeshMode_SurfaceNets:
+		{
+			static thread_local SurfaceNetsMesher surfaceNetsMesher;
+			surfaceNetsMesher.CreateMesh(*this, _generator, mesh);
+		}
+		break;
+	}
 }
 
-void VoxelChunk::CreateMesh()
+void VoxelChunk::CreateLodMesh(int lod, MeshData& mesh)
 {
-	_newVoxels.clear();
+	typedef BinaryVoxelMesher::Mask Mask;
 
-	bool lDefault = false;
-	for (int x = 0; x < CHUNK_SIZE; x++)
+	// Every thread keeps its own copy of the full detail voxels and the coarse voxels made from them
+	static thread_local Column columns[CHUNK_AREA];
+	static thread_local unsigned char blockTypes[CHUNK_VOLUME / 2];
+	static thread_local Mask lodColumns[CHUNK_AREA];
+	static thread_local unsigned char lodBlockTypes[CHUNK_VOLUME / 2];
+	static thread_local Mask lodBorders[VoxelMesher::Face_Count * CHUNK_SIZE];
+
+	mesh.Clear();
+
+	if (lod <= 0 || lod >= LOD_COUNT)
 	{
-		for (int y = 0; y < CHUNK_SIZE; y++)
+		return;
+	}
+
+	const int scale = 1 << lod;
+	const int size = CHUNK_SIZE >> lod;
+	const int volume = scale * scale * scale;
+	const Column run = ((Column)1 << scale) - 1;
+
+	CopyVoxels(columns, blockTypes);
+	memset(lodBlockTypes, 0, ((size * size * size) + 1) / 2);
+
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
 		{
-			for (int z = 0; z < CHUNK_SIZE; z++)
+			Mask lodColumn = 0;
+
+			for (int z = 0; z < size; z++)
 			{
-				if (_voxels[x][y][z].IsActive() == false)
+				int solid = 0;
+
+				for (int i = 0; i < scale; i++)
 				{
-					// Don't create triangle data for inactive blocks
-					continue;
+					const Column* row = columns + GetColumnIndex((x * scale) + i, y * scale);
+
+					for (int j = 0; j < scale; j++)
+					{
+						solid += CountBits((row[j] >> (z * scale)) & run);
+					}
 				}
 
-				bool lXNegative = lDefault;
-				if (x > 0)
-					lXNegative = _voxels[x - 1][y][z].IsActive();
+				if (solid * 2 >= volume)
+				{
+					lodColumn |= (Mask)1 << z;
+				}
+			}
+
+			lodColumns[(x * size) + y] = lodColumn;
+		}
+	}
+
+	// A coarse voxel just outside the chunk only counts as solid when every voxel of the border it covers is. Any
+	// other voxel along the sides gets a face, which stands in for a skirt where the neighbour is drawn at another level.
+	for (int face = 0; face < VoxelMesher::Face_Count; face++)
+	{
+		for (int p = 0; p < size; p++)
+		{
+			Column solid = ~(Column)0;
+			Mask layer = 0;
+
+			for (int i = 0; i < scale; i++)
+			{
+				solid &= _borders[face][(p * scale) + i];
+			}
+
+			for (int q = 0; q < size; q++)
+			{
+				if (((solid >> (q * scale)) & run) == run)
+				{
+					layer |= (Mask)1 << q;
+				}
+			}
 
-				bool lXPositive = lDefault;
-				if (x < CHUNK_SIZE - 1)
-					lXPositive = _voxels[x + 1][y][z].IsActive();
+			lodBorders[(face * size) + p] = layer;
+		}
+	}
 
-				bool lYNegative = lDefault;
-				if (y > 0)
-					lYNegative = _voxels[x][y - 1][z].IsActive();
+	// Only the coarse voxels with a face need a block type, which leaves out the buried ones
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			Mask column = lodColumns[(x * size) + y];
+			if (!column)
+			{
+				continue;
+			}
 
-				bool lYPositive = lDefault;
-				if (y < CHUNK_SIZE - 1)
-					lYPositive = _voxels[x][y + 1][z].IsActive();
+			Mask left = (x > 0) ? lodColumns[((x - 1) * size) + y] : lodBorders[(VoxelMesher::Face_NegativeX * size) + y];
+			Mask right = (x < size - 1) ? lodColumns[((x + 1) * size) + y] : lodBorders[(VoxelMesher::Face_PositiveX * size) + y];
+			Mask bottom = (y > 0) ? lodColumns[(x * size) + y - 1] : lodBorders[(VoxelMesher::Face_NegativeY * size) + x];
+			Mask top = (y < size - 1) ? lodColumns[(x * size) + y + 1] : lodBorders[(VoxelMesher::Face_PositiveY * size) + x];
+			Mask back = (column << 1) | ((lodBorders[(VoxelMesher::Face_NegativeZ * size) + x] >> y) & 1);
+			Mask front = (column >> 1) | (((lodBorders[(VoxelMesher::Face_PositiveZ * size) + x] >> y) & 1) << (size - 1));
+			unsigned long exposed = (unsigned long)(column & ~(left & right & bottom & top & back & front));
+			unsigned long z;
 
-				bool lZNegative = lDefault;
-				if (z > 0)
-					lZNegative = _voxels[x][y][z - 1].IsActive();
+			while (_BitScanForward(&z, exposed))
+			{
+				exposed &= exposed - 1;
 
-				bool lZPositive = lDefault;
-				if (z < CHUNK_SIZE - 1)
-					lZPositive = _voxels[x][y][z + 1].IsActive();
+				// Take the most common block type of the solid voxels
+				int counts[16] = { 0 };
+				int best = 0;
 
-				if (!lXNegative || !lXPositive || !lYNegative || !lYPositive || !lZNegative || !lZPositive)
+				for (int i = 0; i < scale; i++)
 				{
-					NewVoxel newVox;
-					newVox.X = x;
-					newVox.Y = y;
-					newVox.Z = z;
-					newVox.Index = (x * CHUNK_SIZE) + (y * CHUNK_SIZE) + z;
+					for (int j = 0; j < scale; j++)
+					{
+						Column bits = (columns[GetColumnIndex((x * scale) + i, (y * scale) + j)] >> (z * scale)) & run;
+						int first = GetVoxelIndex((x * scale) + i, (y * scale) + j, z * scale);
 
-					_newVoxels.push_back(newVox);
+						for (int k = 0; bits; k++, bits >>= 1)
+						{
+							if (bits & 1)
+							{
+								int type = (blockTypes[(first + k) >> 1] >> (((first + k) & 1) * 4)) & 0xF;
+								if (++counts[type] > counts[best])
+								{
+									best = type;
+								}
+							}
+						}
+					}
 				}
+
+				int index = (((x * size) + y) * size) + z;
+				lodBlockTypes[index >> 1] |= (unsigned char)(best << ((index & 1) * 4));
 			}
 		}
 	}
+
+	// The quads are scaled up to fill the chunk. The texture follows the position, so it stays the same size as at full detail.
+	GetBinaryMesher().CreateMesh(size, lodColumns, lodBlockTypes, lodBorders, 0, scale, true, mesh);
 }
 
-bool VoxelChunk::InitializeBuffers(ID3D11Device * device, int vertexCount, int indexCount)
+void VoxelChunk::FindSurfaceVoxels()
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT result;
-	int i;
+	_newVoxels.clear();
 
-	int voxelCount = _newVoxels.size();
+	for (int x = 0; x < CHUNK_SIZE; x++)
+	{
+		for (int y = 0; y < CHUNK_SIZE; y++)
+		{
+			Column column = GetColumn(x, y);
+			if (column == 0)
+			{
+				// Don't create triangle data for inactive blocks
+				continue;
+			}
 
-	_vertexCount = vertexCount * voxelCount;
-	_indexCount = indexCount * voxelCount;
+			// A voxel is hidden when all six of its neighbours are active. Shifting the column tests the
+			// z neighbours of every voxel in it at once, and the neighbouring columns hold the x and y
+			// neighbours. Past the edges of the chunk the neighbouring chunks borders are used.
+			Column hidden = ((column << 1) | ((_borders[4][x] >> y) & 1)) & ((column >> 1) | (((_borders[5][x] >> y) & 1) << (CHUNK_SIZE - 1)));
 
-	// Create the vertex array.
-	vertices = new VertexType[_vertexCount];
-	if (!vertices)
-	{
-		return false;
-	}
+			hidden &= (x > 0) ? GetColumn(x - 1, y) : _borders[0][y];
+			hidden &= (x < CHUNK_SIZE - 1) ? GetColumn(x + 1, y) : _borders[1][y];
+			hidden &= (y > 0) ? GetColumn(x, y - 1) : _borders[2][x];
+			hidden &= (y < CHUNK_SIZE - 1) ? GetColumn(x, y + 1) : _borders[3][x];
 
-	// Create the index array.
-	indices = new unsigned long[_indexCount];
-	if (!indices)
-	{
-		return false;
+			Column surface = column & ~hidden;
+
+			// Add every surface voxel in the column
+			unsigned long z;
+			while (_BitScanForward(&z, surface))
+			{
+				surface &= surface - 1;
+
+				NewVoxel newVox;
+				newVox.X = x;
+				newVox.Y = y;
+				newVox.Z = (int)z;
+				newVox.Index = GetVoxelIndex(x, y, (int)z);
+
+				_newVoxels.push_back(newVox);
+			}
+		}
 	}
+}
+
+void VoxelChunk::CreateCubeMesh(MeshData& mesh, int vertexCount)
+{
+	int voxelCount = (int)_newVoxels.size();
+	float chunkX = (float)(_xPos * CHUNK_SIZE);
+	float chunkY = (float)(_yPos * CHUNK_SIZE);
+	float chunkZ = (float)(_zPos * CHUNK_SIZE);
+
+	mesh.Vertices.resize(vertexCount * voxelCount);
+	mesh.Indices.resize(vertexCount * voxelCount);
 
 	for (int j = 0; j < voxelCount; j++)
 	{
+		// Scale the model from its 2 unit size down to a single voxel and move it to the voxels position
+		float x = chunkX + _newVoxels[j].X + 0.5f;
+		float y = chunkY + _newVoxels[j].Y + 0.5f;
+		float z = chunkZ + _newVoxels[j].Z + 0.5f;
+
 		// Load the vertex array and index array with data.
-		for (i = 0; i<vertexCount; i++)
+		for (int i = 0; i < vertexCount; i++)
 		{
 			int index = (j * vertexCount) + i;
-			
-			vertices[index].position = XMFLOAT3(_model[i].x * _newVoxels[j].X * _xPos, _model[i].y * _newVoxels[j].Y * _yPos, _model[i].z * _newVoxels[j].Z * _zPos);
-			vertices[index].texture = XMFLOAT2(_model[i].tu, _model[i].tv);
-			vertices[index].normal = XMFLOAT3(_model[i].nx, _model[i].ny, _model[i].nz);
 
-			indices[index] = index;
+			mesh.Vertices[index].position = XMFLOAT3(x + (_model[i].x * 0.5f), y + (_model[i].y * 0.5f), z + (_model[i].z * 0.5f));
+			mesh.Vertices[index].texture = XMFLOAT2(_model[i].tu, _model[i].tv);
+			mesh.Vertices[index].normal = XMFLOAT3(_model[i].nx, _model[i].ny, _model[i].nz);
+			mesh.Vertices[index].light = PackVertexLight(3, SKY_LIGHT);
+
+			mesh.Indices[index] = index;
 		}
 	}
+}
+
+void VoxelChunk::ReleaseBuffers()
+{
+	for (int lod = 0; lod < LOD_COUNT; lod++)
+	{
+		ReleaseBuffers(_buffers[lod]);
+	}
+
+	_validMeshes = 0;
+}
+
+void VoxelChunk::ReleaseBuffers(MeshBuffers& buffers)
+{
+	if (buffers.IndexBuffer)
+	{
+		buffers.IndexBuffer->Release();
+		buffers.IndexBuffer = 0;
+	}
+
+	if (buffers.VertexBuffer)
+	{
+		buffers.VertexBuffer->Release();
+		buffers.VertexBuffer = 0;
+	}
+
+	buffers.VertexCount = 0;
+	buffers.IndexCount = 0;
+	buffers.VertexCapacity = 0;
+	buffers.IndexCapacity = 0;
+	buffers.VertexStride = 0;
+}
+
+bool VoxelChunk::InitializeBuffers(ID3D11Device * device, const MeshData& mesh, MeshBuffers& buffers)
+{
+	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
+	D3D11_SUBRESOURCE_DATA vertexData, indexData;
+	HRESULT result;
+
+	buffers.VertexCapacity = mesh.GetVertexCount();
+	buffers.IndexCapacity = (int)mesh.Indices.size();
+	buffers.VertexStride = mesh.IsPacked() ? sizeof(PackedVertexType) : sizeof(VertexType);
 
 	// Set up the description of the static vertex buffer.
 	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType) * _vertexCount;
+	vertexBufferDesc.ByteWidth = buffers.VertexStride * buffers.VertexCapacity;
 	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vertexBufferDesc.CPUAccessFlags = 0;
 	vertexBufferDesc.MiscFlags = 0;
 	vertexBufferDesc.StructureByteStride = 0;
 
 	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
+	vertexData.pSysMem = mesh.IsPacked() ? (const void*)&mesh.PackedVertices[0] : (const void*)&mesh.Vertices[0];
 	vertexData.SysMemPitch = 0;
 	vertexData.SysMemSlicePitch = 0;
 
 	// Now create the vertex buffer.
-	result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &_vertexBuffer);
+	result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &buffers.VertexBuffer);
 	if (FAILED(result))
 	{
 		return false;
@@ -232,30 +1232,23 @@ bool VoxelChunk::InitializeBuffers(ID3D11Device * device, int vertexCount, int i
 
 	// Set up the description of the static index buffer.
 	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long) * _indexCount;
+	indexBufferDesc.ByteWidth = sizeof(unsigned long) * buffers.IndexCapacity;
 	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	indexBufferDesc.CPUAccessFlags = 0;
 	indexBufferDesc.MiscFlags = 0;
 	indexBufferDesc.StructureByteStride = 0;
 
 	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
+	indexData.pSysMem = &mesh.Indices[0];
 	indexData.SysMemPitch = 0;
 	indexData.SysMemSlicePitch = 0;
 
 	// Create the index buffer.
-	result = device->CreateBuffer(&indexBufferDesc, &indexData, &_indexBuffer);
+	result = device->CreateBuffer(&indexBufferDesc, &indexData, &buffers.IndexBuffer);
 	if (FAILED(result))
 	{
 		return false;
 	}
 
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-
-	delete[] indices;
-	indices = 0;
-
 	return true;
 }
@@ -1,14 +1,18 @@
 #pragma once
 
 #include "Voxel.h"
+#include "SparseVoxelOctree.h"
 
 #include <d3d11.h>
 #include <directxmath.h>
+#include <intrin.h>
 
 #include <vector>
 
 using namespace DirectX;
 
+class VoxelGenerator;
+
 class VoxelChunk
 {
 private:
@@ -20,13 +24,38 @@ private:
 			int Z;
 			int Index;
 	};
+
+	// The buffers holding the mesh for one level of detail
+	struct MeshBuffers
+	{
+		ID3D11Buffer*	VertexBuffer;
+		ID3D11Buffer*	IndexBuffer;
+		int				VertexCount, IndexCount;
+		int				VertexCapacity, IndexCapacity;
+		int				VertexStride;
+	};
+public:
 	struct VertexType
 	{
 		XMFLOAT3 position;
 		XMFLOAT2 texture;
 		XMFLOAT3 normal;
+		unsigned int light;		// The ambient occlusion, sunlight and block light in the red, green and blue bytes
 	};
-public:
+
+	// The vertex the block meshers write, 8 bytes in place of the 36 above. The position is a corner of the voxels
+	// counted from the corner of the chunk, which is passed to the shader with each draw, and the normal and texture
+	// coordinates follow from the face. VoxelMesher packs and unpacks them.
+	//   geometry: x, y and z from 0 to 64 in bits 0-6, 7-13 and 14-20, so a block can be as big as the binary mesher
+	//             allows, and the face in bits 21-23
+	//   surface: the ambient occlusion in bits 0-1, the light of the voxel the face looks onto in bits 8-15 and the
+	//            texture layer, which is the block type, in bits 16-23
+	struct PackedVertexType
+	{
+		unsigned int geometry;
+		unsigned int surface;
+	};
+
 	struct ModelType
 	{
 		float x, y, z;
@@ -34,35 +63,227 @@ public:
 		float nx, ny, nz;
 	};
 
+	// The block meshers fill in the packed vertices and the others the full vertices, so only one of them is used
+	struct MeshData
+	{
+		std::vector<VertexType>			Vertices;
+		std::vector<PackedVertexType>	PackedVertices;
+		std::vector<unsigned long>		Indices;
+
+		void Clear() { Vertices.clear(); PackedVertices.clear(); Indices.clear(); }
+		bool IsPacked() const { return !PackedVertices.empty(); }
+		int GetVertexCount() const { return (int)(Vertices.size() + PackedVertices.size()); }
+	};
+
 	VoxelChunk();
 	~VoxelChunk();
 
-	bool Initialize(ID3D11Device* device, char* modelFilename, int textureIndex, ModelType* model, int vertexCount, int indexCount, int xPos, int yPos, int zPos);
+	void SetPosition(int xPos, int yPos, int zPos);
+
+	// Builds the mesh into memory owned by the chunk. This only touches the chunk, so chunks can be meshed on any thread.
+	void BuildMesh(VoxelMeshMode meshMode);
+
+	// Builds a coarser mesh for far away chunks the same way, at a level of detail from 1 to LOD_COUNT - 1
+	void BuildLodMesh(int lod);
 
+	// Copies the mesh built last into the buffers for its level of detail, frees it and draws that level from then
+	// on. The buffers are reused when the mesh fits in them, otherwise they are recreated. Must run on the thread that
+	// owns the device.
+	bool UploadMesh(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	bool HasPendingMesh() const { return _hasPendingMesh; }
+
+	// Each level of detail keeps its buffers once uploaded, so a chunk moving between levels only needs meshing the
+	// first time. Editing the chunk or its neighbours leaves every level out of date until it is meshed again.
+	bool HasMesh(int lod) const { return ((_validMeshes >> lod) & 1) != 0; }
+	void InvalidateMeshes() { _validMeshes = 0; }
+	void SetDrawLod(int lod) { _drawLod = lod; }
+	int GetDrawLod() const { return _drawLod; }
+
+	// The counts for the level of detail being drawn
 	int GetIndexCount();
+	int GetVertexCount();
+	int GetVertexStride() const { return _buffers[_drawLod].VertexStride; }
+
+	// Whether the level of detail being drawn has packed vertices, which are drawn with the corner of the chunk
+	bool IsPacked() const { return _buffers[_drawLod].VertexStride == sizeof(PackedVertexType); }
+	XMFLOAT3 GetOrigin() const { return XMFLOAT3((float)(_xPos * CHUNK_SIZE), (float)(_yPos * CHUNK_SIZE), (float)(_zPos * CHUNK_SIZE)); }
 
 	void Update(float deltaTime);
 
 	void Render(ID3D11DeviceContext* deviceContext);
 
-	void CreateMesh();
+	void SetModel(ModelType* model, int vertexCount);
 
-	bool HasBlocks() { return _hasBlocks; }
+	// The smooth mesher shapes the surface with the density the chunk was generated from. Without a generator the
+	// surface runs halfway between the voxels.
+	void SetGenerator(const VoxelGenerator* generator) { _generator = generator; }
+	void CreateMesh(VoxelMeshMode meshMode, MeshData& mesh);
+
+	// Meshes the chunk at 2^lod voxels to a side. Each coarse voxel is solid when at least half the voxels it covers
+	// are, and takes the most common of their block types. The sides of the chunk are closed off unless the voxels
+	// just outside are all solid, which hides the cracks against neighbours drawn at a different level.
+	void CreateLodMesh(int lod, MeshData& mesh);
+
+	bool HasBlocks() { return _buffers[_drawLod].IndexCount > 0; }
+	bool IsEmpty() const;
+
+	// Packs the ambient occlusion of a vertex, from 0 in a corner to 3 in the open, and the light byte of the voxel
+	// it faces into the light of a vertex, each scaled to fill a byte
+	static unsigned int PackVertexLight(int occlusion, unsigned char light) { return (occlusion * 85) | (((light >> 4) * 17) << 8) | (((light & 0xF) * 17) << 16) | 0xFF000000; }
 
 	static const int CHUNK_SIZE = 32;
+	static const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+	static const int CHUNK_VOLUME = CHUNK_AREA * CHUNK_SIZE;
+	static_assert(CHUNK_SIZE <= 64, "The corners of the voxels must fit in the 7 bits of a packed vertex");
+
+	// Full detail and meshes at 2x, 4x and 8x the voxel size
+	static const int LOD_COUNT = 4;
+
+	// One bit per voxel along z for every (x, y) column
+	typedef SparseVoxelOctree::Column Column;
+	static_assert(CHUNK_SIZE <= sizeof(Column) * 8, "A chunk column must fit in a single Column");
+
+	// The bytes a chunk needs to hold every voxel in a dense array
+	static const int DENSE_VOXEL_BYTES = (CHUNK_AREA * sizeof(Column)) + (CHUNK_VOLUME / 2);
+
+	// The light of a voxel is a byte, sunlight in the high 4 bits and the light of lamps in the low 4
+	static const unsigned char SKY_LIGHT = 0xF0;
+
+	// The chunk and its face neighbours with one voxel more on every side, as the mesher reads the light
+	static const int PADDED_SIZE = CHUNK_SIZE + 2;
+	static const int PADDED_VOLUME = PADDED_SIZE * PADDED_SIZE * PADDED_SIZE;
+
+	// How the voxels are held. A chunk with every voxel the same holds a single value, a chunk that is mostly
+	// uniform is held in an octree and anything else in a dense array. Edits need the dense array, so a chunk
+	// expands to it when a voxel is set and stays that way until it is compacted again.
+	enum VoxelStorage
+	{
+		VoxelStorage_Uniform = 0,
+		VoxelStorage_Octree,
+		VoxelStorage_Dense,
+	};
+
+	bool IsActive(int x, int y, int z) const;
+	BlockType GetBlockType(int x, int y, int z) const;
+	void SetVoxel(int x, int y, int z, bool active, BlockType blockType);
+	void Clear();
+	void Fill(BlockType blockType);
+	void CreateSphere();
+
+	// Moves the voxels into the smallest storage that holds them, or into the dense array so they can be edited.
+	// Neither can run while the chunk is being read on another thread.
+	void Compact();
+	void Expand();
+	VoxelStorage GetStorage() const { return _storage; }
+
+	// Copies the layers of the neighbouring chunks that touch this one, so the faces against them can be culled.
+	// The neighbours are in the order -x, +x, -y, +y, -z, +z and a missing neighbour counts as empty.
+	void UpdateBorders(const VoxelChunk* const neighbours[6]);
+
+	// Copies the edges and corners of the chunks diagonally across from this one, which the smooth mesher needs to
+	// match the chunks around it. The neighbours are all 27 chunks around this one, including itself, indexed by
+	// GetNeighbourIndex, and a missing neighbour counts as empty.
+	void UpdateDiagonalBorders(const VoxelChunk* const neighbours[27]);
+	static int GetNeighbourIndex(int dx, int dy, int dz) { return (((dx + 1) * 3) + (dy + 1)) * 3 + (dz + 1); }
+
+	// Until a chunk is lit voxel by voxel every empty voxel is in full sunlight and every solid voxel is dark, which is
+	// how the generator leaves the world, so most chunks never hold any light. Setting the light of a single voxel
+	// gives the chunk a byte for every voxel, and ResetLight goes back to the default. Only the main thread and the
+	// job generating the chunk change its light.
+	unsigned char GetLight(int x, int y, int z) const;
+	void SetLight(int x, int y, int z, unsigned char light);
+	void ClearLight();
+	void ResetLight();
+	bool HasLight() const { return _light != 0; }
+
+	// Copies the light of the chunk and of the layers of its neighbours its faces look onto, in the order -x, +x,
+	// -y, +y, -z, +z, so the chunk can be meshed while the light keeps changing. Nothing is copied when they all
+	// have the default light. The copy is freed once the chunk is meshed.
+	void UpdateLightBorders(const VoxelChunk* const neighbours[6]);
+
+	// The light copied for meshing, a byte for every voxel of the padded block at index
+	// (((x + 1) * PADDED_SIZE) + y + 1) * PADDED_SIZE + z + 1, or null for the default light
+	const unsigned char* GetMeshLight() const { return _meshLight; }
+
+	// Works out which faces of the chunk can see one another through its empty voxels, for culling the chunks
+	// hidden behind solid ground. Runs as part of BuildMesh, so it only touches the chunk.
+	void UpdateConnectivity();
+
+	// The faces, as a bit per face in the border order, that the given face is joined to through empty voxels.
+	// A chunk that has not worked it out yet counts as empty, with every face joined to every other.
+	unsigned char GetConnectedFaces(int face) const { return _connectedFaces[face]; }
+	bool AreFacesConnected(int first, int second) const { return (_connectedFaces[first] & (1 << second)) != 0; }
+
+	Column GetColumn(int x, int y) const;
+
+	// Fills the layer of voxels at the given coordinate along an axis, laid out the same way as the borders
+	void GetLayer(int axis, int coordinate, Column layer[CHUNK_SIZE]) const;
+
+	// The dense arrays are only there when the chunk is held densely, otherwise these are null
+	const Column* GetColumns() const { return _occupancy; }
+	const unsigned char* GetBlockTypes() const { return _blockTypes; }
+
+	// Writes every voxel out in the dense layout, whichever way the chunk holds them, or replaces them all from it
+	void CopyVoxels(Column* columns, unsigned char* blockTypes) const;
+	void SetVoxels(const Column* columns, const unsigned char* blockTypes);
+	void GetPosition(int& x, int& y, int& z) const { x = _xPos; y = _yPos; z = _zPos; }
+
+	// The neighbouring layer on the given side. Along x it is indexed by y with a bit per z, along y by x with
+	// a bit per z and along z by x with a bit per y.
+	Column GetBorder(int side, int index) const { return _borders[side][index]; }
+
+	// The column at (x, y) with one voxel more at each end, for x and y from -1 to CHUNK_SIZE. Bit 0 is the voxel
+	// at z = -1, and everything outside the chunk comes from the borders.
+	unsigned long long GetPaddedColumn(int x, int y) const;
+
+	int GetMemoryUsage() const;
+	int GetVoxelBytes() const;
+	int GetBufferBytes() const;
 
 private:
-	bool InitializeBuffers(ID3D11Device* device, int vertexCount, int indexCount);
+	void FindSurfaceVoxels();
+	void CreateCubeMesh(MeshData& mesh, int vertexCount);
+
+	bool InitializeBuffers(ID3D11Device* device, const MeshData& mesh, MeshBuffers& buffers);
+	void ReleaseBuffers();
+	static void ReleaseBuffers(MeshBuffers& buffers);
+	void ReleaseVoxels();
+
+	static int GetColumnIndex(int x, int y) { return (x * CHUNK_SIZE) + y; }
+	static int GetVoxelIndex(int x, int y, int z) { return (GetColumnIndex(x, y) * CHUNK_SIZE) + z; }
+
+	// The blocks data. Uniform chunks hold just the value of every voxel, 0 when inactive and 1 + the block type
+	// when active. Dense chunks hold a single allocation, with the occupancy bitset first followed by the block
+	// types which are packed two to a byte.
+	VoxelStorage				_storage;
+	unsigned char				_uniformValue;
+	SparseVoxelOctree			_octree;
+	unsigned char*				_voxelData;
+	Column*						_occupancy;
+	unsigned char*				_blockTypes;
+	Column						_borders[6][CHUNK_SIZE];
+
+	// The edges along each axis are indexed by which side of the first and then the second other axis they are
+	// on, with a bit per voxel along the axis. The corners have a bit each at (x side * 4) + (y side * 2) + z side.
+	Column						_edges[3][4];
+	unsigned char				_corners;
+	unsigned char				_connectedFaces[6];
 
-	// The blocks data
-	Voxel***					_voxels;
+	// The light of every voxel laid out like the block types, or null for the default light
+	unsigned char*				_light;
+	unsigned char*				_meshLight;
 
 	ModelType*					_model;
+	int							_modelVertexCount;
+	const VoxelGenerator*		_generator;
 
-	ID3D11Buffer*				_vertexBuffer, *_indexBuffer;
-	int							_vertexCount, _indexCount;
+	MeshBuffers					_buffers[LOD_COUNT];
+	int							_drawLod;
+	unsigned char				_validMeshes;
 
-	bool						_hasBlocks;
+	MeshData					_mesh;
+	int							_pendingLod;
+	bool						_hasPendingMesh;
 	std::vector<NewVoxel>		_newVoxels;
 	int							_xPos, _yPos, _zPos;
 };
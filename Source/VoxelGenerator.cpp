@@ -0,0 +1,186 @@
+#include "VoxelGenerator.h"
+
+#include <math.h>
+
+#include <vector>
+
+VoxelGenerator::VoxelGenerator()
+{
+	_centre = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	_radius = 0.0f;
+	_surfaceHeight = 0.0f;
+}
+
+void VoxelGenerator::Initialize(int seed, XMFLOAT3 centre, float radius, float surfaceHeight)
+{
+	_centre = centre;
+	_radius = radius;
+	_surfaceHeight = surfaceHeight;
+
+	_noise.SetSeed(seed);
+	_noise.SetNoiseType(FastNoise::SimplexFractal);
+	_noise.SetFrequency(0.02f);
+	_noise.SetFractalOctaves(3);
+}
+
+void VoxelGenerator::GenerateChunk(VoxelChunk& chunk) const
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	int chunkPosition[3];
+	float centre[3] = { _centre.x, _centre.y, _centre.z };
+	float origin[3];
+	float nearest = 0.0f, farthest = 0.0f;
+
+	chunk.GetPosition(chunkPosition[0], chunkPosition[1], chunkPosition[2]);
+
+	// Work relative to the centre of the planet, and find how close to and how far from it the chunk reaches
+	for (int i = 0; i < 3; i++)
+	{
+		origin[i] = (float)(chunkPosition[i] * size) - centre[i];
+
+		float low = origin[i];
+		float high = origin[i] + size;
+		float closest = (low > 0.0f) ? low : ((high < 0.0f) ? -high : 0.0f);
+		float furthest = (fabsf(low) > fabsf(high)) ? fabsf(low) : fabsf(high);
+
+		nearest += closest * closest;
+		farthest += furthest * furthest;
+	}
+
+	nearest = sqrtf(nearest);
+	farthest = sqrtf(farthest);
+
+	// Chunks that are wholly above the highest surface or below the deepest dirt need no noise
+	if (nearest > _radius + _surfaceHeight)
+	{
+		chunk.Clear();
+		return;
+	}
+
+	if (farthest < _radius - _surfaceHeight - DIRT_DEPTH)
+	{
+		chunk.Fill(BlockType_Stone);
+		return;
+	}
+
+	chunk.Clear();
+
+	// The voxels are solid wherever the density is, so the smooth meshers agree with the blocks
+	static thread_local float density[VoxelChunk::CHUNK_VOLUME];
+	SampleDensity(chunkPosition[0] * size, chunkPosition[1] * size, chunkPosition[2] * size, size, size, size, density);
+
+	for (int i = 0; i < VoxelChunk::CHUNK_VOLUME; i++)
+	{
+		float depth = density[i];
+		if (depth < 0.0f)
+		{
+			continue;
+		}
+
+		BlockType blockType = BlockType_Stone;
+		if (depth < 1.0f)
+		{
+			blockType = BlockType_Grass;
+		}
+		else if (depth < DIRT_DEPTH)
+		{
+			blockType = BlockType_Dirt;
+		}
+
+		chunk.SetVoxel(i / VoxelChunk::CHUNK_AREA, (i / size) % size, i % size, true, blockType);
+	}
+}
+
+void VoxelGenerator::SampleDensity(int x, int y, int z, int countX, int countY, int countZ, float* density) const
+{
+	// The points in the band the surface can move through are gathered here and given their noise in one batch
+	static thread_local std::vector<int> indices;
+	static thread_local std::vector<float> noiseX, noiseY, noiseZ, noise;
+
+	float highest = _radius + _surfaceHeight;
+	float deepest = _radius - _surfaceHeight - DIRT_DEPTH;
+
+	indices.clear();
+	noiseX.clear();
+	noiseY.clear();
+	noiseZ.clear();
+
+	for (int i = 0; i < countX; i++)
+	{
+		float px = (x + i + 0.5f) - _centre.x;
+
+		for (int j = 0; j < countY; j++)
+		{
+			float py = (y + j + 0.5f) - _centre.y;
+			float* row = density + (((i * countY) + j) * countZ);
+
+			for (int k = 0; k < countZ; k++)
+			{
+				float pz = (z + k + 0.5f) - _centre.z;
+				float distance = sqrtf((px * px) + (py * py) + (pz * pz));
+
+				// Only the points in the band the surface can move through need the noise
+				if (distance > highest)
+				{
+					row[k] = highest - distance;
+				}
+				else if (distance < deepest)
+				{
+					row[k] = deepest - distance + DIRT_DEPTH;
+				}
+				else if (distance <= 0.0f)
+				{
+					row[k] = _radius;
+				}
+				else
+				{
+					// Sample the noise where the direction to the point crosses the planets radius, so the height only
+					// depends on the direction and every voxel in a line from the centre agrees on where the surface is
+					float scale = _radius / distance;
+
+					row[k] = -distance;
+					indices.push_back((int)(row + k - density));
+					noiseX.push_back(px * scale);
+					noiseY.push_back(py * scale);
+					noiseZ.push_back(pz * scale);
+				}
+			}
+		}
+	}
+
+	int count = (int)indices.size();
+	if (count == 0)
+	{
+		return;
+	}
+
+	noise.resize(count);
+	_noise.FillSimplexFractalSet(count, &noiseX[0], &noiseY[0], &noiseZ[0], &noise[0]);
+
+	for (int n = 0; n < count; n++)
+	{
+		density[indices[n]] += _radius + (_surfaceHeight * noise[n]);
+	}
+}
+
+int VoxelGenerator::GetSkyFace(int chunkX, int chunkY, int chunkZ) const
+{
+	const float half = VoxelChunk::CHUNK_SIZE * 0.5f;
+	float offset[3] =
+	{
+		((chunkX * VoxelChunk::CHUNK_SIZE) + half) - _centre.x,
+		((chunkY * VoxelChunk::CHUNK_SIZE) + half) - _centre.y,
+		((chunkZ * VoxelChunk::CHUNK_SIZE) + half) - _centre.z,
+	};
+
+	int axis = 0;
+	for (int i = 1; i < 3; i++)
+	{
+		if (fabsf(offset[i]) > fabsf(offset[axis]))
+		{
+			axis = i;
+		}
+	}
+
+	return (axis * 2) + ((offset[axis] > 0.0f) ? 1 : 0);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "VoxelChunk.h"
+#include "FastNoise.h"
+
+// Fills chunks with a planet of stone under a few layers of dirt topped with grass, its surface raised and lowered
+// by noise. Generating a chunk only reads from the generator, so chunks can be generated on several threads at once.
+class VoxelGenerator
+{
+public:
+	VoxelGenerator();
+
+	// The surface is moved up to surfaceHeight voxels above or below the planets radius
+	void Initialize(int seed, XMFLOAT3 centre, float radius, float surfaceHeight);
+
+	void GenerateChunk(VoxelChunk& chunk) const;
+
+	// Samples the density at the centre of a block of voxels, starting from the world voxel (x, y, z), into an array
+	// laid out like a chunks block types. The density is how far below the surface each voxel centre is, so it is
+	// positive inside the ground. Points far from the surface only get a bound with the right sign, which is all the
+	// meshers need from them. The points near the surface are given their noise together in a single batch.
+	void SampleDensity(int x, int y, int z, int countX, int countY, int countZ, float* density) const;
+
+	// The face of a chunk, in the border order, that looks out towards the sky. It is the side facing along
+	// whichever axis points most directly away from the centre of the planet, so sunlight falls in straight lines.
+	int GetSkyFace(int chunkX, int chunkY, int chunkZ) const;
+
+private:
+	static const int DIRT_DEPTH = 4;
+
+	FastNoise		_noise;
+	XMFLOAT3		_centre;
+	float			_radius;
+	float			_surfaceHeight;
+};
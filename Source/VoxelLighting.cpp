@@ -0,0 +1,385 @@
+#include "VoxelLighting.h"
+#include "VoxelTerrain.h"
+
+const int VoxelLighting::CHANNEL_SHIFTS[Channel_Count] = { 4, 0 };
+
+VoxelLighting::VoxelLighting()
+{
+	_terrain = 0;
+	_generator = 0;
+	_lastChanged = -1;
+}
+
+void VoxelLighting::Initialize(VoxelTerrain* terrain, const VoxelGenerator* generator)
+{
+	_terrain = terrain;
+	_generator = generator;
+}
+
+void VoxelLighting::LightChunk(VoxelChunk& chunk, const VoxelGenerator* generator, bool edited)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+
+	// The generator leaves no caves, so every empty voxel it makes is open to the sky
+	if (!edited)
+	{
+		chunk.ResetLight();
+		return;
+	}
+
+	// Every thread keeps its own scratch so chunks can be lit from any of them
+	static thread_local VoxelLighting lighting;
+	static thread_local VoxelChunk::Column columns[VoxelChunk::CHUNK_AREA];
+	static thread_local unsigned char blockTypes[VoxelChunk::CHUNK_VOLUME / 2];
+	static thread_local float density[VoxelChunk::CHUNK_VOLUME];
+
+	int chunkX, chunkY, chunkZ;
+	chunk.GetPosition(chunkX, chunkY, chunkZ);
+	chunk.CopyVoxels(columns, blockTypes);
+	generator->SampleDensity(chunkX * size, chunkY * size, chunkZ * size, size, size, size, density);
+
+	lighting.Initialize(0, generator);
+	chunk.ClearLight();
+
+	// Seed the sky the generator left open and the lamps, then let the fills light the rest
+	for (int i = 0; i < VoxelChunk::CHUNK_VOLUME; i++)
+	{
+		bool active = ((columns[i / size] >> (i % size)) & 1) != 0;
+		LightNode node = { &chunk, (unsigned char)(i / (size * size)), (unsigned char)((i / size) % size), (unsigned char)(i % size), 0 };
+
+		if (!active && density[i] < 0.0f)
+		{
+			chunk.SetLight(node.X, node.Y, node.Z, VoxelChunk::SKY_LIGHT);
+			lighting._addQueues[Channel_Sun].push_back(node);
+		}
+		else if (active && ((blockTypes[i >> 1] >> ((i & 1) * 4)) & 0xF) == BlockType_Lamp)
+		{
+			chunk.SetLight(node.X, node.Y, node.Z, LAMP_LEVEL);
+			lighting._addQueues[Channel_Block].push_back(node);
+		}
+	}
+
+	lighting.Propagate();
+	lighting.ClearChangedChunks();
+
+	// Edits that left the light as it would have been anyway need no light of their own
+	for (int i = 0; i < VoxelChunk::CHUNK_VOLUME; i++)
+	{
+		bool active = ((columns[i / size] >> (i % size)) & 1) != 0;
+		if (chunk.GetLight(i / (size * size), (i / size) % size, i % size) != (active ? 0 : VoxelChunk::SKY_LIGHT))
+		{
+			return;
+		}
+	}
+
+	chunk.ResetLight();
+}
+
+void VoxelLighting::UpdateVoxel(VoxelChunk* chunk, int x, int y, int z, unsigned char oldLight)
+{
+	LightNode node = { chunk, (unsigned char)x, (unsigned char)y, (unsigned char)z, 0 };
+
+	if (chunk->IsActive(x, y, z))
+	{
+		// The voxel blocks whatever light it had, and a lamp lights up around it
+		bool lamp = (chunk->GetBlockType(x, y, z) == BlockType_Lamp);
+
+		chunk->SetLight(x, y, z, lamp ? (unsigned char)LAMP_LEVEL : 0);
+		MarkChanged(node);
+
+		for (int channel = 0; channel < Channel_Count; channel++)
+		{
+			node.Level = (unsigned char)GetLevel(oldLight, channel);
+			if (node.Level > 0)
+			{
+				_removeQueues[channel].push_back(node);
+			}
+		}
+
+		if (lamp)
+		{
+			_addQueues[Channel_Block].push_back(node);
+		}
+
+		return;
+	}
+
+	// A solid voxel only has light when it is a lamp, which goes out
+	node.Level = (unsigned char)GetLevel(oldLight, Channel_Block);
+	if (node.Level > 0)
+	{
+		_removeQueues[Channel_Block].push_back(node);
+	}
+
+	chunk->SetLight(x, y, z, 0);
+	MarkChanged(node);
+
+	// The voxel is open now, so the light around it can spread in
+	for (int face = 0; face < 6; face++)
+	{
+		LightNode next;
+		if (Step(node, face, next))
+		{
+			_addQueues[Channel_Sun].push_back(next);
+			_addQueues[Channel_Block].push_back(next);
+		}
+	}
+}
+
+bool VoxelLighting::AddChunk(VoxelChunk* chunk)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	bool queued = false;
+
+	if (!_terrain)
+	{
+		return false;
+	}
+
+	int chunkX, chunkY, chunkZ;
+	chunk->GetPosition(chunkX, chunkY, chunkZ);
+
+	for (int face = 0; face < 6; face++)
+	{
+		int axis = face / 2;
+		int offset[3] = { 0, 0, 0 };
+		offset[axis] = (face & 1) ? 1 : -1;
+
+		VoxelChunk* neighbour = _terrain->GetChunk(chunkX + offset[0], chunkY + offset[1], chunkZ + offset[2]);
+
+		// Chunks that both have the default light already agree where they meet
+		if (!neighbour || (!chunk->HasLight() && !neighbour->HasLight()))
+		{
+			continue;
+		}
+
+		// Queue the layers either side of the face, so each can spread into the other
+		int first = (axis == 0) ? 1 : 0;
+		int second = (axis == 2) ? 1 : 2;
+
+		for (int side = 0; side < 2; side++)
+		{
+			VoxelChunk* from = side ? neighbour : chunk;
+			int layer = ((face & 1) != side) ? size - 1 : 0;
+
+			for (int p = 0; p < size; p++)
+			{
+				for (int q = 0; q < size; q++)
+				{
+					int voxel[3];
+					voxel[axis] = layer;
+					voxel[first] = p;
+					voxel[second] = q;
+
+					unsigned char light = from->GetLight(voxel[0], voxel[1], voxel[2]);
+					LightNode node = { from, (unsigned char)voxel[0], (unsigned char)voxel[1], (unsigned char)voxel[2], 0 };
+
+					for (int channel = 0; channel < Channel_Count; channel++)
+					{
+						if (GetLevel(light, channel) > 1)
+						{
+							_addQueues[channel].push_back(node);
+							queued = true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return queued;
+}
+
+int VoxelLighting::Propagate()
+{
+	int visited = 0;
+
+	// Light has to be taken away before the light around it can fill back in
+	for (int channel = 0; channel < Channel_Count; channel++)
+	{
+		visited += RemoveLight(channel);
+		visited += SpreadLight(channel);
+	}
+
+	return visited;
+}
+
+void VoxelLighting::ClearChangedChunks()
+{
+	_changedChunks.clear();
+	_changedIndices.clear();
+	_lastChanged = -1;
+}
+
+int VoxelLighting::RemoveLight(int channel)
+{
+	std::vector<LightNode>& queue = _removeQueues[channel];
+	int downFace = -1;
+
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		LightNode node = queue[i];
+
+		if (channel == Channel_Sun)
+		{
+			downFace = GetDownFace(node.Chunk);
+		}
+
+		for (int face = 0; face < 6; face++)
+		{
+			LightNode next;
+			if (!Step(node, face, next))
+			{
+				continue;
+			}
+
+			unsigned char light = next.Chunk->GetLight(next.X, next.Y, next.Z);
+			int level = GetLevel(light, channel);
+
+			if (level == 0)
+			{
+				continue;
+			}
+
+			// Dimmer light, and full sunlight falling from the voxel, came from it and goes too. Anything brighter
+			// has another source, so it fills the darkened voxels back in.
+			if (level < node.Level || (face == downFace && level == MAX_LEVEL && node.Level == MAX_LEVEL))
+			{
+				next.Chunk->SetLight(next.X, next.Y, next.Z, SetLevel(light, channel, 0));
+				MarkChanged(next);
+
+				next.Level = (unsigned char)level;
+				queue.push_back(next);
+			}
+			else
+			{
+				_addQueues[channel].push_back(next);
+			}
+		}
+	}
+
+	int visited = (int)queue.size();
+	queue.clear();
+
+	return visited;
+}
+
+int VoxelLighting::SpreadLight(int channel)
+{
+	std::vector<LightNode>& queue = _addQueues[channel];
+	int downFace = -1;
+
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		LightNode node = queue[i];
+		int level = GetLevel(node.Chunk->GetLight(node.X, node.Y, node.Z), channel);
+
+		if (level <= 1)
+		{
+			continue;
+		}
+
+		if (channel == Channel_Sun)
+		{
+			downFace = GetDownFace(node.Chunk);
+		}
+
+		for (int face = 0; face < 6; face++)
+		{
+			LightNode next;
+			if (!Step(node, face, next) || next.Chunk->IsActive(next.X, next.Y, next.Z))
+			{
+				continue;
+			}
+
+			int spread = (face == downFace && level == MAX_LEVEL) ? MAX_LEVEL : level - 1;
+			unsigned char light = next.Chunk->GetLight(next.X, next.Y, next.Z);
+
+			if (GetLevel(light, channel) >= spread)
+			{
+				continue;
+			}
+
+			next.Chunk->SetLight(next.X, next.Y, next.Z, SetLevel(light, channel, spread));
+			MarkChanged(next);
+			queue.push_back(next);
+		}
+	}
+
+	int visited = (int)queue.size();
+	queue.clear();
+
+	return visited;
+}
+
+bool VoxelLighting::Step(const LightNode& node, int face, LightNode& next)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	int axis = face / 2;
+	int voxel[3] = { node.X, node.Y, node.Z };
+
+	voxel[axis] += (face & 1) ? 1 : -1;
+	next.Chunk = node.Chunk;
+
+	// Crossing into the next chunk only works when it is loaded
+	if (voxel[axis] < 0 || voxel[axis] >= size)
+	{
+		if (!_terrain)
+		{
+			return false;
+		}
+
+		int chunk[3];
+		node.Chunk->GetPosition(chunk[0], chunk[1], chunk[2]);
+		chunk[axis] += (face & 1) ? 1 : -1;
+
+		next.Chunk = _terrain->GetChunk(chunk[0], chunk[1], chunk[2]);
+		if (!next.Chunk)
+		{
+			return false;
+		}
+
+		voxel[axis] = (voxel[axis] < 0) ? size - 1 : 0;
+	}
+
+	next.X = (unsigned char)voxel[0];
+	next.Y = (unsigned char)voxel[1];
+	next.Z = (unsigned char)voxel[2];
+	next.Level = 0;
+
+	return true;
+}
+
+int VoxelLighting::GetDownFace(const VoxelChunk* chunk) const
+{
+	int x, y, z;
+	chunk->GetPosition(x, y, z);
+
+	return _generator->GetSkyFace(x, y, z) ^ 1;
+}
+
+void VoxelLighting::MarkChanged(const LightNode& node)
+{
+	const int last = VoxelChunk::CHUNK_SIZE - 1;
+	unsigned char faces = 0;
+
+	faces |= (node.X == 0) ? 0x01 : ((node.X == last) ? 0x02 : 0);
+	faces |= (node.Y == 0) ? 0x04 : ((node.Y == last) ? 0x08 : 0);
+	faces |= (node.Z == 0) ? 0x10 : ((node.Z == last) ? 0x20 : 0);
+
+	// The fills stay in one chunk for long stretches, so check the last one first
+	if (_lastChanged < 0 || _changedChunks[_lastChanged].Chunk != node.Chunk)
+	{
+		std::unordered_map<VoxelChunk*, int>::iterator it = _changedIndices.find(node.Chunk);
+		if (it == _changedIndices.end())
+		{
+			ChangedChunk changed = { node.Chunk, 0 };
+			it = _changedIndices.insert(std::make_pair(node.Chunk, (int)_changedChunks.size())).first;
+			_changedChunks.push_back(changed);
+		}
+
+		_lastChanged = it->second;
+	}
+
+	_changedChunks[_lastChanged].BorderFaces |= faces;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "VoxelChunk.h"
+#include "VoxelGenerator.h"
+
+#include <unordered_map>
+#include <vector>
+
+class VoxelTerrain;
+
+// Spreads sunlight and the light of lamps through the empty voxels of the world. Each voxel holds a level from 0 to
+// 15 of each, sunlight in the top nibble of its light and lamp light in the bottom. Both lose a level for every voxel
+// they spread, except that full sunlight falls straight down without fading, down being away from the sky face the
+// generator gives each chunk.
+//
+// Light is changed with breadth first fills that start from the voxels that changed and stop as soon as the light
+// stops changing, so an edit costs as much as the light it moves rather than anything to do with the size of the
+// world. Taking light away first fills out the region it lit, darkening it, and then fills back in from the lit
+// voxels around its edge. Chunks are lit on their own as they are generated, on the job system, and then joined up
+// with the chunks around them on the main thread.
+class VoxelLighting
+{
+public:
+	// A chunk whose light changed, with a bit for each face, in the border order, its changes reached
+	struct ChangedChunk
+	{
+		VoxelChunk*			Chunk;
+		unsigned char		BorderFaces;
+	};
+
+	VoxelLighting();
+
+	// Without a terrain the fills stop at the sides of the chunk they start in
+	void Initialize(VoxelTerrain* terrain, const VoxelGenerator* generator);
+
+	// Lights a chunk that has just been generated or loaded, touching only that chunk. Generated chunks keep the
+	// default light, and chunks loaded back with edits are lit from the open sky the generator left in them and
+	// from their lamps.
+	static void LightChunk(VoxelChunk& chunk, const VoxelGenerator* generator, bool edited);
+
+	// Queues the light changes for a voxel that has just been set or cleared, given the light it had before
+	void UpdateVoxel(VoxelChunk* chunk, int x, int y, int z, unsigned char oldLight);
+
+	// Queues the light of a chunk that has just been generated to spread into the chunks around it, and theirs into
+	// it. Returns false when there is nothing to spread, which is when they all have the default light.
+	bool AddChunk(VoxelChunk* chunk);
+
+	// Runs the queued fills, returning the number of voxels they visited
+	int Propagate();
+
+	const std::vector<ChangedChunk>& GetChangedChunks() const { return _changedChunks; }
+	void ClearChangedChunks();
+
+	static const int MAX_LEVEL = 15;
+	static const int LAMP_LEVEL = 14;
+
+private:
+	struct LightNode
+	{
+		VoxelChunk*			Chunk;
+		unsigned char		X, Y, Z;
+		unsigned char		Level;
+	};
+
+	enum Channel
+	{
+		Channel_Sun = 0,
+		Channel_Block,
+		Channel_Count,
+	};
+
+	int RemoveLight(int channel);
+	int SpreadLight(int channel);
+	bool Step(const LightNode& node, int face, LightNode& next);
+	int GetDownFace(const VoxelChunk* chunk) const;
+	void MarkChanged(const LightNode& node);
+
+	static int GetLevel(unsigned char light, int channel) { return (light >> CHANNEL_SHIFTS[channel]) & 0xF; }
+	static unsigned char SetLevel(unsigned char light, int channel, int level)
+	{
+		return (unsigned char)((light & ~(0xF << CHANNEL_SHIFTS[channel])) | (level << CHANNEL_SHIFTS[channel]));
+	}
+
+	static const int CHANNEL_SHIFTS[Channel_Count];
+
+	VoxelTerrain*								_terrain;
+	const VoxelGenerator*						_generator;
+
+	// The fills are run from the front of each queue, which is cleared once it is empty
+	std::vector<LightNode>						_removeQueues[Channel_Count];
+	std::vector<LightNode>						_addQueues[Channel_Count];
+
+	std::vector<ChangedChunk>					_changedChunks;
+	std::unordered_map<VoxelChunk*, int>		_changedIndices;
+	int											_lastChanged;
+};
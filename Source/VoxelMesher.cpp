@@ -0,0 +1,311 @@
+#include "VoxelMesher.h"
+
+// The right and up axes of each face are picked so that the quads corners wind clockwise when seen from outside the voxel
+const VoxelMesher::FaceInfo VoxelMesher::FACES[Face_Count] =
+{
+	{ 0, -1,	2, -1,	1, 1,	XMFLOAT3(-1.0f, 0.0f, 0.0f) },
+	{ 0, 1,		2, 1,	1, 1,	XMFLOAT3(1.0f, 0.0f, 0.0f) },
+	{ 1, -1,	0, -1,	2, 1,	XMFLOAT3(0.0f, -1.0f, 0.0f) },
+	{ 1, 1,		0, 1,	2, 1,	XMFLOAT3(0.0f, 1.0f, 0.0f) },
+	{ 2, -1,	0, 1,	1, 1,	XMFLOAT3(0.0f, 0.0f, -1.0f) },
+	{ 2, 1,		0, -1,	1, 1,	XMFLOAT3(0.0f, 0.0f, 1.0f) },
+};
+
+// Pads the chunks columns out with its borders, edges and corners, laid out the way GetShade reads them
+static inline void CopyPaddedColumns(const VoxelChunk& chunk, unsigned long long* paddedColumns)
+{
+	for (int x = -1; x <= VoxelChunk::CHUNK_SIZE; x++)
+	{
+		for (int y = -1; y <= VoxelChunk::CHUNK_SIZE; y++)
+		{
+			paddedColumns[((x + 1) * VoxelChunk::PADDED_SIZE) + y + 1] = chunk.GetPaddedColumn(x, y);
+		}
+	}
+}
+
+void VoxelMesher::CreateCulledMesh(const VoxelChunk& chunk, VoxelChunk::MeshData& mesh)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	VoxelChunk::Column faces[Face_Count];
+	int coord[3];
+
+	static thread_local unsigned long long paddedColumns[VoxelChunk::PADDED_SIZE * VoxelChunk::PADDED_SIZE];
+	CopyPaddedColumns(chunk, paddedColumns);
+
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			if (chunk.GetColumn(x, y) == 0)
+			{
+				continue;
+			}
+
+			FindVisibleFaces(chunk, x, y, faces);
+
+			for (int face = 0; face < Face_Count; face++)
+			{
+				VoxelChunk::Column visible = faces[face];
+
+				unsigned long z;
+				while (_BitScanForward(&z, visible))
+				{
+					visible &= visible - 1;
+
+					coord[0] = x;
+					coord[1] = y;
+					coord[2] = (int)z;
+
+					unsigned int shade = GetShade(size, paddedColumns, chunk.GetMeshLight(), (Face)face, coord);
+					AddQuad(mesh, (Face)face, x, y, (int)z, 1, 1, chunk.GetBlockType(x, y, (int)z), shade);
+				}
+			}
+		}
+	}
+}
+
+void VoxelMesher::CreateGreedyMesh(const VoxelChunk& chunk, VoxelChunk::MeshData& mesh)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	int coord[3];
+
+	// The visible faces of every column, and the block type (0 for no face) and shade of each face in the slice being
+	// merged. Every thread keeps its own.
+	static thread_local VoxelChunk::Column faces[Face_Count * VoxelChunk::CHUNK_AREA];
+	static thread_local unsigned long long paddedColumns[VoxelChunk::PADDED_SIZE * VoxelChunk::PADDED_SIZE];
+	unsigned char mask[VoxelChunk::CHUNK_AREA];
+	unsigned short shades[VoxelChunk::CHUNK_AREA];
+
+	CopyPaddedColumns(chunk, paddedColumns);
+
+	for (int x = 0; x < size; x++)
+	{
+		for (int y = 0; y < size; y++)
+		{
+			FindVisibleFaces(chunk, x, y, &faces[((x * size) + y) * Face_Count]);
+		}
+	}
+
+	for (int face = 0; face < Face_Count; face++)
+	{
+		const FaceInfo& info = FACES[face];
+
+		for (int slice = 0; slice < size; slice++)
+		{
+			bool sliceHasFaces = false;
+
+			// Gather the faces in this slice into a 2D mask laid out along the faces right (i) and up (j) axes
+			coord[info.Axis] = slice;
+			for (int j = 0; j < size; j++)
+			{
+				coord[info.UpAxis] = j;
+				for (int i = 0; i < size; i++)
+				{
+					coord[info.RightAxis] = i;
+
+					unsigned char& cell = mask[(j * size) + i];
+					cell = 0;
+
+					if ((faces[(((coord[0] * size) + coord[1]) * Face_Count) + face] >> coord[2]) & 1)
+					{
+						cell = (unsigned char)(chunk.GetBlockType(coord[0], coord[1], coord[2]) + 1);
+						shades[(j * size) + i] = (unsigned short)GetShade(size, paddedColumns, chunk.GetMeshLight(), (Face)face, coord);
+						sliceHasFaces = true;
+					}
+				}
+			}
+
+			if (!sliceHasFaces)
+			{
+				continue;
+			}
+
+			// Grow a rectangle from each face that has not been used yet, first along i and then along j, over faces of
+			// the same block type and shade
+			for (int j = 0; j < size; j++)
+			{
+				for (int i = 0; i < size;)
+				{
+					unsigned char type = mask[(j * size) + i];
+					if (type == 0)
+					{
+						i++;
+						continue;
+					}
+
+					unsigned short shade = shades[(j * size) + i];
+
+					int width = 1;
+					while (i + width < size && mask[(j * size) + i + width] == type && shades[(j * size) + i + width] == shade)
+					{
+						width++;
+					}
+
+					int height = 1;
+					bool rowMatches = true;
+					while (j + height < size && rowMatches)
+					{
+						for (int k = 0; k < width; k++)
+						{
+							int cell = ((j + height) * size) + i + k;
+							if (mask[cell] != type || shades[cell] != shade)
+							{
+								rowMatches = false;
+								break;
+							}
+						}
+
+						if (rowMatches)
+						{
+							height++;
+						}
+					}
+
+					// Remove the merged faces from the mask
+					for (int l = 0; l < height; l++)
+					{
+						memset(&mask[((j + l) * size) + i], 0, width);
+					}
+
+					coord[info.RightAxis] = i;
+					coord[info.UpAxis] = j;
+					AddQuad(mesh, (Face)face, coord[0], coord[1], coord[2], width, height, type - 1, shade);
+
+					i += width;
+				}
+			}
+		}
+	}
+}
+
+void VoxelMesher::FindVisibleFaces(const VoxelChunk& chunk, int x, int y, VoxelChunk::Column faces[Face_Count])
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	VoxelChunk::Column column = chunk.GetColumn(x, y);
+
+	// A face is visible when the voxel on the other side of it is inactive. Past the edges of the chunk that voxel
+	// is read from the borders copied out of the neighbouring chunks.
+	faces[Face_NegativeX] = column & ~((x > 0) ? chunk.GetColumn(x - 1, y) : chunk.GetBorder(Face_NegativeX, y));
+	faces[Face_PositiveX] = column & ~((x < size - 1) ? chunk.GetColumn(x + 1, y) : chunk.GetBorder(Face_PositiveX, y));
+	faces[Face_NegativeY] = column & ~((y > 0) ? chunk.GetColumn(x, y - 1) : chunk.GetBorder(Face_NegativeY, x));
+	faces[Face_PositiveY] = column & ~((y < size - 1) ? chunk.GetColumn(x, y + 1) : chunk.GetBorder(Face_PositiveY, x));
+	faces[Face_NegativeZ] = column & ~((column << 1) | ((chunk.GetBorder(Face_NegativeZ, x) >> y) & 1));
+	faces[Face_PositiveZ] = column & ~((column >> 1) | (((chunk.GetBorder(Face_PositiveZ, x) >> y) & 1) << (size - 1)));
+}
+
+unsigned int VoxelMesher::GetShade(int size, const unsigned long long* paddedColumns, const unsigned char* light, Face face, const int coord[3])
+{
+	const FaceInfo& info = FACES[face];
+	const int padded = size + 2;
+	int front[3] = { coord[0], coord[1], coord[2] };
+	int occlusion[4];
+
+	front[info.Axis] += info.Sign;
+
+	unsigned char frontLight = VoxelChunk::SKY_LIGHT;
+	if (light)
+	{
+		frontLight = light[((((front[0] + 1) * padded) + front[1] + 1) * padded) + front[2] + 1];
+	}
+
+	// Corners in the order AddQuad gives them, top left, top right, bottom left, bottom right
+	for (int i = 0; i < 4; i++)
+	{
+		int right = (((i & 1) != 0) == (info.RightSign > 0)) ? 1 : -1;
+		int up = ((i < 2) == (info.UpSign > 0)) ? 1 : -1;
+		int solid[3];
+
+		for (int j = 0; j < 3; j++)
+		{
+			int voxel[3] = { front[0], front[1], front[2] };
+
+			if (j != 1)
+			{
+				voxel[info.RightAxis] += right;
+			}
+			if (j != 0)
+			{
+				voxel[info.UpAxis] += up;
+			}
+
+			solid[j] = (int)((paddedColumns[((voxel[0] + 1) * padded) + voxel[1] + 1] >> (voxel[2] + 1)) & 1);
+		}
+
+		// Two solid sides hide the corner between them whatever it holds
+		occlusion[i] = (solid[0] && solid[1]) ? 0 : 3 - (solid[0] + solid[1] + solid[2]);
+	}
+
+	return PackShade(occlusion, frontLight);
+}
+
+void VoxelMesher::AddQuad(VoxelChunk::MeshData& mesh, Face face, int x, int y, int z, int width, int height, int layer, unsigned int shade)
+{
+	const FaceInfo& info = FACES[face];
+	unsigned char light = (unsigned char)(shade >> 8);
+	unsigned long baseIndex = (unsigned long)mesh.PackedVertices.size();
+	int corner[3];
+
+	// Corners in the order top left, top right, bottom left, bottom right
+	const int u[4] = { 0, width, 0, width };
+	const int v[4] = { height, height, 0, 0 };
+
+	mesh.PackedVertices.resize(baseIndex + 4);
+	mesh.Indices.resize(mesh.Indices.size() + 6);
+
+	VoxelChunk::PackedVertexType* vertices = &mesh.PackedVertices[baseIndex];
+	unsigned long* indices = &mesh.Indices[mesh.Indices.size() - 6];
+
+	for (int i = 0; i < 4; i++)
+	{
+		corner[0] = x;
+		corner[1] = y;
+		corner[2] = z;
+
+		// Move onto the plane of the face, then out along its right and up axes
+		if (info.Sign > 0)
+		{
+			corner[info.Axis] += 1;
+		}
+
+		corner[info.RightAxis] += (info.RightSign > 0) ? u[i] : width - u[i];
+		corner[info.UpAxis] += (info.UpSign > 0) ? v[i] : height - v[i];
+
+		vertices[i] = PackVertex(corner[0], corner[1], corner[2], face, (shade >> (i * 2)) & 3, light, layer);
+	}
+
+	// Both ways of splitting the quad wind clockwise
+	if ((shade & 3) + ((shade >> 6) & 3) > ((shade >> 2) & 3) + ((shade >> 4) & 3))
+	{
+		indices[0] = baseIndex;
+		indices[1] = baseIndex + 1;
+		indices[2] = baseIndex + 3;
+		indices[3] = baseIndex;
+		indices[4] = baseIndex + 3;
+		indices[5] = baseIndex + 2;
+	}
+	else
+	{
+		indices[0] = baseIndex;
+		indices[1] = baseIndex + 1;
+		indices[2] = baseIndex + 2;
+		indices[3] = baseIndex + 2;
+		indices[4] = baseIndex + 1;
+		indices[5] = baseIndex + 3;
+	}
+}
+
+void VoxelMesher::UnpackVertex(const VoxelChunk::PackedVertexType& packed, XMFLOAT3 origin, VoxelChunk::VertexType& vertex, int& layer)
+{
+	int position[3] = { (int)(packed.geometry & 0x7F), (int)((packed.geometry >> 7) & 0x7F), (int)((packed.geometry >> 14) & 0x7F) };
+	const FaceInfo& info = FACES[(packed.geometry >> 21) & 0x7];
+
+	vertex.position = XMFLOAT3(origin.x + position[0], origin.y + position[1], origin.z + position[2]);
+	vertex.normal = info.Normal;
+	vertex.light = VoxelChunk::PackVertexLight(packed.surface & 0x3, (unsigned char)(packed.surface >> 8));
+
+	// The texture runs along the right axis and down the up axis, repeating once per voxel. A quad starts at a whole
+	// repeat wherever it is, so counting from the corner of the chunk gives the same texture as counting from the quad.
+	vertex.texture = XMFLOAT2((float)(info.RightSign * position[info.RightAxis]), (float)(-info.UpSign * position[info.UpAxis]));
+
+	layer = (int)((packed.surface >> 16) & 0xFF);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "VoxelChunk.h"
+
+// Builds chunk meshes made only of the voxel faces that can be seen
+class VoxelMesher
+{
+public:
+	enum Face
+	{
+		Face_NegativeX = 0,
+		Face_PositiveX,
+		Face_NegativeY,
+		Face_PositiveY,
+		Face_NegativeZ,
+		Face_PositiveZ,
+
+		Face_Count,
+	};
+
+	struct FaceInfo
+	{
+		int			Axis, Sign;
+		int			RightAxis, RightSign;
+		int			UpAxis, UpSign;
+		XMFLOAT3	Normal;
+	};
+
+	static const FaceInfo FACES[Face_Count];
+
+	static void CreateCulledMesh(const VoxelChunk& chunk, VoxelChunk::MeshData& mesh);
+	static void CreateGreedyMesh(const VoxelChunk& chunk, VoxelChunk::MeshData& mesh);
+
+	// Adds a quad of packed vertices covering width x height voxel faces, starting from the voxel at (x, y, z) in the
+	// chunk. The width runs along the faces right axis and the height along its up axis, so the texture repeats once
+	// per voxel across the quad. The layer is the block type the faces are textured with, and the shade is a value
+	// from PackShade. The quad is split along whichever diagonal joins the brighter corners, so the occlusion fades
+	// evenly across it.
+	static void AddQuad(VoxelChunk::MeshData& mesh, Face face, int x, int y, int z, int width, int height, int layer, unsigned int shade);
+
+	// Packs a vertex at a corner of the voxels of a block, from 0 to 64 along each axis
+	static VoxelChunk::PackedVertexType PackVertex(int x, int y, int z, Face face, int occlusion, unsigned char light, int layer)
+	{
+		VoxelChunk::PackedVertexType vertex;
+		vertex.geometry = x | (y << 7) | (z << 14) | (face << 21);
+		vertex.surface = occlusion | (light << 8) | (layer << 16);
+		return vertex;
+	}
+
+	// Works out the full vertex a packed one stands for, given the corner of its chunk in the world, the same way the
+	// packed voxel vertex shader does. It is there to check the shader against, not for drawing.
+	static void UnpackVertex(const VoxelChunk::PackedVertexType& packed, XMFLOAT3 origin, VoxelChunk::VertexType& vertex, int& layer);
+
+	// The ambient occlusion of each corner of a quad, from 0 for a voxel tucked into a corner to 3 in the open, in
+	// the order top left, top right, bottom left, bottom right, and the light of the voxel the quad faces, packed
+	// into 16 bits. Faces with the same shade can be merged.
+	static unsigned int PackShade(const int occlusion[4], unsigned char light)
+	{
+		return occlusion[0] | (occlusion[1] << 2) | (occlusion[2] << 4) | (occlusion[3] << 6) | (light << 8);
+	}
+
+	// No occlusion and full sunlight
+	static const unsigned int FULL_SHADE = 0xFF | (VoxelChunk::SKY_LIGHT << 8);
+
+	// The shade of the face of the voxel at coord in a size^3 block, from the three voxels beside each corner in front
+	// of the face and the light of the voxel it looks onto. paddedColumns and light are laid out like the
+	// BinaryVoxelMesher::Shading of the block, and light can be null for full sunlight everywhere.
+	static unsigned int GetShade(int size, const unsigned long long* paddedColumns, const unsigned char* light, Face face, const int coord[3]);
+
+private:
+	static void FindVisibleFaces(const VoxelChunk& chunk, int x, int y, VoxelChunk::Column faces[Face_Count]);
+};
@@ -0,0 +1,248 @@
+#include "VoxelRegionStore.h"
+
+#include "VoxelSerializer.h"
+
+#include <windows.h>
+#include <string.h>
+
+VoxelRegionStore::VoxelRegionStore()
+{
+	_bytesRead = 0;
+	_bytesWritten = 0;
+}
+
+VoxelRegionStore::~VoxelRegionStore()
+{
+	Destroy();
+}
+
+bool VoxelRegionStore::Initialize(const char* directory)
+{
+	Destroy();
+
+	_directory = directory;
+	_bytesRead = 0;
+	_bytesWritten = 0;
+
+	// This fails when the directory is already there, which is fine, anything else shows up when a region is saved
+	CreateDirectoryA(directory, 0);
+
+	return true;
+}
+
+void VoxelRegionStore::Destroy()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for (std::unordered_map<long long, Region*>::iterator it = _regions.begin(); it != _regions.end(); ++it)
+	{
+		if (it->second->File)
+		{
+			fclose(it->second->File);
+		}
+
+		delete it->second;
+	}
+
+	_regions.clear();
+}
+
+bool VoxelRegionStore::LoadChunk(VoxelChunk& chunk)
+{
+	// Every thread keeps its own buffer, so only the table lookup needs the regions lock
+	static thread_local std::vector<unsigned char> data;
+
+	int x, y, z, entryIndex;
+	chunk.GetPosition(x, y, z);
+
+	Region* region = GetRegion(x, y, z, entryIndex);
+
+	RegionEntry entry;
+	{
+		std::lock_guard<std::mutex> lock(region->Mutex);
+		entry = region->Entries[entryIndex];
+
+		if (!region->File || entry.Size == 0)
+		{
+			return false;
+		}
+	}
+
+	// Read through a handle of our own, so loads never wait on each other or on a save to the same region. Saves flush
+	// before the table points at their data, and a chunk is never saved while it is being loaded.
+	FILE* file;
+	if (fopen_s(&file, region->Filename.c_str(), "rb") != 0)
+	{
+		return false;
+	}
+
+	data.resize(entry.Size);
+	bool read = fseek(file, entry.Offset, SEEK_SET) == 0 && fread(&data[0], 1, entry.Size, file) == entry.Size;
+	fclose(file);
+
+	if (!read)
+	{
+		return false;
+	}
+
+	_bytesRead += data.size();
+
+	return VoxelSerializer::Decode(&data[0], (int)data.size(), chunk);
+}
+
+bool VoxelRegionStore::SaveChunk(const VoxelChunk& chunk)
+{
+	static thread_local std::vector<unsigned char> data;
+
+	int x, y, z, entryIndex;
+	chunk.GetPosition(x, y, z);
+
+	data.clear();
+	VoxelSerializer::Encode(chunk, data);
+
+	Region* region = GetRegion(x, y, z, entryIndex);
+
+	std::lock_guard<std::mutex> lock(region->Mutex);
+
+	if (!region->File && !CreateRegionFile(region))
+	{
+		return false;
+	}
+
+	// Write over the old data when the chunk still fits in it, otherwise on the end of the file
+	RegionEntry entry = region->Entries[entryIndex];
+	if (entry.Size == 0 || data.size() > entry.Size)
+	{
+		entry.Offset = region->EndOffset;
+	}
+	entry.Size = (unsigned int)data.size();
+
+	if (fseek(region->File, entry.Offset, SEEK_SET) != 0 || fwrite(&data[0], 1, data.size(), region->File) != data.size() ||
+		fflush(region->File) != 0)
+	{
+		return false;
+	}
+
+	if (entry.Offset == region->EndOffset)
+	{
+		region->EndOffset += entry.Size;
+	}
+
+	// Then point the table at it
+	long tableOffset = (2 * sizeof(unsigned int)) + (entryIndex * sizeof(RegionEntry));
+	if (fseek(region->File, tableOffset, SEEK_SET) != 0 || fwrite(&entry, sizeof(RegionEntry), 1, region->File) != 1 ||
+		fflush(region->File) != 0)
+	{
+		return false;
+	}
+
+	region->Entries[entryIndex] = entry;
+	_bytesWritten += entry.Size;
+
+	return true;
+}
+
+void VoxelRegionStore::DeleteRegions()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for (std::unordered_map<long long, Region*>::iterator it = _regions.begin(); it != _regions.end(); ++it)
+	{
+		if (it->second->File)
+		{
+			fclose(it->second->File);
+			remove(it->second->Filename.c_str());
+		}
+
+		delete it->second;
+	}
+
+	_regions.clear();
+}
+
+VoxelRegionStore::Region* VoxelRegionStore::GetRegion(int chunkX, int chunkY, int chunkZ, int& entryIndex)
+{
+	int regionX = FloorToRegion(chunkX);
+	int regionY = FloorToRegion(chunkY);
+	int regionZ = FloorToRegion(chunkZ);
+
+	int localX = chunkX - (regionX * REGION_SIZE);
+	int localY = chunkY - (regionY * REGION_SIZE);
+	int localZ = chunkZ - (regionZ * REGION_SIZE);
+	entryIndex = (((localX * REGION_SIZE) + localY) * REGION_SIZE) + localZ;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::unordered_map<long long, Region*>::iterator it = _regions.find(GetKey(regionX, regionY, regionZ));
+	if (it != _regions.end())
+	{
+		return it->second;
+	}
+
+	char filename[64];
+	sprintf_s(filename, "/region.%d.%d.%d.vxr", regionX, regionY, regionZ);
+
+	Region* region = new Region;
+	region->Filename = _directory + filename;
+	region->File = 0;
+	region->EndOffset = 0;
+	memset(region->Entries, 0, sizeof(region->Entries));
+
+	// Read the table of an existing file. A file that cannot be read is started again when a chunk is saved to it.
+	FILE* file;
+	if (fopen_s(&file, region->Filename.c_str(), "rb+") == 0)
+	{
+		unsigned int header[2];
+
+		if (fread(header, sizeof(header), 1, file) == 1 && header[0] == FILE_MAGIC && header[1] == FILE_VERSION &&
+			fread(region->Entries, sizeof(region->Entries), 1, file) == 1 && fseek(file, 0, SEEK_END) == 0)
+		{
+			region->File = file;
+			region->EndOffset = (unsigned int)ftell(file);
+		}
+		else
+		{
+			fclose(file);
+			memset(region->Entries, 0, sizeof(region->Entries));
+		}
+	}
+
+	_regions[GetKey(regionX, regionY, regionZ)] = region;
+
+	return region;
+}
+
+bool VoxelRegionStore::CreateRegionFile(Region* region)
+{
+	unsigned int header[2] = { FILE_MAGIC, FILE_VERSION };
+
+	if (fopen_s(&region->File, region->Filename.c_str(), "wb+") != 0)
+	{
+		region->File = 0;
+		return false;
+	}
+
+	// Start with an empty table, every chunk is added after it
+	memset(region->Entries, 0, sizeof(region->Entries));
+
+	if (fwrite(header, sizeof(header), 1, region->File) != 1 || fwrite(region->Entries, sizeof(region->Entries), 1, region->File) != 1)
+	{
+		fclose(region->File);
+		region->File = 0;
+		return false;
+	}
+
+	region->EndOffset = HEADER_SIZE;
+
+	return true;
+}
+
+long long VoxelRegionStore::GetKey(int x, int y, int z)
+{
+	return ((long long)(x & 0x1FFFFF) << 42) | ((long long)(y & 0x1FFFFF) << 21) | (long long)(z & 0x1FFFFF);
+}
+
+int VoxelRegionStore::FloorToRegion(int chunk)
+{
+	return (chunk >= 0) ? (chunk / REGION_SIZE) : (((chunk + 1) / REGION_SIZE) - 1);
+}
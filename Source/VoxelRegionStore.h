@@ -0,0 +1,75 @@
+#pragma once
+
+#include "VoxelChunk.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Saves and loads chunks to region files in a directory, one file for each 32x32x32 block of chunks. A region file
+// starts with a table giving the offset and size of every chunk in it, so a chunk is read with a single seek once the
+// table is loaded. Chunks are encoded with the VoxelSerializer. A chunk saved again overwrites its old data when it
+// fits and is appended to the file when it does not.
+//
+// Chunks can be saved and loaded from any thread. Each region has its own lock, held while a save writes its file and
+// while a load looks up its table. A load reads and decodes through its own file handle with the lock released, so
+// loads from the same region run in parallel.
+class VoxelRegionStore
+{
+public:
+	VoxelRegionStore();
+	~VoxelRegionStore();
+
+	// The directory is created if it does not already exist
+	bool Initialize(const char* directory);
+	void Destroy();
+
+	// Loads the chunk at its position. Returns false when the chunk was never saved or cannot be read, so it can be generated instead.
+	bool LoadChunk(VoxelChunk& chunk);
+	bool SaveChunk(const VoxelChunk& chunk);
+
+	// Closes and deletes every region file opened so far
+	void DeleteRegions();
+
+	// The bytes of encoded chunks read and written so far
+	long long GetBytesRead() const { return _bytesRead; }
+	long long GetBytesWritten() const { return _bytesWritten; }
+
+	static const int REGION_SIZE = 32;
+	static const int REGION_VOLUME = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+
+private:
+	struct RegionEntry
+	{
+		unsigned int	Offset;
+		unsigned int	Size;
+	};
+
+	struct Region
+	{
+		std::mutex		Mutex;
+		std::string		Filename;
+		FILE*			File;
+		unsigned int	EndOffset;
+		RegionEntry		Entries[REGION_VOLUME];
+	};
+
+	Region* GetRegion(int chunkX, int chunkY, int chunkZ, int& entryIndex);
+	bool CreateRegionFile(Region* region);
+
+	static long long GetKey(int x, int y, int z);
+	static int FloorToRegion(int chunk);
+
+	static const unsigned int FILE_MAGIC = 0x47525856;	// "VXRG"
+	static const unsigned int FILE_VERSION = 1;
+	static const int HEADER_SIZE = (2 * sizeof(unsigned int)) + (REGION_VOLUME * sizeof(RegionEntry));
+
+	std::string								_directory;
+	std::unordered_map<long long, Region*>	_regions;
+	std::mutex								_mutex;
+	std::atomic<long long>					_bytesRead, _bytesWritten;
+};
@@ -0,0 +1,267 @@
+#include "VoxelSerializer.h"
+
+#include <string.h>
+
+namespace
+{
+	// The run being built up, and the palette of the values written so far in the order they first appear
+	struct RunEncoder
+	{
+		int								Value;
+		int								Length;
+		int								PaletteSize;
+		unsigned char					Palette[VoxelSerializer::MAX_PALETTE_SIZE];
+		unsigned char					PaletteIndex[VoxelSerializer::MAX_PALETTE_SIZE];
+		std::vector<unsigned char>*		Runs;
+	};
+}
+
+static void FlushRun(RunEncoder& encoder)
+{
+	if (encoder.Length == 0)
+	{
+		return;
+	}
+
+	if (encoder.PaletteIndex[encoder.Value] == 0xFF)
+	{
+		encoder.PaletteIndex[encoder.Value] = (unsigned char)encoder.PaletteSize;
+		encoder.Palette[encoder.PaletteSize++] = (unsigned char)encoder.Value;
+	}
+
+	encoder.Runs->push_back(encoder.PaletteIndex[encoder.Value]);
+
+	unsigned int length = (unsigned int)(encoder.Length - 1);
+	while (length >= 0x80)
+	{
+		encoder.Runs->push_back((unsigned char)(length | 0x80));
+		length >>= 7;
+	}
+	encoder.Runs->push_back((unsigned char)length);
+
+	encoder.Length = 0;
+}
+
+static inline void AddRun(RunEncoder& encoder, int value, int length)
+{
+	if (value != encoder.Value)
+	{
+		FlushRun(encoder);
+		encoder.Value = value;
+	}
+
+	encoder.Length += length;
+}
+
+// Sets count block types starting from the given voxel index, filling whole bytes where it can
+static void FillBlockTypes(unsigned char* blockTypes, int start, int count, unsigned char blockType)
+{
+	int end = start + count;
+
+	if (start & 1)
+	{
+		blockTypes[start >> 1] |= blockType << 4;
+		start++;
+	}
+
+	if (end > start && (end & 1))
+	{
+		end--;
+		blockTypes[end >> 1] |= blockType;
+	}
+
+	if (end > start)
+	{
+		memset(blockTypes + (start >> 1), blockType | (blockType << 4), (end - start) >> 1);
+	}
+}
+
+void VoxelSerializer::Encode(const VoxelChunk& chunk, std::vector<unsigned char>& data)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+
+	// Every thread keeps its own scratch so chunks can be saved from any of them
+	static thread_local VoxelChunk::Column columns[VoxelChunk::CHUNK_AREA];
+	static thread_local unsigned char blockTypes[VoxelChunk::CHUNK_VOLUME / 2];
+	static thread_local std::vector<unsigned char> runs;
+
+	// Uniform chunks are a palette of one and need no runs
+	if (chunk.GetStorage() == VoxelChunk::VoxelStorage_Uniform)
+	{
+		data.push_back(1);
+		data.push_back(chunk.IsActive(0, 0, 0) ? (unsigned char)(chunk.GetBlockType(0, 0, 0) + 1) : 0);
+		return;
+	}
+
+	chunk.CopyVoxels(columns, blockTypes);
+
+	RunEncoder encoder;
+	encoder.Value = 0;
+	encoder.Length = 0;
+	encoder.PaletteSize = 0;
+	encoder.Runs = &runs;
+	memset(encoder.PaletteIndex, 0xFF, sizeof(encoder.PaletteIndex));
+	runs.clear();
+
+	for (int i = 0; i < VoxelChunk::CHUNK_AREA; i++)
+	{
+		VoxelChunk::Column column = columns[i];
+		const unsigned char* types = blockTypes + ((i * size) >> 1);
+
+		// Empty columns are a single run of air, and full columns of one block a single run of it
+		if (column == 0)
+		{
+			AddRun(encoder, 0, size);
+			continue;
+		}
+
+		if (column == ~(VoxelChunk::Column)0 && (types[0] & 0xF) == (types[0] >> 4))
+		{
+			int j = 1;
+			while (j < size / 2 && types[j] == types[0])
+			{
+				j++;
+			}
+
+			if (j == size / 2)
+			{
+				AddRun(encoder, (types[0] & 0xF) + 1, size);
+				continue;
+			}
+		}
+
+		for (int z = 0; z < size; z++)
+		{
+			int value = ((column >> z) & 1) ? ((types[z >> 1] >> ((z & 1) * 4)) & 0xF) + 1 : 0;
+			AddRun(encoder, value, 1);
+		}
+	}
+
+	FlushRun(encoder);
+
+	data.push_back((unsigned char)encoder.PaletteSize);
+	data.insert(data.end(), encoder.Palette, encoder.Palette + encoder.PaletteSize);
+
+	// A chunk that was held densely can still turn out to be one value, which needs no runs either
+	if (encoder.PaletteSize > 1)
+	{
+		data.insert(data.end(), runs.begin(), runs.end());
+	}
+}
+
+bool VoxelSerializer::Decode(const unsigned char* data, int size, VoxelChunk& chunk)
+{
+	const int chunkSize = VoxelChunk::CHUNK_SIZE;
+
+	static thread_local VoxelChunk::Column columns[VoxelChunk::CHUNK_AREA];
+	static thread_local unsigned char blockTypes[VoxelChunk::CHUNK_VOLUME / 2];
+
+	chunk.Clear();
+
+	if (size < 1)
+	{
+		return false;
+	}
+
+	int paletteSize = data[0];
+	const unsigned char* palette = data + 1;
+	int position = 1 + paletteSize;
+
+	if (paletteSize < 1 || paletteSize > MAX_PALETTE_SIZE || position > size)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < paletteSize; i++)
+	{
+		if (palette[i] > 16)
+		{
+			return false;
+		}
+	}
+
+	if (paletteSize == 1)
+	{
+		if (palette[0] != 0)
+		{
+			chunk.Fill((BlockType)(palette[0] - 1));
+		}
+
+		return position == size;
+	}
+
+	memset(columns, 0, sizeof(columns));
+	memset(blockTypes, 0, sizeof(blockTypes));
+
+	int index = 0;
+
+	while (position < size)
+	{
+		int paletteIndex = data[position++];
+		unsigned int length = 0;
+		int shift = 0;
+
+		if (paletteIndex >= paletteSize)
+		{
+			return false;
+		}
+
+		// Read the length, which never needs more than a few bytes for a chunk
+		while (true)
+		{
+			if (position >= size || shift > 21)
+			{
+				return false;
+			}
+
+			unsigned char byte = data[position++];
+			length |= (unsigned int)(byte & 0x7F) << shift;
+			shift += 7;
+
+			if (!(byte & 0x80))
+			{
+				break;
+			}
+		}
+
+		length++;
+		if (length > (unsigned int)(VoxelChunk::CHUNK_VOLUME - index))
+		{
+			return false;
+		}
+
+		int value = palette[paletteIndex];
+		if (value != 0)
+		{
+			unsigned char blockType = (unsigned char)(value - 1);
+			int start = index;
+			int remaining = (int)length;
+
+			FillBlockTypes(blockTypes, start, remaining, blockType);
+
+			// A run can cross any number of columns
+			while (remaining > 0)
+			{
+				int z = start % chunkSize;
+				int count = (remaining < chunkSize - z) ? remaining : chunkSize - z;
+				VoxelChunk::Column run = (count >= chunkSize) ? ~(VoxelChunk::Column)0 : ((((VoxelChunk::Column)1 << count) - 1) << z);
+
+				columns[start / chunkSize] |= run;
+				start += count;
+				remaining -= count;
+			}
+		}
+
+		index += (int)length;
+	}
+
+	if (index != VoxelChunk::CHUNK_VOLUME)
+	{
+		return false;
+	}
+
+	chunk.SetVoxels(columns, blockTypes);
+	chunk.Compact();
+
+	return true;
+}
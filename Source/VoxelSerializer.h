@@ -0,0 +1,26 @@
+#pragma once
+
+#include "VoxelChunk.h"
+
+#include <vector>
+
+// Packs the voxels of a chunk into a few bytes for saving. Every voxel is given a value, 0 when it is inactive and
+// 1 + its block type when active, and the values the chunk uses are listed in a palette. The voxels are then written
+// in the order chunks hold them, z fastest, as runs of a palette index and a length.
+//
+// An encoded chunk starts with the palette size and the palette values, one byte each. Each run follows as a byte
+// holding the palette index and the length less one as a variable length integer, 7 bits to a byte with the top bit
+// set on every byte but the last. A chunk with a single value in its palette has no runs.
+class VoxelSerializer
+{
+public:
+	// Appends the encoded chunk to data
+	static void Encode(const VoxelChunk& chunk, std::vector<unsigned char>& data);
+
+	// Fills the chunk with the voxels held in data, compacting them into the smallest storage that holds them.
+	// Returns false when the data is not a whole encoded chunk, leaving the chunk empty.
+	static bool Decode(const unsigned char* data, int size, VoxelChunk& chunk);
+
+	// Inactive voxels and the 16 block types a voxel can hold
+	static const int MAX_PALETTE_SIZE = 17;
+};
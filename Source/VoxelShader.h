@@ -0,0 +1,33 @@
+#pragma once
+
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <directxmath.h>
+#include <fstream>
+
+#include "IShader.h"
+
+using namespace DirectX;
+using namespace std;
+
+// Draws voxel chunks with their texture darkened by the ambient occlusion and light packed into each vertex
+class VoxelShader : public IShader
+{
+public:
+	VoxelShader();
+	VoxelShader(const VoxelShader&);
+	~VoxelShader();
+
+	bool Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture);
+
+protected:
+	bool InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename) override;
+	void DestroyShader() override;
+	void RenderShader(ID3D11DeviceContext* deviceContext, int indexCount) override;
+
+private:
+	bool SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix,
+		XMMATRIX projectionMatrix, ID3D11ShaderResourceView* texture);
+
+	ID3D11SamplerState*			_sampleState;
+};
\ No newline at end of file
@@ -1,10 +1,32 @@
 #include "VoxelTerrain.h"
 
+#include <algorithm>
+#include <float.h>
+
 VoxelTerrain::VoxelTerrain()
 {
+	_vertexCount = 0;
+	_indexCount = 0;
+	_model = 0;
+	_meshMode = VoxelMeshMode_BinaryGreedy;
+	_jobSystem = 0;
+	_viewRadius = 0;
+	_loadRadius = 0;
+	_caveCulling = true;
+	_lodDistance = 0;
+	_memoryBudget = 0;
+	_saveChunks = false;
+	_jobsInFlight = 0;
+	_residentBytes = 0;
+	_loadedChunks = 0;
+	_savedChunks = 0;
+	_cameraChunk[0] = 0;
+	_cameraChunk[1] = 0;
+	_cameraChunk[2] = 0;
+	memset(&_stats, 0, sizeof(_stats));
 }
 
-bool VoxelTerrain::Initialize(ID3D11Device * device, char * modelFilename, int textureIndex)
+bool VoxelTerrain::Initialize(char * modelFilename, int textureIndex, VoxelMeshMode meshMode, JobSystem* jobSystem, float planetRadius, int viewRadius, int memoryBudget, const char* saveDirectory)
 {
 	bool result;
 
@@ -15,19 +37,1037 @@ bool VoxelTerrain::Initialize(ID3D11Device * device, char * modelFilename, int t
 		return false;
 	}
 
-	// Initalize the chunks
-	_chunk = new VoxelChunk**[CHUNK_COUNT];
-	for (int i = 0; i < CHUNK_COUNT; i++)
+	_meshMode = meshMode;
+	_jobSystem = jobSystem;
+	_viewRadius = viewRadius;
+
+	// A ring of chunks around those in view is loaded so they have all their neighbours. The smooth surface and
+	// ambient occlusion need the chunks diagonally across as well, which reach out a little further.
+	_loadRadius = viewRadius + (UsesDiagonalNeighbours() ? 2 : 1);
+	_memoryBudget = (long long)memoryBudget * 1024 * 1024;
+
+	// The planet sits on the origin with hills a few chunks high
+	_generator.Initialize(1337, XMFLOAT3(0.0f, 0.0f, 0.0f), planetRadius, 24.0f);
+	_lighting.Initialize(this, &_generator);
+
+	_saveChunks = (saveDirectory != 0);
+	if (_saveChunks)
+	{
+		result = _regionStore.Initialize(saveDirectory);
+		if (!result)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void VoxelTerrain::Destroy()
+{
+	// Chunks cannot be deleted while jobs are still using them
+	if (_jobSystem)
+	{
+		_jobSystem->Wait();
+	}
+
+	// Keep the edits for next time
+	SaveModifiedChunks();
+	_regionStore.Destroy();
+
+	for (std::unordered_map<long long, ChunkEntry*>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		delete it->second->Chunk;
+		delete it->second;
+	}
+
+	_entries.clear();
+	_lru.clear();
+	_dirtyChunks.clear();
+	_drawList.clear();
+	_residentBytes = 0;
+
+	if (_model)
+	{
+		delete[] _model;
+		_model = 0;
+	}
+}
+
+bool VoxelTerrain::Update(ID3D11Device* device, ID3D11DeviceContext* deviceContext, XMFLOAT3 cameraPosition, Frustum* frustum)
+{
+	bool result;
+	int uploadedBytes = 0;
+
+	_stats.QueuedChunks = 0;
+	_stats.UploadedChunks = 0;
+	_stats.UploadedBytes = 0;
+	_stats.EvictedChunks = 0;
+	_stats.LitVoxels = 0;
+	_stats.LightMilliseconds = 0.0f;
+
+	// Light and remesh everything edited since the last frame first, so edits show up straight away
+	PropagateLight();
+
+	result = RemeshDirtyChunks(device, deviceContext);
+	if (!result)
+	{
+		return false;
+	}
+
+	_cameraChunk[0] = FloorToChunk(cameraPosition.x);
+	_cameraChunk[1] = FloorToChunk(cameraPosition.y);
+	_cameraChunk[2] = FloorToChunk(cameraPosition.z);
+
+	// Make room first, so the memory freed can go to the chunks loaded this frame
+	EvictChunks();
+
+	BuildLoadRequests(cameraPosition, frustum);
+
+	// Without workers the jobs only run when they are waited on below, so just take on a few each frame
+	int jobLimit = (_jobSystem->GetThreadCount() > 0) ? MAX_JOBS_IN_FLIGHT : MAX_JOBS_PER_FRAME_WITHOUT_WORKERS;
+
+	_drawList.clear();
+	int drawableChunks = 0;
+
+	for (size_t i = 0; i < _loadRequests.size(); i++)
+	{
+		const LoadRequest& request = _loadRequests[i];
+		ChunkEntry* entry = FindEntry(request.X, request.Y, request.Z);
+
+		if (!entry)
+		{
+			if (_jobsInFlight < jobLimit && _residentBytes < _memoryBudget)
+			{
+				SubmitGenerate(CreateEntry(request.X, request.Y, request.Z));
+			}
+			else
+			{
+				_stats.QueuedChunks++;
+			}
+			continue;
+		}
+
+		// Keep the chunks around the camera at the front of the list, so the back holds the least recently used
+		_lru.splice(_lru.begin(), _lru, entry->LruPosition);
+
+		int state = entry->State;
+
+		// Light from the chunks around a new chunk has to reach into it before it is meshed
+		if (state != ChunkState_Generating && !entry->Lit)
+		{
+			LightEntry(entry);
+		}
+
+		// Only chunks in range are meshed, the ring of chunks around them is loaded so they have all their neighbours
+		if (state == ChunkState_Generated && request.InRange)
+		{
+			if (_jobsInFlight >= jobLimit || !SubmitMesh(entry, true, request.Lod))
+			{
+				_stats.QueuedChunks++;
+			}
+
+			state = entry->State;
+		}
+
+		// Chunks that have moved to another level of detail switch straight over when they have a mesh for it
+		// already, and are meshed again otherwise
+		if (state == ChunkState_Ready && request.InRange && request.Lod != entry->Chunk->GetDrawLod())
+		{
+			if (entry->Chunk->HasMesh(request.Lod))
+			{
+				entry->Chunk->SetDrawLod(request.Lod);
+			}
+			else if (_jobsInFlight >= jobLimit || !SubmitMesh(entry, true, request.Lod))
+			{
+				_stats.QueuedChunks++;
+			}
+
+			state = entry->State;
+		}
+
+		// Upload the nearest meshes first until the budget for the frame runs out
+		if (state == ChunkState_Meshed && uploadedBytes < UPLOAD_BUDGET)
+		{
+			int bytes = UploadEntry(device, deviceContext, entry);
+			if (bytes < 0)
+			{
+				return false;
+			}
+
+			uploadedBytes += bytes;
+			_stats.UploadedChunks++;
+			state = ChunkState_Ready;
+		}
+
+		// A chunk being meshed at a new level of detail still has the old one to draw
+		if (IsDrawable(entry, state) && request.InRange)
+		{
+			drawableChunks++;
+
+			if (!_caveCulling)
+			{
+				_drawList.push_back(entry->Chunk);
+			}
+		}
+	}
+
+	_stats.VisitedChunks = 0;
+	if (_caveCulling)
+	{
+		BuildDrawList(frustum);
+	}
+
+	if (_jobSystem->GetThreadCount() == 0)
+	{
+		_jobSystem->Wait();
+	}
+
+	_stats.ResidentChunks = (int)_entries.size();
+	_stats.ChunksInFlight = _jobsInFlight;
+	_stats.UploadedBytes = uploadedBytes;
+	_stats.ResidentBytes = _residentBytes;
+	_stats.LoadedChunks = _loadedChunks;
+	_stats.SavedChunks = _savedChunks;
+	_stats.DrawnChunks = (int)_drawList.size();
+	_stats.CulledChunks = drawableChunks - _stats.DrawnChunks;
+	_stats.DrawnTriangles = 0;
+	memset(_stats.LodChunks, 0, sizeof(_stats.LodChunks));
+
+	for (size_t i = 0; i < _drawList.size(); i++)
+	{
+		_stats.DrawnTriangles += _drawList[i]->GetIndexCount() / 3;
+		_stats.LodChunks[_drawList[i]->GetDrawLod()]++;
+	}
+
+	return true;
+}
+
+bool VoxelTerrain::SaveModifiedChunks()
+{
+	bool result = true;
+
+	for (std::unordered_map<long long, ChunkEntry*>::iterator it = _entries.begin(); it != _entries.end(); ++it)
 	{
-		_chunk[i] = new VoxelChunk*[CHUNK_COUNT];
+		ChunkEntry* entry = it->second;
+		int state = entry->State;
 
-		for (int j = 0; j < CHUNK_COUNT; j++)
+		if (entry->Modified && state != ChunkState_Generating && state != ChunkState_Meshing && !SaveEntry(entry))
 		{
-			_chunk[i][j] = new VoxelChunk[CHUNK_COUNT];
-			for (int k = 0; k < CHUNK_COUNT; k++)
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+bool VoxelTerrain::SetVoxel(int x, int y, int z, BlockType blockType)
+{
+	return EditVoxel(x, y, z, true, blockType);
+}
+
+bool VoxelTerrain::ClearVoxel(int x, int y, int z)
+{
+	return EditVoxel(x, y, z, false, BlockType_Default);
+}
+
+int VoxelTerrain::ApplyBrush(XMFLOAT3 centre, float radius, bool active, BlockType blockType)
+{
+	int changed = 0;
+
+	int minX = (int)floorf(centre.x - radius);
+	int minY = (int)floorf(centre.y - radius);
+	int minZ = (int)floorf(centre.z - radius);
+	int maxX = (int)floorf(centre.x + radius);
+	int maxY = (int)floorf(centre.y + radius);
+	int maxZ = (int)floorf(centre.z + radius);
+
+	for (int x = minX; x <= maxX; x++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int z = minZ; z <= maxZ; z++)
 			{
-				result = _chunk[i][j][k].Initialize(device, modelFilename, textureIndex, _model, _vertexCount, _indexCount, i + 1, j + 1, k + 1);
-				if (!result)
+				float dx = (x + 0.5f) - centre.x;
+				float dy = (y + 0.5f) - centre.y;
+				float dz = (z + 0.5f) - centre.z;
+
+				if ((dx * dx) + (dy * dy) + (dz * dz) > radius * radius)
+				{
+					continue;
+				}
+
+				if (EditVoxel(x, y, z, active, blockType))
+				{
+					changed++;
+				}
+			}
+		}
+	}
+
+	return changed;
+}
+
+bool VoxelTerrain::Raycast(const Ray& ray, RaycastHit& hit)
+{
+	ChunkCache cache;
+	cache.Valid = 0;
+
+	return CastRay(ray, cache, hit);
+}
+
+int VoxelTerrain::RaycastBatch(const Ray* rays, int count, RaycastHit* hits)
+{
+	ChunkCache cache;
+	int hitCount = 0;
+
+	cache.Valid = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (CastRay(rays[i], cache, hits[i]))
+		{
+			hitCount++;
+		}
+	}
+
+	return hitCount;
+}
+
+void VoxelTerrain::GetStorageStats(StorageStats& stats)
+{
+	memset(&stats, 0, sizeof(stats));
+
+	for (std::unordered_map<long long, ChunkEntry*>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		// Chunks being generated are still changing how they hold their voxels
+		if (it->second->State == ChunkState_Generating)
+		{
+			continue;
+		}
+
+		const VoxelChunk* chunk = it->second->Chunk;
+		switch (chunk->GetStorage())
+		{
+		case VoxelChunk::VoxelStorage_Uniform:
+			stats.UniformChunks++;
+			break;
+
+		case VoxelChunk::VoxelStorage_Octree:
+			stats.OctreeChunks++;
+			break;
+
+		case VoxelChunk::VoxelStorage_Dense:
+			stats.DenseChunks++;
+			break;
+		}
+
+		stats.VoxelBytes += chunk->GetVoxelBytes();
+		stats.DenseVoxelBytes += VoxelChunk::DENSE_VOXEL_BYTES;
+	}
+}
+
+VoxelChunk* VoxelTerrain::GetChunk(int x, int y, int z)
+{
+	ChunkEntry* entry = FindEntry(x, y, z);
+
+	if (!entry || entry->State == ChunkState_Generating)
+	{
+		return 0;
+	}
+
+	return entry->Chunk;
+}
+
+void VoxelTerrain::GenerateRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ)
+{
+	for (int x = minX; x <= maxX; x++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int z = minZ; z <= maxZ; z++)
+			{
+				if (!FindEntry(x, y, z))
+				{
+					SubmitGenerate(CreateEntry(x, y, z));
+				}
+			}
+		}
+	}
+
+	_jobSystem->Wait();
+}
+
+void VoxelTerrain::MeshRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ)
+{
+	for (int x = minX; x <= maxX; x++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int z = minZ; z <= maxZ; z++)
+			{
+				ChunkEntry* entry = FindEntry(x, y, z);
+				if (entry && entry->State == ChunkState_Generated)
+				{
+					if (!entry->Lit)
+					{
+						LightEntry(entry);
+					}
+
+					SubmitMesh(entry, false, 0);
+				}
+			}
+		}
+	}
+
+	_jobSystem->Wait();
+}
+
+void VoxelTerrain::BuildLoadRequests(XMFLOAT3 cameraPosition, Frustum* frustum)
+{
+	const float halfChunk = VoxelChunk::CHUNK_SIZE * 0.5f;
+	int loadRadius = _loadRadius;
+
+	_loadRequests.clear();
+
+	for (int x = -loadRadius; x <= loadRadius; x++)
+	{
+		for (int y = -loadRadius; y <= loadRadius; y++)
+		{
+			for (int z = -loadRadius; z <= loadRadius; z++)
+			{
+				int distanceSquared = (x * x) + (y * y) + (z * z);
+				if (distanceSquared > loadRadius * loadRadius)
+				{
+					continue;
+				}
+
+				LoadRequest request;
+				request.X = _cameraChunk[0] + x;
+				request.Y = _cameraChunk[1] + y;
+				request.Z = _cameraChunk[2] + z;
+				request.InRange = (distanceSquared <= _viewRadius * _viewRadius);
+				request.Lod = GetLod(distanceSquared);
+
+				float centreX = (request.X * VoxelChunk::CHUNK_SIZE) + halfChunk;
+				float centreY = (request.Y * VoxelChunk::CHUNK_SIZE) + halfChunk;
+				float centreZ = (request.Z * VoxelChunk::CHUNK_SIZE) + halfChunk;
+				float dx = centreX - cameraPosition.x;
+				float dy = centreY - cameraPosition.y;
+				float dz = centreZ - cameraPosition.z;
+
+				// Chunks the camera cannot see are loaded as if they were twice as far away
+				request.Priority = sqrtf((dx * dx) + (dy * dy) + (dz * dz));
+				if (!frustum->CheckCube(centreX, centreY, centreZ, halfChunk))
+				{
+					request.Priority *= 2.0f;
+				}
+
+				_loadRequests.push_back(request);
+			}
+		}
+	}
+
+	std::sort(_loadRequests.begin(), _loadRequests.end());
+}
+
+void VoxelTerrain::BuildDrawList(Frustum* frustum)
+{
+	const float halfChunk = VoxelChunk::CHUNK_SIZE * 0.5f;
+	static const int faceSteps[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+
+	int width = (2 * _viewRadius) + 1;
+	_visibleChunks.assign(width * width * width, 0);
+	_visibilityQueue.clear();
+
+	VisibilityStep start = { 0, 0, 0, -1, 0 };
+	_visibilityQueue.push_back(start);
+	_visibleChunks[(((_viewRadius * width) + _viewRadius) * width) + _viewRadius] = 1;
+
+	// Search out from the camera chunk through the faces each chunk joins to the face it was entered through.
+	// The search never steps back the way it has come, so it cannot wrap around behind solid ground, and it
+	// visits each chunk once, in roughly nearest first order.
+	for (size_t head = 0; head < _visibilityQueue.size(); head++)
+	{
+		VisibilityStep step = _visibilityQueue[head];
+		ChunkEntry* entry = FindEntry(_cameraChunk[0] + step.X, _cameraChunk[1] + step.Y, _cameraChunk[2] + step.Z);
+		int state = entry ? (int)entry->State : ChunkState_Generating;
+
+		// Only meshed chunks know which of their faces join, the rest are searched through as if they were empty
+		const VoxelChunk* chunk = (state == ChunkState_Meshed || state == ChunkState_Ready) ? entry->Chunk : 0;
+
+		if (IsDrawable(entry, state))
+		{
+			_drawList.push_back(entry->Chunk);
+		}
+
+		for (int face = 0; face < 6; face++)
+		{
+			if ((step.Directions & (1 << (face ^ 1))) || (chunk && step.EnteredFace >= 0 && !chunk->AreFacesConnected(step.EnteredFace, face)))
+			{
+				continue;
+			}
+
+			int x = step.X + faceSteps[face][0];
+			int y = step.Y + faceSteps[face][1];
+			int z = step.Z + faceSteps[face][2];
+
+			if ((x * x) + (y * y) + (z * z) > _viewRadius * _viewRadius)
+			{
+				continue;
+			}
+
+			unsigned char& visible = _visibleChunks[((((x + _viewRadius) * width) + y + _viewRadius) * width) + z + _viewRadius];
+			if (visible)
+			{
+				continue;
+			}
+
+			float centreX = ((_cameraChunk[0] + x) * VoxelChunk::CHUNK_SIZE) + halfChunk;
+			float centreY = ((_cameraChunk[1] + y) * VoxelChunk::CHUNK_SIZE) + halfChunk;
+			float centreZ = ((_cameraChunk[2] + z) * VoxelChunk::CHUNK_SIZE) + halfChunk;
+
+			if (!frustum->CheckCube(centreX, centreY, centreZ, halfChunk))
+			{
+				continue;
+			}
+
+			visible = 1;
+
+			VisibilityStep next = { x, y, z, face ^ 1, step.Directions | (1 << face) };
+			_visibilityQueue.push_back(next);
+		}
+	}
+
+	_stats.VisitedChunks = (int)_visibilityQueue.size();
+}
+
+void VoxelTerrain::EvictChunks()
+{
+	int keepRadius = _loadRadius + HYSTERESIS;
+	std::list<ChunkEntry*>::iterator it = _lru.end();
+
+	// Walk from the least recently used chunk, skipping chunks still in use or within the hysteresis radius
+	while (_residentBytes > _memoryBudget && it != _lru.begin())
+	{
+		--it;
+		ChunkEntry* entry = *it;
+
+		int state = entry->State;
+		if (state == ChunkState_Generating || state == ChunkState_Meshing || entry->Dirty)
+		{
+			continue;
+		}
+
+		int dx = entry->X - _cameraChunk[0];
+		int dy = entry->Y - _cameraChunk[1];
+		int dz = entry->Z - _cameraChunk[2];
+		if ((dx * dx) + (dy * dy) + (dz * dz) <= keepRadius * keepRadius)
+		{
+			continue;
+		}
+
+		// Edited chunks would lose their changes if they were regenerated, so they stay unless they can be saved
+		if (entry->Modified && !SaveEntry(entry))
+		{
+			continue;
+		}
+
+		it = _lru.erase(it);
+		DestroyEntry(entry);
+		_stats.EvictedChunks++;
+	}
+}
+
+bool VoxelTerrain::EditVoxel(int x, int y, int z, bool active, BlockType blockType)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+
+	int chunkX = VoxelToChunk(x);
+	int chunkY = VoxelToChunk(y);
+	int chunkZ = VoxelToChunk(z);
+
+	// Chunks that are being generated or meshed cannot be touched until their job is done
+	ChunkEntry* entry = FindEntry(chunkX, chunkY, chunkZ);
+	if (!entry)
+	{
+		return false;
+	}
+
+	int state = entry->State;
+	if (state == ChunkState_Generating || state == ChunkState_Meshing)
+	{
+		return false;
+	}
+
+	int localX = x - (chunkX * size);
+	int localY = y - (chunkY * size);
+	int localZ = z - (chunkZ * size);
+
+	VoxelChunk* chunk = entry->Chunk;
+	if (chunk->IsActive(localX, localY, localZ) == active && (!active || chunk->GetBlockType(localX, localY, localZ) == blockType))
+	{
+		return false;
+	}
+
+	// Setting the voxel expands the chunk to a dense array, which counts against the budget. The light around it
+	// is spread by the next Update.
+	unsigned char oldLight = chunk->GetLight(localX, localY, localZ);
+	chunk->SetVoxel(localX, localY, localZ, active, active ? blockType : BlockType_Default);
+	_lighting.UpdateVoxel(chunk, localX, localY, localZ, oldLight);
+	entry->Modified = true;
+	UpdateEntryBytes(entry);
+
+	MarkDirty(entry);
+
+	// The neighbouring chunks can see voxels on the edges of this one, so they need remeshing too. The smooth
+	// surface also reaches into the chunks diagonally across from the edges and corners.
+	bool diagonals = UsesDiagonalNeighbours();
+	int local[3] = { localX, localY, localZ };
+	int low[3], high[3];
+
+	for (int i = 0; i < 3; i++)
+	{
+		low[i] = (local[i] == 0) ? -1 : 0;
+		high[i] = (local[i] == size - 1) ? 1 : 0;
+	}
+
+	for (int dx = low[0]; dx <= high[0]; dx++)
+	{
+		for (int dy = low[1]; dy <= high[1]; dy++)
+		{
+			for (int dz = low[2]; dz <= high[2]; dz++)
+			{
+				int offAxes = (dx != 0) + (dy != 0) + (dz != 0);
+				if (offAxes == 0 || (offAxes > 1 && !diagonals))
+				{
+					continue;
+				}
+
+				MarkDirty(FindEntry(chunkX + dx, chunkY + dy, chunkZ + dz));
+			}
+		}
+	}
+
+	return true;
+}
+
+void VoxelTerrain::MarkDirty(ChunkEntry* entry)
+{
+	if (!entry || entry->Dirty)
+	{
+		return;
+	}
+
+	entry->Dirty = true;
+	_dirtyChunks.push_back(entry);
+}
+
+void VoxelTerrain::LightEntry(ChunkEntry* entry)
+{
+	entry->Lit = true;
+
+	if (_lighting.AddChunk(entry->Chunk))
+	{
+		PropagateLight();
+	}
+}
+
+void VoxelTerrain::PropagateLight()
+{
+	_lightTimer.StartTimer();
+
+	_stats.LitVoxels += _lighting.Propagate();
+
+	// The chunks that changed are remeshed, along with the neighbours that can see the light on their borders
+	const std::vector<VoxelLighting::ChangedChunk>& changed = _lighting.GetChangedChunks();
+	for (size_t i = 0; i < changed.size(); i++)
+	{
+		int x, y, z;
+		changed[i].Chunk->GetPosition(x, y, z);
+
+		// Lighting a chunk can give it a byte of light for every voxel, which counts against the budget
+		ChunkEntry* entry = FindEntry(x, y, z);
+		MarkDirty(entry);
+
+		if (entry && entry->State != ChunkState_Meshing)
+		{
+			UpdateEntryBytes(entry);
+		}
+
+		for (int face = 0; face < 6; face++)
+		{
+			if (changed[i].BorderFaces & (1 << face))
+			{
+				int offset[3] = { 0, 0, 0 };
+				offset[face / 2] = (face & 1) ? 1 : -1;
+
+				MarkDirty(FindEntry(x + offset[0], y + offset[1], z + offset[2]));
+			}
+		}
+	}
+
+	_lighting.ClearChangedChunks();
+
+	_lightTimer.StopTimer();
+	_stats.LightMilliseconds += _lightTimer.GetTimingMilliseconds();
+}
+
+bool VoxelTerrain::RemeshDirtyChunks(ID3D11Device* device, ID3D11DeviceContext* deviceContext)
+{
+	size_t kept = 0;
+
+	_stats.RemeshedChunks = 0;
+	_stats.RemeshMilliseconds = 0.0f;
+
+	if (_dirtyChunks.empty())
+	{
+		return true;
+	}
+
+	_remeshTimer.StartTimer();
+
+	for (size_t i = 0; i < _dirtyChunks.size(); i++)
+	{
+		ChunkEntry* entry = _dirtyChunks[i];
+		int state = entry->State;
+
+		// A chunk being meshed copied its borders before the edit, so try it again next frame
+		if (state == ChunkState_Generating || state == ChunkState_Meshing)
+		{
+			_dirtyChunks[kept++] = entry;
+			continue;
+		}
+
+		entry->Dirty = false;
+
+		// Chunks that have not been meshed yet will pick the edit up when they are
+		if (state == ChunkState_Generated)
+		{
+			continue;
+		}
+
+		// Meshing a single chunk is quick enough to do here, which saves waiting behind the streaming jobs.
+		// The other levels of detail are out of date now, and are meshed again if the chunk moves to them.
+		UpdateBorders(entry, false);
+		entry->Chunk->InvalidateMeshes();
+
+		int lod = entry->Chunk->GetDrawLod();
+		if (lod > 0)
+		{
+			entry->Chunk->BuildLodMesh(lod);
+		}
+		else
+		{
+			entry->Chunk->BuildMesh(_meshMode);
+		}
+
+		if (UploadEntry(device, deviceContext, entry) < 0)
+		{
+			return false;
+		}
+
+		_stats.RemeshedChunks++;
+	}
+
+	_dirtyChunks.resize(kept);
+
+	_remeshTimer.StopTimer();
+	_stats.RemeshMilliseconds = _remeshTimer.GetTimingMilliseconds();
+
+	return true;
+}
+
+VoxelTerrain::ChunkEntry* VoxelTerrain::FindEntry(int x, int y, int z)
+{
+	std::unordered_map<long long, ChunkEntry*>::iterator it = _entries.find(GetKey(x, y, z));
+
+	return (it != _entries.end()) ? it->second : 0;
+}
+
+VoxelTerrain::ChunkEntry* VoxelTerrain::CreateEntry(int x, int y, int z)
+{
+	ChunkEntry* entry = new ChunkEntry;
+
+	entry->Chunk = new VoxelChunk;
+	entry->Chunk->SetModel(_model, _vertexCount);
+	entry->Chunk->SetGenerator(&_generator);
+	entry->Chunk->SetPosition(x, y, z);
+	entry->X = x;
+	entry->Y = y;
+	entry->Z = z;
+	entry->State = ChunkState_Generating;
+	entry->Bytes = 0;
+	entry->Dirty = false;
+	entry->Modified = false;
+	entry->Lit = false;
+
+	_lru.push_front(entry);
+	entry->LruPosition = _lru.begin();
+
+	_entries[GetKey(x, y, z)] = entry;
+	UpdateEntryBytes(entry);
+
+	return entry;
+}
+
+void VoxelTerrain::DestroyEntry(ChunkEntry* entry)
+{
+	// The entry must already be out of the LRU list
+	_entries.erase(GetKey(entry->X, entry->Y, entry->Z));
+	_residentBytes -= entry->Bytes;
+
+	delete entry->Chunk;
+	delete entry;
+}
+
+void VoxelTerrain::SubmitGenerate(ChunkEntry* entry)
+{
+	entry->State = ChunkState_Generating;
+	_jobsInFlight++;
+
+	_jobSystem->Submit([this, entry]()
+	{
+		// Chunks that were edited and saved are loaded back, which leaves them compacted already
+		bool loaded = _saveChunks && _regionStore.LoadChunk(*entry->Chunk);
+		if (loaded)
+		{
+			_loadedChunks++;
+		}
+		else
+		{
+			_generator.GenerateChunk(*entry->Chunk);
+
+			// Most chunks are air, solid rock or a thin band of surface between them, which an octree holds in
+			// a fraction of the memory
+			entry->Chunk->Compact();
+		}
+
+		VoxelLighting::LightChunk(*entry->Chunk, &_generator, loaded);
+
+		// Nothing else touches the chunk until it is generated, so its size can be counted from here
+		UpdateEntryBytes(entry);
+
+		entry->State = ChunkState_Generated;
+		_jobsInFlight--;
+	});
+}
+
+bool VoxelTerrain::SubmitMesh(ChunkEntry* entry, bool requireNeighbours, int lod)
+{
+	// Empty chunks have nothing to mesh whatever is around them, which is most of them above the ground
+	if (entry->Chunk->IsEmpty())
+	{
+		entry->Chunk->SetDrawLod(lod);
+		entry->State = ChunkState_Ready;
+		return true;
+	}
+
+	// The borders are copied here rather than in the job, so the job only touches its own chunk and the
+	// neighbours can be evicted at any time
+	if (!UpdateBorders(entry, requireNeighbours))
+	{
+		return false;
+	}
+
+	entry->State = ChunkState_Meshing;
+	_jobsInFlight++;
+
+	VoxelMeshMode meshMode = _meshMode;
+	_jobSystem->Submit([this, entry, meshMode, lod]()
+	{
+		if (lod > 0)
+		{
+			entry->Chunk->BuildLodMesh(lod);
+		}
+		else
+		{
+			entry->Chunk->BuildMesh(meshMode);
+		}
+
+		entry->State = ChunkState_Meshed;
+		_jobsInFlight--;
+	});
+
+	return true;
+}
+
+VoxelChunk* VoxelTerrain::GetCachedChunk(ChunkCache& cache, int x, int y, int z)
+{
+	long long key = GetKey(x, y, z);
+	int slot = ((x * 73856093) ^ (y * 19349663) ^ (z * 83492791)) & 63;
+	unsigned long long bit = (unsigned long long)1 << slot;
+
+	if (!(cache.Valid & bit) || cache.Keys[slot] != key)
+	{
+		cache.Valid |= bit;
+		cache.Keys[slot] = key;
+		cache.Chunks[slot] = GetChunk(x, y, z);
+	}
+
+	return cache.Chunks[slot];
+}
+
+bool VoxelTerrain::CastRay(const Ray& ray, ChunkCache& cache, RaycastHit& hit)
+{
+	const int size = VoxelChunk::CHUNK_SIZE;
+	float origin[3] = { ray.Origin.x, ray.Origin.y, ray.Origin.z };
+	float direction[3] = { ray.Direction.x, ray.Direction.y, ray.Direction.z };
+	int voxel[3], step[3], normal[3] = { 0, 0, 0 };
+	float tMax[3], tDelta[3];
+	float t = 0.0f;
+
+	hit.Hit = false;
+
+	float length = sqrtf((direction[0] * direction[0]) + (direction[1] * direction[1]) + (direction[2] * direction[2]));
+	if (length < 1e-6f)
+	{
+		return false;
+	}
+
+	// tMax is the distance along the ray to the next voxel boundary on each axis, and tDelta the distance between them
+	for (int i = 0; i < 3; i++)
+	{
+		direction[i] /= length;
+		voxel[i] = (int)floorf(origin[i]);
+
+		if (direction[i] > 0.0f)
+		{
+			step[i] = 1;
+			tDelta[i] = 1.0f / direction[i];
+			tMax[i] = ((voxel[i] + 1) - origin[i]) / direction[i];
+		}
+		else if (direction[i] < 0.0f)
+		{
+			step[i] = -1;
+			tDelta[i] = -1.0f / direction[i];
+			tMax[i] = (voxel[i] - origin[i]) / direction[i];
+		}
+		else
+		{
+			step[i] = 0;
+			tDelta[i] = FLT_MAX;
+			tMax[i] = FLT_MAX;
+		}
+	}
+
+	while (t <= ray.MaxDistance)
+	{
+		int chunk[3] = { VoxelToChunk(voxel[0]), VoxelToChunk(voxel[1]), VoxelToChunk(voxel[2]) };
+		VoxelChunk* current = GetCachedChunk(cache, chunk[0], chunk[1], chunk[2]);
+
+		// Nothing in this chunk can be hit, so jump straight to where the ray leaves it
+		if (!current || current->IsEmpty())
+		{
+			float exit = FLT_MAX;
+			int exitAxis = 0;
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (step[i] != 0)
+				{
+					float boundary = (float)((chunk[i] + ((step[i] > 0) ? 1 : 0)) * size);
+					float tExit = (boundary - origin[i]) / direction[i];
+
+					if (tExit < exit)
+					{
+						exit = tExit;
+						exitAxis = i;
+					}
+				}
+			}
+
+			t = (exit > t) ? exit : t;
+
+			for (int i = 0; i < 3; i++)
+			{
+				int first = chunk[i] * size;
+
+				if (i == exitAxis)
+				{
+					voxel[i] = (step[i] > 0) ? first + size : first - 1;
+				}
+				else
+				{
+					voxel[i] = (int)floorf(origin[i] + (direction[i] * t));
+					voxel[i] = (voxel[i] < first) ? first : ((voxel[i] > first + size - 1) ? first + size - 1 : voxel[i]);
+				}
+
+				if (step[i] != 0)
+				{
+					tMax[i] = ((voxel[i] + ((step[i] > 0) ? 1 : 0)) - origin[i]) / direction[i];
+				}
+
+				normal[i] = (i == exitAxis) ? -step[i] : 0;
+			}
+
+			continue;
+		}
+
+		// Step voxel by voxel until the ray hits something or leaves the chunk
+		int local[3] = { voxel[0] - (chunk[0] * size), voxel[1] - (chunk[1] * size), voxel[2] - (chunk[2] * size) };
+
+		while (t <= ray.MaxDistance)
+		{
+			if (current->IsActive(local[0], local[1], local[2]))
+			{
+				hit.Hit = true;
+				hit.X = voxel[0];
+				hit.Y = voxel[1];
+				hit.Z = voxel[2];
+				hit.NormalX = normal[0];
+				hit.NormalY = normal[1];
+				hit.NormalZ = normal[2];
+				hit.Distance = t;
+				hit.Type = current->GetBlockType(local[0], local[1], local[2]);
+
+				return true;
+			}
+
+			int axis = (tMax[0] < tMax[1]) ? ((tMax[0] < tMax[2]) ? 0 : 2) : ((tMax[1] < tMax[2]) ? 1 : 2);
+
+			t = tMax[axis];
+			tMax[axis] += tDelta[axis];
+			voxel[axis] += step[axis];
+			local[axis] += step[axis];
+
+			normal[0] = 0;
+			normal[1] = 0;
+			normal[2] = 0;
+			normal[axis] = -step[axis];
+
+			if (local[axis] < 0 || local[axis] >= size)
+			{
+				break;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool VoxelTerrain::UpdateBorders(ChunkEntry* entry, bool requireNeighbours)
+{
+	bool diagonals = UsesDiagonalNeighbours();
+	const VoxelChunk* neighbours[27];
+
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				int index = VoxelChunk::GetNeighbourIndex(dx, dy, dz);
+				int offAxes = (dx != 0) + (dy != 0) + (dz != 0);
+
+				if (offAxes == 0 || (offAxes > 1 && !diagonals))
+				{
+					neighbours[index] = 0;
+					continue;
+				}
+
+				neighbours[index] = GetChunk(entry->X + dx, entry->Y + dy, entry->Z + dz);
+				if (!neighbours[index] && requireNeighbours)
 				{
 					return false;
 				}
@@ -35,22 +1075,98 @@ bool VoxelTerrain::Initialize(ID3D11Device * device, char * modelFilename, int t
 		}
 	}
 
+	const VoxelChunk* sides[6] =
+	{
+		neighbours[VoxelChunk::GetNeighbourIndex(-1, 0, 0)], neighbours[VoxelChunk::GetNeighbourIndex(1, 0, 0)],
+		neighbours[VoxelChunk::GetNeighbourIndex(0, -1, 0)], neighbours[VoxelChunk::GetNeighbourIndex(0, 1, 0)],
+		neighbours[VoxelChunk::GetNeighbourIndex(0, 0, -1)], neighbours[VoxelChunk::GetNeighbourIndex(0, 0, 1)],
+	};
+
+	entry->Chunk->UpdateBorders(sides);
+	entry->Chunk->UpdateLightBorders(sides);
+
+	if (diagonals)
+	{
+		entry->Chunk->UpdateDiagonalBorders(neighbours);
+	}
+
 	return true;
 }
 
-void VoxelTerrain::Render(ID3D11DeviceContext * deviceContext, int x, int y, int z)
+int VoxelTerrain::UploadEntry(ID3D11Device* device, ID3D11DeviceContext* deviceContext, ChunkEntry* entry)
+{
+	bool result;
+
+	result = entry->Chunk->UploadMesh(device, deviceContext);
+	if (!result)
+	{
+		return -1;
+	}
+
+	UpdateEntryBytes(entry);
+	entry->State = ChunkState_Ready;
+
+	// Return how much was copied to the device, which can be less than the buffers hold
+	return (entry->Chunk->GetVertexCount() * entry->Chunk->GetVertexStride()) + (entry->Chunk->GetIndexCount() * sizeof(unsigned long));
+}
+
+void VoxelTerrain::UpdateEntryBytes(ChunkEntry* entry)
+{
+	// Only whoever has the chunk to itself can call this, the job building it or the main thread between jobs
+	int bytes = entry->Chunk->GetMemoryUsage() + entry->Chunk->GetBufferBytes() + sizeof(ChunkEntry);
+
+	_residentBytes += bytes - entry->Bytes;
+	entry->Bytes = bytes;
+}
+
+bool VoxelTerrain::SaveEntry(ChunkEntry* entry)
+{
+	if (!_saveChunks || !_regionStore.SaveChunk(*entry->Chunk))
+	{
+		return false;
+	}
+
+	entry->Modified = false;
+	_savedChunks++;
+
+	return true;
+}
+
+int VoxelTerrain::GetLod(int distanceSquared) const
+{
+	// The smooth surface has no coarser meshes
+	if (_lodDistance <= 0 || _meshMode == VoxelMeshMode_SurfaceNets)
+	{
+		return 0;
+	}
+
+	int lod = 0;
+	long long distance = _lodDistance;
+
+	while (lod < VoxelChunk::LOD_COUNT - 1 && distanceSquared >= distance * distance)
+	{
+		lod++;
+		distance *= 2;
+	}
+
+	return lod;
+}
+
+long long VoxelTerrain::GetKey(int x, int y, int z)
 {
-	_chunk[x][y][z].Render(deviceContext);
+	// 21 bits for each coordinate, a million chunks either way along each axis
+	return ((long long)(x & 0x1FFFFF) << 42) | ((long long)(y & 0x1FFFFF) << 21) | (long long)(z & 0x1FFFFF);
 }
 
-int VoxelTerrain::GetIndexCount(int x, int y, int z)
+int VoxelTerrain::FloorToChunk(float position)
 {
-	return _chunk[x][y][z].GetIndexCount();
+	return (int)floorf(position / VoxelChunk::CHUNK_SIZE);
 }
 
-bool VoxelTerrain::HasBlocks(int x, int y, int z)
+int VoxelTerrain::VoxelToChunk(int voxel)
 {
-	return _chunk[x][y][z].HasBlocks();
+	// Round towards negative infinity so the voxels just below zero land in chunk -1
+	return (voxel >= 0) ? (voxel / VoxelChunk::CHUNK_SIZE) : (((voxel + 1) / VoxelChunk::CHUNK_SIZE) - 1);
 }
 
 bool VoxelTerrain::LoadModel(char * filename)
@@ -1,26 +1,261 @@
 #pragma once
 
 #include "VoxelChunk.h"
+#include "VoxelGenerator.h"
+#include "VoxelLighting.h"
+#include "VoxelRegionStore.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include "Timer.h"
+
+#include <atomic>
 #include <fstream>
+#include <list>
+#include <unordered_map>
+#include <vector>
 
+// A world of chunks keyed by chunk coordinate that is streamed in around the camera. Chunks are generated and meshed
+// on the job system, nearest and visible first, and their buffers are created on the device thread within a per frame
+// budget. Chunks left behind stay cached until the memory budget is reached, when the least recently used chunks
+// beyond the hysteresis radius are evicted. The world has no edges, so it can be far larger than fits in memory.
 class VoxelTerrain
 {
 public:
+	struct StreamingStats
+	{
+		int			ResidentChunks;		// Chunks held in memory, in any state
+		int			QueuedChunks;		// Chunks in view waiting to be generated or meshed
+		int			ChunksInFlight;		// Chunks being generated or meshed on the job system
+		int			UploadedChunks;		// Chunks that had their buffers created this frame
+		int			UploadedBytes;		// Bytes of vertex and index data created this frame
+		int			EvictedChunks;		// Chunks evicted this frame
+		int			RemeshedChunks;		// Edited chunks remeshed this frame
+		float		RemeshMilliseconds;	// Time spent remeshing the edited chunks this frame
+		int			LitVoxels;			// Voxels the light fills visited this frame
+		float		LightMilliseconds;	// Time spent spreading light this frame
+		long long	ResidentBytes;		// Memory held by the resident chunks, counted against the budget
+		int			LoadedChunks;		// Chunks read back from the region files since the terrain was initialized
+		int			SavedChunks;		// Edited chunks written to the region files since the terrain was initialized
+		int			VisitedChunks;		// Chunks the visibility search reached this frame
+		int			CulledChunks;		// Chunks in range with geometry left out of the draw list this frame
+		int			DrawnChunks;		// Chunks in the draw list this frame
+		int			DrawnTriangles;		// Triangles in the chunks of the draw list this frame
+		int			LodChunks[VoxelChunk::LOD_COUNT];	// Chunks in the draw list at each level of detail
+	};
+
+	struct StorageStats
+	{
+		int			UniformChunks;		// Chunks with every voxel the same, holding a single value
+		int			OctreeChunks;		// Chunks held in a sparse voxel octree
+		int			DenseChunks;		// Chunks held in a dense array, which is every edited chunk
+		long long	VoxelBytes;			// Memory held by the voxels of those chunks
+		long long	DenseVoxelBytes;	// Memory the same chunks would hold if they were all dense
+	};
+
+	struct Ray
+	{
+		XMFLOAT3	Origin;
+		XMFLOAT3	Direction;			// Need not be normalized
+		float		MaxDistance;
+	};
+
+	struct RaycastHit
+	{
+		bool		Hit;
+		int			X, Y, Z;			// The world voxel coordinate of the voxel hit
+		int			NormalX, NormalY, NormalZ;	// The face the ray entered through, all zero when it starts inside the voxel
+		float		Distance;			// How far along the ray the voxel was entered
+		BlockType	Type;
+	};
+
 	VoxelTerrain();
 
-	bool Initialize(ID3D11Device* device, char* modelFilename, int textureIndex);
+	// Chunks are drawn out to viewRadius chunks from the camera, and memoryBudget is in megabytes. Edited chunks are
+	// saved to region files in saveDirectory when they are evicted or the terrain is destroyed, and are loaded from
+	// them in place of being generated. Without a saveDirectory edited chunks are never evicted and are lost on exit.
+	bool Initialize(char* modelFilename, int textureIndex, VoxelMeshMode meshMode, JobSystem* jobSystem, float planetRadius, int viewRadius, int memoryBudget, const char* saveDirectory);
+	void Destroy();
+
+	// Saves every edited chunk that is not being built, returning false if any could not be saved
+	bool SaveModifiedChunks();
+
+	bool Update(ID3D11Device* device, ID3D11DeviceContext* deviceContext, XMFLOAT3 cameraPosition, Frustum* frustum);
+
+	// Edit the voxel at a world voxel coordinate. The light is spread and the chunks affected are remeshed once by
+	// the next Update, however many of their voxels change. Returns false when the voxels chunk is not loaded or is
+	// being built.
+	bool SetVoxel(int x, int y, int z, BlockType blockType);
+	bool ClearVoxel(int x, int y, int z);
+
+	// Sets or clears every voxel whose centre is within radius of the given point, returning the number changed
+	int ApplyBrush(XMFLOAT3 centre, float radius, bool active, BlockType blockType);
 
-	void Render(ID3D11DeviceContext* deviceContext, int x, int y, int z);
+	// Spreads the light of the edits made so far straight away, marking the chunks it reaches for remeshing.
+	// Update does this itself, so it is only needed to see the light before then.
+	void PropagateLight();
 
-	int GetIndexCount(int x, int y, int z);
-	bool HasBlocks(int x, int y, int z);
+	// Walks the voxels along a ray with the Amanatides and Woo traversal, stopping at the first active voxel.
+	// Chunks that are empty or not loaded are crossed in a single step. The voxel beside the hit, for placing a
+	// block, is the hit voxel plus its normal. Call from the thread that calls Update.
+	bool Raycast(const Ray& ray, RaycastHit& hit);
 
-	static const int CHUNK_COUNT = 1;
+	// Casts many rays, sharing the chunk lookups between them. Returns the number of rays that hit.
+	int RaycastBatch(const Ray* rays, int count, RaycastHit* hits);
+
+	// With cave culling on, the draw list only holds the chunks the camera can see through the empty voxels of the
+	// chunks in front of them and that are inside the frustum. It is on by default.
+	void SetCaveCulling(bool enabled) { _caveCulling = enabled; }
+
+	// Chunks from lodDistance chunks away are meshed at half the detail, and each time the distance doubles the
+	// detail halves again, down to 8 voxels to a chunk. A chunk keeps drawing at its old level while the new one is
+	// built. Zero, the default, meshes every chunk at full detail, as does the smooth surface.
+	void SetLodDistance(int lodDistance) { _lodDistance = lodDistance; }
+
+	// The chunks in view with geometry, nearest first, as of the last Update
+	const std::vector<VoxelChunk*>& GetDrawList() { return _drawList; }
+	const StreamingStats& GetStats() { return _stats; }
+
+	// Counts how the generated chunks hold their voxels. This walks every resident chunk, so call it now and then.
+	void GetStorageStats(StorageStats& stats);
+
+	VoxelChunk::ModelType* GetModel() { return _model; }
+	int GetModelVertexCount() { return _vertexCount; }
+
+	// The chunk at the given chunk coordinate, or null when it is not resident or has not been generated yet
+	VoxelChunk* GetChunk(int x, int y, int z);
+
+	// Generate or mesh every chunk in a box of chunk coordinates straight away, waiting on the job system.
+	// Meshes built this way are uploaded by the next Update.
+	void GenerateRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+	void MeshRegion(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+	static const int HYSTERESIS = 2;
+	static const int MAX_JOBS_IN_FLIGHT = 64;
+	static const int MAX_JOBS_PER_FRAME_WITHOUT_WORKERS = 4;
+	static const int UPLOAD_BUDGET = 4 * 1024 * 1024;
 
 private:
+	enum ChunkState
+	{
+		ChunkState_Generating = 0,
+		ChunkState_Generated,
+		ChunkState_Meshing,
+		ChunkState_Meshed,
+		ChunkState_Ready,
+	};
+
+	struct ChunkEntry
+	{
+		VoxelChunk*							Chunk;
+		int									X, Y, Z;
+		std::atomic<int>					State;
+		int									Bytes;
+		std::list<ChunkEntry*>::iterator	LruPosition;
+
+		// Dirty chunks are waiting to be remeshed, and modified chunks have edits that have not been saved
+		bool								Dirty;
+		bool								Modified;
+
+		// Lit chunks have had their light joined up with the chunks around them
+		bool								Lit;
+	};
+
+	// The chunks found along the rays of a batch, direct mapped by chunk coordinate, which saves most of the map
+	// lookups as rays cast from near one another cross the same chunks
+	struct ChunkCache
+	{
+		unsigned long long	Valid;
+		long long			Keys[64];
+		VoxelChunk*			Chunks[64];
+	};
+
+	// A chunk reached by the visibility search, relative to the camera chunk, with the face it was entered through
+	// (-1 for the camera chunk) and a bit for each direction the search has stepped in to get there
+	struct VisibilityStep
+	{
+		int			X, Y, Z;
+		int			EnteredFace;
+		int			Directions;
+	};
+
+	struct LoadRequest
+	{
+		int			X, Y, Z;
+		float		Priority;
+		bool		InRange;
+		int			Lod;
+
+		bool operator<(const LoadRequest& other) const { return Priority < other.Priority; }
+	};
+
 	bool LoadModel(char* filename);
 
-	int						_vertexCount, _indexCount;
-	VoxelChunk***			_chunk;
-	VoxelChunk::ModelType*	_model;
-};
\ No newline at end of file
+	void BuildLoadRequests(XMFLOAT3 cameraPosition, Frustum* frustum);
+	void EvictChunks();
+	void BuildDrawList(Frustum* frustum);
+
+	bool EditVoxel(int x, int y, int z, bool active, BlockType blockType);
+	void MarkDirty(ChunkEntry* entry);
+	void LightEntry(ChunkEntry* entry);
+	bool RemeshDirtyChunks(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+
+	ChunkEntry* FindEntry(int x, int y, int z);
+	ChunkEntry* CreateEntry(int x, int y, int z);
+	void DestroyEntry(ChunkEntry* entry);
+
+	void SubmitGenerate(ChunkEntry* entry);
+	bool SubmitMesh(ChunkEntry* entry, bool requireNeighbours, int lod);
+	bool UpdateBorders(ChunkEntry* entry, bool requireNeighbours);
+	int UploadEntry(ID3D11Device* device, ID3D11DeviceContext* deviceContext, ChunkEntry* entry);
+	void UpdateEntryBytes(ChunkEntry* entry);
+	bool SaveEntry(ChunkEntry* entry);
+
+	VoxelChunk* GetCachedChunk(ChunkCache& cache, int x, int y, int z);
+	bool CastRay(const Ray& ray, ChunkCache& cache, RaycastHit& hit);
+
+	// The smooth surface and the ambient occlusion of the binary meshers both look at the chunks diagonally across
+	bool UsesDiagonalNeighbours() const
+	{
+		return _meshMode == VoxelMeshMode_SurfaceNets || _meshMode == VoxelMeshMode_Binary || _meshMode == VoxelMeshMode_BinaryGreedy;
+	}
+	int GetLod(int distanceSquared) const;
+
+	// Chunks are drawn from when they are generated until they are evicted, whatever level of detail is being built
+	static bool IsDrawable(ChunkEntry* entry, int state) { return state != ChunkState_Generating && entry->Chunk->HasBlocks(); }
+
+	static long long GetKey(int x, int y, int z);
+	static int FloorToChunk(float position);
+	static int VoxelToChunk(int voxel);
+
+	int										_vertexCount, _indexCount;
+	VoxelChunk::ModelType*					_model;
+	VoxelGenerator							_generator;
+	VoxelRegionStore						_regionStore;
+	bool									_saveChunks;
+	VoxelLighting							_lighting;
+
+	VoxelMeshMode							_meshMode;
+	JobSystem*								_jobSystem;
+	int										_viewRadius, _loadRadius;
+	int										_lodDistance;
+	long long								_memoryBudget;
+
+	// Every resident chunk, and the same chunks ordered from most to least recently in range of the camera
+	std::unordered_map<long long, ChunkEntry*>	_entries;
+	std::list<ChunkEntry*>					_lru;
+	std::atomic<int>						_jobsInFlight;
+	std::atomic<long long>					_residentBytes;
+	std::atomic<int>						_loadedChunks;
+	int										_savedChunks;
+	int										_cameraChunk[3];
+
+	std::vector<ChunkEntry*>				_dirtyChunks;
+	std::vector<LoadRequest>				_loadRequests;
+	std::vector<VoxelChunk*>				_drawList;
+	bool									_caveCulling;
+	std::vector<unsigned char>				_visibleChunks;
+	std::vector<VisibilityStep>				_visibilityQueue;
+	StreamingStats							_stats;
+	Timer									_remeshTimer;
+	Timer									_lightTimer;
+};